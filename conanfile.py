@@ -92,6 +92,11 @@ class SISLConan(ConanFile):
             self.requires("folly/nu2.2023.12.18.00", transitive_headers=True)
             self.requires("prometheus-cpp/1.1.0", transitive_headers=True)
             self.requires("userspace-rcu/nu2.0.14.0", transitive_headers=True)
+            self.requires("xxhash/0.8.2")
+            self.requires("lz4/1.9.4")
+            self.requires("snappy/1.1.10")
+            self.requires("zstd/1.5.5")
+            self.requires("zlib/1.3.1")
             self.requires("libcurl/8.4.0",  override=True)
             self.requires("xz_utils/5.4.5",  override=True)
 
@@ -217,12 +222,23 @@ class SISLConan(ConanFile):
                     "folly::folly",
                     "prometheus-cpp::prometheus-cpp",
                     ])
+            self.cpp_info.components["metrics_http"].libs = ["sisl_metrics_http"]
+            self.cpp_info.components["metrics_http"].set_property("pkg_config_name", f"libsisl_metrics_http")
+            self.cpp_info.components["metrics_http"].requires.extend([
+                    "metrics",
+                    "sobject",
+                    "zlib::zlib",
+                    ])
             self.cpp_info.components["buffer"].libs = ["sisl_buffer"]
             self.cpp_info.components["buffer"].set_property("pkg_config_name", f"libsisl_buffer")
             self.cpp_info.components["buffer"].requires.extend([
                     "metrics",
                     "folly::folly",
                     "userspace-rcu::userspace-rcu",
+                    "xxhash::xxhash",
+                    "lz4::lz4",
+                    "snappy::snappy",
+                    "zstd::zstd",
                     ])
 
             self.cpp_info.components["cache"].libs = ["sisl_cache"]
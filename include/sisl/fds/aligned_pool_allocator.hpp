@@ -0,0 +1,199 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#if defined __clang__ or defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wattributes"
+#endif
+#include <folly/ThreadLocal.h>
+#if defined __clang__ or defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include "buffer.hpp"
+
+namespace sisl {
+
+class AlignedPoolMetrics : public MetricsGroup {
+public:
+    AlignedPoolMetrics(const AlignedPoolMetrics&) = delete;
+    AlignedPoolMetrics(AlignedPoolMetrics&&) noexcept = delete;
+    AlignedPoolMetrics& operator=(const AlignedPoolMetrics&) = delete;
+    AlignedPoolMetrics& operator=(AlignedPoolMetrics&&) noexcept = delete;
+
+    AlignedPoolMetrics() : MetricsGroup("AlignedPoolAllocation", "Singleton") {
+        for (auto t{(uint8_t)buftag::common}; t < (uint8_t)buftag::sentinel; ++t) {
+            const std::string prefix = "buftag_" + enum_name((buftag)t);
+            m_hit_idx[t] = m_impl_ptr->register_counter(prefix + "_pool_hit",
+                                                        prefix + ": Number of allocs served from thread cache/depot");
+            m_miss_idx[t] = m_impl_ptr->register_counter(prefix + "_pool_miss",
+                                                         prefix + ": Number of allocs which carved a new buffer");
+        }
+        m_depot_get_idx = m_impl_ptr->register_counter("pool_depot_get", "Number of batches taken from depot");
+        m_depot_put_idx = m_impl_ptr->register_counter("pool_depot_put", "Number of batches handed over to depot");
+        m_large_alloc_idx = m_impl_ptr->register_counter("pool_large_alloc", "Number of allocs larger than pooled");
+        m_large_remap_idx = m_impl_ptr->register_counter("pool_large_remap", "Number of reallocs done with mremap");
+        register_me_to_farm();
+    }
+
+    void hit(const buftag tag) { m_impl_ptr->counter_increment(m_hit_idx[(size_t)tag]); }
+    void miss(const buftag tag) { m_impl_ptr->counter_increment(m_miss_idx[(size_t)tag]); }
+    void depot_get() { m_impl_ptr->counter_increment(m_depot_get_idx); }
+    void depot_put() { m_impl_ptr->counter_increment(m_depot_put_idx); }
+    void large_alloc() { m_impl_ptr->counter_increment(m_large_alloc_idx); }
+    void large_remap() { m_impl_ptr->counter_increment(m_large_remap_idx); }
+
+private:
+    std::array< size_t, (size_t)buftag::sentinel > m_hit_idx;
+    std::array< size_t, (size_t)buftag::sentinel > m_miss_idx;
+    size_t m_depot_get_idx;
+    size_t m_depot_put_idx;
+    size_t m_large_alloc_idx;
+    size_t m_large_remap_idx;
+};
+
+/**
+ * @brief Pooling implementation of AlignedAllocatorImpl for I/O buffers, installed with
+ * AlignedAllocator::instance().set_allocator(new AlignedPoolAllocatorImpl()).
+ *
+ * Sizes upto max_class_size are rounded up to power of 2 size classes, which are pooled separately for every buftag.
+ * Each thread keeps a small cache of free buffers per tag and size class and exchanges batches of them with a global
+ * depot when the cache runs dry or overflows. Buffers are carved out of chunk_size regions, which are optionally
+ * backed by huge pages. A buffer of a size class is always aligned to the class size.
+ *
+ * The size class and tag of a buffer are looked up from its address on free, through a 2 level page map of chunks,
+ * so there is no per buffer header. Larger buffers are mapped directly, which allows aligned_realloc to grow them in
+ * place (or have kernel move the pages) with mremap instead of copying. Buffers not allocated by the pool are passed
+ * through to std::free.
+ *
+ * Chunks are not unmapped till the allocator is destroyed, at which point all buffers allocated by it should have
+ * been freed. trim() gives the pages of the free buffers held in the depots, and of the chunks not carved yet, back to
+ * the OS while keeping them mapped for reuse. Buffers smaller than a page and those in the thread caches are not
+ * trimmed.
+ */
+class AlignedPoolAllocatorImpl : public AlignedAllocatorImpl {
+public:
+    static constexpr size_t min_class_size{512};
+    static constexpr size_t max_class_size{1024 * 1024};
+    static constexpr uint8_t num_classes{12}; // min_class_size << (num_classes - 1) == max_class_size
+    static constexpr size_t chunk_size{2 * 1024 * 1024};
+    static constexpr size_t thread_cache_bytes{2 * 1024 * 1024}; // Per tag and size class
+    static_assert((min_class_size << (num_classes - 1)) == max_class_size, "Size classes do not add up");
+    static_assert(max_class_size <= chunk_size, "Chunk should fit atleast one buffer of the largest class");
+
+    explicit AlignedPoolAllocatorImpl(const bool huge_pages = false);
+    AlignedPoolAllocatorImpl(const AlignedPoolAllocatorImpl&) = delete;
+    AlignedPoolAllocatorImpl(AlignedPoolAllocatorImpl&&) noexcept = delete;
+    AlignedPoolAllocatorImpl& operator=(const AlignedPoolAllocatorImpl&) noexcept = delete;
+    AlignedPoolAllocatorImpl& operator=(AlignedPoolAllocatorImpl&&) noexcept = delete;
+    ~AlignedPoolAllocatorImpl() override;
+
+    uint8_t* aligned_alloc(const size_t align, const size_t sz, const sisl::buftag tag) override;
+    void aligned_free(uint8_t* const b, const sisl::buftag tag) override;
+    uint8_t* aligned_realloc(uint8_t* const old_buf, const size_t align, const size_t new_sz,
+                             const size_t old_sz = 0) override;
+
+    uint8_t* aligned_pool_alloc(const size_t align, const size_t sz, const sisl::buftag tag) override {
+        return aligned_alloc(align, sz, tag);
+    }
+    void aligned_pool_free(uint8_t* const b, const size_t, const sisl::buftag tag) override { aligned_free(b, tag); }
+
+    size_t buf_size(uint8_t* buf) const override;
+
+    /**
+     * @brief Release the pages of free buffers in the depots to the OS with madvise(MADV_DONTNEED). Buffers stay in
+     * the pool and are faulted back in, zero filled, when reused.
+     *
+     * @return Number of bytes released
+     */
+    size_t trim();
+
+    AlignedPoolMetrics& pool_metrics() { return m_metrics; }
+
+private:
+    typedef std::array< std::array< std::vector< uint8_t* >, num_classes >, (size_t)buftag::sentinel > bins_t;
+
+    struct thread_cache {
+        AlignedPoolAllocatorImpl* pool;
+        bins_t bins;
+
+        explicit thread_cache(AlignedPoolAllocatorImpl* p) : pool{p} {}
+        thread_cache(const thread_cache&) = delete;
+        thread_cache(thread_cache&&) noexcept = delete;
+        thread_cache& operator=(const thread_cache&) = delete;
+        thread_cache& operator=(thread_cache&&) noexcept = delete;
+        ~thread_cache();
+    };
+
+    struct depot {
+        std::mutex mtx;
+        std::vector< uint8_t* > bufs;
+        size_t trimmed{0};           // Leading bufs whose pages are already released
+        uint8_t* carve_cur{nullptr}; // Unused part of the chunk currently being carved
+        uint8_t* carve_end{nullptr};
+    };
+
+    // Page map entry is (tag << 8 | (size class + 1)) of the chunk, 0 if the chunk is not from the pool
+    static constexpr uint8_t chunk_shift{21};
+    static constexpr uint8_t pagemap_leaf_bits{13};
+    static constexpr uint8_t pagemap_root_bits{48 - chunk_shift - pagemap_leaf_bits};
+    static_assert((size_t{1} << chunk_shift) == chunk_size, "Chunk shift does not match chunk size");
+    typedef std::array< std::atomic< uint16_t >, (size_t{1} << pagemap_leaf_bits) > pagemap_leaf_t;
+
+    static uint8_t size_class(const size_t sz, const size_t align);
+    static size_t class_size(const uint8_t cls) { return min_class_size << cls; }
+    static size_t cache_capacity(const uint8_t cls);
+
+    thread_cache& local_cache();
+    uint8_t* refill(const buftag tag, const uint8_t cls, std::vector< uint8_t* >& bin);
+    void flush(const buftag tag, const uint8_t cls, std::vector< uint8_t* >& bin, const size_t count);
+    uint8_t* carve(const buftag tag, const uint8_t cls, depot& d);
+
+    uint16_t pagemap_get(const uint8_t* const buf) const;
+    bool pagemap_set(const uint8_t* const chunk, const uint16_t entry);
+
+    uint8_t* large_alloc(const size_t sz);
+    size_t large_size(uint8_t* const buf) const;
+
+private:
+    const bool m_huge_pages;
+    std::array< std::array< depot, num_classes >, (size_t)buftag::sentinel > m_depots;
+
+    std::mutex m_chunks_mtx;
+    std::vector< uint8_t* > m_chunks;
+    std::array< std::atomic< pagemap_leaf_t* >, (size_t{1} << pagemap_root_bits) > m_pagemap;
+
+    mutable std::mutex m_large_mtx;
+    std::unordered_map< uint8_t*, size_t > m_large_bufs;
+
+    AlignedPoolMetrics m_metrics;
+
+    // Declared last, so that thread caches are handed back to the depots before anything else is destroyed
+    folly::ThreadLocalPtr< thread_cache > m_caches;
+};
+
+} // namespace sisl
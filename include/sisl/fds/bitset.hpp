@@ -41,6 +41,7 @@
 #include <sisl/logging/logging.h>
 #include "bitword.hpp"
 #include "buffer.hpp"
+#include "rank_select.hpp"
 
 //
 // This is a improved bitset, which can efficiently identify and get the leading bitset or reset
@@ -183,6 +184,7 @@ private:
     sisl::byte_array m_buf;
     bitset_serialized* m_s{nullptr};
     mutable folly::SharedMutex m_lock;
+    RankSelectDirectory< bitword_type > m_rank_dir;
     static constexpr uint64_t m_word_mask{bitword_type::bits() - 1};
 
 #ifndef NDEBUG
@@ -289,6 +291,7 @@ public:
                 if (m_buf != rhs.m_buf) {
                     m_buf = rhs.m_buf;
                     m_s = rhs.m_s;
+                    m_rank_dir.invalidate();
                 }
             }
         }
@@ -304,6 +307,7 @@ public:
                 if (m_buf != rhs.m_buf) {
                     m_buf = std::move(rhs.m_buf);
                     m_s = std::move(rhs.m_s);
+                    m_rank_dir.invalidate();
                 } else {
                     // already sharing same buffer so just clear
                     rhs.m_buf.reset();
@@ -520,6 +524,7 @@ public:
                     }
                 }
             }
+            m_rank_dir.invalidate();
         }
     }
 
@@ -624,6 +629,7 @@ public:
                     }
                 }
             }
+            m_rank_dir.invalidate();
         }
     }
 
@@ -768,6 +774,98 @@ public:
         return set_cnt;
     }
 
+    /**
+     * @brief Get the number of set bits before the given bit (rank). The first rank/select after any mutation builds
+     * a directory of set counts per 512 bit superblock, subsequent calls are O(1).
+     *
+     * NOTE: The directory is per instance and is invalidated by mutations made through this instance only. Shared
+     * copies (copy constructed/assigned) mutating the same underlying buffer do not invalidate each other.
+     *
+     * @param bit Bit upto which (exclusive) set bits are counted; must be <= size()
+     * @return uint64_t Count of set bits in [0, bit)
+     */
+    uint64_t rank(const uint64_t bit) const {
+        ReadLockGuard lock{this};
+        assert(bit <= total_bits());
+        return rank_dir_lookup([this, bit](const auto& table) {
+            return table.rank(bit + m_s->m_skip_bits) - table.rank(m_s->m_skip_bits);
+        });
+    }
+
+    /**
+     * @brief Get the position of the nth (0 based) set bit (select). Uses the same lazily built directory as rank
+     * and does a binary search over the superblocks.
+     *
+     * @param n Count of set bits to skip
+     * @return uint64_t Position of the nth set bit or npos if there are not that many set bits
+     */
+    uint64_t select(const uint64_t n) const {
+        ReadLockGuard lock{this};
+        const uint64_t bit{rank_dir_lookup(
+            [this, n](const auto& table) { return table.select(n + table.rank(m_s->m_skip_bits)); })};
+        return ((bit == m_rank_dir.npos) || (bit >= m_s->m_nbits)) ? npos : (bit - m_s->m_skip_bits);
+    }
+
+    /**
+     * @brief Bitwise combine the bits of other bitset into this bitset in the range [start_bit, end_bit] inclusive.
+     * Only the range common to both bitsets is processed, bits of this bitset outside of it are left untouched.
+     * Word aligned ranges are processed a whole word at a time in a loop the compiler can vectorize; a differing
+     * shrink_head offset between the two bitsets is handled by realigning the other bitset's words on the fly.
+     *
+     * NOTE: On AtomicBitset/ThreadSafeBitset each word is updated with a compare and swap, so concurrent set/reset of
+     * bits of this bitset are not lost, though the operation as a whole is not atomic. Callers wanting to parallelize
+     * on large bitsets can issue the range version on disjoint ranges from different threads.
+     *
+     * @param other Bitset to combine with
+     * @param start_bit Start bit of the range
+     * @param end_bit End bit of the range inclusive; if larger than total bits to end
+     */
+    void and_with(const BitsetImpl& other, const uint64_t start_bit = 0,
+                  const uint64_t end_bit = std::numeric_limits< uint64_t >::max()) {
+        bitwise_op< true >(other, start_bit, end_bit, [](const word_t l, const word_t r) { return l & r; });
+    }
+
+    void or_with(const BitsetImpl& other, const uint64_t start_bit = 0,
+                 const uint64_t end_bit = std::numeric_limits< uint64_t >::max()) {
+        bitwise_op< true >(other, start_bit, end_bit, [](const word_t l, const word_t r) { return l | r; });
+    }
+
+    void xor_with(const BitsetImpl& other, const uint64_t start_bit = 0,
+                  const uint64_t end_bit = std::numeric_limits< uint64_t >::max()) {
+        bitwise_op< true >(other, start_bit, end_bit, [](const word_t l, const word_t r) { return l ^ r; });
+    }
+
+    void andnot_with(const BitsetImpl& other, const uint64_t start_bit = 0,
+                     const uint64_t end_bit = std::numeric_limits< uint64_t >::max()) {
+        bitwise_op< true >(other, start_bit, end_bit, [](const word_t l, const word_t r) { return l & ~r; });
+    }
+
+    /**
+     * @brief Get the number of bits set in the result of (this OP other) in the range [start_bit, end_bit] inclusive
+     * without modifying either bitset. Range semantics are same as and_with/or_with/xor_with/andnot_with.
+     *
+     * @return returns the number of bits set in the combined result
+     */
+    uint64_t get_and_count(const BitsetImpl& other, const uint64_t start_bit = 0,
+                           const uint64_t end_bit = std::numeric_limits< uint64_t >::max()) const {
+        return bitwise_op< false >(other, start_bit, end_bit, [](const word_t l, const word_t r) { return l & r; });
+    }
+
+    uint64_t get_or_count(const BitsetImpl& other, const uint64_t start_bit = 0,
+                          const uint64_t end_bit = std::numeric_limits< uint64_t >::max()) const {
+        return bitwise_op< false >(other, start_bit, end_bit, [](const word_t l, const word_t r) { return l | r; });
+    }
+
+    uint64_t get_xor_count(const BitsetImpl& other, const uint64_t start_bit = 0,
+                           const uint64_t end_bit = std::numeric_limits< uint64_t >::max()) const {
+        return bitwise_op< false >(other, start_bit, end_bit, [](const word_t l, const word_t r) { return l ^ r; });
+    }
+
+    uint64_t get_andnot_count(const BitsetImpl& other, const uint64_t start_bit = 0,
+                              const uint64_t end_bit = std::numeric_limits< uint64_t >::max()) const {
+        return bitwise_op< false >(other, start_bit, end_bit, [](const word_t l, const word_t r) { return l & ~r; });
+    }
+
     /**
      * @brief Set the bit. If the bit is outside the available range throws std::out_of_range exception
      *
@@ -1093,6 +1191,7 @@ private:
             current_bit += count;
             bits_remaining -= count;
         }
+        m_rank_dir.invalidate();
 
         if (bits_remaining > 0) { throw std::out_of_range("Set/Reset bits not in range"); }
     }
@@ -1105,6 +1204,7 @@ private:
         if (!word_ptr) { return; }
         const uint8_t offset{get_word_offset(bit)};
         word_ptr->set_reset_bits(offset, 1, value);
+        m_rank_dir.invalidate();
     }
 
     bool is_bits_set_reset(const uint64_t start, const uint64_t nbits, const bool expected) const {
@@ -1135,6 +1235,77 @@ private:
         return (bits_remaining == 0);
     }
 
+    // Combine other into this (if Modify) with op and return the set count of the combined result
+    template < const bool Modify, typename OpT >
+    uint64_t bitwise_op(const BitsetImpl& other, const uint64_t start_bit, const uint64_t end_bit,
+                        const OpT& op) const {
+        ReadLockGuard lock{this};
+        if (this == &other) { return bitwise_op_impl< Modify >(other, start_bit, end_bit, op); }
+
+        ReadLockGuard other_lock{&other};
+        return bitwise_op_impl< Modify >(other, start_bit, end_bit, op);
+    }
+
+    // NOTE: must be called under lock of both this and other
+    template < const bool Modify, typename OpT >
+    uint64_t bitwise_op_impl(const BitsetImpl& other, const uint64_t start_bit, const uint64_t end_bit,
+                             const OpT& op) const {
+        assert(m_s && other.m_s);
+        assert(end_bit >= start_bit);
+        const uint64_t common_bits{std::min(total_bits(), other.total_bits())};
+        if (start_bit >= common_bits) { return 0; }
+        const uint64_t last_bit{std::min(common_bits - 1, end_bit)};
+
+        uint64_t set_cnt{0};
+        uint64_t current_bit{start_bit};
+        uint64_t bits_remaining{last_bit - start_bit + 1};
+        // Modify versions are only invoked from non-const public methods
+        bitword_type* word_ptr{const_cast< bitword_type* >(get_word_const(start_bit))};
+        while (bits_remaining > 0) {
+            const uint8_t offset{get_word_offset(current_bit)};
+            if ((offset == 0) && (bits_remaining >= word_size()) && (other.get_word_offset(current_bit) == 0)) {
+                // both word aligned, do whole words in a tight loop which can be vectorized
+                const uint64_t num_words{bits_remaining / word_size()};
+                const bitword_type* other_word_ptr{other.get_word_const(current_bit)};
+                for (uint64_t w{0}; w < num_words; ++w) {
+                    const word_t rhs_val{other_word_ptr[w].to_integer()};
+                    word_t val;
+                    if constexpr (Modify) {
+                        val = word_ptr[w].update([&op, rhs_val](const word_t lhs) { return op(lhs, rhs_val); });
+                    } else {
+                        val = static_cast< word_t >(op(word_ptr[w].to_integer(), rhs_val));
+                    }
+                    set_cnt += get_set_bit_count(val);
+                }
+                word_ptr += num_words;
+                current_bit += num_words * word_size();
+                bits_remaining -= num_words * word_size();
+                continue;
+            }
+
+            // partial word or differing offsets, realign other's bits to this word's offset
+            const uint8_t count{static_cast< uint8_t >(std::min< uint64_t >(word_size() - offset, bits_remaining))};
+            const word_t mask{static_cast< word_t >(static_cast< word_t >(consecutive_bitmask[count - 1]) << offset)};
+            const word_t rhs_val{static_cast< word_t >(other.extract_bits(current_bit, count) << offset)};
+            word_t val;
+            if constexpr (Modify) {
+                val = word_ptr->update([&op, rhs_val, mask](const word_t lhs) {
+                    return static_cast< word_t >((lhs & ~mask) | (op(lhs, rhs_val) & mask));
+                });
+                val &= mask;
+            } else {
+                val = static_cast< word_t >(op(word_ptr->to_integer(), rhs_val) & mask);
+            }
+            set_cnt += get_set_bit_count(val);
+
+            ++word_ptr;
+            current_bit += count;
+            bits_remaining -= count;
+        }
+        if constexpr (Modify) { m_rank_dir.invalidate(); }
+        return set_cnt;
+    }
+
 private:
     // NOTE: This function should be called under a write lock
     void resize_impl(const uint64_t nbits, const bool value) {
@@ -1163,6 +1334,7 @@ private:
         // swap old with new
         m_buf = new_buf;
         m_s = new_s;
+        m_rank_dir.invalidate();
 
         LOGDEBUG("Resize to total_bits={} total_actual_bits={}, skip_bits={}, words_cap={}", total_bits(), m_s->m_nbits,
                  m_s->m_skip_bits, m_s->m_words_cap);
@@ -1189,6 +1361,25 @@ private:
         return static_cast< uint8_t >(offset & m_word_mask);
     }
 
+    // NOTE: must be called under lock
+    template < typename CB >
+    uint64_t rank_dir_lookup(const CB& cb) const {
+        assert(m_s);
+        return m_rank_dir.lookup(m_s->get_words_const(), bitset_serialized::total_words(m_s->m_nbits), cb);
+    }
+
+    // NOTE: must be called under lock. Returns nbits (1 to word_size) from bit in LSB order, bits must be valid
+    word_t extract_bits(const uint64_t bit, const uint8_t nbits) const {
+        assert((nbits > 0) && (nbits <= word_size()) && ((bit + nbits) <= total_bits()));
+        const bitword_type* word_ptr{get_word_const(bit)};
+        const uint8_t offset{get_word_offset(bit)};
+        word_t val{static_cast< word_t >(word_ptr->to_integer() >> offset)};
+        if ((offset + nbits) > word_size()) {
+            val |= static_cast< word_t >((word_ptr + 1)->to_integer() << (word_size() - offset));
+        }
+        return static_cast< word_t >(val & static_cast< word_t >(consecutive_bitmask[nbits - 1]));
+    }
+
     // NOTE: must be called under lock
     uint64_t total_bits() const {
         assert(m_s);
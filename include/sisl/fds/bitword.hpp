@@ -27,6 +27,10 @@
 #include <iostream>
 #include <sstream>
 
+#if defined __BMI2__
+#include <immintrin.h>
+#endif
+
 #include <fmt/format.h>
 
 #include <sisl/utility/enum.hpp>
@@ -223,6 +227,20 @@ static inline constexpr uint8_t get_leading_zeros(const uint64_t v) {
 #endif
 }
 
+// Get the position of the nth (0 based) set bit in the word. Caller is expected to ensure n < set bit count
+template < typename DataType >
+static inline uint8_t get_nth_set_bit(const DataType v, uint8_t n) {
+    uint64_t x{static_cast< uint64_t >(static_cast< std::make_unsigned_t< DataType > >(v))};
+#if defined __BMI2__
+    x = _pdep_u64(static_cast< uint64_t >(1) << n, x);
+#else
+    while (n-- > 0) {
+        x &= x - 1; // clear lowest set bit
+    }
+#endif
+    return get_trailing_zeros(x);
+}
+
 ENUM(bit_match_type, uint8_t, no_match, full_match, lsb_match, mid_match, msb_match)
 
 struct bit_filter {
@@ -292,6 +310,15 @@ public:
 
     void set(const word_t& value) { m_bits.set(value); }
 
+    /**
+     * @brief: Replace the word with op(word), atomically for safe_bits, so that concurrent set/reset of other bits in
+     * the same word are not lost. Returns the new value of the word.
+     */
+    template < typename OpT >
+    word_t update(const OpT& op) {
+        return m_bits.update(op);
+    }
+
     /**
      * @brief:
      * Total number of bits set in the bitset
@@ -615,6 +642,12 @@ public:
         return m_Value;
     }
 
+    template < typename OpT >
+    word_t update(const OpT& op) {
+        m_Value = static_cast< word_t >(op(m_Value));
+        return m_Value;
+    }
+
     word_t and_with(const word_t value) {
         m_Value &= value;
         return m_Value;
@@ -660,6 +693,17 @@ public:
         return (old_value | value);
     }
 
+    template < typename OpT >
+    word_t update(const OpT& op) {
+        word_t old_value{m_Value.load(std::memory_order_relaxed)};
+        word_t new_value{static_cast< word_t >(op(old_value))};
+        while ((new_value != old_value) &&
+               !m_Value.compare_exchange_weak(old_value, new_value, std::memory_order_relaxed)) {
+            new_value = static_cast< word_t >(op(old_value));
+        }
+        return new_value;
+    }
+
     word_t and_with(const word_t value) {
         const word_t old_value{m_Value.fetch_and(value, std::memory_order_relaxed)};
         return (old_value & value);
@@ -19,7 +19,9 @@
 #include <array>
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <type_traits>
+#include <utility>
 
 #include <boost/preprocessor/stringize.hpp>
 #ifdef __linux__
@@ -82,8 +84,11 @@ struct sg_list {
     sg_iovs_t iovs;
 };
 
+struct buf_chain;
 struct sg_iterator {
     sg_iterator(const sg_iovs_t& v) : m_input_iovs{v} { assert(v.size() > 0); }
+    // Iterates over the iovs of the chain, which should not be modified while the iterator is in use
+    sg_iterator(const buf_chain& chain);
 
     sg_iovs_t next_iovs(uint32_t size) {
         sg_iovs_t ret_iovs;
@@ -442,7 +447,7 @@ public:
     }
     void set_size(uint32_t sz) { m_view.set_size(sz); }
     void validate() const {
-        DEBUG_ASSERT_LE((void*)(m_base_buf->cbytes() + m_base_buf->size()), (void*)(m_view.cbytes() + m_view.size()),
+        DEBUG_ASSERT_LE((void*)(m_view.cbytes() + m_view.size()), (void*)(m_base_buf->cbytes() + m_base_buf->size()),
                         "Invalid byte_view");
     }
 
@@ -452,4 +457,193 @@ private:
     byte_array m_base_buf;
     blob m_view;
 };
+
+/* A chain of byte_views which together represent one logical buffer, without copying them into one contiguous
+ * byte_array. Each segment holds a reference on its underlying byte_array, so the chain can outlive whoever created
+ * the segments. Segments are appended or prepended in amortized O(1) and split/trim only adjust views, they never
+ * copy. Data is copied only on an explicit coalesce().
+ */
+struct buf_chain {
+public:
+    using segments_t = folly::small_vector< byte_view, 4 >;
+
+    buf_chain() = default;
+    buf_chain(byte_view v) { append(std::move(v)); }
+    ~buf_chain() = default;
+    buf_chain(const buf_chain& other) = default;
+    buf_chain& operator=(const buf_chain& other) = default;
+    buf_chain(buf_chain&& other) noexcept :
+            m_segs{std::move(other.m_segs)},
+            m_first{std::exchange(other.m_first, 0)},
+            m_size{std::exchange(other.m_size, 0)},
+            m_iovs{std::move(other.m_iovs)},
+            m_iovs_valid{std::exchange(other.m_iovs_valid, false)} {
+        other.m_segs.clear();
+    }
+    buf_chain& operator=(buf_chain&& other) noexcept {
+        m_segs = std::move(other.m_segs);
+        m_first = std::exchange(other.m_first, 0);
+        m_size = std::exchange(other.m_size, 0);
+        m_iovs = std::move(other.m_iovs);
+        m_iovs_valid = std::exchange(other.m_iovs_valid, false);
+        other.m_segs.clear();
+        return *this;
+    }
+
+    uint64_t size() const { return m_size; }
+    bool empty() const { return (m_size == 0); }
+    size_t num_segments() const { return m_segs.size() - m_first; }
+
+    const byte_view* begin() const { return m_segs.data() + m_first; }
+    const byte_view* end() const { return m_segs.data() + m_segs.size(); }
+    const byte_view& front() const { return m_segs[m_first]; }
+    const byte_view& back() const { return m_segs.back(); }
+
+    void append(byte_view v) {
+        if (v.size() == 0) { return; }
+        m_size += v.size();
+        m_segs.push_back(std::move(v));
+        m_iovs_valid = false;
+    }
+
+    void append(buf_chain&& other) {
+        for (size_t i{other.m_first}; i < other.m_segs.size(); ++i) {
+            append(std::move(other.m_segs[i]));
+        }
+        other.clear();
+    }
+
+    void prepend(byte_view v) {
+        if (v.size() == 0) { return; }
+        if (m_first == 0) { make_headroom(); }
+        m_size += v.size();
+        m_segs[--m_first] = std::move(v);
+        m_iovs_valid = false;
+    }
+
+    // Detach the first n bytes of this chain and return them as a new chain
+    buf_chain split(uint64_t n) {
+        DEBUG_ASSERT_LE(n, m_size, "Split beyond the chain size");
+        buf_chain ret;
+        while ((n > 0) && !empty()) {
+            byte_view& seg{m_segs[m_first]};
+            if (seg.size() <= n) {
+                n -= seg.size();
+                ret.append(pop_front_segment());
+            } else {
+                ret.append(byte_view{seg, 0, uint32_cast(n)});
+                seg.move_forward(uint32_cast(n));
+                m_size -= n;
+                n = 0;
+            }
+        }
+        m_iovs_valid = false;
+        return ret;
+    }
+
+    void trim_front(uint64_t n) {
+        DEBUG_ASSERT_LE(n, m_size, "Trim beyond the chain size");
+        while ((n > 0) && !empty()) {
+            byte_view& seg{m_segs[m_first]};
+            if (seg.size() <= n) {
+                n -= seg.size();
+                pop_front_segment();
+            } else {
+                seg.move_forward(uint32_cast(n));
+                m_size -= n;
+                n = 0;
+            }
+        }
+        m_iovs_valid = false;
+    }
+
+    void trim_back(uint64_t n) {
+        DEBUG_ASSERT_LE(n, m_size, "Trim beyond the chain size");
+        while ((n > 0) && !empty()) {
+            byte_view& seg{m_segs.back()};
+            if (seg.size() <= n) {
+                n -= seg.size();
+                m_size -= seg.size();
+                m_segs.pop_back();
+            } else {
+                seg.set_size(seg.size() - uint32_cast(n));
+                m_size -= n;
+                n = 0;
+            }
+        }
+        if (empty()) { clear(); }
+        m_iovs_valid = false;
+    }
+
+    void clear() {
+        m_segs.clear();
+        m_first = 0;
+        m_size = 0;
+        m_iovs.clear();
+        m_iovs_valid = false;
+    }
+
+    // iovs of all segments (say for writev/preadv), built lazily and valid till the chain is modified
+    const sg_iovs_t& iovs() const {
+        if (!m_iovs_valid) {
+            m_iovs.clear();
+            for (const auto& seg : *this) {
+                m_iovs.push_back(iovec{const_cast< uint8_t* >(seg.bytes()), seg.size()});
+            }
+            m_iovs_valid = true;
+        }
+        return m_iovs;
+    }
+
+    sg_list to_sg_list() const { return sg_list{m_size, iovs()}; }
+
+    // Copy all segments into one contiguous byte_array, unless it already is a single segment. Chain is replaced by
+    // the coalesced segment, which is also returned
+    byte_view coalesce(uint32_t alignment = 0, buftag tag = buftag::common) {
+        if (num_segments() == 0) { return byte_view{}; }
+        if (num_segments() == 1) { return front(); }
+
+        auto buf{make_byte_array(uint32_cast(m_size), alignment, tag)};
+        uint8_t* dst{buf->bytes()};
+        for (const auto& seg : *this) {
+            std::memcpy(dst, seg.bytes(), seg.size());
+            dst += seg.size();
+        }
+
+        clear();
+        const uint32_t sz{buf->size()};
+        append(byte_view{std::move(buf), 0u, sz});
+        return front();
+    }
+
+private:
+    byte_view pop_front_segment() {
+        byte_view seg{std::move(m_segs[m_first])}; // Slot no longer holds a reference on the underlying array
+        m_size -= seg.size();
+        if (++m_first == m_segs.size()) {
+            clear();
+        } else if (m_first > m_segs.size() / 2) {
+            // Drop the popped slots once they are the majority, so that a chain used as a queue does not grow forever
+            m_segs.erase(m_segs.begin(), m_segs.begin() + m_first);
+            m_first = 0;
+        }
+        return seg;
+    }
+
+    // Reserve as many empty slots at the front as there are segments (at least 2), so that prepends are amortized O(1)
+    void make_headroom() {
+        const size_t headroom{std::max< size_t >(num_segments(), 2)};
+        m_segs.insert(m_segs.begin(), headroom, byte_view{});
+        m_first = headroom;
+    }
+
+private:
+    segments_t m_segs;  // Segments are [m_first, m_segs.size()), slots before m_first are headroom for prepends
+    size_t m_first{0};
+    uint64_t m_size{0};
+    mutable sg_iovs_t m_iovs;
+    mutable bool m_iovs_valid{false};
+};
+
+inline sg_iterator::sg_iterator(const buf_chain& chain) : sg_iterator{chain.iovs()} {}
 } // namespace sisl
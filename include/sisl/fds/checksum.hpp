@@ -0,0 +1,99 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "buffer.hpp"
+
+struct XXH3_state_s;
+
+namespace sisl {
+
+/**
+ * @brief CRC32C (Castagnoli) of the data, continuing from crc, which is 0 to start a new checksum. Passing the
+ * result of a previous call as crc gives the checksum of the concatenated data, so the data can be fed piecemeal.
+ *
+ * On x86_64 CPUs with SSE4.2 and PCLMUL it uses the crc32 instruction on 3 interleaved streams, merging them with a
+ * carry-less multiply. It falls back to a slicing-by-8 table implementation otherwise.
+ */
+uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0);
+inline uint32_t crc32c(const blob& b, uint32_t crc = 0) { return crc32c(b.cbytes(), b.size(), crc); }
+uint32_t crc32c(const sg_iovs_t& iovs, uint32_t crc = 0);
+inline uint32_t crc32c(const sg_list& sgl, uint32_t crc = 0) { return crc32c(sgl.iovs, crc); }
+
+/**
+ * @brief CRC32C of the next size bytes of the iterator, which is moved past them
+ */
+uint32_t crc32c(sg_iterator& it, uint64_t size, uint32_t crc = 0);
+
+/**
+ * @brief Given crc1 of data A and crc2 of data B (of len2 bytes), get the crc of A followed by B, without the data
+ */
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+
+/**
+ * @brief CRC32C of a large buffer, computed on nchunks chunks in parallel (nchunks - 1 additional threads) and
+ * combined. Same result as crc32c(data, len, crc).
+ */
+uint32_t crc32c_parallel(const void* data, size_t len, uint32_t nchunks, uint32_t crc = 0);
+
+/**
+ * @brief Portable table driven CRC32C, which crc32c uses when there is no hardware support. Exposed for testing
+ */
+uint32_t crc32c_sw(const void* data, size_t len, uint32_t crc = 0);
+
+/**
+ * @brief XXH3 64 bit hash of the data
+ */
+uint64_t xxh3_64(const void* data, size_t len, uint64_t seed = 0);
+inline uint64_t xxh3_64(const blob& b, uint64_t seed = 0) { return xxh3_64(b.cbytes(), b.size(), seed); }
+uint64_t xxh3_64(const sg_iovs_t& iovs, uint64_t seed = 0);
+inline uint64_t xxh3_64(const sg_list& sgl, uint64_t seed = 0) { return xxh3_64(sgl.iovs, seed); }
+uint64_t xxh3_64(sg_iterator& it, uint64_t size, uint64_t seed = 0);
+
+/**
+ * @brief Streaming XXH3 64 bit hash, for data which is not available all at once. Unlike CRC32C, XXH3 of
+ * concatenated data cannot be continued from or combined with the hash of the parts, hence the state.
+ */
+class xxh3_64_hasher {
+public:
+    explicit xxh3_64_hasher(uint64_t seed = 0);
+    xxh3_64_hasher(const xxh3_64_hasher&) = delete;
+    xxh3_64_hasher(xxh3_64_hasher&&) noexcept = default;
+    xxh3_64_hasher& operator=(const xxh3_64_hasher&) = delete;
+    xxh3_64_hasher& operator=(xxh3_64_hasher&&) noexcept = default;
+    ~xxh3_64_hasher() = default;
+
+    void reset(uint64_t seed = 0);
+    void update(const void* data, size_t len);
+    void update(const blob& b) { update(b.cbytes(), b.size()); }
+    void update(const sg_iovs_t& iovs);
+    void update(const sg_list& sgl) { update(sgl.iovs); }
+    void update(sg_iterator& it, uint64_t size);
+    uint64_t digest() const;
+
+private:
+    struct state_deleter {
+        void operator()(XXH3_state_s* state) const;
+    };
+    std::unique_ptr< XXH3_state_s, state_deleter > m_state;
+};
+
+} // namespace sisl
@@ -18,6 +18,7 @@
 #include <sisl/fds/bitword.hpp>
 #include <sisl/fds/utils.hpp>
 #include <sisl/fds/buffer.hpp>
+#include <sisl/fds/rank_select.hpp>
 
 namespace sisl {
 class CompactBitSet {
@@ -34,6 +35,7 @@ private:
     bit_count_t nbits_{0};
     bool allocated_{false};
     serialized* s_{nullptr};
+    RankSelectDirectory< bitword_type > rank_dir_; // Built lazily on first rank/select after a mutation
 
 private:
     static constexpr size_t word_size_bytes() { return sizeof(unsafe_bits< uint64_t >); }
@@ -103,11 +105,32 @@ public:
         return inval_bit;
     }
 
+    /// @brief This method gets the number of set bits before the given bit (rank). The first call after any
+    /// mutation builds the rank directory, subsequent calls are O(1).
+    /// @param bit: Bit upto which (exclusive) set bits are counted, should be <= size()
+    /// @return Returns the count of set bits in [0, bit)
+    bit_count_t rank(bit_count_t bit) const {
+        DEBUG_ASSERT_LE(bit, size(), "rank bit beyond compact bitset size");
+        return s_cast< bit_count_t >(rank_dir_.lookup(&s_->words[0], size() / word_size_bits(),
+                                                      [bit](auto const& table) { return table.rank(bit); }));
+    }
+
+    /// @brief This method gets the position of the nth (0 based) set bit (select). It uses the same lazily built
+    /// directory as rank.
+    /// @param n: Count of set bits to skip
+    /// @return Returns the position of the nth set bit or inval_bit if there are not that many set bits
+    bit_count_t select(bit_count_t n) const {
+        auto const bit = rank_dir_.lookup(&s_->words[0], size() / word_size_bits(),
+                                          [n](auto const& table) { return table.select(n); });
+        return (bit == rank_dir_.npos) ? inval_bit : s_cast< bit_count_t >(bit);
+    }
+
     void set_reset_bit(bit_count_t bit, bool value) {
         bitword_type* word_ptr = get_word(bit);
         if (!word_ptr) { return; }
         uint8_t const offset = get_word_offset(bit);
         word_ptr->set_reset_bits(offset, 1, value);
+        rank_dir_.invalidate();
     }
 
     bit_count_t get_next_set_or_reset_bit(bit_count_t start_bit, bool search_for_set_bit) const {
@@ -15,21 +15,24 @@
  *
  *********************************************************************************/
 #pragma once
-#include <snappy-c.h>
-// #include <lz4.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
-namespace sisl {
-#if 0
-static inline int compress_bound(size_t size) { return LZ4_compressBound(size); }
+#include <snappy-c.h>
 
-static inline int compress(const char* src, char* dst, int src_size, int dst_capacity) {
-    return LZ4_compress_default(src, dst, src_size, dst_capacity);
-}
+#include "buffer.hpp"
 
-static inline int decompress(const char* src, char* dst, int compressed_size, int dst_capacity) {
-    return LZ4_decompress_safe(src, dst, compressed_size, dst_capacity);
-}
-#endif
+namespace sisl {
 
 class Compress {
 public:
@@ -56,4 +59,244 @@ public:
 private:
 };
 
+VENUM(compress_codec, uint8_t, // Codecs, values are persisted in the frame header
+      none = 0,                // Stored as is
+      snappy = 1,              //
+      lz4 = 2,                 // Fastest, level is the acceleration (higher is faster, less compression)
+      zstd = 3,                // Best ratio, level is the zstd compression level, supports dictionaries
+      sentinel = 4             // Expected to be the last
+)
+
+struct compress_error : public std::runtime_error {
+    explicit compress_error(const std::string& what) : std::runtime_error{what} {}
+};
+
+/**
+ * @brief Header written in front of every compressed frame, so that the reader can detect the codec, dictionary and
+ * the size of the output buffer without any out of band information.
+ */
+struct compress_frame_header {
+    static constexpr uint32_t MAGIC{0x504d4353}; // "SCMP"
+    static constexpr uint8_t VERSION{1};
+
+    uint32_t magic{MAGIC};
+    uint8_t version{VERSION};
+    compress_codec codec{compress_codec::none};
+    uint16_t reserved{0};
+    uint32_t dict_id{0};      // Id of the dictionary needed to decompress, 0 if none
+    uint32_t raw_size{0};     // Size of the data once decompressed
+    uint32_t payload_size{0}; // Size of the compressed data following the header
+};
+static_assert(sizeof(compress_frame_header) == 20, "Frame header size is part of the on disk format");
+
+/**
+ * @brief Trained zstd dictionary, shared by all the contexts compressing or decompressing with it. Dictionaries help
+ * a lot for small blocks of similar data (metadata, btree nodes), which have too little history to compress well.
+ */
+class compress_dictionary {
+public:
+    explicit compress_dictionary(std::vector< uint8_t > content);
+
+    /**
+     * @brief Train a dictionary of upto max_size bytes from samples representative of the data to be compressed
+     */
+    static std::shared_ptr< compress_dictionary > train(const std::vector< blob >& samples, size_t max_size);
+
+    uint32_t id() const { return m_id; }
+    const std::vector< uint8_t >& content() const { return m_content; }
+
+private:
+    std::vector< uint8_t > m_content;
+    uint32_t m_id;
+};
+
+/**
+ * @brief Interface of a codec. A codec instance holds whatever state the library needs (zstd contexts, digested
+ * dictionaries, lz4 stream state, scratch buffers), which is reused from call to call. Instances are not thread
+ * safe; use one per thread.
+ */
+class CompressCodec {
+public:
+    CompressCodec() = default;
+    CompressCodec(const CompressCodec&) = delete;
+    CompressCodec(CompressCodec&&) noexcept = delete;
+    CompressCodec& operator=(const CompressCodec&) = delete;
+    CompressCodec& operator=(CompressCodec&&) noexcept = delete;
+    virtual ~CompressCodec() = default;
+
+    /**
+     * @brief Create a codec. level of 0 picks the codec default. dict is used only by zstd, and ignored otherwise.
+     */
+    static std::unique_ptr< CompressCodec > make(compress_codec codec, int level = 0,
+                                                 std::shared_ptr< const compress_dictionary > dict = nullptr);
+
+    virtual compress_codec type() const = 0;
+    virtual uint32_t dict_id() const { return 0; }
+    virtual size_t max_compressed_len(size_t raw_size) const = 0;
+
+    /**
+     * @brief Compress src_size bytes of src into dst, which should be atleast max_compressed_len(src_size) long, and
+     * return the compressed size. Throws compress_error on failure.
+     */
+    virtual size_t compress(const sg_iovs_t& src, size_t src_size, uint8_t* dst, size_t dst_capacity) = 0;
+
+    /**
+     * @brief Decompress src into exactly raw_size bytes of dst. Throws compress_error on corrupt input.
+     */
+    virtual void decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t raw_size) = 0;
+};
+
+/**
+ * @brief Streaming compression context, which writes self describing frames (compress_frame_header followed by the
+ * codec output) and reads frames of any codec. Keep one per thread and reuse it, so that codec state is allocated
+ * only once.
+ *
+ * Decompression auto detects the codec from the frame header. Frames compressed with a dictionary can be
+ * decompressed only by a context created with the same dictionary.
+ */
+class CompressContext {
+public:
+    explicit CompressContext(compress_codec codec = compress_codec::lz4, int level = 0,
+                             std::shared_ptr< const compress_dictionary > dict = nullptr);
+    CompressContext(const CompressContext&) = delete;
+    CompressContext(CompressContext&&) noexcept = default;
+    CompressContext& operator=(const CompressContext&) = delete;
+    CompressContext& operator=(CompressContext&&) noexcept = default;
+    ~CompressContext() = default;
+
+    compress_codec codec() const { return m_codec; }
+    size_t max_frame_size(size_t raw_size) const;
+
+    /**
+     * @brief Compress into a frame in a newly allocated buffer, trimmed to the frame size
+     */
+    io_blob_safe compress(const sg_list& src, buftag tag = buftag::compression);
+    io_blob_safe compress(const blob& src, buftag tag = buftag::compression);
+
+    /**
+     * @brief Compress into a frame at dst, which should be atleast max_frame_size(src.size) long. Returns frame size.
+     */
+    size_t compress(const sg_list& src, uint8_t* dst, size_t dst_capacity);
+
+    /**
+     * @brief Decompress the frame into a newly allocated buffer of the raw size
+     */
+    io_blob_safe decompress(const blob& frame, buftag tag = buftag::compression);
+
+    /**
+     * @brief Decompress the frame into dst and return the raw size
+     */
+    size_t decompress(const blob& frame, uint8_t* dst, size_t dst_capacity);
+
+    /**
+     * @brief Validate and read the header of a frame. Throws compress_error if it is not a valid frame.
+     */
+    static compress_frame_header read_header(const blob& frame);
+
+private:
+    CompressCodec& codec_for(compress_codec codec);
+
+private:
+    compress_codec m_codec;
+    int m_level;
+    std::shared_ptr< const compress_dictionary > m_dict;
+    std::array< std::unique_ptr< CompressCodec >, (size_t)compress_codec::sentinel > m_codecs;
+};
+
+/**
+ * @brief Header of the container written by ParallelCompressor. It is followed by an index of (nchunks + 1) uint64_t
+ * offsets of the chunk frames from the start of the container, the last one being the container size, and then by
+ * the chunk frames themselves. Every chunk is a self contained frame of upto chunk_size raw bytes.
+ */
+struct chunked_frame_header {
+    static constexpr uint32_t MAGIC{0x43504353}; // "SCPC"
+    static constexpr uint8_t VERSION{1};
+
+    uint32_t magic{MAGIC};
+    uint8_t version{VERSION};
+    uint8_t reserved[3]{};
+    uint32_t chunk_size{0};
+    uint32_t nchunks{0};
+    uint64_t raw_size{0};
+};
+static_assert(sizeof(chunked_frame_header) == 24, "Frame header size is part of the on disk format");
+
+/**
+ * @brief Compresses large buffers by splitting them into chunk_size chunks, which are compressed independently by
+ * nthreads threads (the calling thread and nthreads - 1 workers, each with its own CompressContext). The index in
+ * the output allows any single chunk to be decompressed without touching the rest.
+ *
+ * Calls on the same ParallelCompressor from multiple threads are serialized; decompress_chunk is static and can be
+ * called from any thread with its own context.
+ */
+class ParallelCompressor {
+public:
+    static constexpr size_t default_chunk_size{1024 * 1024};
+
+    ParallelCompressor(compress_codec codec = compress_codec::lz4, int level = 0,
+                       uint32_t nthreads = std::thread::hardware_concurrency(),
+                       size_t chunk_size = default_chunk_size,
+                       std::shared_ptr< const compress_dictionary > dict = nullptr);
+    ParallelCompressor(const ParallelCompressor&) = delete;
+    ParallelCompressor(ParallelCompressor&&) noexcept = delete;
+    ParallelCompressor& operator=(const ParallelCompressor&) = delete;
+    ParallelCompressor& operator=(ParallelCompressor&&) noexcept = delete;
+    ~ParallelCompressor();
+
+    uint32_t nthreads() const { return uint32_cast(m_workers.size() + 1); }
+    size_t chunk_size() const { return m_chunk_size; }
+
+    io_blob_safe compress(const sg_list& src, buftag tag = buftag::compression);
+    io_blob_safe compress(const blob& src, buftag tag = buftag::compression);
+
+    /**
+     * @brief Decompress all the chunks of the container in parallel
+     */
+    io_blob_safe decompress(const blob& container, buftag tag = buftag::compression);
+    size_t decompress(const blob& container, uint8_t* dst, size_t dst_capacity);
+
+    /**
+     * @brief Validate and read the header of a container. Throws compress_error if it is not a valid container.
+     */
+    static chunked_frame_header read_header(const blob& container);
+
+    /**
+     * @brief Get the frame of a single chunk, which can be passed to CompressContext::decompress
+     */
+    static blob chunk_frame(const blob& container, uint32_t chunk);
+
+    /**
+     * @brief Decompress a single chunk into dst and return its raw size
+     */
+    static size_t decompress_chunk(CompressContext& ctx, const blob& container, uint32_t chunk, uint8_t* dst,
+                                   size_t dst_capacity);
+
+private:
+    struct batch {
+        std::function< void(CompressContext&, uint32_t) > fn;
+        uint32_t njobs;
+        std::atomic< uint32_t > next{0};
+        uint32_t users{0}; // Workers still running jobs of the batch, protected by m_mtx
+        std::mutex error_mtx;
+        std::exception_ptr error;
+    };
+
+    void run_batch(uint32_t njobs, std::function< void(CompressContext&, uint32_t) > fn);
+    void run_jobs(batch& b, CompressContext& ctx);
+    void worker_loop(CompressContext& ctx);
+
+private:
+    const size_t m_chunk_size;
+    std::vector< std::unique_ptr< CompressContext > > m_contexts; // One per thread, the last one is the caller's
+    std::vector< std::thread > m_workers;
+
+    std::mutex m_serial_mtx; // Serializes the callers
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+    std::condition_variable m_done_cv;
+    batch* m_batch{nullptr};
+    uint64_t m_batch_gen{0};
+    bool m_stopping{false};
+};
+
 } // namespace sisl
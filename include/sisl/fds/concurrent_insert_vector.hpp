@@ -16,10 +16,19 @@
  *********************************************************************************/
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include <sisl/utility/thread_buffer.hpp>
+#include "utils.hpp"
 
 namespace sisl {
 
@@ -32,43 +41,71 @@ namespace sisl {
 // simplistic cases where insertion and iteration never happen concurrently. As a result it provides better performance
 // than even sisl::ThreadVector and better debuggability.
 //
+// Every thread appends to its own list of chunks, each a vector reserved upfront to chunk_entries, so growth only adds
+// a chunk and entries are never copied or moved once inserted. Chunks are also the unit of work for parallel_foreach
+// and are handed over as is by drain().
+//
 // Benchmark shows atleast 10x better performance on more than 4 threads concurrently inserting with mutex.
 //
 template < typename T >
 class ConcurrentInsertVector {
+public:
+    using chunk_t = std::vector< T >;
+    static constexpr size_t default_chunk_entries{std::max< size_t >(64 * 1024 / sizeof(T), 16)};
+
 private:
-    ExitSafeThreadBuffer< std::vector< T >, size_t > tvector_;
-    std::vector< std::vector< T > const* > per_thread_vec_ptrs_;
+    struct thread_chunks {
+        explicit thread_chunks(const size_t chunk_entries) : chunk_entries{chunk_entries} {}
+
+        template < class... Args >
+        void emplace_back(Args&&... args) {
+            if (chunks.empty() || (chunks.back().size() == chunk_entries)) {
+                chunks.emplace_back();
+                chunks.back().reserve(chunk_entries);
+            }
+            chunks.back().emplace_back(std::forward< Args >(args)...);
+        }
+
+        const size_t chunk_entries;
+        std::vector< chunk_t > chunks;
+    };
+
+    ExitSafeThreadBuffer< thread_chunks, size_t > tvector_;
+    std::vector< chunk_t const* > chunk_ptrs_;
 
 public:
     struct iterator {
-        size_t next_thread{0};
-        size_t next_id_in_thread{0};
+        size_t next_chunk{0};
+        size_t next_id_in_chunk{0};
         ConcurrentInsertVector const* vec{nullptr};
 
         iterator() = default;
         iterator(ConcurrentInsertVector const& v) : vec{&v} {}
         iterator(ConcurrentInsertVector const& v, bool end_iterator) : vec{&v} {
-            if (end_iterator) { next_thread = vec->per_thread_vec_ptrs_.size(); }
+            if (end_iterator) { next_chunk = vec->chunk_ptrs_.size(); }
         }
 
         void operator++() {
-            ++next_id_in_thread;
-            if (next_id_in_thread >= vec->per_thread_vec_ptrs_[next_thread]->size()) {
-                ++next_thread;
-                next_id_in_thread = 0;
+            ++next_id_in_chunk;
+            if (next_id_in_chunk >= vec->chunk_ptrs_[next_chunk]->size()) {
+                ++next_chunk;
+                next_id_in_chunk = 0;
             }
         }
 
         bool operator==(iterator const& other) const = default;
         bool operator!=(iterator const& other) const = default;
 
-        T const& operator*() const { return vec->per_thread_vec_ptrs_[next_thread]->at(next_id_in_thread); }
-        T const* operator->() const { return &(vec->per_thread_vec_ptrs_[next_thread]->at(next_id_in_thread)); }
+        T const& operator*() const { return (*vec->chunk_ptrs_[next_chunk])[next_id_in_chunk]; }
+        T const* operator->() const { return &(*vec->chunk_ptrs_[next_chunk])[next_id_in_chunk]; }
     };
 
-    ConcurrentInsertVector() = default;
-    ConcurrentInsertVector(size_t size) : tvector_{size} {}
+    ConcurrentInsertVector() : ConcurrentInsertVector{default_chunk_entries} {}
+
+    /**
+     * @brief chunk_entries is the number of entries in every chunk, to be sized to what a thread inserts in one go
+     */
+    ConcurrentInsertVector(size_t chunk_entries) : tvector_{std::max< size_t >(chunk_entries, 1)} {}
     ConcurrentInsertVector(const ConcurrentInsertVector&) = delete;
     ConcurrentInsertVector(ConcurrentInsertVector&&) noexcept = delete;
     ConcurrentInsertVector& operator=(const ConcurrentInsertVector&) = delete;
@@ -79,7 +116,7 @@ public:
                typename = typename std::enable_if<
                    std::is_convertible< typename std::decay< InputType >::type, T >::value >::type >
     void push_back(InputType&& ele) {
-        tvector_->push_back(std::forward< InputType >(ele));
+        tvector_->emplace_back(std::forward< InputType >(ele));
     }
 
     template < class... Args >
@@ -88,35 +125,122 @@ public:
     }
 
     iterator begin() {
-        tvector_.access_all_threads([this](std::vector< T > const* tvec, bool, bool) {
-            if (tvec && tvec->size()) { per_thread_vec_ptrs_.push_back(tvec); }
-            return false;
-        });
+        chunk_ptrs_ = all_chunks();
         return iterator{*this};
     }
 
     iterator end() { return iterator{*this, true /* end_iterator */}; }
 
     void foreach_entry(auto&& cb) {
-        tvector_.access_all_threads([this, &cb](std::vector< T > const* tvec, bool, bool) {
-            if (tvec) {
-                for (auto const& e : *tvec) {
-                    cb(e);
+        for (auto const* chunk : all_chunks()) {
+            for (auto const& e : *chunk) {
+                cb(e);
+            }
+        }
+    }
+
+    /**
+     * @brief Call cb(entry) for all the entries in parallel, one chunk at a time, and wait for all of them to be done.
+     * executor(std::function< void() >) is called upto ntasks times to run a task, say on a thread pool, and tasks keep
+     * picking chunks till there are none left. If cb throws, the remaining chunks are skipped and the first exception
+     * is rethrown. If executor throws, the tasks already submitted are waited for before rethrowing it.
+     */
+    void parallel_foreach(auto&& executor, auto&& cb, uint32_t ntasks = std::thread::hardware_concurrency()) {
+        struct shared_state {
+            std::vector< chunk_t const* > chunks;
+            std::atomic< size_t > next{0};
+            std::mutex mtx;
+            std::condition_variable cv;
+            uint32_t pending;
+            std::exception_ptr error;
+        };
+        auto state{std::make_shared< shared_state >()};
+        state->chunks = all_chunks();
+        if (state->chunks.empty()) { return; }
+        ntasks = uint32_cast(std::clamp< size_t >(ntasks, 1, state->chunks.size()));
+        state->pending = ntasks;
+
+        auto task{[state, &cb]() {
+            try {
+                for (size_t c{state->next.fetch_add(1)}; c < state->chunks.size(); c = state->next.fetch_add(1)) {
+                    for (auto const& e : *state->chunks[c]) {
+                        cb(e);
+                    }
                 }
+            } catch (...) {
+                std::unique_lock lg{state->mtx};
+                if (!state->error) { state->error = std::current_exception(); }
+                state->next.store(state->chunks.size());
             }
-            return false;
+
+            std::unique_lock lg{state->mtx};
+            if (--state->pending == 0) { state->cv.notify_all(); }
+        }};
+
+        uint32_t t{0};
+        try {
+            for (; t < ntasks; ++t) {
+                executor(task);
+            }
+        } catch (...) {
+            // The tasks submitted refer to cb, so wait for them, skipping the chunks they have not picked yet
+            std::unique_lock lg{state->mtx};
+            state->next.store(state->chunks.size());
+            state->pending -= (ntasks - t);
+            state->cv.wait(lg, [&state]() { return (state->pending == 0); });
+            throw;
+        }
+
+        std::unique_lock lg{state->mtx};
+        state->cv.wait(lg, [&state]() { return (state->pending == 0); });
+        if (state->error) { std::rethrow_exception(state->error); }
+    }
+
+    /**
+     * @brief Move all the chunks out, leaving the vector empty. No entry is copied.
+     */
+    std::vector< chunk_t > drain() {
+        std::vector< chunk_t > ret;
+        tvector_.access_all_threads([&ret](thread_chunks* tchunks, bool, bool) {
+            if (tchunks) {
+                for (auto& chunk : tchunks->chunks) {
+                    if (!chunk.empty()) { ret.emplace_back(std::move(chunk)); }
+                }
+                tchunks->chunks.clear();
+            }
+            return true; // Buffers of the threads which exited are not needed anymore
         });
+        chunk_ptrs_.clear();
+        return ret;
     }
 
     size_t size() const {
         size_t sz{0};
-        const_cast< ExitSafeThreadBuffer< std::vector< T >, size_t >& >(tvector_).access_all_threads(
-            [this, &sz](std::vector< T > const* tvec, bool, bool) {
-                if (tvec) { sz += tvec->size(); }
+        const_cast< ExitSafeThreadBuffer< thread_chunks, size_t >& >(tvector_).access_all_threads(
+            [&sz](thread_chunks const* tchunks, bool, bool) {
+                if (tchunks) {
+                    for (auto const& chunk : tchunks->chunks) {
+                        sz += chunk.size();
+                    }
+                }
                 return false;
             });
         return sz;
     }
+
+private:
+    std::vector< chunk_t const* > all_chunks() {
+        std::vector< chunk_t const* > chunks;
+        tvector_.access_all_threads([&chunks](thread_chunks const* tchunks, bool, bool) {
+            if (tchunks) {
+                for (auto const& chunk : tchunks->chunks) {
+                    if (!chunk.empty()) { chunks.push_back(&chunk); }
+                }
+            }
+            return false;
+        });
+        return chunks;
+    }
 };
 
 } // namespace sisl
@@ -0,0 +1,521 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <sisl/metrics/metrics.hpp>
+#include "utils.hpp"
+
+namespace sisl {
+static constexpr size_t ring_cache_line_size{64};
+
+/**
+ * @brief Backoff while waiting on a slot claimed by another thread: pause for a while and then yield, so that we do
+ * not burn the whole time slice of a preempted owner when threads outnumber cores.
+ */
+inline void ring_spin_wait(uint32_t& spins) {
+    if (++spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+/**
+ * @brief Event count on which threads of a ring block, waiting for it to become non empty or non full. Waiting and
+ * waking is done with a futex directly, and notify does not make a syscall unless there are waiters.
+ */
+class RingWaiter {
+public:
+    /**
+     * @brief Block till ready() returns true, ready() being an attempt to push or pop
+     */
+    template < typename ReadyFn >
+    void wait(ReadyFn&& ready) {
+        while (!ready()) {
+            m_waiters.fetch_add(1);
+            const uint32_t seq{m_seq.load()};
+            if (!ready()) {
+                futex_wait(seq, nullptr);
+            } else {
+                m_waiters.fetch_sub(1);
+                return;
+            }
+            m_waiters.fetch_sub(1);
+        }
+    }
+
+    /**
+     * @brief Same as wait, but gives up at the deadline and returns false
+     */
+    template < typename ReadyFn >
+    bool wait_until(ReadyFn&& ready, const std::chrono::steady_clock::time_point deadline) {
+        while (!ready()) {
+            const auto now{std::chrono::steady_clock::now()};
+            if (now >= deadline) { return false; }
+            const auto ns{std::chrono::duration_cast< std::chrono::nanoseconds >(deadline - now).count()};
+            const struct timespec ts {
+                static_cast< time_t >(ns / 1000000000), static_cast< long >(ns % 1000000000)
+            };
+
+            m_waiters.fetch_add(1);
+            const uint32_t seq{m_seq.load()};
+            if (!ready()) {
+                futex_wait(seq, &ts);
+            } else {
+                m_waiters.fetch_sub(1);
+                return true;
+            }
+            m_waiters.fetch_sub(1);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Wake upto count waiters. Caller should have made the change (push or pop) visible before calling it.
+     */
+    void notify(const uint32_t count) {
+        // Pairs with the waiter incrementing m_waiters before its final attempt: either we see the waiter or the
+        // waiter sees our change
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_relaxed) == 0) { return; }
+        m_seq.fetch_add(1);
+#ifdef __linux__
+        ::syscall(SYS_futex, r_cast< uint32_t* >(&m_seq), FUTEX_WAKE_PRIVATE, std::min< uint32_t >(count, INT32_MAX),
+                  nullptr, nullptr, 0);
+#else
+        (count == 1) ? m_seq.notify_one() : m_seq.notify_all();
+#endif
+    }
+
+private:
+    void futex_wait(const uint32_t seq, [[maybe_unused]] const struct timespec* ts) {
+#ifdef __linux__
+        ::syscall(SYS_futex, r_cast< uint32_t* >(&m_seq), FUTEX_WAIT_PRIVATE, seq, ts, nullptr, 0);
+#else
+        if (ts == nullptr) {
+            m_seq.wait(seq);
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds{50});
+        }
+#endif
+    }
+
+private:
+    static_assert(sizeof(std::atomic< uint32_t >) == sizeof(uint32_t), "Futex word should be a plain 32 bit int");
+    alignas(ring_cache_line_size) std::atomic< uint32_t > m_seq{0};
+    std::atomic< uint32_t > m_waiters{0};
+};
+
+class ConcurrentRingMetrics : public MetricsGroupWrapper {
+public:
+    template < typename OccupancyFn >
+    ConcurrentRingMetrics(const std::string& ring_name, [[maybe_unused]] const size_t capacity,
+                          OccupancyFn&& occupancy) :
+            sisl::MetricsGroupWrapper{"ConcurrentRing", ring_name},
+            m_occupancy{std::forward< OccupancyFn >(occupancy)} {
+        REGISTER_COUNTER(ring_push_full, "Number of push attempts which found the ring full");
+        REGISTER_COUNTER(ring_pop_empty, "Number of pop attempts which found the ring empty");
+        REGISTER_GAUGE(ring_occupancy, "Number of entries in the ring");
+        REGISTER_GAUGE(ring_capacity, "Capacity of the ring");
+        register_me_to_farm();
+        GAUGE_UPDATE(*this, ring_capacity, static_cast< int64_t >(capacity));
+        // Occupancy is sampled only when metrics are gathered, so that push/pop pay nothing for it
+        attach_gather_cb([this]() { GAUGE_UPDATE(*this, ring_occupancy, static_cast< int64_t >(m_occupancy())); });
+    }
+    ConcurrentRingMetrics(const ConcurrentRingMetrics&) = delete;
+    ConcurrentRingMetrics(ConcurrentRingMetrics&&) noexcept = delete;
+    ConcurrentRingMetrics& operator=(const ConcurrentRingMetrics&) = delete;
+    ConcurrentRingMetrics& operator=(ConcurrentRingMetrics&&) noexcept = delete;
+
+    ~ConcurrentRingMetrics() {
+        detach_gather_cb();
+        deregister_me_from_farm();
+    }
+
+private:
+    std::function< size_t(void) > m_occupancy;
+};
+
+/**
+ * @brief Bounded multi producer multi consumer ring (Dmitry Vyukov's algorithm). Every slot carries a sequence number
+ * which tells whether it is ready to be written or read for a given lap of the ring, so producers and consumers only
+ * contend on their own cursor, each on its own cache line.
+ *
+ * push_n/pop_n claim a range of slots with a single CAS of the cursor. A batch may have to briefly spin on a slot of
+ * its range whose previous reader (or writer) has claimed it but not finished with it yet.
+ *
+ * With Blocking set, push/pop (and the timed try_pop_for) wait on a futex when the ring is full/empty. Non blocking
+ * rings pay nothing for it.
+ *
+ * If a name is passed, ConcurrentRingMetrics are registered for the ring with its occupancy and full/empty counts.
+ */
+template < typename T, bool Blocking = false >
+class MPMCRing {
+public:
+    explicit MPMCRing(const size_t capacity, const std::string& metrics_name = "") :
+            m_mask{std::max< uint64_t >(std::bit_ceil< uint64_t >(capacity), 2) - 1},
+            m_slots{new slot[m_mask + 1]} {
+        for (uint64_t i{0}; i <= m_mask; ++i) {
+            m_slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+        if (!metrics_name.empty()) {
+            m_metrics = std::make_unique< ConcurrentRingMetrics >(metrics_name, this->capacity(),
+                                                                  [this]() { return size(); });
+        }
+    }
+    MPMCRing(const MPMCRing&) = delete;
+    MPMCRing(MPMCRing&&) noexcept = delete;
+    MPMCRing& operator=(const MPMCRing&) = delete;
+    MPMCRing& operator=(MPMCRing&&) noexcept = delete;
+
+    ~MPMCRing() {
+        m_metrics.reset();
+        for (uint64_t pos{m_deq_pos.load()}; pos < m_enq_pos.load(); ++pos) {
+            m_slots[pos & m_mask].ptr()->~T();
+        }
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+    /**
+     * @brief Approximate number of entries, exact only when there are no concurrent push/pop
+     */
+    size_t size() const {
+        const uint64_t deq{m_deq_pos.load(std::memory_order_acquire)};
+        const uint64_t enq{m_enq_pos.load(std::memory_order_acquire)};
+        return (enq > deq) ? std::min< uint64_t >(enq - deq, capacity()) : 0;
+    }
+    bool empty() const { return size() == 0; }
+
+    template < typename U >
+    bool try_push(U&& v) {
+        uint64_t pos{m_enq_pos.load(std::memory_order_relaxed)};
+        slot* s;
+        while (true) {
+            s = &m_slots[pos & m_mask];
+            const int64_t diff{static_cast< int64_t >(s->seq.load(std::memory_order_acquire) - pos)};
+            if (diff == 0) {
+                if (m_enq_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            } else if (diff < 0) {
+                if (m_metrics) { COUNTER_INCREMENT(*m_metrics, ring_push_full, 1); }
+                return false;
+            } else {
+                pos = m_enq_pos.load(std::memory_order_relaxed);
+            }
+        }
+        new (s->ptr()) T(std::forward< U >(v));
+        s->seq.store(pos + 1, std::memory_order_release);
+        if constexpr (Blocking) { m_not_empty.notify(1); }
+        return true;
+    }
+
+    bool try_pop(T& out) {
+        uint64_t pos{m_deq_pos.load(std::memory_order_relaxed)};
+        slot* s;
+        while (true) {
+            s = &m_slots[pos & m_mask];
+            const int64_t diff{static_cast< int64_t >(s->seq.load(std::memory_order_acquire) - (pos + 1))};
+            if (diff == 0) {
+                if (m_deq_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            } else if (diff < 0) {
+                if (m_metrics) { COUNTER_INCREMENT(*m_metrics, ring_pop_empty, 1); }
+                return false;
+            } else {
+                pos = m_deq_pos.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(*s->ptr());
+        s->ptr()->~T();
+        s->seq.store(pos + m_mask + 1, std::memory_order_release);
+        if constexpr (Blocking) { m_not_full.notify(1); }
+        return true;
+    }
+
+    /**
+     * @brief Push upto n entries from first (which are moved from), return the number pushed
+     */
+    template < typename InputIt >
+    size_t push_n(InputIt first, const size_t n) {
+        uint64_t pos{m_enq_pos.load(std::memory_order_relaxed)};
+        size_t count;
+        while (true) {
+            const uint64_t deq{m_deq_pos.load(std::memory_order_acquire)};
+            if (deq > pos) {
+                pos = m_enq_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+            count = std::min< uint64_t >(n, capacity() - std::min< uint64_t >(pos - deq, capacity()));
+            if (count == 0) {
+                if (m_metrics && (n != 0)) { COUNTER_INCREMENT(*m_metrics, ring_push_full, 1); }
+                return 0;
+            }
+            if (m_enq_pos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) { break; }
+        }
+
+        for (size_t i{0}; i < count; ++i, ++first) {
+            slot& s{m_slots[(pos + i) & m_mask]};
+            uint32_t spins{0};
+            while (s.seq.load(std::memory_order_acquire) != pos + i) {
+                ring_spin_wait(spins); // Consumer of the previous lap has claimed the slot, but not yet moved out
+            }
+            new (s.ptr()) T(std::move(*first));
+            s.seq.store(pos + i + 1, std::memory_order_release);
+        }
+        if constexpr (Blocking) { m_not_empty.notify(uint32_cast(count)); }
+        return count;
+    }
+
+    /**
+     * @brief Pop upto n entries into out, return the number popped
+     */
+    template < typename OutputIt >
+    size_t pop_n(OutputIt out, const size_t n) {
+        uint64_t pos{m_deq_pos.load(std::memory_order_relaxed)};
+        size_t count;
+        while (true) {
+            const uint64_t enq{m_enq_pos.load(std::memory_order_acquire)};
+            count = (enq > pos) ? std::min< uint64_t >(n, enq - pos) : 0;
+            if (count == 0) {
+                if (m_metrics && (n != 0)) { COUNTER_INCREMENT(*m_metrics, ring_pop_empty, 1); }
+                return 0;
+            }
+            if (m_deq_pos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) { break; }
+        }
+
+        for (size_t i{0}; i < count; ++i, ++out) {
+            slot& s{m_slots[(pos + i) & m_mask]};
+            uint32_t spins{0};
+            while (s.seq.load(std::memory_order_acquire) != pos + i + 1) {
+                ring_spin_wait(spins); // Producer has claimed the slot, but not yet written it
+            }
+            *out = std::move(*s.ptr());
+            s.ptr()->~T();
+            s.seq.store(pos + i + m_mask + 1, std::memory_order_release);
+        }
+        if constexpr (Blocking) { m_not_full.notify(uint32_cast(count)); }
+        return count;
+    }
+
+    /**
+     * @brief Push, waiting for room if the ring is full
+     */
+    template < typename U, bool B = Blocking >
+    std::enable_if_t< B > push(U&& v) {
+        m_not_full.wait([this, &v]() { return try_push(std::forward< U >(v)); });
+    }
+
+    /**
+     * @brief Pop, waiting for an entry if the ring is empty
+     */
+    template < bool B = Blocking >
+    std::enable_if_t< B, T > pop() {
+        T v;
+        m_not_empty.wait([this, &v]() { return try_pop(v); });
+        return v;
+    }
+
+    template < typename Rep, typename Period, bool B = Blocking >
+    std::enable_if_t< B, bool > try_pop_for(T& out, const std::chrono::duration< Rep, Period >& timeout) {
+        return m_not_empty.wait_until([this, &out]() { return try_pop(out); },
+                                      std::chrono::steady_clock::now() + timeout);
+    }
+
+private:
+    struct slot {
+        std::atomic< uint64_t > seq;
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T* ptr() { return std::launder(r_cast< T* >(&storage[0])); }
+    };
+
+    alignas(ring_cache_line_size) std::atomic< uint64_t > m_enq_pos{0};
+    alignas(ring_cache_line_size) std::atomic< uint64_t > m_deq_pos{0};
+    alignas(ring_cache_line_size) const uint64_t m_mask;
+    std::unique_ptr< slot[] > m_slots;
+    std::unique_ptr< ConcurrentRingMetrics > m_metrics;
+    RingWaiter m_not_empty;
+    RingWaiter m_not_full;
+};
+
+/**
+ * @brief Bounded single producer single consumer ring. Each side keeps a cached copy of the other side's cursor on
+ * its own cache line and rereads the shared cursor only when the cached one says full/empty, so in steady state a
+ * push or pop touches no cache line written by the other side except the slot itself. Batches publish with one
+ * store of the cursor.
+ *
+ * Blocking and metrics work the same as in MPMCRing.
+ */
+template < typename T, bool Blocking = false >
+class SPSCRing {
+public:
+    explicit SPSCRing(const size_t capacity, const std::string& metrics_name = "") :
+            m_mask{std::max< uint64_t >(std::bit_ceil< uint64_t >(capacity), 2) - 1},
+            m_slots{new storage[m_mask + 1]} {
+        if (!metrics_name.empty()) {
+            m_metrics = std::make_unique< ConcurrentRingMetrics >(metrics_name, this->capacity(),
+                                                                  [this]() { return size(); });
+        }
+    }
+    SPSCRing(const SPSCRing&) = delete;
+    SPSCRing(SPSCRing&&) noexcept = delete;
+    SPSCRing& operator=(const SPSCRing&) = delete;
+    SPSCRing& operator=(SPSCRing&&) noexcept = delete;
+
+    ~SPSCRing() {
+        m_metrics.reset();
+        for (uint64_t pos{m_tail.load()}; pos < m_head.load(); ++pos) {
+            ptr(pos)->~T();
+        }
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+    size_t size() const {
+        const uint64_t tail{m_tail.load(std::memory_order_acquire)};
+        const uint64_t head{m_head.load(std::memory_order_acquire)};
+        return (head > tail) ? (head - tail) : 0;
+    }
+    bool empty() const { return size() == 0; }
+
+    template < typename U >
+    bool try_push(U&& v) {
+        const uint64_t head{m_head.load(std::memory_order_relaxed)};
+        if ((head - m_cached_tail) > m_mask) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if ((head - m_cached_tail) > m_mask) {
+                if (m_metrics) { COUNTER_INCREMENT(*m_metrics, ring_push_full, 1); }
+                return false;
+            }
+        }
+        new (ptr(head)) T(std::forward< U >(v));
+        m_head.store(head + 1, std::memory_order_release);
+        if constexpr (Blocking) { m_not_empty.notify(1); }
+        return true;
+    }
+
+    bool try_pop(T& out) {
+        const uint64_t tail{m_tail.load(std::memory_order_relaxed)};
+        if (tail == m_cached_head) {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail == m_cached_head) {
+                if (m_metrics) { COUNTER_INCREMENT(*m_metrics, ring_pop_empty, 1); }
+                return false;
+            }
+        }
+        out = std::move(*ptr(tail));
+        ptr(tail)->~T();
+        m_tail.store(tail + 1, std::memory_order_release);
+        if constexpr (Blocking) { m_not_full.notify(1); }
+        return true;
+    }
+
+    template < typename InputIt >
+    size_t push_n(InputIt first, const size_t n) {
+        const uint64_t head{m_head.load(std::memory_order_relaxed)};
+        if (capacity() - (head - m_cached_tail) < n) { m_cached_tail = m_tail.load(std::memory_order_acquire); }
+        const size_t count{std::min< size_t >(n, capacity() - (head - m_cached_tail))};
+        if (count == 0) {
+            if (m_metrics && (n != 0)) { COUNTER_INCREMENT(*m_metrics, ring_push_full, 1); }
+            return 0;
+        }
+        for (size_t i{0}; i < count; ++i, ++first) {
+            new (ptr(head + i)) T(std::move(*first));
+        }
+        m_head.store(head + count, std::memory_order_release);
+        if constexpr (Blocking) { m_not_empty.notify(1); }
+        return count;
+    }
+
+    template < typename OutputIt >
+    size_t pop_n(OutputIt out, const size_t n) {
+        const uint64_t tail{m_tail.load(std::memory_order_relaxed)};
+        if (m_cached_head - tail < n) { m_cached_head = m_head.load(std::memory_order_acquire); }
+        const size_t count{std::min< size_t >(n, m_cached_head - tail)};
+        if (count == 0) {
+            if (m_metrics && (n != 0)) { COUNTER_INCREMENT(*m_metrics, ring_pop_empty, 1); }
+            return 0;
+        }
+        for (size_t i{0}; i < count; ++i, ++out) {
+            *out = std::move(*ptr(tail + i));
+            ptr(tail + i)->~T();
+        }
+        m_tail.store(tail + count, std::memory_order_release);
+        if constexpr (Blocking) { m_not_full.notify(1); }
+        return count;
+    }
+
+    template < typename U, bool B = Blocking >
+    std::enable_if_t< B > push(U&& v) {
+        m_not_full.wait([this, &v]() { return try_push(std::forward< U >(v)); });
+    }
+
+    template < bool B = Blocking >
+    std::enable_if_t< B, T > pop() {
+        T v;
+        m_not_empty.wait([this, &v]() { return try_pop(v); });
+        return v;
+    }
+
+    template < typename Rep, typename Period, bool B = Blocking >
+    std::enable_if_t< B, bool > try_pop_for(T& out, const std::chrono::duration< Rep, Period >& timeout) {
+        return m_not_empty.wait_until([this, &out]() { return try_pop(out); },
+                                      std::chrono::steady_clock::now() + timeout);
+    }
+
+private:
+    struct storage {
+        alignas(T) std::byte bytes[sizeof(T)];
+    };
+    T* ptr(const uint64_t pos) { return std::launder(r_cast< T* >(&m_slots[pos & m_mask].bytes[0])); }
+
+    // Producer side
+    alignas(ring_cache_line_size) std::atomic< uint64_t > m_head{0};
+    uint64_t m_cached_tail{0};
+
+    // Consumer side
+    alignas(ring_cache_line_size) std::atomic< uint64_t > m_tail{0};
+    uint64_t m_cached_head{0};
+
+    alignas(ring_cache_line_size) const uint64_t m_mask;
+    std::unique_ptr< storage[] > m_slots;
+    std::unique_ptr< ConcurrentRingMetrics > m_metrics;
+    RingWaiter m_not_empty;
+    RingWaiter m_not_full;
+};
+
+} // namespace sisl
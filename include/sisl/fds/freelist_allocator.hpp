@@ -17,10 +17,12 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <mutex>
 #include <utility>
 
 #if defined __clang__ or defined __GNUC__
@@ -59,6 +61,11 @@ public:
         REGISTER_COUNTER(freelist_dealloc, "freelist: Number of deallocs to system");
         REGISTER_COUNTER(freelist_alloc_size, "freelist: size of alloc", sisl::_publish_as::publish_as_gauge);
         REGISTER_COUNTER(freelist_cache_size, "freelist: cache size", sisl::_publish_as::publish_as_gauge);
+        REGISTER_COUNTER(freelist_depot_put, "freelist: Number of full magazines handed over to depot");
+        REGISTER_COUNTER(freelist_depot_get, "freelist: Number of full magazines taken from depot");
+        REGISTER_COUNTER(freelist_depot_full, "freelist: Number of deallocs to system because depot was full");
+        REGISTER_COUNTER(freelist_slab_mapped, "freelist: Number of slabs mapped from OS");
+        REGISTER_COUNTER(freelist_slab_unmapped, "freelist: Number of idle slabs returned to OS");
 
         register_me_to_farm();
     }
@@ -84,34 +91,134 @@ public:
 #define INIT_METRICS ;
 #endif
 
-template < uint16_t MaxListCount, std::size_t Size >
+static constexpr uint32_t FREELIST_DEPOT_MAGAZINE_COUNT{64};
+
+/**
+ * @brief Default backing policy for FreeListAllocator, which goes to the system allocator on every miss. See
+ * FreeListSlabBacking in slab_allocator.hpp for the alternative.
+ */
+struct FreeListMallocBacking {
+    template < std::size_t Size >
+    static uint8_t* allocate() {
+        return static_cast< uint8_t* >(std::malloc(Size));
+    }
+
+    template < std::size_t Size >
+    static void deallocate(uint8_t* const mem) {
+        std::free(static_cast< void* >(mem));
+    }
+
+    // Nothing is held back from the system allocator
+    template < std::size_t Size >
+    static void trim() {}
+};
+
+template < std::size_t Size, typename BackingT >
+void free_list_release(free_list_header* hdr) {
+    while (hdr) {
+        free_list_header* const next{hdr->next};
+        BackingT::template deallocate< Size >(reinterpret_cast< uint8_t* >(hdr));
+        hdr = next;
+    }
+}
+
+/**
+ * @brief Central depot of full magazines shared by all the per thread free lists of a FreeListAllocator. A magazine
+ * is simply a free list of exactly MaxListCount objects. A thread whose free list overflows hands it over as a
+ * magazine and a thread whose free list runs dry takes one, so objects allocated on one thread and freed on another
+ * flow back to the allocating thread in batches instead of piling up on the freeing thread. The lock is taken once
+ * per MaxListCount allocs/deallocs at most.
+ */
+template < std::size_t Size, uint32_t MaxMagazines, typename BackingT >
+class FreeListMagazineDepot {
+private:
+    std::mutex m_mutex;
+    std::array< free_list_header*, MaxMagazines > m_magazines;
+    uint32_t m_count{0};
+
+public:
+    FreeListMagazineDepot() = default;
+    FreeListMagazineDepot(const FreeListMagazineDepot&) = delete;
+    FreeListMagazineDepot(FreeListMagazineDepot&&) noexcept = delete;
+    FreeListMagazineDepot& operator=(const FreeListMagazineDepot&) = delete;
+    FreeListMagazineDepot& operator=(FreeListMagazineDepot&&) noexcept = delete;
+
+    ~FreeListMagazineDepot() {
+        for (uint32_t i{0}; i < m_count; ++i) {
+            free_list_release< Size, BackingT >(m_magazines[i]);
+        }
+    }
+
+    // Returns false if the depot is full, in which case the caller still owns the magazine
+    bool put(free_list_header* const magazine) {
+        std::scoped_lock< std::mutex > lock{m_mutex};
+        if (m_count == MaxMagazines) { return false; }
+        m_magazines[m_count++] = magazine;
+        return true;
+    }
+
+    // Returns nullptr if the depot has no magazines
+    free_list_header* get() {
+        std::scoped_lock< std::mutex > lock{m_mutex};
+        return (m_count == 0) ? nullptr : m_magazines[--m_count];
+    }
+
+    // Release all the magazines to the backing
+    void trim() {
+        std::array< free_list_header*, MaxMagazines > magazines;
+        uint32_t count;
+        {
+            std::scoped_lock< std::mutex > lock{m_mutex};
+            count = m_count;
+            std::copy_n(m_magazines.begin(), count, magazines.begin());
+            m_count = 0;
+        }
+        for (uint32_t i{0}; i < count; ++i) {
+            free_list_release< Size, BackingT >(magazines[i]);
+        }
+    }
+};
+
+template < uint16_t MaxListCount, std::size_t Size, uint32_t MaxMagazines = FREELIST_DEPOT_MAGAZINE_COUNT,
+           typename BackingT = FreeListMallocBacking >
 class FreeListAllocatorImpl {
+public:
+    typedef FreeListMagazineDepot< Size, MaxMagazines, BackingT > depot_type;
+
 private:
     free_list_header* m_head;
     int64_t m_list_count;
+    depot_type* m_depot;
 
 public:
-    FreeListAllocatorImpl() : m_head(nullptr), m_list_count(0) {}
+    explicit FreeListAllocatorImpl(depot_type* const depot = nullptr) :
+            m_head(nullptr), m_list_count(0), m_depot(depot) {}
     FreeListAllocatorImpl(const FreeListAllocatorImpl&) = delete;
     FreeListAllocatorImpl(FreeListAllocatorImpl&&) noexcept = delete;
     FreeListAllocatorImpl& operator=(const FreeListAllocatorImpl&) = delete;
     FreeListAllocatorImpl& operator=(FreeListAllocatorImpl&&) noexcept = delete;
 
     ~FreeListAllocatorImpl() {
-        free_list_header* hdr{m_head};
-        while (hdr) {
-            free_list_header* const next{hdr->next};
-            std::free(static_cast< void* >(hdr));
-            hdr = next;
-        }
+        // Thread is going away, a full list can still be of use to other threads
+        if ((m_list_count == MaxListCount) && m_depot && m_depot->put(m_head)) { return; }
+        free_list_release< Size, BackingT >(m_head);
     }
 
     uint8_t* allocate(const uint32_t size_needed) {
         uint8_t* ptr;
         INIT_METRICS;
 
+        if ((m_head == nullptr) && m_depot && (size_needed == Size)) {
+            m_head = m_depot->get();
+            if (m_head) {
+                m_list_count = MaxListCount;
+                COUNTER_INCREMENT_IF_ENABLED(freelist_depot_get, 1);
+            }
+        }
+
         if (m_head == nullptr) {
-            ptr = static_cast< uint8_t* >(std::malloc(size_needed));
+            ptr = (size_needed == Size) ? BackingT::template allocate< Size >()
+                                        : static_cast< uint8_t* >(std::malloc(size_needed));
             COUNTER_INCREMENT_IF_ENABLED(freelist_alloc_miss, 1);
         } else {
             ptr = reinterpret_cast< uint8_t* >(m_head);
@@ -124,10 +231,24 @@ public:
     }
 
     bool deallocate(uint8_t* const mem, const uint32_t size_alloced) {
-        if ((size_alloced != Size) || (m_list_count == MaxListCount)) {
+        INIT_METRICS;
+
+        if (size_alloced != Size) {
             std::free(static_cast< void* >(mem));
             return true;
         }
+
+        if (m_list_count == MaxListCount) {
+            if (!m_depot || !m_depot->put(m_head)) {
+                COUNTER_INCREMENT_IF_ENABLED(freelist_depot_full, 1);
+                BackingT::template deallocate< Size >(mem);
+                return true;
+            }
+            COUNTER_INCREMENT_IF_ENABLED(freelist_depot_put, 1);
+            m_head = nullptr;
+            m_list_count = 0;
+        }
+
         auto* const hdr{reinterpret_cast< free_list_header* >(mem)};
         hdr->next = m_head;
         m_head = hdr;
@@ -135,12 +256,29 @@ public:
 
         return true;
     }
+
+    // Release the free list of this thread to the backing
+    void trim() {
+        free_list_release< Size, BackingT >(m_head);
+        m_head = nullptr;
+        m_list_count = 0;
+    }
 };
 
-template < const uint16_t MaxListCount, const size_t Size >
+template < const uint16_t MaxListCount, const size_t Size, const uint32_t MaxMagazines = FREELIST_DEPOT_MAGAZINE_COUNT,
+           typename BackingT = FreeListMallocBacking >
 class FreeListAllocator {
 private:
-    folly::ThreadLocalPtr< FreeListAllocatorImpl< MaxListCount, Size > > m_impl;
+    typedef FreeListAllocatorImpl< MaxListCount, Size, MaxMagazines, BackingT > impl_type;
+
+    // Depot has to outlive all the thread local impls, which return their lists to it on destruction
+    typename impl_type::depot_type m_depot;
+    folly::ThreadLocalPtr< impl_type > m_impl;
+
+    impl_type* get_impl() {
+        if (sisl_unlikely(m_impl.get() == nullptr)) { m_impl.reset(new impl_type(&m_depot)); }
+        return m_impl.get();
+    }
 
 public:
     static_assert((Size >= sizeof(uint8_t*)), "Size requested should be atleast a pointer size");
@@ -153,18 +291,22 @@ public:
 
     ~FreeListAllocator() { m_impl.reset(nullptr); }
 
-    uint8_t* allocate(const uint32_t size_needed) {
-        if (sisl_unlikely(m_impl.get() == nullptr)) { m_impl.reset(new FreeListAllocatorImpl< MaxListCount, Size >()); }
-        return (m_impl->allocate(size_needed));
-    }
+    uint8_t* allocate(const uint32_t size_needed) { return get_impl()->allocate(size_needed); }
 
+    // Threads which only free (consumers in a producer/consumer setup) also need a list, so that their frees can make
+    // it back to the allocating threads through the depot
     bool deallocate(uint8_t* const mem, const uint32_t size_alloced) {
-        if (sisl_unlikely(m_impl.get() == nullptr)) {
-            std::free(static_cast< void* >(mem));
-            return true;
-        } else {
-            return m_impl->deallocate(mem, size_alloced);
-        }
+        return get_impl()->deallocate(mem, size_alloced);
+    }
+
+    /**
+     * @brief Return the cached objects of the calling thread and of the depot to the backing, and let the backing
+     * release what it holds to the OS. Objects cached by the other threads stay cached.
+     */
+    void trim() {
+        if (impl_type* const impl{m_impl.get()}) { impl->trim(); }
+        m_depot.trim();
+        BackingT::template trim< Size >();
     }
 
     bool owns(uint8_t* const mem) const { return true; }
@@ -16,72 +16,231 @@
  *********************************************************************************/
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <cassert>
 #include <memory>
 #include <mutex>
+#include <vector>
+
+#if defined __clang__ or defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wattributes"
+#endif
+#include <folly/ThreadLocal.h>
+#if defined __clang__ or defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
 
 #include "bitset.hpp"
 #include "utils.hpp"
 
 namespace sisl {
+/**
+ * @brief IDReserver hands out the lowest unreserved id. It maintains a hint below which all ids are known to be
+ * reserved, so reserve does not rescan from id 0 every time.
+ *
+ * Optionally (thread_cache_ids > 0) every thread pre-claims ids in batches and hands them out or takes back
+ * unreserved ids from its own cache, which is guarded only by a per thread mutex. The shared lock is taken only
+ * once per batch. With thread caches ids are no longer handed out lowest first. Cached ids are not reported as
+ * reserved by is_reserved, first_reserved_id, next_reserved_id or serialize. When a thread exits its cached ids are
+ * returned to the reserver.
+ */
 class IDReserver {
+private:
+    struct id_cache {
+        explicit id_cache(IDReserver* r) : reserver{r} {}
+        id_cache(const id_cache&) = delete;
+        id_cache(id_cache&&) noexcept = delete;
+        id_cache& operator=(const id_cache&) = delete;
+        id_cache& operator=(id_cache&&) noexcept = delete;
+        ~id_cache() { reserver->unreserve_bulk(ids); }
+
+        IDReserver* reserver;
+        std::mutex mtx; // Contended only with the rare is_reserved/serialize/iteration calls
+        std::vector< uint32_t > ids;
+    };
+    struct id_cache_tag {};
+
+    id_cache& thread_cache() {
+        if (sisl_unlikely(m_thread_caches.get() == nullptr)) { m_thread_caches.reset(new id_cache(this)); }
+        return *m_thread_caches;
+    }
+
+    // Lock all thread caches and then the reserver lock, so that the cached ids are a consistent snapshot. Lock
+    // order is always thread cache(s) followed by m_mutex.
+    template < typename FnT >
+    auto with_all_locked(const FnT& fn) {
+        std::vector< id_cache* > caches;
+        if (m_thread_cache_ids == 0) {
+            std::unique_lock lg(m_mutex);
+            return fn(caches);
+        }
+
+        auto accessor = m_thread_caches.accessAllThreads();
+        std::vector< std::unique_lock< std::mutex > > cache_locks;
+        for (auto& c : accessor) {
+            cache_locks.emplace_back(c.mtx);
+            caches.push_back(&c);
+        }
+        std::unique_lock lg(m_mutex);
+        return fn(caches);
+    }
+
+    static bool is_cached(const std::vector< id_cache* >& caches, uint32_t id) {
+        for (const auto* c : caches) {
+            if (std::find(c->ids.cbegin(), c->ids.cend(), id) != c->ids.cend()) { return true; }
+        }
+        return false;
+    }
+
 public:
-    IDReserver(uint32_t estimated_ids = 1024) : m_reserved_bits(estimated_ids) { assert(estimated_ids != 0); }
+    IDReserver(uint32_t estimated_ids = 1024, uint32_t thread_cache_ids = 0) :
+            m_reserved_bits(estimated_ids), m_thread_cache_ids{thread_cache_ids} {
+        assert(estimated_ids != 0);
+    }
 
-    IDReserver(const sisl::byte_array& b) : m_reserved_bits(b) {}
+    IDReserver(const sisl::byte_array& b, uint32_t thread_cache_ids = 0) :
+            m_reserved_bits(b), m_thread_cache_ids{thread_cache_ids} {}
 
     uint32_t reserve() {
-        std::unique_lock lg(m_mutex);
-        size_t nbit = m_reserved_bits.get_next_reset_bit(0);
-        if (nbit == Bitset::npos) {
-            // We ran out of room to allocate bits, resize and allocate more
-            const auto cur_size = m_reserved_bits.size();
-            assert(cur_size != 0);
-            m_reserved_bits.resize(cur_size * 2);
-            nbit = cur_size;
+        if (m_thread_cache_ids != 0) {
+            id_cache& c = thread_cache();
+            std::unique_lock cl(c.mtx);
+            if (c.ids.empty()) { reserve_bulk(m_thread_cache_ids, c.ids); }
+            const uint32_t id = c.ids.back();
+            c.ids.pop_back();
+            return id;
         }
-        m_reserved_bits.set_bit(nbit);
-        return nbit;
+
+        std::unique_lock lg(m_mutex);
+        return reserve_next();
     }
 
     void reserve(uint32_t id) {
+        with_all_locked([this, id](const std::vector< id_cache* >& caches) {
+            assert(id < m_reserved_bits.size());
+            // If the id is sitting in a thread cache, take it out of there
+            for (auto* c : caches) {
+                auto it = std::find(c->ids.begin(), c->ids.end(), id);
+                if (it != c->ids.end()) {
+                    c->ids.erase(it);
+                    return;
+                }
+            }
+            assert(!(m_reserved_bits.get_bitval(id)));
+            m_reserved_bits.set_bit(id);
+        });
+    }
+
+    // Reserve count ids under a single lock and append them to ids
+    void reserve_bulk(uint32_t count, std::vector< uint32_t >& ids) {
+        ids.reserve(ids.size() + count);
         std::unique_lock lg(m_mutex);
-        assert(!(m_reserved_bits.get_bitval(id)));
-        assert(id < m_reserved_bits.size());
-        m_reserved_bits.set_bit(id);
+        for (uint32_t i{0}; i < count; ++i) {
+            ids.push_back(reserve_next());
+        }
     }
 
     void unreserve(uint32_t id) {
+        if (m_thread_cache_ids != 0) {
+            id_cache& c = thread_cache();
+            std::unique_lock cl(c.mtx);
+            c.ids.push_back(id);
+            if (c.ids.size() > 2 * m_thread_cache_ids) {
+                // Cache is overflowing, return the excess in bulk
+                std::unique_lock lg(m_mutex);
+                for (auto i = m_thread_cache_ids; i < c.ids.size(); ++i) {
+                    unreserve_locked(c.ids[i]);
+                }
+                c.ids.resize(m_thread_cache_ids);
+            }
+            return;
+        }
+
         std::unique_lock lg(m_mutex);
-        assert(id < m_reserved_bits.size());
-        m_reserved_bits.reset_bit(id);
+        unreserve_locked(id);
     }
 
-    bool is_reserved(uint32_t id) {
+    // Unreserve all the ids under a single lock, bypassing the thread cache
+    void unreserve_bulk(const std::vector< uint32_t >& ids) {
         std::unique_lock lg(m_mutex);
-        return m_reserved_bits.get_bitval(id);
+        for (const auto id : ids) {
+            unreserve_locked(id);
+        }
+    }
+
+    bool is_reserved(uint32_t id) {
+        return with_all_locked([this, id](const std::vector< id_cache* >& caches) {
+            return m_reserved_bits.get_bitval(id) && !is_cached(caches, id);
+        });
     }
 
     sisl::byte_array serialize() {
-        std::unique_lock lg(m_mutex);
-        return m_reserved_bits.serialize();
+        return with_all_locked([this](const std::vector< id_cache* >& caches) {
+            bool any_cached{false};
+            for (auto* c : caches) {
+                any_cached = any_cached || !c->ids.empty();
+            }
+            if (!any_cached) { return m_reserved_bits.serialize(); }
+
+            // Persist the cached ids as unreserved
+            sisl::Bitset bits;
+            bits.copy(m_reserved_bits);
+            for (auto* c : caches) {
+                for (const auto id : c->ids) {
+                    bits.reset_bit(id);
+                }
+            }
+            return bits.serialize(std::nullopt, true /* force_copy */);
+        });
     }
 
     bool first_reserved_id(uint32_t& found_id) { return find_next_reserved_id(true, found_id); }
     bool next_reserved_id(uint32_t& last_found_id) { return find_next_reserved_id(false, last_found_id); }
 
 private:
+    // NOTE: must be called under m_mutex
+    uint32_t reserve_next() {
+        size_t nbit = m_reserved_bits.get_next_reset_bit(m_free_hint);
+        if (nbit == Bitset::npos) {
+            // We ran out of room to allocate bits, resize and allocate more
+            const auto cur_size = m_reserved_bits.size();
+            assert(cur_size != 0);
+            m_reserved_bits.resize(cur_size * 2);
+            nbit = cur_size;
+        }
+        m_reserved_bits.set_bit(nbit);
+        m_free_hint = nbit + 1; // Everything below is reserved
+        return nbit;
+    }
+
+    // NOTE: must be called under m_mutex
+    void unreserve_locked(uint32_t id) {
+        assert(id < m_reserved_bits.size());
+        m_reserved_bits.reset_bit(id);
+        m_free_hint = std::min< uint64_t >(m_free_hint, id);
+    }
+
     bool find_next_reserved_id(bool first, uint32_t& last_found_id) {
-        std::unique_lock lg(m_mutex);
-        size_t nbit = m_reserved_bits.get_next_set_bit(first ? 0 : last_found_id + 1);
-        if (nbit == Bitset::npos) return false;
-        last_found_id = (uint32_t)nbit;
-        return true;
+        return with_all_locked([this, first, &last_found_id](const std::vector< id_cache* >& caches) {
+            size_t nbit = m_reserved_bits.get_next_set_bit(first ? 0 : last_found_id + 1);
+            while ((nbit != Bitset::npos) && is_cached(caches, nbit)) {
+                nbit = m_reserved_bits.get_next_set_bit(nbit + 1);
+            }
+            if (nbit == Bitset::npos) return false;
+            last_found_id = (uint32_t)nbit;
+            return true;
+        });
     }
 
 private:
     std::mutex m_mutex;
     sisl::Bitset m_reserved_bits;
+    uint64_t m_free_hint{0}; // All ids below this are reserved
+    uint32_t m_thread_cache_ids;
+    // Declared last so that all the cached ids are returned before the bitset is destroyed
+    folly::ThreadLocalPtr< id_cache, id_cache_tag > m_thread_caches;
 };
 } // namespace sisl
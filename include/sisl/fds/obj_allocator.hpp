@@ -18,8 +18,10 @@
 
 #include <cstdlib>
 #include <memory>
+#include <new>
 
 #include "freelist_allocator.hpp"
+#include "slab_allocator.hpp"
 
 namespace sisl {
 
@@ -27,14 +29,17 @@ static constexpr size_t FREELIST_CACHE_COUNT{200};
 
 /**
  * @brief Object Allocator is an object wrapper on top of freelist allocator. It provides convenient method to create
- * a C++ object and destruct them.
+ * a C++ object and destruct them. BackingT decides where the objects come from on a freelist miss, either the system
+ * allocator (FreeListMallocBacking) or slabs which keep the objects of this type contiguous (FreeListSlabBacking).
  */
-template < typename T, const size_t CacheCount = FREELIST_CACHE_COUNT >
+template < typename T, const size_t CacheCount = FREELIST_CACHE_COUNT, typename BackingT = FreeListMallocBacking >
 class ObjectAllocator {
+private:
+    typedef sisl::FreeListAllocator< FREELIST_CACHE_COUNT, sizeof(T), FREELIST_DEPOT_MAGAZINE_COUNT, BackingT >
+        freelist_allocator_t;
+
 public:
-    ObjectAllocator() {
-        m_allocator = std::make_unique< sisl::FreeListAllocator< FREELIST_CACHE_COUNT, sizeof(T) > >();
-    }
+    ObjectAllocator() { m_allocator = std::make_unique< freelist_allocator_t >(); }
     ObjectAllocator(const ObjectAllocator&) = delete;
     ObjectAllocator(ObjectAllocator&&) noexcept = delete;
     ObjectAllocator& operator=(const ObjectAllocator&) = delete;
@@ -43,6 +48,7 @@ public:
     template < class... Args >
     static T* make_object(Args&&... args) {
         uint8_t* const mem{get_obj_allocator()->m_allocator->allocate(sizeof(T))};
+        if (sisl_unlikely(mem == nullptr)) { throw std::bad_alloc(); }
         T* const ptr{new (mem) T(std::forward< Args >(args)...)};
         return ptr;
     }
@@ -52,16 +58,19 @@ public:
         get_obj_allocator()->m_allocator->deallocate(reinterpret_cast< uint8_t* >(mem), obj_size);
     }
 
-    static std::unique_ptr< ObjectAllocator< T, CacheCount > > obj_allocator;
+    // Return the objects cached by the calling thread and the depot to the backing, see FreeListAllocator::trim()
+    static void trim() { get_obj_allocator()->m_allocator->trim(); }
+
+    static std::unique_ptr< ObjectAllocator< T, CacheCount, BackingT > > obj_allocator;
 
 private:
-    sisl::FreeListAllocator< FREELIST_CACHE_COUNT, sizeof(T) >* get_freelist_allocator() { return m_allocator.get(); }
+    freelist_allocator_t* get_freelist_allocator() { return m_allocator.get(); }
 
 private:
-    std::unique_ptr< sisl::FreeListAllocator< FREELIST_CACHE_COUNT, sizeof(T) > > m_allocator;
+    std::unique_ptr< freelist_allocator_t > m_allocator;
 
-    static ObjectAllocator< T, CacheCount >* get_obj_allocator() {
-        static ObjectAllocator< T, CacheCount > obj_allocator{};
+    static ObjectAllocator< T, CacheCount, BackingT >* get_obj_allocator() {
+        static ObjectAllocator< T, CacheCount, BackingT > obj_allocator{};
         return &obj_allocator;
     }
 };
@@ -0,0 +1,204 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include "bitword.hpp"
+
+namespace sisl {
+
+//
+// Succinct rank/select directory over an array of Bitwords. It keeps the cumulative set count at every 512 bit
+// superblock, so rank is one lookup plus at most one superblock worth of popcounts, and select is a binary search
+// over the superblocks plus the same in-superblock scan.
+//
+// Nothing is allocated until the first lookup(), which builds the directory, and the directory is rebuilt on the
+// next lookup() after an invalidate(). Owners are expected to call invalidate() on every mutation of the words; it is
+// a single relaxed load unless a directory is built, so owners which never rank/select pay nothing more. Concurrent
+// lookups share the directory under a reader lock. Like any read of the words, a lookup concurrent with a mutation
+// may or may not reflect it, and so may the lookups after it until the next invalidate().
+//
+// Copies and moves never carry the directory over, as the target is not assumed to be over the same words.
+//
+template < typename BitwordT >
+class RankSelectDirectory {
+public:
+    typedef BitwordT bitword_type;
+    static constexpr uint64_t npos{std::numeric_limits< uint64_t >::max()};
+    static constexpr uint64_t superblock_bits() { return 512; }
+    static constexpr uint64_t superblock_words() { return superblock_bits() / bitword_type::bits(); }
+
+    class Table {
+    public:
+        /**
+         * @brief Get the number of set bits in [0, bit) of the words array
+         *
+         * @param bit Bit position upto which (exclusive) to count; must be <= nwords * bits per word
+         */
+        uint64_t rank(const uint64_t bit) const {
+            assert(bit <= m_nwords * bitword_type::bits());
+            const uint64_t word_idx{bit / bitword_type::bits()};
+            const uint64_t sb_idx{word_idx / superblock_words()};
+            uint64_t cnt{m_ranks[sb_idx]};
+            for (uint64_t w{sb_idx * superblock_words()}; w < word_idx; ++w) {
+                cnt += m_words[w].get_set_count();
+            }
+
+            const uint8_t offset{static_cast< uint8_t >(bit % bitword_type::bits())};
+            if (offset > 0) {
+                cnt += get_set_bit_count(m_words[word_idx].to_integer() &
+                                         static_cast< typename bitword_type::word_t >(consecutive_bitmask[offset - 1]));
+            }
+            return cnt;
+        }
+
+        /**
+         * @brief Get the bit position of the nth (0 based) set bit in the words array
+         *
+         * @return Bit position or npos if there are not that many set bits
+         */
+        uint64_t select(uint64_t n) const {
+            if (n >= m_ranks.back()) { return npos; }
+
+            // Find the last superblock whose cumulative count is <= n
+            const auto it{std::upper_bound(m_ranks.cbegin(), m_ranks.cend(), n)};
+            const uint64_t sb_idx{static_cast< uint64_t >(std::distance(m_ranks.cbegin(), it)) - 1};
+            n -= m_ranks[sb_idx];
+
+            for (uint64_t w{sb_idx * superblock_words()}; w < m_nwords; ++w) {
+                const uint8_t cnt{m_words[w].get_set_count()};
+                if (n < cnt) {
+                    return w * bitword_type::bits() +
+                        get_nth_set_bit(m_words[w].to_integer(), static_cast< uint8_t >(n));
+                }
+                n -= cnt;
+            }
+            return npos;
+        }
+
+        uint64_t total_set_count() const { return m_ranks.back(); }
+
+    private:
+        friend class RankSelectDirectory;
+
+        bool is_over(const bitword_type* const words, const uint64_t nwords) const {
+            return (words == m_words) && (nwords == m_nwords) && !m_ranks.empty();
+        }
+
+        void build(const bitword_type* const words, const uint64_t nwords) {
+            m_words = words;
+            m_nwords = nwords;
+
+            // m_ranks[i] = set count of all words before superblock i, last entry is the total set count
+            const uint64_t nsb{(nwords + superblock_words() - 1) / superblock_words()};
+            m_ranks.resize(nsb + 1);
+            uint64_t cnt{0};
+            for (uint64_t w{0}; w < nwords; ++w) {
+                if ((w % superblock_words()) == 0) { m_ranks[w / superblock_words()] = cnt; }
+                cnt += words[w].get_set_count();
+            }
+            m_ranks[nsb] = cnt;
+        }
+
+    private:
+        const bitword_type* m_words{nullptr};
+        uint64_t m_nwords{0};
+        std::vector< uint64_t > m_ranks;
+    };
+
+    RankSelectDirectory() = default;
+    RankSelectDirectory(const RankSelectDirectory&) noexcept {}
+    RankSelectDirectory(RankSelectDirectory&&) noexcept {}
+    RankSelectDirectory& operator=(const RankSelectDirectory&) noexcept {
+        invalidate();
+        return *this;
+    }
+    RankSelectDirectory& operator=(RankSelectDirectory&&) noexcept {
+        invalidate();
+        return *this;
+    }
+    ~RankSelectDirectory() { delete m_state.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Mark the table stale. Has to be called after the last word of a mutation is written, the fence pairs
+     * with the one in lookup(), so that either the scan sees the written words or this sees the table marked valid
+     * and marks it stale again.
+     */
+    void invalidate() const {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_valid.load(std::memory_order_relaxed)) { m_valid.store(false, std::memory_order_relaxed); }
+    }
+
+    /**
+     * @brief Call cb with a Table that is up to date with the words array, building it first if needed. The words
+     * must not be freed or reallocated while this is in progress.
+     *
+     * @return Whatever cb returns
+     */
+    template < typename CB >
+    auto lookup(const bitword_type* const words, const uint64_t nwords, const CB& cb) const {
+        state_t* const state{get_state()};
+        {
+            std::shared_lock lk{state->mutex};
+            if (m_valid.load(std::memory_order_acquire) && state->table.is_over(words, nwords)) {
+                return cb(static_cast< const Table& >(state->table));
+            }
+        }
+
+        std::unique_lock lk{state->mutex};
+        if (!m_valid.load(std::memory_order_acquire) || !state->table.is_over(words, nwords)) {
+            // Marked valid before the scan, so that a mutation the scan could have missed invalidates it again
+            m_valid.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            state->table.build(words, nwords);
+        }
+        return cb(static_cast< const Table& >(state->table));
+    }
+
+private:
+    struct state_t {
+        std::shared_mutex mutex;
+        Table table;
+    };
+
+    state_t* get_state() const {
+        state_t* state{m_state.load(std::memory_order_acquire)};
+        if (state == nullptr) {
+            auto* const new_state{new state_t{}};
+            if (m_state.compare_exchange_strong(state, new_state, std::memory_order_acq_rel)) {
+                state = new_state;
+            } else {
+                delete new_state;
+            }
+        }
+        return state;
+    }
+
+private:
+    mutable std::atomic< bool > m_valid{false};
+    mutable std::atomic< state_t* > m_state{nullptr};
+};
+
+} // namespace sisl
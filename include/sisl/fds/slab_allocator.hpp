@@ -0,0 +1,250 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+#include <sys/mman.h>
+
+#include <boost/intrusive/list.hpp>
+
+#include "freelist_allocator.hpp"
+
+namespace sisl {
+
+static constexpr size_t SLAB_SIZE{2 * 1024 * 1024};
+static constexpr std::chrono::milliseconds SLAB_DEFAULT_IDLE_RELEASE_PERIOD{1000};
+
+/**
+ * @brief Map an anonymous region of size bytes aligned to size, which has to be a power of 2 multiple of the page
+ * size. With huge_pages, a hugetlb mapping (naturally aligned for size of huge page) is tried first and if there are
+ * no huge pages reserved, it falls back to regular pages advised for transparent huge pages.
+ *
+ * @return Start of the region or nullptr if it could not be mapped. Release it with munmap(region, size)
+ */
+inline void* map_aligned_region(const size_t size, const bool huge_pages) {
+    if (huge_pages) {
+        void* const region{
+            ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0)};
+        if ((region != MAP_FAILED) && ((reinterpret_cast< uintptr_t >(region) & (size - 1)) == 0)) { return region; }
+        if (region != MAP_FAILED) { ::munmap(region, size); }
+    }
+
+    // Map twice the size and trim both ends, to get a size aligned region
+    void* const raw{::mmap(nullptr, 2 * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+    if (raw == MAP_FAILED) { return nullptr; }
+
+    const uintptr_t start{reinterpret_cast< uintptr_t >(raw)};
+    const uintptr_t aligned{(start + size - 1) & ~(uintptr_t{size} - 1)};
+    if (aligned > start) { ::munmap(raw, aligned - start); }
+    if (const uintptr_t tail{start + 2 * size - (aligned + size)}; tail > 0) {
+        ::munmap(reinterpret_cast< void* >(aligned + size), tail);
+    }
+    if (huge_pages) { ::madvise(reinterpret_cast< void* >(aligned), size, MADV_HUGEPAGE); }
+    return reinterpret_cast< void* >(aligned);
+}
+
+/**
+ * @brief SlabPool carves SLAB_SIZE regions, aligned to SLAB_SIZE, into Size slots so that all objects of one size
+ * stay contiguous in memory and share a few (huge) pages. The slab a slot belongs to is found by aligning the slot
+ * address down, so there is no per object overhead. Slabs which become fully free are returned to the OS once they
+ * have stayed free for the idle release period.
+ *
+ * The pool is shared by all threads and protected by a mutex. It is only meant to back FreeListAllocator on a miss,
+ * which already absorbs most allocs/deallocs in its thread local lists and depot. Idle slabs are looked for on every
+ * allocate and deallocate reaching the pool, and trim() releases all the fully free slabs right away. As objects
+ * cached in the free lists keep their slab in use, FreeListAllocator::trim() hands them back here first.
+ */
+template < std::size_t Size, bool HugePages >
+class SlabPool {
+private:
+    typedef std::chrono::steady_clock clock_type;
+
+    struct slab_header {
+        boost::intrusive::list_member_hook<> m_hook;
+        free_list_header* m_free_head{nullptr}; // Slots returned to the slab
+        uint8_t* m_bump;                        // Slots never handed out start here
+        uint32_t m_used{0};
+        clock_type::time_point m_free_since;
+    };
+    typedef boost::intrusive::list<
+        slab_header, boost::intrusive::member_hook< slab_header, boost::intrusive::list_member_hook<>,
+                                                    &slab_header::m_hook >,
+        boost::intrusive::constant_time_size< false > >
+        slab_list_t;
+
+    static constexpr size_t slots_offset() {
+        return ((sizeof(slab_header) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t)) *
+            alignof(std::max_align_t);
+    }
+    static constexpr uint32_t slots_per_slab() { return (SLAB_SIZE - slots_offset()) / Size; }
+    static_assert(slots_per_slab() > 1, "Slab size is too small for the object size");
+
+    std::mutex m_mutex;
+    slab_list_t m_partial_slabs; // Slabs with at least one free and one used slot
+    slab_list_t m_free_slabs;    // Fully free slabs, oldest first
+    uint64_t m_nslabs{0};        // Slabs currently mapped
+    std::atomic< int64_t > m_idle_period_ms{SLAB_DEFAULT_IDLE_RELEASE_PERIOD.count()};
+
+public:
+    SlabPool() = default;
+    SlabPool(const SlabPool&) = delete;
+    SlabPool(SlabPool&&) noexcept = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+    SlabPool& operator=(SlabPool&&) noexcept = delete;
+    ~SlabPool() = default;
+
+    static SlabPool& instance() {
+        // Intentionally leaked: static objects destructed later (say an ObjectAllocator) may still free to the pool
+        static SlabPool* const inst{new SlabPool()};
+        return *inst;
+    }
+
+    /**
+     * @brief Set how long a fully free slab is kept around, for reuse, before returning it to the OS
+     */
+    void set_idle_release_period(const std::chrono::milliseconds period) {
+        m_idle_period_ms.store(period.count(), std::memory_order_relaxed);
+    }
+
+    uint8_t* allocate() {
+        std::scoped_lock< std::mutex > lock{m_mutex};
+        release_idle_slabs(idle_release_period());
+        slab_header* slab;
+        if (!m_partial_slabs.empty()) {
+            slab = &m_partial_slabs.front();
+        } else if (!m_free_slabs.empty()) {
+            // Most recently freed slab is the most likely to still be in cache/TLB
+            slab = &m_free_slabs.back();
+            m_free_slabs.pop_back();
+            m_partial_slabs.push_front(*slab);
+        } else {
+            slab = create_slab();
+            if (slab == nullptr) { return nullptr; }
+            m_partial_slabs.push_front(*slab);
+        }
+
+        uint8_t* ptr;
+        if (slab->m_free_head) {
+            ptr = reinterpret_cast< uint8_t* >(slab->m_free_head);
+            slab->m_free_head = slab->m_free_head->next;
+        } else {
+            ptr = slab->m_bump;
+            slab->m_bump += Size;
+        }
+
+        // Full slabs are not tracked in any list, they are found from the slot address on free
+        if (++slab->m_used == slots_per_slab()) { m_partial_slabs.erase(m_partial_slabs.iterator_to(*slab)); }
+        return ptr;
+    }
+
+    void deallocate(uint8_t* const mem) {
+        auto* const slab{slab_of(mem)};
+        std::scoped_lock< std::mutex > lock{m_mutex};
+        auto* const hdr{reinterpret_cast< free_list_header* >(mem)};
+        hdr->next = slab->m_free_head;
+        slab->m_free_head = hdr;
+
+        if (slab->m_used-- == slots_per_slab()) { m_partial_slabs.push_front(*slab); }
+        if (slab->m_used == 0) {
+            m_partial_slabs.erase(m_partial_slabs.iterator_to(*slab));
+            slab->m_free_since = clock_type::now();
+            m_free_slabs.push_back(*slab);
+        }
+        release_idle_slabs(idle_release_period());
+    }
+
+    // Release all the fully free slabs to the OS, irrespective of how long they have been free
+    void trim() {
+        std::scoped_lock< std::mutex > lock{m_mutex};
+        release_idle_slabs(std::chrono::milliseconds{0});
+    }
+
+    uint64_t num_slabs() {
+        std::scoped_lock< std::mutex > lock{m_mutex};
+        return m_nslabs;
+    }
+
+private:
+    static slab_header* slab_of(uint8_t* const mem) {
+        return reinterpret_cast< slab_header* >(reinterpret_cast< uintptr_t >(mem) & ~(uintptr_t{SLAB_SIZE} - 1));
+    }
+
+    slab_header* create_slab() {
+        void* const region{map_aligned_region(SLAB_SIZE, HugePages)};
+        if (region == nullptr) { return nullptr; }
+
+        COUNTER_INCREMENT_IF_ENABLED(freelist_slab_mapped, 1);
+        ++m_nslabs;
+        auto* const slab{new (region) slab_header()};
+        slab->m_bump = static_cast< uint8_t* >(region) + slots_offset();
+        return slab;
+    }
+
+    std::chrono::milliseconds idle_release_period() const {
+        return std::chrono::milliseconds{m_idle_period_ms.load(std::memory_order_relaxed)};
+    }
+
+    void release_idle_slabs(const std::chrono::milliseconds idle_period) {
+        if (m_free_slabs.empty()) { return; }
+
+        const auto now{clock_type::now()};
+        while (!m_free_slabs.empty() && ((now - m_free_slabs.front().m_free_since) >= idle_period)) {
+            slab_header* const slab{&m_free_slabs.front()};
+            m_free_slabs.pop_front();
+            slab->~slab_header();
+            ::munmap(static_cast< void* >(slab), SLAB_SIZE);
+            --m_nslabs;
+            COUNTER_INCREMENT_IF_ENABLED(freelist_slab_unmapped, 1);
+        }
+    }
+};
+
+/**
+ * @brief Backing policy for FreeListAllocator which, on a miss, allocates from slabs instead of going to the system
+ * allocator for every object. With HugePages, slabs are backed by a hugetlb page if available or else advised for
+ * transparent huge pages.
+ */
+template < bool HugePages = false >
+struct FreeListSlabBacking {
+    template < std::size_t Size >
+    static uint8_t* allocate() {
+        return SlabPool< Size, HugePages >::instance().allocate();
+    }
+
+    template < std::size_t Size >
+    static void deallocate(uint8_t* const mem) {
+        SlabPool< Size, HugePages >::instance().deallocate(mem);
+    }
+
+    template < std::size_t Size >
+    static void trim() {
+        SlabPool< Size, HugePages >::instance().trim();
+    }
+
+    template < std::size_t Size >
+    static void set_idle_release_period(const std::chrono::milliseconds period) {
+        SlabPool< Size, HugePages >::instance().set_idle_release_period(period);
+    }
+};
+
+} // namespace sisl
@@ -16,8 +16,16 @@
  *********************************************************************************/
 #pragma once
 
+#include <array>
+#include <bit>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace sisl {
@@ -65,4 +73,237 @@ private:
         }
     }
 };
+
+/*
+ * Sparse array of fixed size pages, where a page is allocated only when an index in it is first touched. Index is
+ * split into a page number and a slot within the page (2^PageBits slots). Pages are found through a three level radix
+ * directory: a root vector, then mid and leaf nodes of 2^dir_bits entries each, which are allocated only when a page
+ * under them is. So lookup is O(1), and touching a far index allocates just one page and the nodes on its path, not
+ * every entry or directory slot before it. Only the slots which are populated hold a constructed T.
+ *
+ * Iteration skips the pages which were never touched. If release_empty_pages is set, a page is freed as soon as its
+ * last entry is erased, so that memory follows the populated pages rather than the largest index ever touched.
+ *
+ * Not thread safe.
+ */
+template < typename T, uint8_t PageBits = 10 >
+class paged_sparse_vector {
+public:
+    static constexpr size_t page_size{size_t{1} << PageBits};
+
+    explicit paged_sparse_vector(const bool release_empty_pages = false) : m_release_empty_pages{release_empty_pages} {}
+    paged_sparse_vector(const paged_sparse_vector&) = delete;
+    paged_sparse_vector(paged_sparse_vector&&) noexcept = default;
+    paged_sparse_vector& operator=(const paged_sparse_vector&) = delete;
+    paged_sparse_vector& operator=(paged_sparse_vector&&) noexcept = default;
+    ~paged_sparse_vector() = default;
+
+    /**
+     * @brief Get the entry at index, default constructing it if it is not populated
+     */
+    T& operator[](const size_t index) {
+        T* const p{find(index)};
+        return (p == nullptr) ? construct_entry(index) : *p;
+    }
+
+    /**
+     * @brief Construct the entry at index in place, replacing the existing entry if any. If the constructor throws,
+     * the entry at index is left unpopulated.
+     */
+    template < typename... Args >
+    T& emplace(const size_t index, Args&&... args) {
+        return construct_entry(index, std::forward< Args >(args)...);
+    }
+
+    bool index_exists(const size_t index) const { return (find(index) != nullptr); }
+
+    T* find(const size_t index) {
+        page* pg{get_page(index)};
+        return (pg && pg->is_populated(slot_of(index))) ? pg->ptr(slot_of(index)) : nullptr;
+    }
+
+    const T* find(const size_t index) const { return const_cast< paged_sparse_vector* >(this)->find(index); }
+
+    T& at(const size_t index) {
+        T* const p{find(index)};
+        if (p == nullptr) { throw std::out_of_range("Index is not populated"); }
+        return *p;
+    }
+
+    const T& at(const size_t index) const { return const_cast< paged_sparse_vector* >(this)->at(index); }
+
+    /**
+     * @brief Destroy the entry at index, returns false if it was not populated
+     */
+    bool erase(const size_t index) {
+        page* pg{get_page(index)};
+        if ((pg == nullptr) || !pg->is_populated(slot_of(index))) { return false; }
+
+        pg->destroy(slot_of(index));
+        --m_size;
+        if (m_release_empty_pages && (pg->count == 0)) { release_page(index); }
+        return true;
+    }
+
+    void clear() {
+        m_root.clear();
+        m_size = 0;
+        m_page_count = 0;
+    }
+
+    // Number of populated entries
+    size_t size() const { return m_size; }
+    bool empty() const { return (m_size == 0); }
+
+    // Number of pages allocated right now
+    size_t page_count() const { return m_page_count; }
+
+    /**
+     * @brief Call cb(index, entry) for every populated entry in increasing order of index, till cb returns false
+     */
+    template < typename CB >
+    void foreach_entry(const CB& cb) {
+        for (size_t r{0}; r < m_root.size(); ++r) {
+            const mid_node* const mid{m_root[r].get()};
+            if (mid == nullptr) { continue; }
+            for (size_t m{0}; m < dir_fanout; ++m) {
+                const leaf_node* const leaf{mid->leaves[m].get()};
+                if (leaf == nullptr) { continue; }
+                for (size_t l{0}; l < dir_fanout; ++l) {
+                    page* const pg{leaf->pages[l].get()};
+                    if ((pg == nullptr) || (pg->count == 0)) { continue; }
+                    const size_t base_index{((((r << dir_bits) | m) << dir_bits) | l) << PageBits};
+                    for (size_t w{0}; w < pg->populated.size(); ++w) {
+                        for (uint64_t bits{pg->populated[w]}; bits != 0; bits &= (bits - 1)) {
+                            const size_t slot{w * 64 + std::countr_zero(bits)};
+                            if (!cb(base_index + slot, *pg->ptr(slot))) { return; }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    struct page {
+        static constexpr size_t nwords{(page_size + 63) / 64};
+
+        page() = default;
+        page(const page&) = delete;
+        page& operator=(const page&) = delete;
+        ~page() {
+            for (size_t slot{0}; (count != 0) && (slot < page_size); ++slot) {
+                if (is_populated(slot)) { destroy(slot); }
+            }
+        }
+
+        bool is_populated(const size_t slot) const { return (populated[slot / 64] & (uint64_t{1} << (slot % 64))); }
+
+        template < typename... Args >
+        void construct(const size_t slot, Args&&... args) {
+            new (ptr(slot)) T(std::forward< Args >(args)...);
+            populated[slot / 64] |= (uint64_t{1} << (slot % 64));
+            ++count;
+        }
+
+        void destroy(const size_t slot) {
+            ptr(slot)->~T();
+            populated[slot / 64] &= ~(uint64_t{1} << (slot % 64));
+            --count;
+        }
+
+        T* ptr(const size_t slot) { return std::launder(reinterpret_cast< T* >(&storage[0]) + slot); }
+
+        std::array< uint64_t, nwords > populated{};
+        size_t count{0};
+        alignas(T) std::byte storage[sizeof(T) * page_size];
+    };
+
+    // Directory nodes below the root, each with the number of its children which are allocated
+    static constexpr uint8_t dir_bits{9};
+    static constexpr size_t dir_fanout{size_t{1} << dir_bits};
+
+    struct leaf_node {
+        std::array< std::unique_ptr< page >, dir_fanout > pages;
+        size_t count{0};
+    };
+
+    struct mid_node {
+        std::array< std::unique_ptr< leaf_node >, dir_fanout > leaves;
+        size_t count{0};
+    };
+
+    static size_t page_of(const size_t index) { return (index >> PageBits); }
+    static size_t slot_of(const size_t index) { return (index & (page_size - 1)); }
+    static size_t root_of(const size_t pnum) { return (pnum >> (2 * dir_bits)); }
+    static size_t mid_of(const size_t pnum) { return ((pnum >> dir_bits) & (dir_fanout - 1)); }
+    static size_t leaf_of(const size_t pnum) { return (pnum & (dir_fanout - 1)); }
+
+    page* get_page(const size_t index) const {
+        const size_t pnum{page_of(index)};
+        if (root_of(pnum) >= m_root.size()) { return nullptr; }
+        const mid_node* const mid{m_root[root_of(pnum)].get()};
+        if (mid == nullptr) { return nullptr; }
+        const leaf_node* const leaf{mid->leaves[mid_of(pnum)].get()};
+        return (leaf == nullptr) ? nullptr : leaf->pages[leaf_of(pnum)].get();
+    }
+
+    page& get_or_alloc_page(const size_t index) {
+        const size_t pnum{page_of(index)};
+        if (root_of(pnum) >= m_root.size()) { m_root.resize(root_of(pnum) + 1); }
+        auto& mid{m_root[root_of(pnum)]};
+        if (!mid) { mid = std::make_unique< mid_node >(); }
+        auto& leaf{mid->leaves[mid_of(pnum)]};
+        if (!leaf) {
+            leaf = std::make_unique< leaf_node >();
+            ++mid->count;
+        }
+        auto& pg{leaf->pages[leaf_of(pnum)]};
+        if (!pg) {
+            pg = std::make_unique< page >();
+            ++leaf->count;
+            ++m_page_count;
+        }
+        return *pg;
+    }
+
+    // Free the page of index along with the directory nodes which are left empty
+    void release_page(const size_t index) {
+        const size_t pnum{page_of(index)};
+        auto& mid{m_root[root_of(pnum)]};
+        auto& leaf{mid->leaves[mid_of(pnum)]};
+        leaf->pages[leaf_of(pnum)].reset();
+        --m_page_count;
+        if (--leaf->count == 0) {
+            leaf.reset();
+            if (--mid->count == 0) { mid.reset(); }
+        }
+    }
+
+    template < typename... Args >
+    T& construct_entry(const size_t index, Args&&... args) {
+        page& pg{get_or_alloc_page(index)};
+        const size_t slot{slot_of(index)};
+        if (pg.is_populated(slot)) {
+            pg.destroy(slot);
+            --m_size;
+        }
+        try {
+            pg.construct(slot, std::forward< Args >(args)...);
+        } catch (...) {
+            // Do not leave behind an empty page for an entry which could not be built
+            if (pg.count == 0) { release_page(index); }
+            throw;
+        }
+        ++m_size;
+        return *pg.ptr(slot);
+    }
+
+private:
+    // Root of the page directory, sized upto the largest mid node touched. nullptr for untouched nodes and pages.
+    std::vector< std::unique_ptr< mid_node > > m_root;
+    size_t m_size{0};
+    size_t m_page_count{0};
+    bool m_release_empty_pages;
+};
 } // namespace sisl
@@ -16,11 +16,27 @@
  *********************************************************************************/
 #pragma once
 
-#include <folly/SharedMutex.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
 #include <sisl/metrics/metrics_group_impl.hpp>
 #include <sisl/metrics/metrics.hpp>
 
-#include "bitset.hpp"
+#include "utils.hpp"
 
 namespace sisl {
 class StreamTrackerMetrics : public MetricsGroupWrapper {
@@ -37,34 +53,60 @@ public:
     ~StreamTrackerMetrics() { deregister_me_from_farm(); }
 };
 
+/**
+ * @brief Tracks the state of a stream of entries (say journal entries) by index: which are created (active), which
+ * are completed and how far the stream is contiguously completed, so that it can be truncated upto there.
+ *
+ * Slots are stored in a ring of fixed size segments of alloc_blk_size slots, each with its own active and completed
+ * bits. Growth appends a segment and truncate recycles the head segments, so existing slots are never moved. Reads
+ * and updates of existing slots are lock free: they pin the segment and validate that it still holds the index,
+ * which makes them safe against a concurrent truncate recycling it. Only growth, truncate, rollback and reinit take
+ * the mutex.
+ */
 template < typename T, bool AutoTruncate = false >
 class StreamTracker {
     // using data_processing_t = std::function< bool(T&) >;
 
 public:
-    static constexpr size_t alloc_blk_size = 10000;
-    static constexpr size_t compaction_threshold = alloc_blk_size / 2;
+    // Number of slots in a segment
+    static constexpr size_t alloc_blk_size = 8192;
     static constexpr auto null_processor = []([[maybe_unused]] auto... x) -> bool { return true; };
 
     static_assert(std::is_trivially_copyable< T >::value, "Cannot use StreamTracker for non-trivally copyable classes");
+    static_assert(std::has_single_bit(alloc_blk_size) && (alloc_blk_size % 64 == 0), "Segment size should be 2^n");
 
     // Initialize the stream vector with start index
     StreamTracker(const char* name = "StreamTracker", int64_t start_idx = -1) :
-            m_comp_slot_bits(alloc_blk_size), m_active_slot_bits(alloc_blk_size), m_metrics(name) {
-        m_slot_ref_idx = start_idx + 1;
-
-        // Allocate the data for that size.
-        m_slot_data = (T*)std::calloc(alloc_blk_size, sizeof(T));
-        m_alloced_slots = alloc_blk_size;
-        GAUGE_UPDATE(m_metrics, stream_tracker_mem_size, (m_alloced_slots * sizeof(T)));
+            m_origin_idx{start_idx + 1},
+            m_slot_ref_idx{start_idx + 1},
+            m_completed_upto{start_idx},
+            m_metrics(name) {
+        m_dirs.emplace_back(std::make_unique< seg_dir >(initial_dir_size));
+        m_dir.store(m_dirs.back().get(), std::memory_order_release);
+        append_segment();
     }
 
-    ~StreamTracker() {
-        GAUGE_UPDATE(m_metrics, stream_tracker_mem_size, 0);
-        free(m_slot_data);
-    }
+    StreamTracker(const StreamTracker&) = delete;
+    StreamTracker(StreamTracker&&) noexcept = delete;
+    StreamTracker& operator=(const StreamTracker&) = delete;
+    StreamTracker& operator=(StreamTracker&&) noexcept = delete;
+
+    ~StreamTracker() { GAUGE_UPDATE(m_metrics, stream_tracker_mem_size, 0); }
 
-    void reinit(int64_t start_idx) { m_slot_ref_idx = start_idx; }
+    /**
+     * @brief Drop everything tracked and restart the stream at start_idx. Not to be called concurrently with other
+     * operations on the tracker.
+     */
+    void reinit(int64_t start_idx) {
+        std::unique_lock lg{m_mtx};
+        retire_segments(m_tail_seg.load(std::memory_order_relaxed));
+        m_origin_idx = start_idx;
+        m_slot_ref_idx.store(start_idx, std::memory_order_release);
+        m_completed_upto.store(start_idx - 1, std::memory_order_release);
+        m_head_seg = 0;
+        m_tail_seg.store(0, std::memory_order_release);
+        append_segment();
+    }
 
     template < class... Args >
     int64_t create_and_complete(int64_t idx, Args&&... args) {
@@ -83,30 +125,85 @@ public:
     }
 
     void complete(int64_t start_idx, int64_t end_idx) {
-        folly::SharedMutexWritePriority::ReadHolder holder(m_lock);
-        auto start_bit = start_idx - m_slot_ref_idx;
-        m_comp_slot_bits.set_bits(start_bit, end_idx - start_idx + 1);
+        foreach_segment_range(std::max(start_idx, ref_idx()), end_idx,
+                              [](segment* seg, size_t start_off, size_t count) {
+                                  seg->comp_bits.set_bits(start_off, count);
+                                  return true;
+                              });
+    }
+
+    /**
+     * @brief Update all the slots in [start_idx, end_idx] in one pass. If args are passed, slots which are not created
+     * yet are created with a copy of args, otherwise they are skipped. processor is called on every slot and the ones
+     * it returns true for are marked completed, setting the bits a word at a time. Returns the idx upto which the
+     * tracker is truncated, same as update.
+     */
+    template < class... Args >
+    int64_t update_range(int64_t start_idx, int64_t end_idx, const auto& processor, const Args&... args) {
+        return do_update_range(start_idx, end_idx, [&processor, &args...](segment* seg, size_t off, size_t count) {
+            if constexpr (sizeof...(Args) != 0) {
+                for (size_t i{off}; i < off + count; ++i) {
+                    if (!seg->active_bits.get_bitval(i)) { new (seg->slot(i)) T(args...); }
+                }
+                seg->active_bits.set_bits(off, count);
+            }
+            return seg->comp_bits.set_bits_if(off, count, [seg, &processor](size_t nbit) {
+                return ((sizeof...(Args) != 0) || seg->active_bits.get_bitval(nbit)) && processor(*seg->slot(nbit));
+            });
+        });
     }
 
+    /**
+     * @brief Mark all the slots in [start_idx, end_idx] completed in one pass. Unlike complete(), it grows the tracker
+     * to cover the range and accounts the completions towards auto truncation. Returns the idx upto which the tracker
+     * is truncated.
+     */
+    int64_t complete_range(int64_t start_idx, int64_t end_idx) {
+        return do_update_range(start_idx, end_idx, [](segment* seg, size_t off, size_t count) {
+            return seg->comp_bits.set_bits(off, count);
+        });
+    }
+
+    /**
+     * @brief Reset the slots after new_end_idx. Not to be called concurrently with completions of those slots.
+     * Excludes truncate and growth through the mutex. completed_upto() scans in progress are waited for and the ones
+     * started meanwhile do not cache their result, so that no watermark beyond new_end_idx survives the rollback.
+     */
     void rollback(int64_t new_end_idx) {
-        folly::SharedMutexWritePriority::ReadHolder holder(m_lock);
-        if ((new_end_idx < m_slot_ref_idx) ||
-            (new_end_idx >= (m_slot_ref_idx + int64_cast(m_active_slot_bits.size())))) {
+        std::unique_lock lg{m_mtx};
+        if ((new_end_idx < ref_idx()) || (new_end_idx >= alloced_end_idx())) {
             throw std::out_of_range("Slot idx is not in range");
         }
 
-        auto new_end_bit = new_end_idx - m_slot_ref_idx;
-        m_active_slot_bits.reset_bits(new_end_bit + 1, m_active_slot_bits.size() - new_end_bit - 1);
-        m_comp_slot_bits.reset_bits(new_end_bit + 1, m_comp_slot_bits.size() - new_end_bit - 1);
+        // Odd generation while the rollback is in progress. Pairs with the scan guard: either a scan has registered
+        // before this and is waited for, or it sees the odd generation and leaves the watermark alone.
+        m_rollback_gen.fetch_add(1, std::memory_order_seq_cst);
+        while (m_upto_scans.load(std::memory_order_seq_cst) != 0) {
+            std::this_thread::yield();
+        }
+
+        foreach_segment_range(new_end_idx + 1, alloced_end_idx() - 1,
+                              [](segment* seg, size_t start_off, size_t count) {
+                                  seg->active_bits.reset_bits(start_off, count);
+                                  seg->comp_bits.reset_bits(start_off, count);
+                                  return true;
+                              });
+
+        // Bring back the completion watermark if it is beyond the new end
+        int64_t upto{m_completed_upto.load(std::memory_order_acquire)};
+        while ((upto > new_end_idx) &&
+               !m_completed_upto.compare_exchange_weak(upto, new_end_idx, std::memory_order_acq_rel)) {}
+        m_rollback_gen.fetch_add(1, std::memory_order_release);
     }
 
     T& at(int64_t idx) const {
-        folly::SharedMutexWritePriority::ReadHolder holder(m_lock);
-        if (idx < m_slot_ref_idx) { throw std::out_of_range("Slot idx is not in range"); }
+        if (idx < ref_idx()) { throw std::out_of_range("Slot idx is not in range"); }
 
-        size_t nbit = idx - m_slot_ref_idx;
-        if (!m_active_slot_bits.get_bitval(nbit)) { throw std::out_of_range("Slot idx is not in range"); }
-        return *get_slot_data(nbit);
+        pinned_segment seg{pin(idx)};
+        if (!seg || !seg->active_bits.get_bitval(seg_offset(idx))) {
+            throw std::out_of_range("Slot idx is not in range");
+        }
+        return *seg->slot(seg_offset(idx));
     }
 
     /* Returns an anonymous structure which has 3 fields
@@ -123,69 +220,69 @@ public:
             bool is_completed = false;
         } ret;
 
-        folly::SharedMutexWritePriority::ReadHolder holder(m_lock);
-        if (idx < m_slot_ref_idx) {
+        if (idx < ref_idx()) {
             ret.is_out_of_range = true;
-        } else {
-            size_t nbit = idx - m_slot_ref_idx;
-            if (m_comp_slot_bits.get_bitval(nbit)) {
-                ret.is_completed = true;
-            } else if (m_active_slot_bits.get_bitval(nbit)) {
-                ret.is_active = true;
+            return ret;
+        }
+
+        pinned_segment seg{pin(idx)};
+        if (!seg) {
+            if (idx < ref_idx()) {
+                ret.is_out_of_range = true; // Truncated while we were looking
             } else {
                 ret.is_hole = true;
             }
+        } else if (seg->comp_bits.get_bitval(seg_offset(idx))) {
+            ret.is_completed = true;
+        } else if (seg->active_bits.get_bitval(seg_offset(idx))) {
+            ret.is_active = true;
+        } else {
+            ret.is_hole = true;
         }
         return ret;
     }
 
     size_t truncate(int64_t idx) {
-        folly::SharedMutexWritePriority::WriteHolder holder(m_lock);
+        std::unique_lock lg{m_mtx};
 
-        auto upto_bit = idx - m_slot_ref_idx + 1;
-        if (upto_bit <= 0) { return m_slot_ref_idx - 1; }
+        auto upto_bit = idx - ref_idx() + 1;
+        if (upto_bit <= 0) { return ref_idx() - 1; }
         return do_truncate(upto_bit);
     }
 
     size_t truncate() {
         if (AutoTruncate && (m_cmpltd_count_since_last_truncate.load(std::memory_order_acquire) == 0)) { return 0; }
 
-        folly::SharedMutexWritePriority::WriteHolder holder(m_lock);
+        std::unique_lock lg{m_mtx};
 
-        // Find the first bit with 0 in it
-        auto first_incomplete_bit = m_comp_slot_bits.get_next_reset_bit(0);
-        if (first_incomplete_bit == AtomicBitset::npos) {
-            // Seems like all the bits are completed, set it as last
-            first_incomplete_bit = m_alloced_slots;
-        } else if (first_incomplete_bit == 0) {
+        // Find the first incomplete slot, all the slots until then can be truncated. If all the slots are
+        // completed, it is the end of the allocated slots.
+        const auto upto_bit{completed_upto() - ref_idx() + 1};
+        if (upto_bit == 0) {
             // Nothing is completed, nothing to truncate
-            return m_slot_ref_idx - 1;
+            return ref_idx() - 1;
         }
-        return do_truncate(first_incomplete_bit);
+        return do_truncate(upto_bit);
     }
 
+    /**
+     * @brief Truncate the first upto_bit slots. Caller should hold the tracker mutex.
+     */
     size_t do_truncate(int64_t upto_bit) {
-        // Move all the bits upto the first incomplete bit
-        m_comp_slot_bits.shrink_head(upto_bit);
-        m_active_slot_bits.shrink_head(upto_bit);
-
-        // Shrink the data as well upto first_incomplete_bit. Instead of memmoving every truncate which could also
-        // be frequent, we simply mark to skip that much data and then when we are really needed we compact them.
-        m_data_skip_count += upto_bit;
-        m_alloced_slots -= upto_bit;
-        if (m_data_skip_count > compaction_threshold) {
-            std::memmove((void*)&m_slot_data[0], (void*)&m_slot_data[m_data_skip_count], (sizeof(T) * m_alloced_slots));
-            m_data_skip_count = 0;
-        }
-
-        // auto prev_ref_idx = m_slot_ref_idx;
-        m_slot_ref_idx += upto_bit;
+        const int64_t new_ref_idx{ref_idx() + upto_bit};
+        m_slot_ref_idx.store(new_ref_idx, std::memory_order_release);
+        advance_completed_upto(new_ref_idx - 1);
+        if (AutoTruncate) { m_cmpltd_count_since_last_truncate.store(0, std::memory_order_release); }
+
+        // Recycle the head segments which are entirely truncated. Lookups of indexes in them will fail validation
+        // from now on, so that nobody writes into a recycled segment.
+        retire_segments(seg_num(new_ref_idx));
         COUNTER_DECREMENT(m_metrics, stream_tracker_unsweeped_completions, upto_bit);
 
         // TODO: Do a callback on how much has been moved forward to
         // m_on_sweep_cb(m_slot_ref_idx - prev_ref_idx);
 
-        return m_slot_ref_idx - 1;
+        return new_ref_idx - 1;
     }
 
     void foreach_contiguous_completed(int64_t start_idx, const auto& cb) { _foreach_contiguous(start_idx, true, cb); }
@@ -193,73 +290,286 @@ public:
     void foreach_all_completed(int64_t start_idx, const auto& cb) { _foreach_all(start_idx, true, cb); }
     void foreach_all_active(int64_t start_idx, const auto& cb) { _foreach_all(start_idx, false, cb); }
 
+    /**
+     * @brief Idx upto which all the slots are completed. The last value found is cached, so that every call scans
+     * only the slots completed since, unless search_hint_idx is beyond it.
+     */
     int64_t completed_upto(int64_t search_hint_idx = 0) const {
-        folly::SharedMutexWritePriority::ReadHolder holder(m_lock);
-        return _upto(true /* completed */, search_hint_idx);
-    }
+        upto_scan_guard scan_guard{m_upto_scans};
+        const uint64_t gen{m_rollback_gen.load(std::memory_order_seq_cst)};
+        const bool cache_result{(gen & 1) == 0};
+        if (!cache_result) {
+            // A rollback is in progress and does not wait for scans which started after it, nor should they cache
+            scan_guard.release();
+        }
+
+        const int64_t cached_upto{m_completed_upto.load(std::memory_order_acquire)};
+        if (search_hint_idx > cached_upto + 1) { return _upto(true /* completed */, search_hint_idx); }
 
-    int64_t active_upto(int64_t search_hint_idx = 0) const {
-        folly::SharedMutexWritePriority::ReadHolder holder(m_lock);
-        return _upto(false /* completed */, search_hint_idx);
+        const int64_t upto{_upto(true /* completed */, cached_upto + 1)};
+        if (cache_result && (m_rollback_gen.load(std::memory_order_acquire) == gen)) { advance_completed_upto(upto); }
+        return upto;
     }
 
+    int64_t active_upto(int64_t search_hint_idx = 0) const { return _upto(false /* completed */, search_hint_idx); }
+
     nlohmann::json get_status(const int verbosity) const {
         nlohmann::json js;
-        js["start"] = m_slot_ref_idx;
+        js["start"] = ref_idx();
         js["completed_upto"] = completed_upto();
         js["active_upto"] = active_upto();
 
         if (verbosity == 2) {
-            js["alloced_count"] = m_alloced_slots;
+            js["alloced_count"] = alloced_end_idx() - ref_idx();
             if (AutoTruncate) {
                 js["completed_since_last_truncate"] =
                     m_cmpltd_count_since_last_truncate.load(std::memory_order_relaxed);
             }
             js["truncate_frequency"] = m_truncate_on_count;
-            js["garbage_count"] = m_data_skip_count;
+            js["segment_count"] = m_nsegments.load(std::memory_order_relaxed);
         }
         return js;
     }
 
 private:
-    template < class... Args >
-    int64_t do_update(int64_t idx, const auto& processor, bool replace, Args&&... args) {
-        bool need_truncate = false;
-        int64_t ret = 0;
-        size_t nbit;
+    /**
+     * @brief Fixed size array of bits, each word individually atomic
+     */
+    class segment_bits {
+    public:
+        segment_bits() { clear(); }
 
-        do {
-            m_lock.lock_shared();
+        void clear() {
+            for (auto& w : m_words) {
+                w.store(0, std::memory_order_relaxed);
+            }
+        }
 
-            // In case we got an update for older idx which was already swept, return right away
-            if (idx < m_slot_ref_idx) {
-                ret = m_slot_ref_idx - 1;
-                m_lock.unlock_shared();
-                return ret;
+        bool get_bitval(const size_t nbit) const {
+            return m_words[nbit / 64].load(std::memory_order_acquire) & (uint64_t{1} << (nbit % 64));
+        }
+
+        void set_bit(const size_t nbit) {
+            m_words[nbit / 64].fetch_or(uint64_t{1} << (nbit % 64), std::memory_order_acq_rel);
+        }
+
+        // Returns the number of bits which were not set already
+        size_t set_bits(const size_t start, const size_t count) {
+            return set_bits_if(start, count, [](size_t) { return true; });
+        }
+
+        // Set the bits among [start, start + count) for which fn(nbit) returns true, with one atomic op per word.
+        // Returns the number of bits which were not set already.
+        template < typename BitFn >
+        size_t set_bits_if(const size_t start, const size_t count, const BitFn& fn) {
+            size_t nset{0};
+            foreach_word(start, count, [this, &fn, &nset](std::atomic< uint64_t >& w, uint64_t mask) {
+                for (uint64_t bits{mask}; bits != 0; bits &= (bits - 1)) {
+                    if (!fn(uint64_cast(&w - &m_words[0]) * 64 + std::countr_zero(bits))) {
+                        mask &= ~(bits & -bits);
+                    }
+                }
+                if (mask != 0) { nset += std::popcount(mask & ~w.fetch_or(mask, std::memory_order_acq_rel)); }
+            });
+            return nset;
+        }
+
+        void reset_bits(const size_t start, const size_t count) {
+            foreach_word(start, count, [](std::atomic< uint64_t >& w, const uint64_t mask) {
+                w.fetch_and(~mask, std::memory_order_acq_rel);
+            });
+        }
+
+        // Returns alloc_blk_size if there is no such bit at or after start
+        size_t get_next_reset_bit(const size_t start) const { return next_bit(start, true /* reset */); }
+        size_t get_next_set_bit(const size_t start) const { return next_bit(start, false /* reset */); }
+
+    private:
+        template < typename WordFn >
+        void foreach_word(size_t start, size_t count, const WordFn& fn) {
+            while (count > 0) {
+                const size_t nbits{std::min< size_t >(64 - (start % 64), count)};
+                const uint64_t mask{(nbits == 64) ? ~uint64_t{0} : (((uint64_t{1} << nbits) - 1) << (start % 64))};
+                fn(m_words[start / 64], mask);
+                start += nbits;
+                count -= nbits;
             }
+        }
 
-            nbit = idx - m_slot_ref_idx;
-            if (nbit >= m_alloced_slots) {
-                m_lock.unlock_shared();
-                do_resize(nbit + 1);
-            } else {
-                break;
+        size_t next_bit(const size_t start, const bool reset) const {
+            for (size_t w{start / 64}; w < m_words.size(); ++w) {
+                uint64_t word{m_words[w].load(std::memory_order_acquire)};
+                if (reset) { word = ~word; }
+                if (w == start / 64) { word &= (~uint64_t{0} << (start % 64)); }
+                if (word != 0) { return w * 64 + std::countr_zero(word); }
             }
-        } while (true);
+            return alloc_blk_size;
+        }
+
+    private:
+        std::array< std::atomic< uint64_t >, alloc_blk_size / 64 > m_words;
+    };
+
+    struct segment {
+        static constexpr int64_t invalid_idx{std::numeric_limits< int64_t >::min()};
+
+        std::atomic< int64_t > start_idx{invalid_idx}; // Index of the first slot, invalid_idx if retired
+        std::atomic< uint32_t > pins{0};               // Number of lookups using the segment right now
+        segment_bits active_bits;                      // Slots which are created or completed
+        segment_bits comp_bits;                        // Slots which are completed
+        alignas(T) std::byte data[sizeof(T) * alloc_blk_size];
 
+        T* slot(const size_t off) { return std::launder(r_cast< T* >(&data[0]) + off); }
+    };
+
+    /**
+     * @brief Ring of segment pointers, indexed by segment number. When the ring runs out of room, a bigger one is
+     * published and the old one is kept around till the tracker is destroyed, since lookups may still be using it.
+     */
+    struct seg_dir {
+        explicit seg_dir(const uint64_t size) : mask{size - 1}, segs{new std::atomic< segment* >[size]} {
+            for (uint64_t i{0}; i < size; ++i) {
+                segs[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+        std::atomic< segment* >& at(const uint64_t seg_num) { return segs[seg_num & mask]; }
+
+        const uint64_t mask;
+        std::unique_ptr< std::atomic< segment* >[] > segs;
+    };
+
+    /**
+     * @brief Keeps a segment pinned (from being recycled) for its lifetime
+     */
+    class pinned_segment {
+    public:
+        explicit pinned_segment(segment* seg = nullptr) : m_seg{seg} {}
+        pinned_segment(const pinned_segment&) = delete;
+        pinned_segment(pinned_segment&& other) noexcept : m_seg{std::exchange(other.m_seg, nullptr)} {}
+        pinned_segment& operator=(const pinned_segment&) = delete;
+        pinned_segment& operator=(pinned_segment&& other) noexcept {
+            reset();
+            m_seg = std::exchange(other.m_seg, nullptr);
+            return *this;
+        }
+        ~pinned_segment() { reset(); }
+
+        void reset() {
+            if (m_seg) { m_seg->pins.fetch_sub(1, std::memory_order_release); }
+            m_seg = nullptr;
+        }
+        explicit operator bool() const { return (m_seg != nullptr); }
+        segment* operator->() const { return m_seg; }
+        segment* get() const { return m_seg; }
+
+    private:
+        segment* m_seg;
+    };
+
+    static constexpr uint64_t initial_dir_size{16};
+
+    int64_t ref_idx() const { return m_slot_ref_idx.load(std::memory_order_acquire); }
+    uint64_t seg_num(const int64_t idx) const { return uint64_cast(idx - m_origin_idx) / alloc_blk_size; }
+    size_t seg_offset(const int64_t idx) const { return uint64_cast(idx - m_origin_idx) % alloc_blk_size; }
+    int64_t seg_start_idx(const uint64_t seg_num) const { return m_origin_idx + int64_cast(seg_num * alloc_blk_size); }
+    int64_t alloced_end_idx() const { return seg_start_idx(m_tail_seg.load(std::memory_order_acquire)); }
+
+    /**
+     * @brief Find and pin the segment holding idx (which should be >= m_origin_idx). Returns an empty pin if the
+     * segment is not allocated, or was truncated.
+     */
+    pinned_segment pin(const int64_t idx) const {
+        const uint64_t sn{seg_num(idx)};
+        while (true) {
+            seg_dir* dir{m_dir.load(std::memory_order_acquire)};
+            segment* seg{dir->at(sn).load(std::memory_order_acquire)};
+            if (seg != nullptr) {
+                // Pairs with retire invalidating start_idx before checking pins: either we see it is retired, or
+                // it sees our pin and does not recycle the segment
+                seg->pins.fetch_add(1, std::memory_order_seq_cst);
+                if (seg->start_idx.load(std::memory_order_seq_cst) == seg_start_idx(sn)) { return pinned_segment{seg}; }
+                seg->pins.fetch_sub(1, std::memory_order_release);
+            }
+            if (m_dir.load(std::memory_order_acquire) == dir) { return pinned_segment{}; }
+        }
+    }
+
+    /**
+     * @brief Call cb(segment, start offset, count) for the part of [start_idx, end_idx] in each allocated segment,
+     * with the segment pinned, till cb returns false.
+     */
+    template < typename SegFn >
+    void foreach_segment_range(int64_t start_idx, const int64_t end_idx, const SegFn& cb) const {
+        while (start_idx <= end_idx) {
+            const size_t off{seg_offset(start_idx)};
+            const size_t count{std::min< size_t >(alloc_blk_size - off, end_idx - start_idx + 1)};
+            pinned_segment seg{pin(start_idx)};
+            if (!seg) {
+                // Skip over what got truncated underneath us, stop at the end of the allocated segments
+                if (start_idx >= ref_idx()) { break; }
+                start_idx = ref_idx();
+                continue;
+            }
+            if (!cb(seg.get(), off, count)) { break; }
+            start_idx += count;
+        }
+    }
+
+    // Run fn(segment, start offset, count) on every segment of the range and account the completions it returns
+    int64_t do_update_range(int64_t start_idx, int64_t end_idx, const auto& fn) {
+        start_idx = std::max(start_idx, ref_idx());
+        if (start_idx > end_idx) { return ref_idx() - 1; }
+        if (end_idx >= alloced_end_idx()) { grow(end_idx); }
+
+        size_t ncompleted{0};
+        foreach_segment_range(start_idx, end_idx, [&fn, &ncompleted](segment* seg, size_t off, size_t count) {
+            ncompleted += fn(seg, off, count);
+            return true;
+        });
+        if (ncompleted == 0) { return ref_idx() - 1; }
+
+        COUNTER_INCREMENT(m_metrics, stream_tracker_unsweeped_completions, ncompleted);
+        if (AutoTruncate) {
+            if (m_cmpltd_count_since_last_truncate.fetch_add(ncompleted, std::memory_order_acq_rel) + ncompleted >
+                m_truncate_on_count) {
+                return truncate();
+            }
+        }
+        return ref_idx() - 1;
+    }
+
+    void advance_completed_upto(const int64_t upto) const {
+        int64_t cur{m_completed_upto.load(std::memory_order_acquire)};
+        while ((cur < upto) && !m_completed_upto.compare_exchange_weak(cur, upto, std::memory_order_acq_rel)) {}
+    }
+
+    template < class... Args >
+    int64_t do_update(int64_t idx, const auto& processor, bool replace, Args&&... args) {
+        pinned_segment seg;
+        while (true) {
+            // In case we got an update for older idx which was already swept, return right away
+            if (idx < ref_idx()) { return ref_idx() - 1; }
+
+            seg = pin(idx);
+            if (seg) { break; }
+            grow(idx);
+        }
+
+        bool need_truncate = false;
+        const size_t off{seg_offset(idx)};
         T* data;
-        if (replace || !m_active_slot_bits.get_bitval(nbit)) {
+        if (replace || !seg->active_bits.get_bitval(off)) {
             // First time being updated, so use placement new to use the slot to build data
-            data = new ((void*)get_slot_data(nbit)) T(std::forward< Args >(args)...);
-            m_active_slot_bits.set_bit(nbit);
+            data = new (seg->slot(off)) T(std::forward< Args >(args)...);
+            seg->active_bits.set_bit(off);
         } else {
-            data = get_slot_data(nbit);
+            data = seg->slot(off);
         }
 
         // Check with processor to update any fields and return if they are completed
         if (processor(*data)) {
             // All actions on this idx is completed, truncate if needbe
-            m_comp_slot_bits.set_bit(nbit);
+            seg->comp_bits.set_bit(off);
             if (AutoTruncate) {
                 if (m_cmpltd_count_since_last_truncate.fetch_add(1, std::memory_order_acq_rel) >= m_truncate_on_count) {
                     need_truncate = true;
@@ -267,98 +577,178 @@ private:
             }
             COUNTER_INCREMENT(m_metrics, stream_tracker_unsweeped_completions, 1);
         }
-        ret = m_slot_ref_idx - 1;
-        m_lock.unlock_shared();
+        seg.reset();
 
-        if (need_truncate) { ret = truncate(); }
-        return ret;
+        if (need_truncate) { return truncate(); }
+        return ref_idx() - 1;
     }
 
-    void do_resize(size_t atleast_count) {
-        folly::SharedMutexWritePriority::WriteHolder holder(m_lock);
+    // Append segments till idx is covered. Existing segments are not touched.
+    void grow(int64_t idx) {
+        std::unique_lock lg{m_mtx};
+        if (idx < ref_idx()) { return; }
+        while (m_tail_seg.load(std::memory_order_relaxed) <= seg_num(idx)) {
+            append_segment();
+        }
+    }
 
-        // Check if we already resized enough
-        if (atleast_count < m_alloced_slots) { return; }
+    void append_segment() {
+        const uint64_t tail{m_tail_seg.load(std::memory_order_relaxed)};
+        seg_dir* dir{m_dir.load(std::memory_order_relaxed)};
+        if (tail - m_head_seg > dir->mask) {
+            auto new_dir{std::make_unique< seg_dir >((dir->mask + 1) * 2)};
+            for (uint64_t sn{m_head_seg}; sn < tail; ++sn) {
+                new_dir->at(sn).store(dir->at(sn).load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            dir = new_dir.get();
+            m_dirs.emplace_back(std::move(new_dir));
+            m_dir.store(dir, std::memory_order_release);
+        }
 
-        auto new_count = std::max((m_alloced_slots * 2), atleast_count);
-        auto new_slot_data = (T*)std::calloc(new_count, sizeof(T));
-        if (new_slot_data == nullptr) { throw std::bad_alloc(); }
+        segment* seg{get_free_segment()};
+        seg->active_bits.clear();
+        seg->comp_bits.clear();
+        seg->start_idx.store(seg_start_idx(tail), std::memory_order_release);
+        dir->at(tail).store(seg, std::memory_order_release);
+        m_tail_seg.store(tail + 1, std::memory_order_release);
+    }
 
-        std::memmove((void*)&new_slot_data[0], (void*)&m_slot_data[m_data_skip_count], (sizeof(T) * m_alloced_slots));
-        free(m_slot_data);
-        m_slot_data = new_slot_data;
-        m_alloced_slots = new_count;
-        m_data_skip_count = 0;
+    segment* get_free_segment() {
+        // A retired segment can be reused once no lookup holds a pin on it. Lookups pinning it from now on will fail
+        // validation, since we checked for pins only after it was invalidated.
+        for (auto it{m_free_segs.begin()}; it != m_free_segs.end(); ++it) {
+            segment* seg{*it};
+            if (seg->pins.load(std::memory_order_seq_cst) == 0) {
+                m_free_segs.erase(it);
+                return seg;
+            }
+        }
 
-        m_active_slot_bits.resize(new_count);
-        m_comp_slot_bits.resize(new_count);
+        m_all_segs.emplace_back(std::make_unique< segment >());
+        m_nsegments.fetch_add(1, std::memory_order_relaxed);
+        GAUGE_UPDATE(m_metrics, stream_tracker_mem_size, (m_all_segs.size() * alloc_blk_size * sizeof(T)));
+        return m_all_segs.back().get();
+    }
 
-        GAUGE_UPDATE(m_metrics, stream_tracker_mem_size, (m_alloced_slots * sizeof(T)));
+    // Retire all the segments before upto_seg_num. Caller should hold the mutex.
+    void retire_segments(const uint64_t upto_seg_num) {
+        seg_dir* dir{m_dir.load(std::memory_order_relaxed)};
+        const uint64_t tail{m_tail_seg.load(std::memory_order_relaxed)};
+        for (; (m_head_seg < upto_seg_num) && (m_head_seg < tail); ++m_head_seg) {
+            segment* seg{dir->at(m_head_seg).exchange(nullptr, std::memory_order_acq_rel)};
+            seg->start_idx.store(segment::invalid_idx, std::memory_order_seq_cst);
+            m_free_segs.push_back(seg);
+        }
+        if (m_head_seg < upto_seg_num) {
+            // Truncated beyond what is allocated, restart the ring at the new head
+            m_head_seg = upto_seg_num;
+            m_tail_seg.store(upto_seg_num, std::memory_order_release);
+            append_segment();
+        }
     }
 
     int64_t _upto(bool completed, int64_t search_hint_idx) const {
-        auto search_start_bit = std::max(0l, (search_hint_idx - m_slot_ref_idx));
-        auto first_incomplete_bit = completed ? m_comp_slot_bits.get_next_reset_bit(search_start_bit)
-                                              : m_active_slot_bits.get_next_reset_bit(search_start_bit);
-        if (first_incomplete_bit == AtomicBitset::npos) {
-            // Seems like all the bits are completed, set it as last
-            return m_slot_ref_idx + m_alloced_slots - 1;
-        } else {
-            return m_slot_ref_idx + first_incomplete_bit - 1;
+        int64_t idx{std::max(search_hint_idx, ref_idx())};
+        while (true) {
+            pinned_segment seg{pin(idx)};
+            if (!seg) {
+                // Truncated underneath us, restart from the new start
+                if (idx < ref_idx()) {
+                    idx = ref_idx();
+                    continue;
+                }
+                // Seems like all the allocated slots are completed, set it as last
+                return idx - 1;
+            }
+
+            const size_t off{seg_offset(idx)};
+            const size_t nbit{completed ? seg->comp_bits.get_next_reset_bit(off)
+                                        : seg->active_bits.get_next_reset_bit(off)};
+            idx += nbit - off;
+            if (nbit < alloc_blk_size) { return idx - 1; }
         }
     }
 
     void _foreach_contiguous(int64_t start_idx, bool completed_only, const auto& cb) {
-        folly::SharedMutexWritePriority::ReadHolder holder(m_lock);
-        auto upto = _upto(completed_only, start_idx);
+        start_idx = std::max(start_idx, ref_idx());
+        auto upto = completed_only ? completed_upto(start_idx) : _upto(false /* completed */, start_idx);
+        pinned_segment seg;
         for (auto idx = start_idx; idx <= upto; ++idx) {
-            auto proceed = cb(idx, upto, *(get_slot_data(idx - m_slot_ref_idx)));
+            if (!seg || (seg_offset(idx) == 0)) {
+                seg = pin(idx);
+                if (!seg) { break; }
+            }
+            auto proceed = cb(idx, upto, *(seg->slot(seg_offset(idx))));
             if (!proceed) break;
         }
     }
 
     void _foreach_all(int64_t start_idx, bool completed_only, const auto& cb) {
-        folly::SharedMutexWritePriority::ReadHolder holder(m_lock);
-        auto search_bit = std::max(0l, (start_idx - m_slot_ref_idx));
-        do {
-            search_bit = completed_only ? m_comp_slot_bits.get_next_set_bit(search_bit)
-                                        : m_active_slot_bits.get_next_set_bit(search_bit);
-            if (search_bit == AtomicBitset::npos) { break; }
-            if (!cb(search_bit + m_slot_ref_idx, *(get_slot_data(search_bit)))) { break; }
-            ++search_bit;
-        } while (true);
+        foreach_segment_range(std::max(start_idx, ref_idx()), alloced_end_idx() - 1,
+                              [&](segment* seg, size_t off, const size_t count) {
+                                  const int64_t base_idx{seg->start_idx.load(std::memory_order_relaxed)};
+                                  const size_t end_off{off + count};
+                                  while (true) {
+                                      off = completed_only ? seg->comp_bits.get_next_set_bit(off)
+                                                           : seg->active_bits.get_next_set_bit(off);
+                                      if (off >= end_off) { return true; }
+                                      if (!cb(base_idx + int64_cast(off), *(seg->slot(off)))) { return false; }
+                                      ++off;
+                                  }
+                              });
     }
 
-    T* get_slot_data(int64_t nbit) const { return &(m_slot_data[nbit + m_data_skip_count]); }
-
 private:
-    // Mutex to protect the completion of last commit info
-    mutable folly::SharedMutexWritePriority m_lock;
+    // Serializes growth, truncate, rollback and reinit. Lookups of existing slots do not take it.
+    std::mutex m_mtx;
 
-    // A bitset that covers the completion and truncation
-    sisl::AtomicBitset m_comp_slot_bits;
+    // Index of the first slot of segment number 0
+    int64_t m_origin_idx;
 
-    // A bitset that tracks which are active or completed.
-    sisl::AtomicBitset m_active_slot_bits;
+    // Reference idx of the stream. This is the cursor idx which it is tracking
+    std::atomic< int64_t > m_slot_ref_idx;
 
-    // The array of cursors which are being processed right now. We purposefully didn't want to use std::vector
-    // because, completion bits truncates everything at one shot and we don't want iterating one after other under
-    // lock.
-    T* m_slot_data{nullptr};
+    // Last idx found to be contiguously completed, so that completed_upto need not scan from the start every time
+    mutable std::atomic< int64_t > m_completed_upto;
 
-    // Amount of data to skip before m_slot_data[0] index starts. This is done to avoid memmove entire data set
-    // everytime it is truncated. Instead it leaves the buffer as is and then shrinks fewer a between
-    size_t m_data_skip_count{0};
+    // Number of completed_upto scans in progress which may cache their result, rollback waits for them to drain
+    struct upto_scan_guard {
+        explicit upto_scan_guard(std::atomic< uint32_t >& scans) : m_scans{&scans} {
+            m_scans->fetch_add(1, std::memory_order_seq_cst);
+        }
+        upto_scan_guard(const upto_scan_guard&) = delete;
+        upto_scan_guard& operator=(const upto_scan_guard&) = delete;
+        ~upto_scan_guard() { release(); }
+
+        void release() {
+            if (m_scans != nullptr) {
+                m_scans->fetch_sub(1, std::memory_order_release);
+                m_scans = nullptr;
+            }
+        }
+        std::atomic< uint32_t >* m_scans;
+    };
+    mutable std::atomic< uint32_t > m_upto_scans{0};
+
+    // Bumped at the start and the end of every rollback, so it is odd while one is in progress
+    std::atomic< uint64_t > m_rollback_gen{0};
+
+    // Segments [m_head_seg, m_tail_seg) are live. m_head_seg is protected by m_mtx.
+    uint64_t m_head_seg{0};
+    std::atomic< uint64_t > m_tail_seg{0};
 
-    // Total number of slots allocated
-    size_t m_alloced_slots{0};
+    // Current segment directory, and all the ones ever published
+    std::atomic< seg_dir* > m_dir{nullptr};
+    std::vector< std::unique_ptr< seg_dir > > m_dirs;
+
+    // All the segments ever allocated, and the retired ones waiting to be reused. Protected by m_mtx.
+    std::vector< std::unique_ptr< segment > > m_all_segs;
+    std::vector< segment* > m_free_segs;
+    std::atomic< size_t > m_nsegments{0};
 
     // Total number of entries completely acked (for all txns) since last truncate
     std::atomic< size_t > m_cmpltd_count_since_last_truncate{0};
 
-    // Reference idx of the stream. This is the cursor idx which it is tracking
-    int64_t m_slot_ref_idx{0};
-
     // How frequent (on count) truncate needs to happen
     uint32_t m_truncate_on_count{1000};
 
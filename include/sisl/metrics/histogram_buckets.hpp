@@ -17,6 +17,9 @@
 #ifndef METRICS_HISTOGRAM_BUCKETS_HPP
 #define METRICS_HISTOGRAM_BUCKETS_HPP
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <vector>
 #include <cstdint>
 #include <limits> // std::numeric_limits
@@ -65,6 +68,56 @@ constexpr size_t _get_max_hist_bkts(V&&... v) {
 
 constexpr int64_t exp2(const int64_t exponent) { return exponent == 0 ? 1 : 2 * exp2(exponent - 1); }
 
+/*
+ * Log-linear (HDR style) buckets: values below 2 * 2^SubBucketBits get a bucket each, after which every power of two
+ * is split into 2^SubBucketBits equal sub buckets, upto 2^MaxValueBits. The bucket of a value is computed with a
+ * count of leading zeros and a couple of shifts, so observing into them needs neither a search over the boundaries
+ * nor any int to double conversion. Values beyond the last bucket go to the overflow (+Inf) bucket.
+ */
+template < uint8_t SubBucketBits, uint8_t MaxValueBits >
+class LogLinearBucketScheme {
+    static_assert((SubBucketBits > 0) && (MaxValueBits > SubBucketBits) && (MaxValueBits < 63),
+                  "Invalid log linear bucket layout");
+
+public:
+    static constexpr uint64_t sub_buckets{1ull << SubBucketBits};
+    static constexpr size_t num_buckets{(MaxValueBits - SubBucketBits + 1) * sub_buckets};
+
+    static constexpr size_t bucket_index(const int64_t value) {
+        const uint64_t v{static_cast< uint64_t >(std::max< int64_t >(value, 0))};
+        const uint32_t shift{static_cast< uint32_t >(63 - std::countl_zero(v | sub_buckets)) - SubBucketBits};
+        return std::min< size_t >((static_cast< size_t >(shift) << SubBucketBits) + (v >> shift), num_buckets);
+    }
+
+    // Largest value which falls in the bucket, which is what prometheus reports as its 'le'
+    static constexpr int64_t bucket_upper_bound(const size_t idx) {
+        if (idx < 2 * sub_buckets) { return static_cast< int64_t >(idx); }
+        const uint64_t shift{(idx >> SubBucketBits) - 1};
+        const uint64_t mantissa{idx - (shift << SubBucketBits)};
+        return static_cast< int64_t >(((mantissa + 1) << shift) - 1);
+    }
+
+    // Smallest value which falls in the bucket, the overflow bucket starts right after the last bucket
+    static constexpr int64_t bucket_lower_bound(const size_t idx) {
+        return (idx == 0) ? 0 : bucket_upper_bound(idx - 1) + 1;
+    }
+
+    static std::vector< double > boundaries() {
+        std::vector< double > b(num_buckets);
+        for (size_t i{0}; i < num_buckets; ++i) {
+            b[i] = static_cast< double >(bucket_upper_bound(i));
+        }
+        return b;
+    }
+};
+
+// 4 sub buckets per power of two (upto 25% wide) covering upto ~4 billion, which suits most usec latencies
+using LogLinearBuckets_t = LogLinearBucketScheme< 2, 32 >;
+
+// 32 sub buckets per power of two, so that the midpoint of a bucket is within 1/64 (~1.6%) of any value in it. Used
+// by the summary quantile sketch, which covers upto ~68 billion.
+using SummaryBuckets_t = LogLinearBucketScheme< 5, 36 >;
+
 #define HistogramBucketsType(name) (sisl::HistogramBuckets::getInstance().name)
 
 // to define the histogram buckets used for various metrics
@@ -80,17 +133,25 @@ public:
 
 #define X(name, ...) _hist_bkt_count(__VA_ARGS__),
     static const constexpr size_t max_hist_bkts =
-        _get_max_hist_bkts(HIST_BKTS_TYPES 0UL) + 1; // +1 for upper bound bucket
+        _get_max_hist_bkts(HIST_BKTS_TYPES LogLinearBuckets_t::num_buckets) + 1; // +1 for upper bound bucket
 #undef X
 
 #define X(name, ...) hist_bucket_boundaries_t name;
     HIST_BKTS_TYPES
 #undef X
 
+    // Prometheus 'le' boundaries of LogLinearBuckets_t, histograms registered with these are bucketed without search
+    hist_bucket_boundaries_t LogLinearBuckets;
+
+    [[nodiscard]] bool is_log_linear(const hist_bucket_boundaries_t& boundaries) const {
+        return (&boundaries == &LogLinearBuckets);
+    }
+
     HistogramBuckets() {
 #define X(name, ...) name = {{__VA_ARGS__}};
         HIST_BKTS_TYPES
 #undef X
+        LogLinearBuckets = LogLinearBuckets_t::boundaries();
     }
 };
 
@@ -0,0 +1,110 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "prometheus_text_writer.hpp"
+
+namespace sisl {
+class sobject_manager;
+
+struct http_exporter_options {
+    std::string address{"127.0.0.1"};      // IPv4 address to listen on
+    uint16_t port{0};                      // 0 picks an ephemeral port, see MetricsHttpExporter::port()
+    uint32_t cache_ms{1000};               // Serialized metrics are served from the snapshot for these many ms
+    uint32_t max_connections{64};          // Further connections are closed right after accept
+    sobject_manager* sobject_mgr{nullptr}; // Serves the status tree at /status, if set
+};
+
+/*
+ * MetricsHttpExporter is a minimal HTTP/1.1 server, run on a single epoll thread, for scraping the MetricsFarm:
+ *
+ * GET /metrics       Prometheus text format
+ * GET /metrics.json  Same as MetricsFarm::get_result_in_json()
+ * GET /status        sobject status tree. Query parameters type, name, path (separated by '/'), recurse, verbose,
+ *                    batch_size and cursor map to the corresponding fields of status_request.
+ *
+ * Connections are kept alive unless the client asks otherwise. Metrics are serialized at most once in cache_ms, so
+ * that any number of scrapers within that time are served the same snapshot without gathering again. Responses are
+ * gzip encoded if the client accepts it. All requests are served on the exporter thread, so a slow gather or status
+ * callback delays the other scrapers. A callback throwing is answered with 500. Requests of a connection are not read
+ * while it has more than a MB of responses yet to be sent.
+ */
+class MetricsHttpExporter {
+public:
+    explicit MetricsHttpExporter(const http_exporter_options& options = http_exporter_options{});
+    ~MetricsHttpExporter();
+    MetricsHttpExporter(const MetricsHttpExporter&) = delete;
+    MetricsHttpExporter(MetricsHttpExporter&&) noexcept = delete;
+    MetricsHttpExporter& operator=(const MetricsHttpExporter&) = delete;
+    MetricsHttpExporter& operator=(MetricsHttpExporter&&) noexcept = delete;
+
+    bool start();
+    bool stop();
+
+    // Port the exporter is listening on, valid after start()
+    [[nodiscard]] uint16_t port() const { return m_port; }
+
+private:
+    struct connection_t {
+        std::string in;
+        std::string out;
+        size_t out_offset{0};
+        bool close_after_write{false};
+    };
+
+    struct cached_body_t {
+        std::chrono::steady_clock::time_point at;
+        bool valid{false};
+        std::string body;
+        std::string gzip_body;
+    };
+
+    void run();
+    void accept_connections();
+    void on_readable(const int fd, connection_t& conn);
+    void on_writable(const int fd, connection_t& conn);
+    void close_connection(const int fd);
+    void serve_requests(connection_t& conn);
+    bool handle_request(const std::string& header, connection_t& conn);
+    void respond(connection_t& conn, const int status, const char* content_type, const std::string& body,
+                 const bool gzipped, const bool head_only, const bool keep_alive);
+    // Body of the snapshot, gzip encoded if asked for. gzip is reset if the body could not be compressed.
+    const std::string& cached_body(cached_body_t& cache, bool& gzip, const bool is_json);
+    std::string status_body(const std::string& query);
+
+private:
+    http_exporter_options m_options;
+    uint16_t m_port{0};
+    int m_listen_fd{-1};
+    int m_epoll_fd{-1};
+    int m_event_fd{-1}; // Notifies the epoll loop to exit
+    std::unique_ptr< std::thread > m_thread;
+
+    // Below are accessed only by the exporter thread
+    std::unordered_map< int, connection_t > m_conns;
+    PrometheusTextWriter m_text_writer;
+    cached_body_t m_text_cache;
+    cached_body_t m_json_cache;
+};
+} // namespace sisl
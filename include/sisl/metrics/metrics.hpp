@@ -18,6 +18,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <functional>
 #include <iterator>
 #include <limits>
 #include <memory>
@@ -26,6 +27,7 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <boost/preprocessor/cat.hpp>
 #include <boost/preprocessor/control/if.hpp>
@@ -37,8 +39,10 @@
 #include <sisl/options/options.h>
 #include "metrics_atomic.hpp"
 #include "metrics_group_impl.hpp"
+#include "metrics_percpu.hpp"
 #include "metrics_rcu.hpp"
 #include "metrics_tlocal.hpp"
+#include "prometheus_text_writer.hpp"
 
 // TODO: Commenting out this tempoarily till the SISL_OPTIONS and SISL_LOGGING issue is resolved
 // SISL_LOGGING_DECL(vmod_metrics_framework)
@@ -77,17 +81,37 @@ public:
     [[nodiscard]] std::string instance_name() const { return m_impl_ptr->instance_name(); }
 };
 
+/*
+ * Scrapes (gather, report and get_result_in_json) work on a snapshot of the registered groups, so that the farm is
+ * not locked, and hence group registration is not blocked, while the groups are being scraped.
+ */
+struct gather_options {
+    uint32_t nthreads{1};       // Groups are scraped on these many threads, including the caller
+    bool skip_unchanged{false}; // Skip the groups which are not updated since their last scrape of the same kind
+};
+
 class MetricsFarm {
 private:
     std::set< MetricsGroupImplPtr > m_mgroups;
     std::unordered_map< std::string, uint64_t > m_uniq_inst_maintainer;
     mutable std::mutex m_lock;
+    std::mutex m_scrape_lock; // Serializes the scrapes, since reporter doesn't allow publish in parallel to serialize
+    gather_options m_gather_opts;
     std::unique_ptr< Reporter > m_reporter;
     std::shared_ptr< ThreadRegistry > m_treg; // Keep a ref of ThreadRegistry to prevent it from destructing before us.
+    GaugeCallbackRunner m_gauge_cb_runner;    // Declared last, so that its threads are joined first
 private:
     MetricsFarm();
 
     [[nodiscard]] auto lock() const { return std::lock_guard< decltype(m_lock) >(m_lock); }
+    [[nodiscard]] std::vector< MetricsGroupImplPtr > snapshot_groups() const;
+    void foreach_group(const std::vector< MetricsGroupImplPtr >& groups,
+                       const std::function< void(const MetricsGroupImplPtr&, size_t) >& cb) const;
+
+    // Which of the groups are to be scraped: the ones updated since the last scrape of the type, if unchanged groups
+    // are skipped, else all of them
+    [[nodiscard]] std::vector< bool > test_and_clear_updated(const std::vector< MetricsGroupImplPtr >& groups,
+                                                             const scrape_type type);
 
 public:
     ~MetricsFarm();
@@ -104,6 +128,7 @@ public:
     }
 
     static Reporter& get_reporter();
+    static GaugeCallbackRunner& get_gauge_cb_runner();
     static bool is_initialized();
 
     void register_metrics_group(MetricsGroupImplPtr mgroup, const bool add_to_farm_list = true);
@@ -112,7 +137,12 @@ public:
     nlohmann::json get_result_in_json(bool need_latest = true);
     std::string get_result_in_json_string(bool need_latest = true);
     std::string report(ReportFormat format);
+
+    // Write all metrics in prometheus text format directly from the gathered values, without going through the
+    // reporter. Returns false if writer failed to write to its file descriptor.
+    bool report(PrometheusTextWriter& writer);
     void gather(); // Dummy call just to make it gather. Does not report
+    void set_gather_options(const gather_options& opts);
 
     std::string ensure_unique(const std::string& grp_name, const std::string& inst_name);
 };
@@ -151,6 +181,9 @@ class NamedGauge;
 template < typename >
 class NamedHistogram;
 
+template < typename >
+class NamedSummary;
+
 template < char... elements >
 class NamedCounter< tstring< elements... > > {
 public:
@@ -223,6 +256,30 @@ private:
     size_t m_Index;
 };
 
+template < char... elements >
+class NamedSummary< tstring< elements... > > {
+public:
+    NamedSummary(const NamedSummary&) = delete;
+    NamedSummary(NamedSummary&&) noexcept = delete;
+    NamedSummary& operator=(const NamedSummary&) = delete;
+    NamedSummary& operator=(NamedSummary&&) noexcept = delete;
+
+    static NamedSummary& getInstance() {
+        static NamedSummary instance{};
+        return instance;
+    }
+
+    void set_index(const uint64_t index) { m_Index = index; }
+    [[nodiscard]] uint64_t get_index() const { return m_Index; }
+    [[nodiscard]] constexpr const char* get_name() const { return m_Name; }
+
+private:
+    NamedSummary() : m_Index{std::numeric_limits< uint64_t >::max()} {}
+
+    static constexpr char m_Name[sizeof...(elements) + 1] = {elements..., '\0'};
+    size_t m_Index;
+};
+
 // decltype(BOOST_PP_CAT(BOOST_PP_STRINGIZE(name), _tstr)
 
 #define REGISTER_COUNTER(name, ...)                                                                                    \
@@ -239,6 +296,14 @@ private:
         ng.set_index(this->m_impl_ptr->register_gauge(ng.get_name(), __VA_ARGS__));                                    \
     }
 
+// Gauge computed by the callback at scrape time, e.g. REGISTER_GAUGE_CB(queue_depth, "Queue depth", [this] { ... })
+#define REGISTER_GAUGE_CB(name, ...)                                                                                   \
+    {                                                                                                                  \
+        using namespace sisl;                                                                                          \
+        auto& ng{sisl::NamedGauge< decltype(BOOST_PP_CAT(BOOST_PP_STRINGIZE(name), _tstr)) >::getInstance()};          \
+        ng.set_index(this->m_impl_ptr->register_gauge_cb(ng.get_name(), __VA_ARGS__));                                 \
+    }
+
 #define REGISTER_HISTOGRAM(name, ...)                                                                                  \
     {                                                                                                                  \
         using namespace sisl;                                                                                          \
@@ -246,9 +311,17 @@ private:
         nh.set_index(this->m_impl_ptr->register_histogram(nh.get_name(), __VA_ARGS__));                                \
     }
 
+#define REGISTER_SUMMARY(name, ...)                                                                                    \
+    {                                                                                                                  \
+        using namespace sisl;                                                                                          \
+        auto& ns{sisl::NamedSummary< decltype(BOOST_PP_CAT(BOOST_PP_STRINGIZE(name), _tstr)) >::getInstance()};        \
+        ns.set_index(this->m_impl_ptr->register_summary(ns.get_name(), __VA_ARGS__));                                  \
+    }
+
 #define COUNTER_INDEX(name) METRIC_NAME_TO_INDEX(NamedCounter, name)
 #define GAUGE_INDEX(name) METRIC_NAME_TO_INDEX(NamedGauge, name)
 #define HISTOGRAM_INDEX(name) METRIC_NAME_TO_INDEX(NamedHistogram, name)
+#define SUMMARY_INDEX(name) METRIC_NAME_TO_INDEX(NamedSummary, name)
 
 #define METRIC_NAME_TO_INDEX(type, name)                                                                               \
     (sisl::type< decltype(BOOST_PP_CAT(BOOST_PP_STRINGIZE(name), _tstr)) >::getInstance().get_index())
@@ -301,6 +374,11 @@ private:
 #define HISTOGRAM_OBSERVE_IF_ELSE(group, cond, namea, nameb, ...)                                                      \
     __VALIDATE_AND_EXECUTE_IF_ELSE(group, NamedHistogram, histogram_observe, cond, namea, nameb, __VA_ARGS__)
 
+#define SUMMARY_OBSERVE(group, name, ...)                                                                              \
+    __VALIDATE_AND_EXECUTE(group, NamedSummary, summary_observe, name, __VA_ARGS__)
+#define SUMMARY_OBSERVE_IF_ELSE(group, cond, namea, nameb, ...)                                                        \
+    __VALIDATE_AND_EXECUTE_IF_ELSE(group, NamedSummary, summary_observe, cond, namea, nameb, __VA_ARGS__)
+
 #if 0
 #define COUNTER_INCREMENT(group, name, ...)                                                                            \
     {                                                                                                                  \
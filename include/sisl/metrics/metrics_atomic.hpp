@@ -28,6 +28,7 @@
 
 namespace sisl {
 static_assert(std::is_trivially_copyable< HistogramValue >::value, "Expecting HistogramValue to be trivally copyable");
+static_assert(std::is_trivially_copyable< SummaryValue >::value, "Expecting SummaryValue to be trivally copyable");
 
 class AtomicCounterValue {
 public:
@@ -62,12 +63,16 @@ public:
     void observe(const int64_t value, const hist_bucket_boundaries_t& boundaries, const uint64_t count = 1) {
         const auto lower{std::lower_bound(std::cbegin(boundaries), std::cend(boundaries), value)};
         if (lower != std::cend(boundaries)) {
-            const auto bkt_idx{std::distance(std::cbegin(boundaries), lower)};
-            m_freqs[bkt_idx].fetch_add(count, std::memory_order_relaxed);
-            m_sum.fetch_add((value * count), std::memory_order_relaxed);
+            observe(value, static_cast< size_t >(std::distance(std::cbegin(boundaries), lower)), count);
         }
     }
 
+    // Observe with the bucket already computed, typically by HistogramStaticInfo::bucket_index()
+    void observe(const int64_t value, const size_t bkt_idx, const uint64_t count = 1) {
+        m_freqs[bkt_idx].fetch_add(count, std::memory_order_relaxed);
+        m_sum.fetch_add((value * count), std::memory_order_relaxed);
+    }
+
     [[nodiscard]] auto& get_freqs() const { return m_freqs; }
     [[nodiscard]] int64_t get_sum() const { return m_sum.load(std::memory_order_relaxed); }
 
@@ -83,6 +88,31 @@ private:
     std::atomic< int64_t > m_sum{0};
 };
 
+class AtomicSummaryValue {
+public:
+    AtomicSummaryValue() = default;
+    AtomicSummaryValue(const AtomicSummaryValue&) = delete;
+    AtomicSummaryValue(AtomicSummaryValue&&) noexcept = delete;
+    AtomicSummaryValue& operator=(const AtomicSummaryValue&) = delete;
+    AtomicSummaryValue& operator=(AtomicSummaryValue&&) noexcept = delete;
+
+    void observe(const int64_t value, const uint64_t count = 1) {
+        m_counts[SummaryBuckets_t::bucket_index(value)].fetch_add(count, std::memory_order_relaxed);
+        m_sum.fetch_add((value * count), std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] SummaryValue to_summary_value() const {
+        SummaryValue s{};
+        std::copy(std::cbegin(m_counts), std::cend(m_counts), std::begin(s.m_counts));
+        s.m_sum = m_sum.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    std::array< std::atomic< uint64_t >, SummaryBuckets_t::num_buckets + 1 > m_counts{};
+    std::atomic< int64_t > m_sum{0};
+};
+
 class AtomicMetricsGroup : public MetricsGroupImpl {
 public:
     AtomicMetricsGroup(const char* const grp_name, const char* const inst_name) :
@@ -99,16 +129,19 @@ public:
     void counter_decrement(const uint64_t index, const int64_t val = 1) override;
     void histogram_observe(const uint64_t index, const int64_t val) override;
     void histogram_observe(const uint64_t index, const int64_t val, const uint64_t count) override;
+    void summary_observe(const uint64_t index, const int64_t val) override;
+    void summary_observe(const uint64_t index, const int64_t val, const uint64_t count) override;
 
     [[nodiscard]] group_impl_type_t impl_type() const { return group_impl_type_t::atomic; }
 
 private:
     void on_register();
     void gather_result(bool need_latest, const counter_gather_cb_t& counter_cb, const gauge_gather_cb_t& gauge_cb,
-                       const histogram_gather_cb_t& histogram_cb) override;
+                       const histogram_gather_cb_t& histogram_cb, const summary_gather_cb_t& summary_cb) override;
 
 private:
     std::unique_ptr< AtomicCounterValue[] > m_counter_values;
     std::unique_ptr< AtomicHistogramValue[] > m_histogram_values;
+    std::unique_ptr< AtomicSummaryValue[] > m_summary_values;
 };
 } // namespace sisl
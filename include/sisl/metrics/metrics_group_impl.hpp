@@ -16,15 +16,22 @@
  *********************************************************************************/
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <iterator>
+#include <list>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <set>
 #include <string>
+#include <thread>
 #include <variant>
 #include <vector>
 
@@ -33,9 +40,11 @@
 #include <sisl/utility/thread_buffer.hpp>
 
 #include "histogram_buckets.hpp"
+#include "metrics_labeled.hpp"
 #include "prometheus_reporter.hpp"
 
 namespace sisl {
+class PrometheusTextWriter;
 using on_gather_cb_t = std::function< void(void) >;
 
 enum class group_impl_type_t : uint8_t {
@@ -43,6 +52,7 @@ enum class group_impl_type_t : uint8_t {
     thread_buf_volatile,
     thread_buf_signal,
     atomic,
+    per_cpu,
 };
 
 enum class _publish_as : uint8_t {
@@ -51,10 +61,22 @@ enum class _publish_as : uint8_t {
     publish_as_histogram,
 };
 
+// Each kind of scrape tracks the updates since its own last run, so that one does not hide the updates from other
+enum class scrape_type : uint8_t {
+    report = 1 << 0,
+    json = 1 << 1,
+    gather = 1 << 2,
+};
+static constexpr uint8_t all_scrape_types{0x7};
+
+using summary_quantiles_t = std::vector< double >;
+inline const summary_quantiles_t default_summary_quantiles{0.5, 0.99, 0.999};
+
 /****************************** Counter ************************************/
 class CounterValue {
 public:
     friend class AtomicCounterValue;
+    friend class PerCpuMetricsGroup;
 
     CounterValue() = default;
     CounterValue(const CounterValue&) = default;
@@ -111,6 +133,8 @@ public:
     CounterDynamicInfo& operator=(CounterDynamicInfo&&) noexcept = delete;
 
     void publish(const CounterValue& value);
+    void write_text(PrometheusTextWriter& writer, const CounterStaticInfo& static_info,
+                    const CounterValue& value) const;
     void unregister(const CounterStaticInfo& static_info);
 
 private:
@@ -128,6 +152,7 @@ private:
 
 private:
     std::variant< std::shared_ptr< ReportCounter >, std::shared_ptr< ReportGauge > > m_report_counter_gauge;
+    std::string m_text_labels;
 };
 
 /****************************** Gauge ************************************/
@@ -191,16 +216,94 @@ public:
     GaugeDynamicInfo& operator=(GaugeDynamicInfo&&) noexcept = delete;
 
     void publish(const GaugeValue& value);
+    void write_text(PrometheusTextWriter& writer, const GaugeStaticInfo& static_info, const GaugeValue& value) const;
     void unregister(const GaugeStaticInfo& static_info);
 
 private:
     std::shared_ptr< ReportGauge > m_report_gauge;
+    std::string m_text_labels;
+};
+
+using gauge_value_cb_t = std::function< int64_t(void) >;
+
+/*
+ * GaugeCallbackRunner runs the gauge callbacks which have a timeout on a small pool of threads owned by the
+ * MetricsFarm, started with the first such callback. A worker whose callback runs past its timeout is retired: it
+ * exits once the callback returns and a new worker takes its place on the queue, so that a stuck callback holds up
+ * only its own gauge. All the workers are joined when the farm is destroyed.
+ */
+class GaugeCallbackRunner {
+public:
+    struct job_t;
+    static constexpr size_t num_workers{2};
+
+    GaugeCallbackRunner() = default;
+    ~GaugeCallbackRunner();
+    GaugeCallbackRunner(const GaugeCallbackRunner&) = delete;
+    GaugeCallbackRunner(GaugeCallbackRunner&&) noexcept = delete;
+    GaugeCallbackRunner& operator=(const GaugeCallbackRunner&) = delete;
+    GaugeCallbackRunner& operator=(GaugeCallbackRunner&&) noexcept = delete;
+
+    // Returns false if the runner is already stopped, in which case the job is never run
+    bool submit(const std::shared_ptr< job_t >& job);
+
+    // Called when the job has been running past its timeout, to replace the worker running it
+    void overrun(const std::shared_ptr< job_t >& job);
+
+private:
+    struct worker_t {
+        std::unique_ptr< std::thread > thread;
+        bool retired{false}; // Stuck on a callback past its timeout, exits once it returns
+        bool exited{false};
+    };
+
+    void run(worker_t* worker);
+
+    // NOTE: Both have to be called under m_mutex
+    void start_worker();
+    void reap_workers();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque< std::shared_ptr< job_t > > m_jobs;
+    std::list< worker_t > m_workers; // Active ones and the retired ones which are yet to be joined
+    bool m_stopped{false};
+};
+
+/*
+ * GaugeCallback computes the value of a gauge when its group is scraped, so that the code owning the value does not
+ * have to update the gauge on every change. A callback which throws or runs past its timeout does not fail the
+ * scrape, the gauge just retains its previous value.
+ *
+ * Without a timeout, callback is run inline by the scrape. With a timeout, it is run by the GaugeCallbackRunner and
+ * the scrape waits only upto the timeout from when the callback starts running. A callback which is still running is
+ * not called again till it returns.
+ * Destroying the GaugeCallback (along with its group) waits for such a callback to return, hence whatever it captures
+ * only has to outlive the group.
+ */
+class GaugeCallback {
+public:
+    GaugeCallback(const gauge_value_cb_t& cb, const std::chrono::milliseconds timeout);
+    ~GaugeCallback();
+    GaugeCallback(const GaugeCallback&) = delete;
+    GaugeCallback(GaugeCallback&&) noexcept = default;
+    GaugeCallback& operator=(const GaugeCallback&) = delete;
+    GaugeCallback& operator=(GaugeCallback&&) noexcept = delete;
+
+    [[nodiscard]] std::optional< int64_t > evaluate(const std::string& name);
+
+private:
+    std::shared_ptr< const gauge_value_cb_t > m_cb; // Shared with the job running it
+    std::chrono::milliseconds m_timeout;
+    std::shared_ptr< GaugeCallbackRunner::job_t > m_pending; // Evaluation which is running past its timeout
 };
 
 /****************************** Histogram ************************************/
 class HistogramValue {
 public:
     friend class AtomicHistogramValue;
+    friend class PerCpuMetricsGroup;
 
     HistogramValue() = default;
     HistogramValue(const HistogramValue&) = default;
@@ -210,13 +313,17 @@ public:
 
     void observe(const int64_t value, const hist_bucket_boundaries_t& boundaries, const uint64_t count = 1) {
         const auto lower{std::lower_bound(std::cbegin(boundaries), std::cend(boundaries), value)};
-        const auto bkt_idx{std::distance(std::cbegin(boundaries), lower)};
+        observe(value, static_cast< size_t >(std::distance(std::cbegin(boundaries), lower)), count);
+    }
+
+    // Observe with the bucket already computed, typically by HistogramStaticInfo::bucket_index()
+    void observe(const int64_t value, const size_t bkt_idx, const uint64_t count = 1) {
         m_freqs[bkt_idx] += count;
         m_sum += (value * count);
     }
 
     void merge(const HistogramValue& other, const hist_bucket_boundaries_t& boundaries) {
-        for (size_t i{0}; i < boundaries.size(); ++i) {
+        for (size_t i{0}; i <= boundaries.size(); ++i) {
             this->m_freqs[i] += other.m_freqs[i];
         }
         this->m_sum += other.m_sum;
@@ -253,12 +360,24 @@ public:
     }
 
     [[nodiscard]] const hist_bucket_boundaries_t& get_boundaries() const { return m_bkt_boundaries; }
+    [[nodiscard]] bool is_log_linear() const { return m_log_linear; }
+
+    // 'le' label of each bucket for the text exposition, including the last "+Inf" bucket
+    [[nodiscard]] const std::vector< std::string >& le_labels() const { return m_le_labels; }
+
+    [[nodiscard]] size_t bucket_index(const int64_t value) const {
+        if (m_log_linear) { return LogLinearBuckets_t::bucket_index(value); }
+        const auto lower{std::lower_bound(std::cbegin(m_bkt_boundaries), std::cend(m_bkt_boundaries), value)};
+        return static_cast< size_t >(std::distance(std::cbegin(m_bkt_boundaries), lower));
+    }
 
 private:
     const std::string m_name;
     const std::string m_desc;
     std::pair< std::string, std::string > m_label_pair;
     const hist_bucket_boundaries_t& m_bkt_boundaries;
+    const bool m_log_linear;
+    std::vector< std::string > m_le_labels;
 };
 
 class HistogramDynamicInfo {
@@ -279,6 +398,8 @@ public:
     [[nodiscard]] double average(const HistogramValue& hvalue) const;
 
     void publish(const HistogramValue& hvalue);
+    void write_text(PrometheusTextWriter& writer, const HistogramStaticInfo& static_info,
+                    const HistogramValue& hvalue) const;
     void unregister(const HistogramStaticInfo& static_info);
 
 private:
@@ -296,6 +417,103 @@ private:
 
 private:
     std::variant< std::shared_ptr< ReportHistogram >, std::shared_ptr< ReportGauge > > m_report_histogram_gauge;
+    std::string m_text_labels;
+};
+
+/****************************** Summary ************************************/
+/*
+ * Summary is a quantile sketch: values are counted in fine grained log-linear buckets (SummaryBuckets_t), so that
+ * any quantile is estimated within ~1.6% of the actual value. Unlike histogram buckets, these are not reported, only
+ * the configured quantiles are. Merging sketches is adding up their buckets and the size of a sketch is fixed,
+ * irrespective of how many values are observed in it.
+ */
+class SummaryValue {
+public:
+    friend class AtomicSummaryValue;
+    friend class PerCpuMetricsGroup;
+
+    SummaryValue() = default;
+    SummaryValue(const SummaryValue&) = default;
+    SummaryValue(SummaryValue&&) noexcept = default;
+    SummaryValue& operator=(const SummaryValue&) = delete;
+    SummaryValue& operator=(SummaryValue&&) noexcept = delete;
+
+    void observe(const int64_t value, const uint64_t count = 1) {
+        m_counts[SummaryBuckets_t::bucket_index(value)] += count;
+        m_sum += (value * count);
+    }
+
+    void merge(const SummaryValue& other) {
+        for (size_t i{0}; i < m_counts.size(); ++i) {
+            this->m_counts[i] += other.m_counts[i];
+        }
+        this->m_sum += other.m_sum;
+    }
+
+    [[nodiscard]] const auto& get_counts() const { return m_counts; }
+    [[nodiscard]] int64_t get_sum() const { return m_sum; }
+    [[nodiscard]] uint64_t count() const;
+    [[nodiscard]] double average() const;
+
+    // Value at the given quantile (0 < q <= 1), estimated as the midpoint of the bucket the quantile falls in
+    [[nodiscard]] double quantile(const double q) const;
+
+private:
+    std::array< uint64_t, SummaryBuckets_t::num_buckets + 1 > m_counts{};
+    int64_t m_sum{0};
+};
+
+class SummaryStaticInfo {
+    friend class SummaryDynamicInfo;
+
+public:
+    SummaryStaticInfo(const std::string& name, const std::string& desc, const std::string& report_name = "",
+                      const metric_label& label_pair = {"", ""},
+                      const summary_quantiles_t& quantiles = default_summary_quantiles);
+
+    SummaryStaticInfo(const SummaryStaticInfo&) = default;
+    SummaryStaticInfo(SummaryStaticInfo&&) noexcept = delete;
+    SummaryStaticInfo& operator=(const SummaryStaticInfo&) = delete;
+    SummaryStaticInfo& operator=(SummaryStaticInfo&&) noexcept = delete;
+
+    [[nodiscard]] const std::string& name() const { return m_name; }
+    [[nodiscard]] const std::string& desc() const { return m_desc; }
+    [[nodiscard]] std::string label_pair() const {
+        return (!m_label_pair.first.empty() && !m_label_pair.second.empty())
+            ? m_label_pair.first + "-" + m_label_pair.second
+            : "";
+    }
+
+    [[nodiscard]] const summary_quantiles_t& get_quantiles() const { return m_quantiles; }
+
+    // 'quantile' label of each of the quantiles for the text exposition
+    [[nodiscard]] const std::vector< std::string >& quantile_labels() const { return m_quantile_labels; }
+
+private:
+    const std::string m_name;
+    const std::string m_desc;
+    std::pair< std::string, std::string > m_label_pair;
+    const summary_quantiles_t m_quantiles;
+    std::vector< std::string > m_quantile_labels;
+};
+
+class SummaryDynamicInfo {
+public:
+    SummaryDynamicInfo(const SummaryStaticInfo& static_info, const std::string& instance_name);
+
+    SummaryDynamicInfo(const SummaryDynamicInfo&) = default;
+    SummaryDynamicInfo(SummaryDynamicInfo&&) noexcept = delete;
+    SummaryDynamicInfo& operator=(const SummaryDynamicInfo&) = delete;
+    SummaryDynamicInfo& operator=(SummaryDynamicInfo&&) noexcept = delete;
+
+    void publish(const SummaryValue& svalue, const SummaryStaticInfo& static_info);
+    void write_text(PrometheusTextWriter& writer, const SummaryStaticInfo& static_info,
+                    const SummaryValue& svalue) const;
+    void unregister(const SummaryStaticInfo& static_info);
+
+private:
+    std::shared_ptr< ReportSummary > m_report_summary;
+    std::string m_text_labels;
 };
 
 class MetricsGroupImpl;
@@ -326,6 +544,10 @@ public:
                                 const metric_label& label_pair = {"", ""},
                                 const hist_bucket_boundaries_t& bkt_boundaries = HistogramBucketsType(DefaultBuckets));
 
+    uint64_t register_summary(const std::string& name, const std::string& desc, const std::string& report_name = "",
+                              const metric_label& label_pair = {"", ""},
+                              const summary_quantiles_t& quantiles = default_summary_quantiles);
+
     [[nodiscard]] const CounterStaticInfo& get_counter_info(uint64_t index) const;
     [[nodiscard]] const GaugeStaticInfo& get_gauge_info(uint64_t index) const;
     [[nodiscard]] const HistogramStaticInfo& get_histogram_info(uint64_t index) const;
@@ -337,12 +559,14 @@ public:
     std::vector< CounterStaticInfo > m_counters;
     std::vector< GaugeStaticInfo > m_gauges;
     std::vector< HistogramStaticInfo > m_histograms;
+    std::vector< SummaryStaticInfo > m_summaries;
     bool m_reg_pending{true};
 };
 
 using counter_gather_cb_t = std::function< void(uint64_t, const CounterValue&) >;
 using gauge_gather_cb_t = std::function< void(uint64_t, const GaugeValue&) >;
 using histogram_gather_cb_t = std::function< void(uint64_t, const HistogramValue&) >;
+using summary_gather_cb_t = std::function< void(uint64_t, const SummaryValue&) >;
 
 class MetricsGroupImpl {
 private:
@@ -371,6 +595,20 @@ public:
                             const metric_label& label_pair = {"", ""});
     uint64_t register_gauge(const std::string& name, const std::string& desc, const metric_label& label_pair);
 
+    // Gauge whose value is computed by the callback on every scrape, see GaugeCallback. No timeout by default.
+    uint64_t register_gauge_cb(const std::string& name, const std::string& desc, const gauge_value_cb_t& cb,
+                               const std::string& report_name = "", const metric_label& label_pair = {"", ""},
+                               const std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
+    uint64_t register_gauge_cb(const std::string& name, const std::string& desc, const gauge_value_cb_t& cb,
+                               const metric_label& label_pair,
+                               const std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
+    uint64_t register_gauge_cb(const std::string& name, const std::string& desc, const gauge_value_cb_t& cb,
+                               const std::chrono::milliseconds timeout);
+
+    // Counter whose label values are known only at runtime, see LabeledCounterFamily. Can be registered anytime.
+    LabeledCounterFamily& register_labeled_counter(const std::string& name, const std::string& desc,
+                                                   const uint32_t max_label_sets = default_max_label_sets);
+
     uint64_t register_histogram(const std::string& name, const std::string& desc, const std::string& report_name = "",
                                 const metric_label& label_pair = {"", ""},
                                 const hist_bucket_boundaries_t& bkt_boundaries = HistogramBucketsType(DefaultBuckets),
@@ -383,6 +621,14 @@ public:
                                 _publish_as ptype = _publish_as::publish_as_histogram);
     uint64_t register_histogram(const std::string& name, const std::string& desc, _publish_as ptype);
 
+    uint64_t register_summary(const std::string& name, const std::string& desc, const std::string& report_name = "",
+                              const metric_label& label_pair = {"", ""},
+                              const summary_quantiles_t& quantiles = default_summary_quantiles);
+    uint64_t register_summary(const std::string& name, const std::string& desc, const metric_label& label_pair,
+                              const summary_quantiles_t& quantiles = default_summary_quantiles);
+    uint64_t register_summary(const std::string& name, const std::string& desc,
+                              const summary_quantiles_t& quantiles);
+
     virtual void counter_increment(const uint64_t index, const int64_t val = 1) = 0;
     virtual void counter_decrement(const uint64_t index, const int64_t val = 1) = 0;
 
@@ -391,6 +637,9 @@ public:
     virtual void histogram_observe(const uint64_t index, const int64_t val, const uint64_t count) = 0;
     virtual void histogram_observe(const uint64_t index, const int64_t val) = 0;
 
+    virtual void summary_observe(const uint64_t index, const int64_t val, const uint64_t count) = 0;
+    virtual void summary_observe(const uint64_t index, const int64_t val) = 0;
+
     nlohmann::json get_result_in_json(const bool need_latest);
     [[nodiscard]] const std::string& get_group_name() const;
     [[nodiscard]] const std::string& get_instance_name() const;
@@ -398,6 +647,25 @@ public:
     void publish_result();
     void gather();
 
+    // Append the metrics of this group and its child groups to the writer, bypassing the reporter
+    void write_prometheus_text(PrometheusTextWriter& writer);
+
+    // Returns if this group or any of its child groups is updated since the last scrape of the given type, and
+    // resets it for the next. Groups with gather callback are always treated as updated. The caller has to run
+    // ThreadBufferMetricsGroup::flush_core_cache() after clearing and before reading the values, see mark_updated().
+    [[nodiscard]] bool test_and_clear_updated(const scrape_type type);
+
+    // Updates mark the groups updated only once a scrape skips the unchanged groups, after which it stays enabled.
+    // fence_updates is for when flush_core_cache() cannot order every thread, the updates then fence themselves.
+    static void enable_update_tracking(const bool fence_updates) {
+        if (fence_updates) { s_fence_updates.store(true, std::memory_order_relaxed); }
+        s_track_updates.store(true, std::memory_order_seq_cst);
+    }
+
+    // Same as get_result_in_json(), except that it returns the previous result if not updated, as found by the
+    // caller with test_and_clear_updated()
+    nlohmann::json get_result_in_json_if_updated(const bool need_latest, const bool updated);
+
     [[nodiscard]] virtual const CounterStaticInfo& counter_static_info(const uint64_t idx) const {
         return m_static_info->m_counters[idx];
     }
@@ -413,6 +681,11 @@ public:
     }
     virtual HistogramDynamicInfo& hist_dynamic_info(const uint64_t idx) { return m_histograms_dinfo[idx]; }
 
+    [[nodiscard]] virtual const SummaryStaticInfo& summary_static_info(const uint64_t idx) const {
+        return m_static_info->m_summaries[idx];
+    }
+    virtual SummaryDynamicInfo& summary_dynamic_info(const uint64_t idx) { return m_summaries_dinfo[idx]; }
+
     [[nodiscard]] virtual uint64_t num_counters() const {
         assert(m_static_info->m_counters.size() == m_counters_dinfo.size());
         return m_counters_dinfo.size();
@@ -428,6 +701,11 @@ public:
         return m_histograms_dinfo.size();
     }
 
+    [[nodiscard]] virtual uint64_t num_summaries() const {
+        assert(m_static_info->m_summaries.size() == m_summaries_dinfo.size());
+        return m_summaries_dinfo.size();
+    }
+
     void attach_gather_cb(const on_gather_cb_t& cb) {
         auto locked{lock()};
         m_on_gather_cb = cb;
@@ -448,9 +726,31 @@ public:
 
     virtual void on_register() = 0;
 
+private:
+    // Update the callback gauges, before gathering the values. Called before taking the group lock, so that a slow
+    // callback does not hold it.
+    void update_callback_gauges();
+
 protected:
     virtual void gather_result(const bool need_latest, const counter_gather_cb_t& counter_cb,
-                               const gauge_gather_cb_t& gauge_cb, const histogram_gather_cb_t& histogram_cb) = 0;
+                               const gauge_gather_cb_t& gauge_cb, const histogram_gather_cb_t& histogram_cb,
+                               const summary_gather_cb_t& summary_cb) = 0;
+
+    // Called on every update, hence only a shared read once the group is already marked updated, with no fence. The
+    // scrape clears m_updated and then runs a full barrier on every running thread (flush_core_cache()), so that it
+    // either sees the new value or this sees the cleared bit and sets it again. Only the compiler has to be kept from
+    // reading m_updated ahead of the value update here.
+    void mark_updated() {
+        if (!s_track_updates.load(std::memory_order_relaxed)) { return; }
+        if (s_fence_updates.load(std::memory_order_relaxed)) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        } else {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        }
+        if (m_updated.load(std::memory_order_relaxed) != all_scrape_types) {
+            m_updated.store(all_scrape_types, std::memory_order_relaxed);
+        }
+    }
 
 protected:
     std::string m_inst_name;
@@ -461,9 +761,19 @@ protected:
     std::vector< CounterDynamicInfo > m_counters_dinfo;
     std::vector< GaugeDynamicInfo > m_gauges_dinfo;
     std::vector< HistogramDynamicInfo > m_histograms_dinfo;
+    std::vector< SummaryDynamicInfo > m_summaries_dinfo;
 
     std::vector< GaugeValue > m_gauge_values;
+    std::vector< std::pair< uint64_t, GaugeCallback > > m_gauge_cbs; // Gauge index and its callback
+    std::mutex m_gauge_cbs_mutex; // Serializes the evaluation of m_gauge_cbs, which is done outside of m_mutex
+    std::vector< std::unique_ptr< LabeledCounterFamily > > m_labeled_counters;
     std::vector< MetricsGroupImplPtr > m_child_groups;
+
+    std::atomic< uint8_t > m_updated{all_scrape_types}; // Bitmap of scrape_type which are yet to see the updates
+    nlohmann::json m_last_json;
+
+    static inline std::atomic< bool > s_track_updates{false};
+    static inline std::atomic< bool > s_fence_updates{false};
 };
 
 } // namespace sisl
@@ -0,0 +1,168 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include <sisl/utility/thread_buffer.hpp>
+
+#include "reporter.hpp"
+
+namespace sisl {
+class PrometheusTextWriter;
+class LabeledCounterFamily;
+
+using metric_labels_t = std::vector< metric_label >;
+static constexpr uint32_t default_max_label_sets{1000};
+
+/*
+ * Per thread values of a labeled family, indexed by the dense index of the label set. Only the owner thread writes,
+ * hence an update is a relaxed load and store. Values live in fixed size chunks, allocated when the thread first uses
+ * a label set in that chunk and never moved, so that the scraper can read them while the array grows.
+ */
+class LabeledValues {
+public:
+    explicit LabeledValues(const uint32_t num_values);
+    ~LabeledValues();
+    LabeledValues(const LabeledValues&) = delete;
+    LabeledValues(LabeledValues&&) noexcept = delete;
+    LabeledValues& operator=(const LabeledValues&) = delete;
+    LabeledValues& operator=(LabeledValues&&) noexcept = delete;
+
+    void add(const uint32_t idx, const int64_t val) {
+        auto* chunk{m_chunks[idx / chunk_size].load(std::memory_order_relaxed)};
+        if (chunk == nullptr) { chunk = new_chunk(idx / chunk_size); }
+        auto& value{(*chunk)[idx % chunk_size]};
+        value.store(value.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+    }
+
+    // Add all the values of this thread to the given array
+    void merge_into(std::vector< int64_t >& values) const;
+
+    // Label set key to index, cached per thread so that resolving a label set already seen takes no locks
+    std::unordered_map< std::string, uint32_t > m_index_cache;
+    bool m_folded{false}; // Values are already added to the family, after the thread exited
+
+private:
+    static constexpr uint32_t chunk_size{64};
+    using chunk_t = std::array< std::atomic< int64_t >, chunk_size >;
+
+    chunk_t* new_chunk(const uint32_t chunk_num);
+
+private:
+    std::vector< std::atomic< chunk_t* > > m_chunks;
+};
+
+// Counter of a resolved label set. It is cheap to copy and is meant to be kept by the call site.
+class LabeledCounter {
+public:
+    LabeledCounter(LabeledCounterFamily* family, const uint32_t idx) : m_family{family}, m_idx{idx} {}
+
+    inline void increment(const int64_t val = 1);
+    inline void decrement(const int64_t val = 1);
+    [[nodiscard]] uint32_t index() const { return m_idx; }
+
+private:
+    LabeledCounterFamily* m_family;
+    uint32_t m_idx;
+};
+
+/*
+ * LabeledCounterFamily is a counter whose label values are known only at runtime, like per tenant or per opcode
+ * counts, without creating a metrics group per label value:
+ *
+ *     auto& family{mgroup->register_labeled_counter("tenant_ops", "Ops per tenant")};
+ *     family.with_labels({"tenant", id}).increment();
+ *
+ * Every distinct label set gets a dense index the first time it is seen. Beyond max_label_sets distinct sets, all new
+ * label sets are counted in a single overflow set, whose label values are all "__overflow__". All label sets of a
+ * family are expected to have the same label names. A label named "entity" is reported as "exported_entity", since
+ * "entity" already carries the instance name.
+ */
+class LabeledCounterFamily {
+    friend class LabeledCounter;
+
+public:
+    LabeledCounterFamily(const std::string& name, const std::string& desc, const std::string& instance_name,
+                         const uint32_t max_label_sets = default_max_label_sets);
+    ~LabeledCounterFamily();
+    LabeledCounterFamily(const LabeledCounterFamily&) = delete;
+    LabeledCounterFamily(LabeledCounterFamily&&) noexcept = delete;
+    LabeledCounterFamily& operator=(const LabeledCounterFamily&) = delete;
+    LabeledCounterFamily& operator=(LabeledCounterFamily&&) noexcept = delete;
+
+    [[nodiscard]] LabeledCounter with_labels(const metric_label& label) {
+        return with_label_set(metric_labels_t{label});
+    }
+    [[nodiscard]] LabeledCounter with_labels(std::initializer_list< metric_label > labels) {
+        return with_label_set(metric_labels_t{labels});
+    }
+    [[nodiscard]] LabeledCounter with_label_set(const metric_labels_t& labels);
+
+    [[nodiscard]] const std::string& name() const { return m_name; }
+    [[nodiscard]] const std::string& desc() const { return m_desc; }
+    [[nodiscard]] uint32_t overflow_index() const { return m_max_label_sets; }
+
+    // Scrape side, gather() sums up the thread values which the rest of them report
+    void gather();
+    [[nodiscard]] nlohmann::json get_result_in_json() const;
+    void publish();
+    void write_text(PrometheusTextWriter& writer) const;
+
+private:
+    struct label_set_t {
+        metric_labels_t labels;
+        std::string text_labels;
+        std::shared_ptr< ReportCounter > report_counter;
+    };
+
+    [[nodiscard]] uint32_t resolve(const std::string& key, const metric_labels_t& labels);
+    [[nodiscard]] label_set_t make_label_set(const metric_labels_t& labels) const;
+
+    // Visit every label set which is in use, along with its gathered value
+    template < typename CB >
+    void foreach_label_set(const CB& cb) const;
+
+private:
+    std::string m_name;
+    std::string m_desc;
+    std::string m_instance_name;
+    uint32_t m_max_label_sets;
+
+    mutable std::shared_mutex m_mutex; // Protects the label sets below
+    std::unordered_map< std::string, uint32_t > m_index;
+    std::vector< label_set_t > m_label_sets;
+    std::unique_ptr< label_set_t > m_overflow_set;
+
+    ExitSafeThreadBuffer< LabeledValues, uint32_t > m_values;
+    std::vector< int64_t > m_exited_values; // Values of the threads which already exited
+    std::vector< int64_t > m_gathered;
+};
+
+void LabeledCounter::increment(const int64_t val) { m_family->m_values->add(m_idx, val); }
+void LabeledCounter::decrement(const int64_t val) { m_family->m_values->add(m_idx, -val); }
+} // namespace sisl
@@ -0,0 +1,85 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+#include "histogram_buckets.hpp"
+#include "metrics_group_impl.hpp"
+
+namespace sisl {
+/*
+ * PerCpuMetricsGroup keeps a slab of counter, histogram and summary values per cpu, hence its memory is bounded by the
+ * number of cpus instead of the number of threads, and a gather sums up the slabs.
+ *
+ * An update is a restartable sequence (rseq) adding to the slab of the current cpu, which needs no atomic
+ * instruction. Where rseq is not available to the thread (kernel older than 4.18, arch other than x86_64, or compiler
+ * older than gcc 11 or clang 11), the update is a relaxed atomic add to a separate set of slabs, picked by
+ * sched_getcpu(), which still spreads the contention across cpus.
+ */
+class PerCpuMetricsGroup : public MetricsGroupImpl {
+public:
+    PerCpuMetricsGroup(const char* const grp_name, const char* const inst_name) :
+            MetricsGroupImpl(grp_name, inst_name) {}
+    PerCpuMetricsGroup(const std::string& grp_name, const std::string& inst_name) :
+            MetricsGroupImpl(grp_name, inst_name) {}
+    virtual ~PerCpuMetricsGroup() = default;
+    PerCpuMetricsGroup(const PerCpuMetricsGroup&) = delete;
+    PerCpuMetricsGroup(PerCpuMetricsGroup&&) noexcept = delete;
+    PerCpuMetricsGroup& operator=(const PerCpuMetricsGroup&) = delete;
+    PerCpuMetricsGroup& operator=(PerCpuMetricsGroup&&) noexcept = delete;
+
+    void counter_increment(const uint64_t index, const int64_t val = 1) override;
+    void counter_decrement(const uint64_t index, const int64_t val = 1) override;
+    void histogram_observe(const uint64_t index, const int64_t val) override;
+    void histogram_observe(const uint64_t index, const int64_t val, const uint64_t count) override;
+    void summary_observe(const uint64_t index, const int64_t val) override;
+    void summary_observe(const uint64_t index, const int64_t val, const uint64_t count) override;
+
+    [[nodiscard]] group_impl_type_t impl_type() const { return group_impl_type_t::per_cpu; }
+
+    // Whether the updates from the calling thread use rseq, rather than the atomic fallback
+    [[nodiscard]] static bool is_rseq_enabled();
+
+private:
+    void on_register();
+    void gather_result(bool need_latest, const counter_gather_cb_t& counter_cb, const gauge_gather_cb_t& gauge_cb,
+                       const histogram_gather_cb_t& histogram_cb, const summary_gather_cb_t& summary_cb) override;
+
+    void add(const uint64_t offset, const int64_t val);
+    [[nodiscard]] int64_t sum_all_cpus(const uint64_t offset) const;
+    [[nodiscard]] int64_t* slab(const uint32_t slab_num) const {
+        return m_slabs.get()->values.data() + (slab_num * m_slab_size);
+    }
+
+private:
+    static constexpr uint64_t hist_slab_values{HistogramBuckets::max_hist_bkts + 1};  // Buckets and sum
+    static constexpr uint64_t summary_slab_values{SummaryBuckets_t::num_buckets + 2}; // Buckets and sum
+
+    struct alignas(64) cache_line_t {
+        std::array< int64_t, 8 > values;
+    };
+
+    uint32_t m_ncpus{0};
+    uint64_t m_slab_size{0}; // Values per slab, rounded up to cache lines to avoid false sharing between cpus
+    uint64_t m_hist_offset{0};
+    uint64_t m_summary_offset{0};
+    std::unique_ptr< cache_line_t[] > m_slabs; // m_ncpus slabs updated with rseq followed by m_ncpus atomic ones
+};
+} // namespace sisl
@@ -28,7 +28,7 @@
 
 namespace sisl {
 using WisrBufferMetrics =
-    sisl::wisr_framework< PerThreadMetrics, const std::vector< HistogramStaticInfo >&, uint32_t, uint32_t >;
+    sisl::wisr_framework< PerThreadMetrics, const std::vector< HistogramStaticInfo >&, uint32_t, uint32_t, uint32_t >;
 
 class WisrBufferMetricsGroup : public MetricsGroupImpl {
 public:
@@ -40,13 +40,15 @@ public:
     void counter_decrement(uint64_t index, int64_t val = 1) override;
     void histogram_observe(uint64_t index, int64_t val) override;
     void histogram_observe(uint64_t index, int64_t val, uint64_t count) override;
+    void summary_observe(uint64_t index, int64_t val) override;
+    void summary_observe(uint64_t index, int64_t val, uint64_t count) override;
 
     group_impl_type_t impl_type() const { return group_impl_type_t::rcu; }
 
 private:
     void on_register();
     void gather_result(bool need_latest, const counter_gather_cb_t& counter_cb, const gauge_gather_cb_t& gauge_cb,
-                       const histogram_gather_cb_t& histogram_cb) override;
+                       const histogram_gather_cb_t& histogram_cb, const summary_gather_cb_t& summary_cb) override;
 
 private:
     std::unique_ptr< WisrBufferMetrics > m_metrics;
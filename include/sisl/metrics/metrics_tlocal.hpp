@@ -30,19 +30,23 @@
 
 namespace sisl {
 static_assert(std::is_trivially_copyable< HistogramValue >::value, "Expecting HistogramValue to be trivally copyable");
+static_assert(std::is_trivially_copyable< SummaryValue >::value, "Expecting SummaryValue to be trivally copyable");
 
 class HistogramStaticInfo;
 class PerThreadMetrics {
 private:
     std::unique_ptr< CounterValue[] > m_counters{nullptr};
     std::unique_ptr< HistogramValue[] > m_histograms{nullptr};
+    std::unique_ptr< SummaryValue[] > m_summaries{nullptr};
     const std::vector< HistogramStaticInfo >& m_histogram_info;
 
     uint32_t m_ncntrs;
     uint32_t m_nhists;
+    uint32_t m_nsummaries;
 
 public:
-    PerThreadMetrics(const std::vector< HistogramStaticInfo >& hinfo, const uint32_t ncntrs, const uint32_t nhists);
+    PerThreadMetrics(const std::vector< HistogramStaticInfo >& hinfo, const uint32_t ncntrs, const uint32_t nhists,
+                     const uint32_t nsummaries);
     PerThreadMetrics(const PerThreadMetrics&) = delete;
     PerThreadMetrics(PerThreadMetrics&&) noexcept = delete;
     PerThreadMetrics& operator=(const PerThreadMetrics&) = delete;
@@ -52,24 +56,25 @@ public:
     static void merge(PerThreadMetrics* const a, PerThreadMetrics* const b);
     CounterValue& get_counter(const uint64_t index);
     HistogramValue& get_histogram(const uint64_t index);
+    SummaryValue& get_summary(const uint64_t index);
 
-    auto get_num_metrics() const { return std::make_tuple(m_ncntrs, m_nhists); }
+    auto get_num_metrics() const { return std::make_tuple(m_ncntrs, m_nhists, m_nsummaries); }
 };
 
 using PerThreadMetricsBuffer =
-    ExitSafeThreadBuffer< PerThreadMetrics, const std::vector< HistogramStaticInfo >&, uint32_t, uint32_t >;
+    ExitSafeThreadBuffer< PerThreadMetrics, const std::vector< HistogramStaticInfo >&, uint32_t, uint32_t, uint32_t >;
 
 /*
  * ThreadBufferMetricsGroup is a very fast metrics accumulator and unlike RCU, it gathers the metrics for reporting
  * much faster. The logic is simply using sisl::ThreadBuffer, which is a per thread buffer with exit safety where even
  * after thread exits, its data is protected for scrapping. The metics are accumulated on each thread and when it is
- * time to scrap the metrics, it send a signal to all threads to flush caches (using atomic fencing) and then other
- * thread reads the data. Of course there is no atomicity in fetching the accurate data, but it will be timeline
- * consistent.
+ * time to scrap the metrics, it issues a process wide membarrier (or where it is not supported, sends a signal to all
+ * threads) to flush caches and then other thread reads the data. Of course there is no atomicity in fetching the
+ * accurate data, but it will be timeline consistent.
  *
  * Given that it is using no locks or atomics or even rcu critical section, during collecting metrics - it is probably
- * the fastest we could get. During scrapping additional latency compared to AtomicMetricsGroup is in sending signal
- * to all threads and then read thread. The difference on that is much more closer and manageable.
+ * the fastest we could get. During scrapping additional latency compared to AtomicMetricsGroup is in the barrier
+ * and then read thread. The difference on that is much more closer and manageable.
  */
 class ThreadBufferMetricsGroup : public MetricsGroupImpl {
 public:
@@ -88,15 +93,21 @@ public:
     void counter_decrement(const uint64_t index, const int64_t val = 1) override;
     void histogram_observe(const uint64_t index, const int64_t val) override;
     void histogram_observe(const uint64_t index, const int64_t val, const uint64_t count) override;
+    void summary_observe(const uint64_t index, const int64_t val) override;
+    void summary_observe(const uint64_t index, const int64_t val, const uint64_t count) override;
 
     static void flush_core_cache();
+    static void flush_core_cache_by_signal();
+
+    // Whether flush_core_cache() orders every thread of the process, rather than only the registered ones
+    static bool flush_core_cache_covers_all_threads();
 
     group_impl_type_t impl_type() const { return group_impl_type_t::thread_buf_signal; }
 
 private:
     void on_register();
     void gather_result(const bool need_latest, const counter_gather_cb_t& counter_cb, const gauge_gather_cb_t& gauge_cb,
-                       const histogram_gather_cb_t& histogram_cb) override;
+                       const histogram_gather_cb_t& histogram_cb, const summary_gather_cb_t& summary_cb) override;
 
 private:
     std::unique_ptr< PerThreadMetricsBuffer > m_metrics_buf;
@@ -16,16 +16,20 @@
  *********************************************************************************/
 #pragma once
 
+#include <algorithm>
 #include <map>
 #include <unordered_map>
 #include <memory>
 #include <string>
 #include <mutex>
+#include <vector>
 #include "reporter.hpp"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 #include <prometheus/registry.h>
+#include <prometheus/client_metric.h>
+#include <prometheus/metric_family.h>
 #include <prometheus/counter.h>
 #include <prometheus/gauge.h>
 #include <prometheus/histogram.h>
@@ -89,6 +93,44 @@ public:
     const hist_bucket_boundaries_t& m_bkt_boundaries;
 };
 
+/*
+ * prometheus::Summary computes its quantiles from the values observed into it, while our summaries are sketches that
+ * are already merged across threads. So the reporter keeps the computed quantiles as client metrics of its own and
+ * adds them as summary families on every serialize.
+ */
+class PrometheusReportSummary : public ReportSummary {
+public:
+    PrometheusReportSummary(const std::map< std::string, std::string >& label_pairs,
+                            const std::vector< double >& quantiles) {
+        for (const auto& [name, value] : label_pairs) {
+            m_metric.label.push_back(prometheus::ClientMetric::Label{name, value});
+        }
+        for (const auto q : quantiles) {
+            prometheus::ClientMetric::Quantile quantile;
+            quantile.quantile = q;
+            m_metric.summary.quantile.push_back(quantile);
+        }
+    }
+
+    virtual void set_value(const std::vector< double >& quantile_values, uint64_t count, double sum) override {
+        std::unique_lock lk(m_mutex);
+        for (size_t i{0}; (i < quantile_values.size()) && (i < m_metric.summary.quantile.size()); ++i) {
+            m_metric.summary.quantile[i].value = quantile_values[i];
+        }
+        m_metric.summary.sample_count = count;
+        m_metric.summary.sample_sum = sum;
+    }
+
+    prometheus::ClientMetric collect() const {
+        std::unique_lock lk(m_mutex);
+        return m_metric;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    prometheus::ClientMetric m_metric;
+};
+
 class PrometheusReporter : public Reporter {
 public:
     PrometheusReporter() {
@@ -102,6 +144,14 @@ public:
     std::shared_ptr< ReportCounter > add_counter(const std::string& name, const std::string& desc,
                                                  const std::string& instance_name,
                                                  const metric_label& label_pair = {"", ""}) {
+        std::vector< metric_label > labels;
+        if (!label_pair.first.empty() && !label_pair.second.empty()) { labels.push_back(label_pair); }
+        return add_labeled_counter(name, desc, instance_name, labels);
+    }
+
+    std::shared_ptr< ReportCounter > add_labeled_counter(const std::string& name, const std::string& desc,
+                                                         const std::string& instance_name,
+                                                         const std::vector< metric_label >& labels) {
         prometheus::Family< prometheus::Counter >* family_ptr;
 
         std::unique_lock lk(m_mutex);
@@ -114,13 +164,10 @@ public:
             family_ptr = it->second;
         }
 
-        std::map< std::string, std::string > label_pairs;
-        if (!label_pair.first.empty() && !label_pair.second.empty()) {
-            label_pairs = {{"entity", instance_name}, {label_pair.first, label_pair.second}};
-        } else {
-            label_pairs = {{"entity", instance_name}};
+        std::map< std::string, std::string > label_pairs{{"entity", instance_name}};
+        for (const auto& label : labels) {
+            label_pairs.insert(label);
         }
-
         return std::make_shared< PrometheusReportCounter >(*family_ptr, label_pairs);
     }
 
@@ -175,6 +222,25 @@ public:
         return std::make_shared< PrometheusReportHistogram >(*family_ptr, label_pairs, bkt_boundaries);
     }
 
+    std::shared_ptr< ReportSummary > add_summary(const std::string& name, const std::string& desc,
+                                                 const std::string& instance_name,
+                                                 const std::vector< double >& quantiles,
+                                                 const metric_label& label_pair = {"", ""}) override {
+        std::map< std::string, std::string > label_pairs;
+        if (!label_pair.first.empty() && !label_pair.second.empty()) {
+            label_pairs = {{"entity", instance_name}, {label_pair.first, label_pair.second}};
+        } else {
+            label_pairs = {{"entity", instance_name}};
+        }
+
+        auto summary = std::make_shared< PrometheusReportSummary >(label_pairs, quantiles);
+        std::unique_lock lk(m_mutex);
+        auto& family = m_summary_families[name];
+        family.desc = desc;
+        family.summaries.push_back(summary);
+        return summary;
+    }
+
     void remove_counter(const std::string& name, const std::shared_ptr< ReportCounter >& rc) override {
         std::unique_lock lk(m_mutex);
         auto it = m_counter_families.find(name);
@@ -214,6 +280,19 @@ public:
         family_ptr->Remove(&prh->m_histogram);
     }
 
+    void remove_summary(const std::string& name, const std::shared_ptr< ReportSummary >& rs) override {
+        std::unique_lock lk(m_mutex);
+        auto it = m_summary_families.find(name);
+        if (it == m_summary_families.end()) {
+            LOGERROR("Unable to locate the summary of name {} to remove", name);
+            return;
+        }
+
+        auto& summaries = it->second.summaries;
+        summaries.erase(std::remove(summaries.begin(), summaries.end(), rs), summaries.end());
+        if (summaries.empty()) { m_summary_families.erase(it); }
+    }
+
     std::string serialize(ReportFormat format) {
         if (format != m_cur_serializer_format) {
             // If user wants different formatter now, change the serializer
@@ -229,7 +308,22 @@ public:
 
             m_cur_serializer_format = format;
         }
-        return m_serializer->Serialize(m_registry->Collect());
+
+        auto families = m_registry->Collect();
+        {
+            std::unique_lock lk(m_mutex);
+            for (const auto& [name, sfamily] : m_summary_families) {
+                prometheus::MetricFamily family;
+                family.name = name;
+                family.help = sfamily.desc;
+                family.type = prometheus::MetricType::Summary;
+                for (const auto& summary : sfamily.summaries) {
+                    family.metric.push_back(summary->collect());
+                }
+                families.push_back(std::move(family));
+            }
+        }
+        return m_serializer->Serialize(families);
     }
 
 private:
@@ -239,6 +333,12 @@ private:
     std::unordered_map< std::string, prometheus::Family< prometheus::Gauge >* > m_gauge_families;
     std::unordered_map< std::string, prometheus::Family< prometheus::Histogram >* > m_histogram_families;
 
+    struct summary_family {
+        std::string desc;
+        std::vector< std::shared_ptr< PrometheusReportSummary > > summaries;
+    };
+    std::map< std::string, summary_family > m_summary_families;
+
     std::unique_ptr< prometheus::Serializer > m_serializer;
     ReportFormat m_cur_serializer_format;
 };
@@ -0,0 +1,88 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "reporter.hpp"
+
+namespace sisl {
+/*
+ * PrometheusTextWriter writes the prometheus text exposition format straight from the gathered metric values, without
+ * going through prometheus-cpp registry and its MetricFamily objects. Samples are appended to their family as the
+ * groups are gathered (all instances of a metric have to be under one family) and finish() writes out the families.
+ *
+ * The writer is meant to be reused across scrapes, its buffers retain their capacity. A family is complete only after
+ * every group is gathered, hence the samples of the whole scrape are held in memory until finish(). If a file
+ * descriptor is given, finish() writes the output to it whenever flush_size bytes accumulate, which saves only the
+ * second copy of the scrape that text() would otherwise hold.
+ */
+class PrometheusTextWriter {
+public:
+    explicit PrometheusTextWriter(const int fd = -1, const size_t flush_size = 64 * 1024);
+    PrometheusTextWriter(const PrometheusTextWriter&) = delete;
+    PrometheusTextWriter(PrometheusTextWriter&&) noexcept = delete;
+    PrometheusTextWriter& operator=(const PrometheusTextWriter&) = delete;
+    PrometheusTextWriter& operator=(PrometheusTextWriter&&) noexcept = delete;
+
+    // Start a new scrape, dropping the samples and output of the previous one
+    void begin();
+
+    // Buffer to append the samples of the given family to. Help and type are taken from its first use in a scrape.
+    std::string& family(const std::string& name, const std::string& help, const char* type);
+
+    // Write out all families, returns false if writing to the file descriptor failed
+    bool finish();
+
+    // Output of the scrape, when not writing to a file descriptor
+    [[nodiscard]] const std::string& text() const { return m_out; }
+
+    static void append_sample(std::string& buf, const std::string& name, const char* suffix,
+                              const std::string& labels, const std::string& extra_label, double value);
+    static void append_sample(std::string& buf, const std::string& name, const char* suffix,
+                              const std::string& labels, const std::string& extra_label, int64_t value);
+
+    // Labels of a metric instance in the form 'entity="<instance>",<label>="<value>"', computed once at registration
+    [[nodiscard]] static std::string make_labels(const std::string& instance_name, const metric_label& label_pair);
+    [[nodiscard]] static std::string make_labels(const std::string& instance_name,
+                                                 const std::vector< metric_label >& labels);
+
+    // Additional label like ',le="10"' to be appended after the metric labels
+    [[nodiscard]] static std::string make_extra_label(const char* name, double value);
+
+private:
+    bool write_out(const bool force);
+
+private:
+    struct family_t {
+        std::string name;
+        std::string help;
+        const char* type{nullptr};
+        std::string samples;
+    };
+
+    int m_fd;
+    size_t m_flush_size;
+    bool m_write_failed{false};
+    std::string m_out;
+    std::vector< family_t > m_families; // Kept across scrapes, so that their buffers are reused
+    std::unordered_map< std::string, size_t > m_family_index;
+};
+} // namespace sisl
@@ -16,9 +16,11 @@
  *********************************************************************************/
 #pragma once
 
+#include <cstdint>
 #include <map>
 #include <string>
 #include <memory>
+#include <vector>
 #include "histogram_buckets.hpp"
 
 namespace sisl {
@@ -41,12 +43,25 @@ public:
     virtual void set_value(std::vector< double >& bucket_values, double sum) = 0;
 };
 
+class ReportSummary {
+public:
+    // quantile_values are in the same order as the quantiles the summary was added with
+    virtual void set_value(const std::vector< double >& quantile_values, uint64_t count, double sum) = 0;
+};
+
 class Reporter {
 public:
     virtual ~Reporter() = default;
     virtual std::shared_ptr< ReportCounter > add_counter(const std::string& name, const std::string& desc,
                                                          const std::string& instance_name,
                                                          const metric_label& label_pair = {"", ""}) = 0;
+    // Counter with any number of labels, all the counters of a name are expected to have the same label names.
+    // Reporters supporting only a single label get the first one.
+    virtual std::shared_ptr< ReportCounter > add_labeled_counter(const std::string& name, const std::string& desc,
+                                                                 const std::string& instance_name,
+                                                                 const std::vector< metric_label >& labels) {
+        return add_counter(name, desc, instance_name, labels.empty() ? metric_label{"", ""} : labels.front());
+    }
     virtual std::shared_ptr< ReportGauge > add_gauge(const std::string& name, const std::string& desc,
                                                      const std::string& instance_name,
                                                      const metric_label& label_pair = {"", ""}) = 0;
@@ -54,10 +69,15 @@ public:
                                                              const std::string& instance_name,
                                                              const hist_bucket_boundaries_t& bkt_boundaries,
                                                              const metric_label& label_pair = {"", ""}) = 0;
+    virtual std::shared_ptr< ReportSummary > add_summary(const std::string& name, const std::string& desc,
+                                                         const std::string& instance_name,
+                                                         const std::vector< double >& quantiles,
+                                                         const metric_label& label_pair = {"", ""}) = 0;
 
     virtual void remove_counter(const std::string& name, const std::shared_ptr< ReportCounter >& hist) = 0;
     virtual void remove_gauge(const std::string& name, const std::shared_ptr< ReportGauge >& hist) = 0;
     virtual void remove_histogram(const std::string& name, const std::shared_ptr< ReportHistogram >& hist) = 0;
+    virtual void remove_summary(const std::string& name, const std::shared_ptr< ReportSummary >& summary) = 0;
 
     virtual std::string serialize(ReportFormat format) = 0;
 };
@@ -0,0 +1,315 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "sisl/fds/aligned_pool_allocator.hpp"
+#include "sisl/fds/slab_allocator.hpp"
+
+namespace sisl {
+static size_t page_size() {
+    static const size_t s_page_size{static_cast< size_t >(::sysconf(_SC_PAGESIZE))};
+    return s_page_size;
+}
+
+AlignedPoolAllocatorImpl::AlignedPoolAllocatorImpl(const bool huge_pages) : m_huge_pages{huge_pages} {
+    for (auto& leaf : m_pagemap) {
+        leaf.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+AlignedPoolAllocatorImpl::~AlignedPoolAllocatorImpl() {
+    // Hand over all thread caches to depots first, so that there is no one to touch the chunks afterwards
+    m_caches.reset(nullptr);
+    for (auto& tc : m_caches.accessAllThreads()) {
+        for (auto& tag_bins : tc.bins) {
+            for (auto& bin : tag_bins) {
+                bin.clear();
+            }
+        }
+    }
+
+    for (auto* const chunk : m_chunks) {
+        ::munmap(static_cast< void* >(chunk), chunk_size);
+    }
+    for (auto& [buf, sz] : m_large_bufs) {
+        ::munmap(static_cast< void* >(buf), sz);
+    }
+    for (auto& leaf : m_pagemap) {
+        delete leaf.load(std::memory_order_relaxed);
+    }
+}
+
+AlignedPoolAllocatorImpl::thread_cache::~thread_cache() {
+    for (uint8_t t{0}; t < (uint8_t)buftag::sentinel; ++t) {
+        for (uint8_t cls{0}; cls < num_classes; ++cls) {
+            auto& bin{bins[t][cls]};
+            if (!bin.empty()) { pool->flush((buftag)t, cls, bin, bin.size()); }
+        }
+    }
+}
+
+uint8_t* AlignedPoolAllocatorImpl::aligned_alloc(const size_t align, const size_t sz, const sisl::buftag tag) {
+    const uint8_t cls{size_class(sz, align)};
+    uint8_t* buf;
+    if (sisl_unlikely(cls == num_classes)) {
+        buf = (align <= page_size()) ? large_alloc(sz) : nullptr;
+        if (buf == nullptr) {
+            // Alignment is beyond what mmap gives us, nothing to pool here
+            buf = static_cast< uint8_t* >(std::aligned_alloc(align, sisl::round_up(sz, align)));
+        }
+    } else {
+        auto& bin{local_cache().bins[(size_t)tag][cls]};
+        if (!bin.empty()) {
+            buf = bin.back();
+            bin.pop_back();
+            m_metrics.hit(tag);
+        } else {
+            buf = refill(tag, cls, bin);
+        }
+    }
+
+    if (buf) { AlignedAllocator::metrics().increment(tag, buf_size(buf)); }
+    return buf;
+}
+
+void AlignedPoolAllocatorImpl::aligned_free(uint8_t* const b, const sisl::buftag tag) {
+    if (b == nullptr) { return; }
+
+    const uint16_t entry{pagemap_get(b)};
+    if (sisl_unlikely(entry == 0)) {
+        AlignedAllocator::metrics().decrement(tag, buf_size(b));
+        {
+            std::unique_lock< std::mutex > lock{m_large_mtx};
+            if (const auto it{m_large_bufs.find(b)}; it != m_large_bufs.end()) {
+                const size_t sz{it->second};
+                m_large_bufs.erase(it);
+                lock.unlock();
+                ::munmap(static_cast< void* >(b), sz);
+                return;
+            }
+        }
+        std::free(b);
+        return;
+    }
+
+    // Buffer goes back to the pool of the tag it was allocated with, which could differ from the tag it is freed with
+    const uint8_t cls{static_cast< uint8_t >((entry & 0xff) - 1)};
+    const auto pool_tag{static_cast< buftag >(entry >> 8)};
+    AlignedAllocator::metrics().decrement(tag, class_size(cls));
+
+    auto& bin{local_cache().bins[(size_t)pool_tag][cls]};
+    if (bin.size() >= cache_capacity(cls)) { flush(pool_tag, cls, bin, cache_capacity(cls) / 2); }
+    bin.push_back(b);
+}
+
+uint8_t* AlignedPoolAllocatorImpl::aligned_realloc(uint8_t* const old_buf, const size_t align, const size_t new_sz,
+                                                   const size_t old_sz) {
+    if (old_buf == nullptr) { return aligned_alloc(align, new_sz, buftag::common); }
+
+    const uint16_t entry{pagemap_get(old_buf)};
+    if (entry != 0) {
+        const size_t cur_size{class_size(static_cast< uint8_t >((entry & 0xff) - 1))};
+        if ((cur_size >= new_sz) && (align <= cur_size)) { return old_buf; }
+
+        uint8_t* const new_buf{aligned_alloc(align, new_sz, buftag::common)};
+        if (new_buf == nullptr) { return nullptr; }
+        std::memcpy(static_cast< void* >(new_buf), static_cast< const void* >(old_buf),
+                    (old_sz == 0) ? cur_size : std::min(old_sz, cur_size));
+        aligned_free(old_buf, buftag::common);
+        return new_buf;
+    }
+
+    if (align <= page_size()) {
+        std::unique_lock< std::mutex > lock{m_large_mtx};
+        if (const auto it{m_large_bufs.find(old_buf)}; it != m_large_bufs.end()) {
+            const size_t cur_size{it->second};
+            if (cur_size >= new_sz) { return old_buf; }
+
+            // Kernel either extends the mapping in place or moves the pages, either way there is no copy
+            const size_t remap_size{sisl::round_up(new_sz, page_size())};
+            void* const new_buf{::mremap(static_cast< void* >(old_buf), cur_size, remap_size, MREMAP_MAYMOVE)};
+            if (new_buf == MAP_FAILED) { return nullptr; }
+            m_large_bufs.erase(it);
+            m_large_bufs.emplace(static_cast< uint8_t* >(new_buf), remap_size);
+            lock.unlock();
+
+            m_metrics.large_remap();
+            AlignedAllocator::metrics().increment(buftag::common, remap_size - cur_size);
+            return static_cast< uint8_t* >(new_buf);
+        }
+    }
+
+    // Neither pooled nor large, so it is not ours; the default realloc handles it using our alloc/free
+    return AlignedAllocatorImpl::aligned_realloc(old_buf, align, new_sz, old_sz);
+}
+
+size_t AlignedPoolAllocatorImpl::buf_size(uint8_t* buf) const {
+    const uint16_t entry{pagemap_get(buf)};
+    if (entry != 0) { return class_size(static_cast< uint8_t >((entry & 0xff) - 1)); }
+    if (const size_t sz{large_size(buf)}; sz != 0) { return sz; }
+    return AlignedAllocatorImpl::buf_size(buf);
+}
+
+uint8_t AlignedPoolAllocatorImpl::size_class(const size_t sz, const size_t align) {
+    const size_t needed{std::max({sz, align, min_class_size})};
+    if (needed > max_class_size) { return num_classes; }
+
+    uint8_t cls{0};
+    while (class_size(cls) < needed) {
+        ++cls;
+    }
+    return cls;
+}
+
+size_t AlignedPoolAllocatorImpl::cache_capacity(const uint8_t cls) {
+    return std::clamp< size_t >(thread_cache_bytes / class_size(cls), 4, 64);
+}
+
+AlignedPoolAllocatorImpl::thread_cache& AlignedPoolAllocatorImpl::local_cache() {
+    if (sisl_unlikely(m_caches.get() == nullptr)) { m_caches.reset(new thread_cache(this)); }
+    return *m_caches;
+}
+
+uint8_t* AlignedPoolAllocatorImpl::refill(const buftag tag, const uint8_t cls, std::vector< uint8_t* >& bin) {
+    auto& d{m_depots[(size_t)tag][cls]};
+    std::unique_lock< std::mutex > lock{d.mtx};
+    if (d.bufs.empty()) {
+        uint8_t* const buf{carve(tag, cls, d)};
+        lock.unlock();
+        if (buf) { m_metrics.miss(tag); }
+        return buf;
+    }
+
+    // Take half a cache worth, so that a few more allocs or frees on this thread do not need the depot again
+    const size_t count{std::min(d.bufs.size(), cache_capacity(cls) / 2)};
+    bin.insert(bin.end(), d.bufs.end() - count, d.bufs.end());
+    d.bufs.resize(d.bufs.size() - count);
+    d.trimmed = std::min(d.trimmed, d.bufs.size());
+    lock.unlock();
+
+    m_metrics.depot_get();
+    m_metrics.hit(tag);
+    uint8_t* const buf{bin.back()};
+    bin.pop_back();
+    return buf;
+}
+
+void AlignedPoolAllocatorImpl::flush(const buftag tag, const uint8_t cls, std::vector< uint8_t* >& bin,
+                                     const size_t count) {
+    auto& d{m_depots[(size_t)tag][cls]};
+    {
+        std::scoped_lock< std::mutex > lock{d.mtx};
+        d.bufs.insert(d.bufs.end(), bin.end() - count, bin.end());
+    }
+    bin.resize(bin.size() - count);
+    m_metrics.depot_put();
+}
+
+size_t AlignedPoolAllocatorImpl::trim() {
+    size_t released{0};
+    const auto release{[&released](uint8_t* const start, uint8_t* const end) {
+        // Only whole pages can be released
+        auto* const first{
+            reinterpret_cast< uint8_t* >(sisl::round_up(reinterpret_cast< uintptr_t >(start), page_size()))};
+        if (first >= end) { return; }
+        const size_t len{sisl::round_down(static_cast< size_t >(end - first), page_size())};
+        if ((len > 0) && (::madvise(static_cast< void* >(first), len, MADV_DONTNEED) == 0)) { released += len; }
+    }};
+
+    for (auto& tag_depots : m_depots) {
+        for (uint8_t cls{0}; cls < num_classes; ++cls) {
+            auto& d{tag_depots[cls]};
+            std::scoped_lock< std::mutex > lock{d.mtx};
+            if (class_size(cls) >= page_size()) {
+                for (size_t i{d.trimmed}; i < d.bufs.size(); ++i) {
+                    release(d.bufs[i], d.bufs[i] + class_size(cls));
+                }
+                d.trimmed = d.bufs.size();
+            }
+            // Uncarved pages are refaulted, zero filled, once carved
+            if (d.carve_cur != d.carve_end) { release(d.carve_cur, d.carve_end); }
+        }
+    }
+    return released;
+}
+
+uint8_t* AlignedPoolAllocatorImpl::carve(const buftag tag, const uint8_t cls, depot& d) {
+    if (d.carve_cur == d.carve_end) {
+        auto* const chunk{static_cast< uint8_t* >(map_aligned_region(chunk_size, m_huge_pages))};
+        if (chunk == nullptr) { return nullptr; }
+        if (!pagemap_set(chunk, static_cast< uint16_t >(((uint16_t)tag << 8) | (cls + 1)))) {
+            ::munmap(static_cast< void* >(chunk), chunk_size);
+            return nullptr;
+        }
+        d.carve_cur = chunk;
+        d.carve_end = chunk + chunk_size;
+    }
+
+    uint8_t* const buf{d.carve_cur};
+    d.carve_cur += class_size(cls);
+    return buf;
+}
+
+uint16_t AlignedPoolAllocatorImpl::pagemap_get(const uint8_t* const buf) const {
+    const uintptr_t idx{reinterpret_cast< uintptr_t >(buf) >> chunk_shift};
+    if (sisl_unlikely((idx >> (pagemap_root_bits + pagemap_leaf_bits)) != 0)) { return 0; }
+
+    const pagemap_leaf_t* const leaf{m_pagemap[idx >> pagemap_leaf_bits].load(std::memory_order_acquire)};
+    if (leaf == nullptr) { return 0; }
+    return (*leaf)[idx & ((uintptr_t{1} << pagemap_leaf_bits) - 1)].load(std::memory_order_relaxed);
+}
+
+bool AlignedPoolAllocatorImpl::pagemap_set(const uint8_t* const chunk, const uint16_t entry) {
+    const uintptr_t idx{reinterpret_cast< uintptr_t >(chunk) >> chunk_shift};
+    if ((idx >> (pagemap_root_bits + pagemap_leaf_bits)) != 0) { return false; }
+
+    std::scoped_lock< std::mutex > lock{m_chunks_mtx};
+    auto& root_entry{m_pagemap[idx >> pagemap_leaf_bits]};
+    pagemap_leaf_t* leaf{root_entry.load(std::memory_order_relaxed)};
+    if (leaf == nullptr) {
+        leaf = new pagemap_leaf_t{};
+        root_entry.store(leaf, std::memory_order_release);
+    }
+    (*leaf)[idx & ((uintptr_t{1} << pagemap_leaf_bits) - 1)].store(entry, std::memory_order_relaxed);
+    m_chunks.push_back(const_cast< uint8_t* >(chunk));
+    return true;
+}
+
+uint8_t* AlignedPoolAllocatorImpl::large_alloc(const size_t sz) {
+    const size_t map_size{sisl::round_up(sz, page_size())};
+    void* const buf{::mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+    if (buf == MAP_FAILED) { return nullptr; }
+    if (m_huge_pages) { ::madvise(buf, map_size, MADV_HUGEPAGE); }
+
+    {
+        std::scoped_lock< std::mutex > lock{m_large_mtx};
+        m_large_bufs.emplace(static_cast< uint8_t* >(buf), map_size);
+    }
+    m_metrics.large_alloc();
+    return static_cast< uint8_t* >(buf);
+}
+
+size_t AlignedPoolAllocatorImpl::large_size(uint8_t* const buf) const {
+    std::scoped_lock< std::mutex > lock{m_large_mtx};
+    const auto it{m_large_bufs.find(buf)};
+    return (it == m_large_bufs.end()) ? 0 : it->second;
+}
+} // namespace sisl
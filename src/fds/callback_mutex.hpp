@@ -14,11 +14,10 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <functional>
-#include <vector>
-#include "sisl/fds/vector_pool.hpp"
-#include <folly/SharedMutex.h>
 #include <boost/tti/has_member_function.hpp>
 
 // Generate the metafunction
@@ -34,55 +33,147 @@ static constexpr bool unlock_shared_check = has_member_function_unlock_shared< T
 namespace sisl {
 using post_lock_cb_t = std::function< void(void) >;
 
+/**
+ * @brief Intrusive multi-producer single-consumer list of post lock callbacks.
+ *
+ * Waiters push nodes with a single CAS on the head. The consumer is always the thread holding the base mutex
+ * exclusively, so it can take the entire list in one exchange, which keeps the list free of ABA issues. Nodes are
+ * recycled through a small per thread cache of the draining thread. Hence a thread which both queues and drains does
+ * not allocate in steady state, but one which only ever waits (never unlocks while others are queued) allocates a
+ * node per wait, as its nodes end up in the caches of the draining threads.
+ */
 class _cb_wait_q {
+private:
+    struct cb_node {
+        post_lock_cb_t cb;
+        cb_node* next{nullptr};
+    };
+
+    struct node_cache {
+        static constexpr uint32_t max_cached_nodes{64};
+        cb_node* head{nullptr};
+        uint32_t count{0};
+
+        node_cache() = default;
+        node_cache(const node_cache&) = delete;
+        node_cache& operator=(const node_cache&) = delete;
+        ~node_cache() {
+            while (head) {
+                auto* const n{head};
+                head = n->next;
+                delete n;
+            }
+        }
+
+        cb_node* get() {
+            if (head == nullptr) { return new cb_node{}; }
+            auto* const n{head};
+            head = n->next;
+            --count;
+            return n;
+        }
+
+        void put(cb_node* n) {
+            n->cb = nullptr;
+            if (count == max_cached_nodes) {
+                delete n;
+                return;
+            }
+            n->next = head;
+            head = n;
+            ++count;
+        }
+    };
+
+    static node_cache& cache() {
+        static thread_local node_cache s_cache;
+        return s_cache;
+    }
+
 public:
     _cb_wait_q() = default;
-    ~_cb_wait_q() = default;
+    _cb_wait_q(const _cb_wait_q&) = delete;
+    _cb_wait_q& operator=(const _cb_wait_q&) = delete;
+    ~_cb_wait_q() {
+        // Callbacks still queued here were never given the lock, drop them
+        auto* n{m_head.exchange(nullptr, std::memory_order_acquire)};
+        while (n) {
+            auto* const next{n->next};
+            delete n;
+            n = next;
+        }
+    }
 
     void add_cb(post_lock_cb_t&& cb) {
-        folly::SharedMutexWritePriority::WriteHolder holder{m_waitq_lock};
-        if (m_wait_q == nullptr) { m_wait_q = sisl::VectorPool< post_lock_cb_t >::alloc(); }
-        m_wait_q->emplace_back(std::move(cb));
+        auto* const n{cache().get()};
+        n->cb = std::move(cb);
+        n->next = m_head.load(std::memory_order_relaxed);
+        while (!m_head.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed)) {}
     }
 
+    /**
+     * @brief Run all the callbacks queued so far, in the order they were queued. Must be called only by the thread
+     * holding the base mutex exclusively.
+     *
+     * @return true if any callback was run
+     */
     bool drain_cb() {
-        std::vector< post_lock_cb_t >* wait_q{nullptr};
-        {
-            folly::SharedMutexWritePriority::WriteHolder holder{m_waitq_lock};
-            std::swap(wait_q, m_wait_q);
+        auto* n{m_head.exchange(nullptr, std::memory_order_acquire)};
+        if (n == nullptr) { return false; }
+
+        // The list is in LIFO order, reverse it so that waiters get the lock in the order they asked for it
+        cb_node* fifo{nullptr};
+        while (n) {
+            auto* const next{n->next};
+            n->next = fifo;
+            fifo = n;
+            n = next;
         }
 
-        if (wait_q) {
-            for (const auto& cb : *wait_q) {
-                cb();
-            }
-            sisl::VectorPool< post_lock_cb_t >::free(wait_q);
+        auto& c{cache()};
+        while (fifo) {
+            auto* const next{fifo->next};
+            fifo->cb();
+            c.put(fifo);
+            fifo = next;
         }
-        return (wait_q != nullptr);
+        return true;
     }
 
-    bool empty() const {
-        folly::SharedMutexWritePriority::ReadHolder holder{m_waitq_lock};
-        return ((m_wait_q == nullptr) || (m_wait_q->empty()));
-    }
+    bool empty() const { return (m_head.load(std::memory_order_acquire) == nullptr); }
 
 private:
-    mutable folly::SharedMutexWritePriority m_waitq_lock;
-    std::vector< post_lock_cb_t >* m_wait_q{nullptr};
+    std::atomic< cb_node* > m_head{nullptr};
 };
 
+/**
+ * @brief Mutex whose lock attempts never block: a caller that cannot get the lock leaves behind a callback, which
+ * is run under the lock by whichever thread unlocks next.
+ *
+ * By default, unlock drains the callbacks queued at that point, releases the base mutex and then retries the lock
+ * for any waiters which queued meanwhile. With batch_handoff set, the unlocking thread keeps the lock and drains
+ * again until no waiter is left, so a burst of waiters is served by one lock holder without a release and
+ * reacquire of the base mutex between them.
+ */
 template < typename MutexImpl >
 class CallbackMutex {
 public:
-    explicit CallbackMutex() = default;
+    explicit CallbackMutex(bool batch_handoff = false) : m_batch_handoff{batch_handoff} {}
+    CallbackMutex(const CallbackMutex&) = delete;
+    CallbackMutex& operator=(const CallbackMutex&) = delete;
     ~CallbackMutex() = default;
 
+    /**
+     * @brief Run the callback under the lock, either right away or later from the thread which unlocks.
+     *
+     * @return true if the lock was acquired and is now held by the caller, who has to unlock it
+     */
     bool try_lock(post_lock_cb_t&& cb) {
         if (m_base_mutex.try_lock()) {
             cb();
             return true;
         }
-        m_q.add_cb(std::move(cb));
+        enqueue(std::move(cb));
         return false;
     }
 
@@ -92,51 +183,64 @@ public:
             cb();
             return true;
         }
-        m_q.add_cb(std::move(cb));
+        enqueue(std::move(cb));
         return false;
     }
 
-    bool unlock() {
-        auto drained = m_q.drain_cb();
-        m_base_mutex.unlock();
-        return drained;
-    }
+    bool unlock() { return drain_and_unlock(); }
 
     template < class I = MutexImpl >
     typename std::enable_if< unlock_shared_check< I >, void >::type unlock_shared() {
         m_base_mutex.unlock_shared();
-        if (!m_q.empty()) {
-            // If Q is not empty, try to lock the base mutex (which callers wait on) and if successful,
-            // we can drain the q. If unsuccessful, ignore it, because next unlock on elements in the q
-            // will do the same
-            if (m_base_mutex.try_lock()) {
-                m_q.drain_cb();
-                m_base_mutex.unlock();
-            }
-        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // If Q is not empty, try to lock the base mutex (which callers wait on) and if successful, we can drain the
+        // q. If unsuccessful, ignore it, because the current lock holder will drain it on its unlock
+        if (!m_q.empty() && m_base_mutex.try_lock()) { drain_and_unlock(); }
     }
 
     template < class I = MutexImpl >
     typename std::enable_if< !unlock_shared_check< I >, void >::type unlock_shared() {
-        m_base_mutex.unlock();
+        unlock();
     }
 
+    bool batch_handoff() const { return m_batch_handoff; }
+
     static constexpr bool shared_mode_supported = try_lock_shared_check< MutexImpl >;
-#if 0
-    template < class I = MutexImpl >
-    static constexpr typename std::enable_if< try_lock_shared_check< I >, bool >::type shared_mode_supported() {
-        return true;
+
+private:
+    void enqueue(post_lock_cb_t&& cb) {
+        m_q.add_cb(std::move(cb));
+
+        // The lock holder could have checked the q and unlocked just before the add, in which case nobody would
+        // run the callback. Retry the lock once, any holder seen from here on will find the callback on its unlock.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_base_mutex.try_lock()) { drain_and_unlock(); }
     }
 
-    template < class I = MutexImpl >
-    static constexpr typename std::enable_if< !try_lock_shared_check< I >, bool >::type shared_mode_supported() {
-        return false;
+    // Called with the base mutex held exclusively, returns with it released
+    bool drain_and_unlock() {
+        bool drained{false};
+        do {
+            if (m_batch_handoff) {
+                while (m_q.drain_cb()) {
+                    drained = true;
+                }
+            } else {
+                drained = m_q.drain_cb() || drained;
+            }
+            m_base_mutex.unlock();
+
+            // A waiter could have queued after the last drain but before the unlock, while it still failed to get
+            // the lock. Take the lock back and serve it, unless some other thread already got the lock.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        } while (!m_q.empty() && m_base_mutex.try_lock());
+        return drained;
     }
-#endif
 
 private:
     MutexImpl m_base_mutex;
     _cb_wait_q m_q;
+    const bool m_batch_handoff;
 };
 
 template < typename MutexImpl >
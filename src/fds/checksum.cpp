@@ -0,0 +1,287 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <array>
+#include <cstring>
+#include <future>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define XXH_STATIC_LINKING_ONLY
+#include <xxhash.h>
+
+#include "sisl/fds/checksum.hpp"
+
+namespace sisl {
+namespace {
+// All the polynomials below are in the reflected form, where bit 31 is the coefficient of x^0
+constexpr uint32_t crc32c_poly{0x82f63b78};
+
+constexpr std::array< std::array< uint32_t, 256 >, 8 > make_crc32c_tables() {
+    std::array< std::array< uint32_t, 256 >, 8 > tables{};
+    for (uint32_t i{0}; i < 256; ++i) {
+        uint32_t crc{i};
+        for (uint32_t b{0}; b < 8; ++b) {
+            crc = (crc & 1) ? ((crc >> 1) ^ crc32c_poly) : (crc >> 1);
+        }
+        tables[0][i] = crc;
+    }
+    // tables[k][i] is the crc of byte i followed by k zero bytes
+    for (uint32_t k{1}; k < 8; ++k) {
+        for (uint32_t i{0}; i < 256; ++i) {
+            tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xff];
+        }
+    }
+    return tables;
+}
+constexpr auto s_crc32c_tables{make_crc32c_tables()};
+
+// a(x) * b(x) modulo the crc polynomial
+constexpr uint32_t multmodp(uint32_t a, uint32_t b) {
+    uint32_t m{uint32_t{1} << 31};
+    uint32_t p{0};
+    while (true) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) { break; }
+        }
+        m >>= 1;
+        b = (b & 1) ? ((b >> 1) ^ crc32c_poly) : (b >> 1);
+    }
+    return p;
+}
+
+// x^n modulo the crc polynomial
+constexpr uint32_t xpow_mod(uint64_t n) {
+    uint32_t p{uint32_t{1} << 31}; // x^0
+    uint32_t sq{uint32_t{1} << 30}; // x^1, x^2, x^4 ...
+    while (n) {
+        if (n & 1) { p = multmodp(sq, p); }
+        sq = multmodp(sq, sq);
+        n >>= 1;
+    }
+    return p;
+}
+
+// s_x8pow2k[k] = x^(8 * 2^k), which shifts a crc by 2^k bytes
+constexpr std::array< uint32_t, 64 > make_x8pow2k() {
+    std::array< uint32_t, 64 > t{};
+    t[0] = xpow_mod(8);
+    for (uint32_t k{1}; k < 64; ++k) {
+        t[k] = multmodp(t[k - 1], t[k - 1]);
+    }
+    return t;
+}
+constexpr auto s_x8pow2k{make_x8pow2k()};
+
+uint32_t shift_sw(uint32_t crc, uint64_t len) {
+    for (uint32_t k{0}; len; ++k, len >>= 1) {
+        if (len & 1) { crc = multmodp(s_x8pow2k[k], crc); }
+    }
+    return crc;
+}
+
+uint64_t load_u64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+#if defined(__x86_64__)
+// Lengths (per stream) of the 3 way interleaved blocks; long blocks keep the merge cost negligible and short blocks
+// are for whatever remains
+constexpr size_t long_block{8192};
+constexpr size_t short_block{256};
+
+// Multiplying a crc by x^(8n - 32) with a carry-less multiply and reducing the 64 bit product with the crc32
+// instruction (which itself multiplies by x^32) shifts the crc by n bytes
+constexpr uint32_t s_long_shift{xpow_mod(8 * long_block - 32)};
+constexpr uint32_t s_short_shift{xpow_mod(8 * short_block - 32)};
+
+// s_hw_x8pow2k[k] = x^(8 * 2^k - 32) for k >= 2, to shift by any length in log steps
+constexpr std::array< uint32_t, 64 > make_hw_x8pow2k() {
+    std::array< uint32_t, 64 > t{};
+    for (uint32_t k{2}; k < 64; ++k) {
+        t[k] = (k == 2) ? xpow_mod(0) : multmodp(t[k - 1], s_x8pow2k[k - 1]);
+    }
+    return t;
+}
+constexpr auto s_hw_x8pow2k{make_hw_x8pow2k()};
+
+__attribute__((target("sse4.2,pclmul"))) inline uint32_t shift_hw(uint32_t crc, uint32_t xpow) {
+    const __m128i prod{_mm_clmulepi64_si128(_mm_cvtsi32_si128(static_cast< int >(crc)),
+                                            _mm_cvtsi32_si128(static_cast< int >(xpow)), 0)};
+    return static_cast< uint32_t >(_mm_crc32_u64(0, static_cast< uint64_t >(_mm_cvtsi128_si64(prod)) << 1));
+}
+
+__attribute__((target("sse4.2,pclmul"))) uint32_t shift_len_hw(uint32_t crc, uint64_t len) {
+    // Shift by less than 4 bytes is simply feeding zero bytes
+    for (uint64_t i{0}; i < (len & 3); ++i) {
+        crc = _mm_crc32_u8(crc, 0);
+    }
+    len >>= 2;
+    for (uint32_t k{2}; len; ++k, len >>= 1) {
+        if (len & 1) { crc = shift_hw(crc, s_hw_x8pow2k[k]); }
+    }
+    return crc;
+}
+
+template < size_t BlockLen >
+__attribute__((target("sse4.2,pclmul"))) inline uint64_t crc32c_3way(uint64_t crc, const uint8_t*& p, size_t& len,
+                                                                       const uint32_t shift) {
+    while (len >= 3 * BlockLen) {
+        uint64_t crc1{0};
+        uint64_t crc2{0};
+        for (const uint8_t* const end{p + BlockLen}; p < end; p += 8) {
+            crc = _mm_crc32_u64(crc, load_u64(p));
+            crc1 = _mm_crc32_u64(crc1, load_u64(p + BlockLen));
+            crc2 = _mm_crc32_u64(crc2, load_u64(p + 2 * BlockLen));
+        }
+        crc = shift_hw(static_cast< uint32_t >(crc), shift) ^ crc1;
+        crc = shift_hw(static_cast< uint32_t >(crc), shift) ^ crc2;
+        p += 2 * BlockLen;
+        len -= 3 * BlockLen;
+    }
+    return crc;
+}
+
+__attribute__((target("sse4.2,pclmul"))) uint32_t crc32c_hw(const void* data, size_t len, uint32_t crc) {
+    const auto* p{static_cast< const uint8_t* >(data)};
+    uint64_t c{~crc};
+    while (len && (reinterpret_cast< uintptr_t >(p) & 7)) {
+        c = _mm_crc32_u8(static_cast< uint32_t >(c), *p++);
+        --len;
+    }
+
+    c = crc32c_3way< long_block >(c, p, len, s_long_shift);
+    c = crc32c_3way< short_block >(c, p, len, s_short_shift);
+    for (; len >= 8; p += 8, len -= 8) {
+        c = _mm_crc32_u64(c, load_u64(p));
+    }
+    for (; len; --len) {
+        c = _mm_crc32_u8(static_cast< uint32_t >(c), *p++);
+    }
+    return ~static_cast< uint32_t >(c);
+}
+
+const bool s_has_hw_crc{__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul")};
+#endif
+} // namespace
+
+uint32_t crc32c_sw(const void* data, size_t len, uint32_t crc) {
+    const auto* p{static_cast< const uint8_t* >(data)};
+    const auto& t{s_crc32c_tables};
+    crc = ~crc;
+    while (len && (reinterpret_cast< uintptr_t >(p) & 7)) {
+        crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        --len;
+    }
+    for (; len >= 8; p += 8, len -= 8) {
+        const uint64_t w{load_u64(p) ^ crc};
+        crc = t[7][w & 0xff] ^ t[6][(w >> 8) & 0xff] ^ t[5][(w >> 16) & 0xff] ^ t[4][(w >> 24) & 0xff] ^
+            t[3][(w >> 32) & 0xff] ^ t[2][(w >> 40) & 0xff] ^ t[1][(w >> 48) & 0xff] ^ t[0][w >> 56];
+    }
+    for (; len; --len) {
+        crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t crc32c(const void* data, size_t len, uint32_t crc) {
+#if defined(__x86_64__)
+    if (s_has_hw_crc) { return crc32c_hw(data, len, crc); }
+#endif
+    return crc32c_sw(data, len, crc);
+}
+
+uint32_t crc32c(const sg_iovs_t& iovs, uint32_t crc) {
+    for (const auto& iov : iovs) {
+        crc = crc32c(iov.iov_base, iov.iov_len, crc);
+    }
+    return crc;
+}
+
+uint32_t crc32c(sg_iterator& it, uint64_t size, uint32_t crc) {
+    return crc32c(it.next_iovs(uint32_cast(size)), crc);
+}
+
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2) {
+    // Pre and post inversions of the two crcs cancel out, leaving crc1 * x^(8 * len2) + crc2
+#if defined(__x86_64__)
+    if (s_has_hw_crc) { return shift_len_hw(crc1, len2) ^ crc2; }
+#endif
+    return shift_sw(crc1, len2) ^ crc2;
+}
+
+uint32_t crc32c_parallel(const void* data, size_t len, uint32_t nchunks, uint32_t crc) {
+    const size_t chunk_size{sisl::round_up((len + nchunks - 1) / std::max(nchunks, 1u), 8)};
+    if ((nchunks <= 1) || (chunk_size >= len)) { return crc32c(data, len, crc); }
+
+    const auto* const p{static_cast< const uint8_t* >(data)};
+    std::vector< std::future< uint32_t > > futs;
+    for (size_t off{chunk_size}; off < len; off += chunk_size) {
+        futs.emplace_back(std::async(std::launch::async, [p, off, sz = std::min(chunk_size, len - off)]() {
+            return crc32c(p + off, sz, 0);
+        }));
+    }
+
+    crc = crc32c(p, chunk_size, crc);
+    size_t off{chunk_size};
+    for (auto& f : futs) {
+        const size_t sz{std::min(chunk_size, len - off)};
+        crc = crc32c_combine(crc, f.get(), sz);
+        off += sz;
+    }
+    return crc;
+}
+
+uint64_t xxh3_64(const void* data, size_t len, uint64_t seed) { return XXH3_64bits_withSeed(data, len, seed); }
+
+uint64_t xxh3_64(const sg_iovs_t& iovs, uint64_t seed) {
+    if (iovs.size() == 1) { return xxh3_64(iovs[0].iov_base, iovs[0].iov_len, seed); }
+    xxh3_64_hasher h{seed};
+    h.update(iovs);
+    return h.digest();
+}
+
+uint64_t xxh3_64(sg_iterator& it, uint64_t size, uint64_t seed) {
+    return xxh3_64(it.next_iovs(uint32_cast(size)), seed);
+}
+
+void xxh3_64_hasher::state_deleter::operator()(XXH3_state_s* state) const { XXH3_freeState(state); }
+
+xxh3_64_hasher::xxh3_64_hasher(uint64_t seed) : m_state{XXH3_createState()} {
+    if (m_state == nullptr) { throw std::bad_alloc(); }
+    reset(seed);
+}
+
+void xxh3_64_hasher::reset(uint64_t seed) { XXH3_64bits_reset_withSeed(m_state.get(), seed); }
+
+void xxh3_64_hasher::update(const void* data, size_t len) { XXH3_64bits_update(m_state.get(), data, len); }
+
+void xxh3_64_hasher::update(const sg_iovs_t& iovs) {
+    for (const auto& iov : iovs) {
+        update(iov.iov_base, iov.iov_len);
+    }
+}
+
+void xxh3_64_hasher::update(sg_iterator& it, uint64_t size) { update(it.next_iovs(uint32_cast(size))); }
+
+uint64_t xxh3_64_hasher::digest() const { return XXH3_64bits_digest(m_state.get()); }
+} // namespace sisl
@@ -0,0 +1,515 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Yaming Kuang
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cstring>
+#include <limits>
+
+#include <lz4.h>
+#include <zdict.h>
+#include <zstd.h>
+
+#include <sisl/utility/thread_factory.hpp>
+#include "sisl/fds/compress.hpp"
+
+namespace sisl {
+namespace {
+// Gives a contiguous view of the input, copying into the scratch buffer only if it is scattered
+const uint8_t* contiguous(const sg_iovs_t& src, size_t src_size, std::vector< uint8_t >& scratch) {
+    if (src.size() == 1) { return static_cast< const uint8_t* >(src[0].iov_base); }
+    scratch.resize(src_size);
+    size_t off{0};
+    for (const auto& iov : src) {
+        if (off == src_size) { break; }
+        const size_t sz{std::min(iov.iov_len, src_size - off)};
+        std::memcpy(scratch.data() + off, iov.iov_base, sz);
+        off += sz;
+    }
+    return scratch.data();
+}
+
+class NoneCodec : public CompressCodec {
+public:
+    compress_codec type() const override { return compress_codec::none; }
+    size_t max_compressed_len(size_t raw_size) const override { return raw_size; }
+
+    size_t compress(const sg_iovs_t& src, size_t src_size, uint8_t* dst, size_t dst_capacity) override {
+        if (dst_capacity < src_size) { throw compress_error("Output buffer is too small"); }
+        size_t off{0};
+        for (const auto& iov : src) {
+            if (off == src_size) { break; }
+            const size_t sz{std::min(iov.iov_len, src_size - off)};
+            std::memcpy(dst + off, iov.iov_base, sz);
+            off += sz;
+        }
+        return src_size;
+    }
+
+    void decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t raw_size) override {
+        if (src_size != raw_size) { throw compress_error("Stored frame size mismatch"); }
+        std::memcpy(dst, src, raw_size);
+    }
+};
+
+class SnappyCodec : public CompressCodec {
+public:
+    compress_codec type() const override { return compress_codec::snappy; }
+    size_t max_compressed_len(size_t raw_size) const override { return snappy_max_compressed_length(raw_size); }
+
+    size_t compress(const sg_iovs_t& src, size_t src_size, uint8_t* dst, size_t dst_capacity) override {
+        const auto* const in{contiguous(src, src_size, m_scratch)};
+        size_t out_len{dst_capacity};
+        if (snappy_compress(r_cast< const char* >(in), src_size, r_cast< char* >(dst), &out_len) != SNAPPY_OK) {
+            throw compress_error("snappy compression failed");
+        }
+        return out_len;
+    }
+
+    void decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t raw_size) override {
+        size_t out_len{raw_size};
+        if ((snappy_uncompress(r_cast< const char* >(src), src_size, r_cast< char* >(dst), &out_len) != SNAPPY_OK) ||
+            (out_len != raw_size)) {
+            throw compress_error("snappy decompression failed");
+        }
+    }
+
+private:
+    std::vector< uint8_t > m_scratch;
+};
+
+class LZ4Codec : public CompressCodec {
+public:
+    explicit LZ4Codec(int acceleration) :
+            m_acceleration{std::max(acceleration, 1)}, m_state(static_cast< size_t >(LZ4_sizeofState())) {}
+
+    compress_codec type() const override { return compress_codec::lz4; }
+    size_t max_compressed_len(size_t raw_size) const override {
+        return static_cast< size_t >(LZ4_compressBound(static_cast< int >(raw_size)));
+    }
+
+    size_t compress(const sg_iovs_t& src, size_t src_size, uint8_t* dst, size_t dst_capacity) override {
+        if (src_size > LZ4_MAX_INPUT_SIZE) { throw compress_error("Input too large for lz4"); }
+        const auto* const in{contiguous(src, src_size, m_scratch)};
+        const int ret{LZ4_compress_fast_extState(
+            m_state.data(), r_cast< const char* >(in), r_cast< char* >(dst), static_cast< int >(src_size),
+            static_cast< int >(std::min< size_t >(dst_capacity, std::numeric_limits< int >::max())), m_acceleration)};
+        if (ret <= 0) { throw compress_error("lz4 compression failed"); }
+        return static_cast< size_t >(ret);
+    }
+
+    void decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t raw_size) override {
+        const int ret{LZ4_decompress_safe(r_cast< const char* >(src), r_cast< char* >(dst),
+                                          static_cast< int >(src_size), static_cast< int >(raw_size))};
+        if (ret != static_cast< int >(raw_size)) { throw compress_error("lz4 decompression failed"); }
+    }
+
+private:
+    const int m_acceleration;
+    std::vector< char > m_state;
+    std::vector< uint8_t > m_scratch;
+};
+
+class ZstdCodec : public CompressCodec {
+public:
+    ZstdCodec(int level, std::shared_ptr< const compress_dictionary > dict) : m_dict{std::move(dict)} {
+        if (level == 0) { level = ZSTD_CLEVEL_DEFAULT; }
+        if ((m_cctx = ZSTD_createCCtx()) == nullptr) { throw std::bad_alloc(); }
+        if ((m_dctx = ZSTD_createDCtx()) == nullptr) { throw std::bad_alloc(); }
+        if (m_dict) {
+            // Digest the dictionary once, the contexts only refer to it on every frame
+            m_cdict = ZSTD_createCDict(m_dict->content().data(), m_dict->content().size(), level);
+            m_ddict = ZSTD_createDDict(m_dict->content().data(), m_dict->content().size());
+            if ((m_cdict == nullptr) || (m_ddict == nullptr)) { throw compress_error("Invalid zstd dictionary"); }
+            check(ZSTD_CCtx_refCDict(m_cctx, m_cdict));
+            check(ZSTD_DCtx_refDDict(m_dctx, m_ddict));
+        } else {
+            check(ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, level));
+        }
+        // Our frame header already has the raw size and the dictionary id, keep zstd frames lean
+        check(ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_contentSizeFlag, 0));
+        check(ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_dictIDFlag, 0));
+    }
+
+    ~ZstdCodec() override {
+        ZSTD_freeCCtx(m_cctx);
+        ZSTD_freeDCtx(m_dctx);
+        ZSTD_freeCDict(m_cdict);
+        ZSTD_freeDDict(m_ddict);
+    }
+
+    compress_codec type() const override { return compress_codec::zstd; }
+    uint32_t dict_id() const override { return m_dict ? m_dict->id() : 0; }
+    size_t max_compressed_len(size_t raw_size) const override { return ZSTD_compressBound(raw_size); }
+
+    size_t compress(const sg_iovs_t& src, size_t src_size, uint8_t* dst, size_t dst_capacity) override {
+        // Stream the iovs through the context, which saves coalescing the scattered input
+        check(ZSTD_CCtx_reset(m_cctx, ZSTD_reset_session_only));
+        check(ZSTD_CCtx_setPledgedSrcSize(m_cctx, src_size));
+        ZSTD_outBuffer out{dst, dst_capacity, 0};
+        size_t remain{src_size};
+        for (const auto& iov : src) {
+            if (remain == 0) { break; }
+            ZSTD_inBuffer in{iov.iov_base, std::min(iov.iov_len, remain), 0};
+            remain -= in.size;
+            while (in.pos < in.size) {
+                check(ZSTD_compressStream2(m_cctx, &out, &in, ZSTD_e_continue));
+                if ((in.pos < in.size) && (out.pos == out.size)) { throw compress_error("Output buffer too small"); }
+            }
+        }
+
+        ZSTD_inBuffer in{nullptr, 0, 0};
+        while (check(ZSTD_compressStream2(m_cctx, &out, &in, ZSTD_e_end)) != 0) {
+            if (out.pos == out.size) { throw compress_error("Output buffer too small"); }
+        }
+        return out.pos;
+    }
+
+    void decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t raw_size) override {
+        check(ZSTD_DCtx_reset(m_dctx, ZSTD_reset_session_only));
+        ZSTD_inBuffer in{src, src_size, 0};
+        ZSTD_outBuffer out{dst, raw_size, 0};
+        const size_t ret{check(ZSTD_decompressStream(m_dctx, &out, &in))};
+        if ((ret != 0) || (out.pos != raw_size)) { throw compress_error("zstd frame is truncated or corrupt"); }
+    }
+
+private:
+    static size_t check(size_t ret) {
+        if (ZSTD_isError(ret)) { throw compress_error(std::string{"zstd error: "} + ZSTD_getErrorName(ret)); }
+        return ret;
+    }
+
+private:
+    std::shared_ptr< const compress_dictionary > m_dict;
+    ZSTD_CCtx* m_cctx{nullptr};
+    ZSTD_DCtx* m_dctx{nullptr};
+    ZSTD_CDict* m_cdict{nullptr};
+    ZSTD_DDict* m_ddict{nullptr};
+};
+} // namespace
+
+/////////////////////////////////// compress_dictionary ///////////////////////////////////
+compress_dictionary::compress_dictionary(std::vector< uint8_t > content) :
+        m_content{std::move(content)}, m_id{ZDICT_getDictID(m_content.data(), m_content.size())} {
+    if (m_id == 0) { throw compress_error("Not a valid zstd dictionary"); }
+}
+
+std::shared_ptr< compress_dictionary > compress_dictionary::train(const std::vector< blob >& samples,
+                                                                  size_t max_size) {
+    std::vector< uint8_t > buf;
+    std::vector< size_t > sizes;
+    sizes.reserve(samples.size());
+    for (const auto& s : samples) {
+        buf.insert(buf.end(), s.cbytes(), s.cbytes() + s.size());
+        sizes.push_back(s.size());
+    }
+
+    std::vector< uint8_t > dict(max_size);
+    const size_t ret{ZDICT_trainFromBuffer(dict.data(), dict.size(), buf.data(), sizes.data(),
+                                           static_cast< unsigned >(sizes.size()))};
+    if (ZDICT_isError(ret)) {
+        throw compress_error(std::string{"Dictionary training failed: "} + ZDICT_getErrorName(ret));
+    }
+    dict.resize(ret);
+    return std::make_shared< compress_dictionary >(std::move(dict));
+}
+
+/////////////////////////////////// CompressCodec ///////////////////////////////////
+std::unique_ptr< CompressCodec > CompressCodec::make(compress_codec codec, int level,
+                                                     std::shared_ptr< const compress_dictionary > dict) {
+    switch (codec) {
+    case compress_codec::none:
+        return std::make_unique< NoneCodec >();
+    case compress_codec::snappy:
+        return std::make_unique< SnappyCodec >();
+    case compress_codec::lz4:
+        return std::make_unique< LZ4Codec >(level);
+    case compress_codec::zstd:
+        return std::make_unique< ZstdCodec >(level, std::move(dict));
+    default:
+        throw compress_error("Unknown compression codec " + std::to_string((int)codec));
+    }
+}
+
+/////////////////////////////////// CompressContext ///////////////////////////////////
+CompressContext::CompressContext(compress_codec codec, int level, std::shared_ptr< const compress_dictionary > dict) :
+        m_codec{codec}, m_level{level}, m_dict{std::move(dict)} {
+    codec_for(codec); // Create upfront, to catch invalid codec or dictionary here
+}
+
+CompressCodec& CompressContext::codec_for(compress_codec codec) {
+    if ((uint8_t)codec >= (uint8_t)compress_codec::sentinel) {
+        throw compress_error("Unknown compression codec " + std::to_string((int)codec));
+    }
+    auto& c{m_codecs[(size_t)codec]};
+    if (!c) { c = CompressCodec::make(codec, m_level, m_dict); }
+    return *c;
+}
+
+size_t CompressContext::max_frame_size(size_t raw_size) const {
+    return sizeof(compress_frame_header) + m_codecs[(size_t)m_codec]->max_compressed_len(raw_size);
+}
+
+size_t CompressContext::compress(const sg_list& src, uint8_t* dst, size_t dst_capacity) {
+    if (src.size > std::numeric_limits< uint32_t >::max()) { throw compress_error("Input too large to compress"); }
+    if (dst_capacity < max_frame_size(src.size)) { throw compress_error("Output buffer too small"); }
+
+    auto& codec{codec_for(m_codec)};
+    compress_frame_header hdr;
+    hdr.codec = m_codec;
+    hdr.dict_id = codec.dict_id();
+    hdr.raw_size = uint32_cast(src.size);
+    uint8_t* const payload{dst + sizeof(compress_frame_header)};
+    size_t payload_size{codec.compress(src.iovs, src.size, payload, dst_capacity - sizeof(compress_frame_header))};
+
+    // Incompressible data is stored as is, which also makes it faster to read
+    if (payload_size >= src.size) {
+        hdr.codec = compress_codec::none;
+        hdr.dict_id = 0;
+        payload_size = codec_for(compress_codec::none).compress(src.iovs, src.size, payload, src.size);
+    }
+    hdr.payload_size = uint32_cast(payload_size);
+    std::memcpy(dst, &hdr, sizeof(hdr));
+    return sizeof(compress_frame_header) + payload_size;
+}
+
+io_blob_safe CompressContext::compress(const sg_list& src, buftag tag) {
+    io_blob_safe frame{uint32_cast(max_frame_size(src.size)), 0, tag};
+    frame.set_size(uint32_cast(compress(src, frame.bytes(), frame.size())));
+    return frame;
+}
+
+io_blob_safe CompressContext::compress(const blob& src, buftag tag) {
+    return compress(sg_list{src.size(), {iovec{const_cast< uint8_t* >(src.cbytes()), src.size()}}}, tag);
+}
+
+compress_frame_header CompressContext::read_header(const blob& frame) {
+    compress_frame_header hdr;
+    if (frame.size() < sizeof(hdr)) { throw compress_error("Frame is smaller than its header"); }
+    std::memcpy(&hdr, frame.cbytes(), sizeof(hdr));
+    if (hdr.magic != compress_frame_header::MAGIC) { throw compress_error("Not a compressed frame"); }
+    if (hdr.version > compress_frame_header::VERSION) {
+        throw compress_error("Unsupported frame version " + std::to_string(hdr.version));
+    }
+    if (hdr.payload_size > frame.size() - sizeof(hdr)) { throw compress_error("Frame is truncated"); }
+    return hdr;
+}
+
+size_t CompressContext::decompress(const blob& frame, uint8_t* dst, size_t dst_capacity) {
+    const auto hdr{read_header(frame)};
+    if (dst_capacity < hdr.raw_size) { throw compress_error("Output buffer too small"); }
+
+    auto& codec{codec_for(hdr.codec)};
+    if (hdr.dict_id != codec.dict_id()) {
+        throw compress_error("Frame needs dictionary " + std::to_string(hdr.dict_id) + ", context has " +
+                             std::to_string(codec.dict_id()));
+    }
+    codec.decompress(frame.cbytes() + sizeof(hdr), hdr.payload_size, dst, hdr.raw_size);
+    return hdr.raw_size;
+}
+
+io_blob_safe CompressContext::decompress(const blob& frame, buftag tag) {
+    io_blob_safe raw{read_header(frame).raw_size, 0, tag};
+    decompress(frame, raw.bytes(), raw.size());
+    return raw;
+}
+
+/////////////////////////////////// ParallelCompressor ///////////////////////////////////
+ParallelCompressor::ParallelCompressor(compress_codec codec, int level, uint32_t nthreads, size_t chunk_size,
+                                       std::shared_ptr< const compress_dictionary > dict) :
+        m_chunk_size{chunk_size} {
+    if ((chunk_size == 0) || (chunk_size > std::numeric_limits< uint32_t >::max() / 2)) {
+        throw std::invalid_argument("Invalid compression chunk size " + std::to_string(chunk_size));
+    }
+    nthreads = std::max(nthreads, 1u);
+    for (uint32_t i{0}; i < nthreads; ++i) {
+        m_contexts.push_back(std::make_unique< CompressContext >(codec, level, dict));
+    }
+    for (uint32_t i{0}; i < nthreads - 1; ++i) {
+        m_workers.push_back(sisl::named_thread("compress_" + std::to_string(i),
+                                               [this, ctx = m_contexts[i].get()]() { worker_loop(*ctx); }));
+    }
+}
+
+ParallelCompressor::~ParallelCompressor() {
+    {
+        std::unique_lock lg{m_mtx};
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    for (auto& t : m_workers) {
+        t.join();
+    }
+}
+
+void ParallelCompressor::worker_loop(CompressContext& ctx) {
+    uint64_t seen_gen{0};
+    std::unique_lock lg{m_mtx};
+    while (true) {
+        m_cv.wait(lg, [this, &seen_gen]() {
+            return m_stopping || ((m_batch != nullptr) && (m_batch_gen != seen_gen));
+        });
+        if (m_stopping) { break; }
+
+        seen_gen = m_batch_gen;
+        batch& b{*m_batch};
+        ++b.users;
+        lg.unlock();
+        run_jobs(b, ctx);
+        lg.lock();
+        if (--b.users == 0) { m_done_cv.notify_all(); }
+    }
+}
+
+void ParallelCompressor::run_jobs(batch& b, CompressContext& ctx) {
+    for (uint32_t i{b.next.fetch_add(1)}; i < b.njobs; i = b.next.fetch_add(1)) {
+        try {
+            b.fn(ctx, i);
+        } catch (...) {
+            std::unique_lock lg{b.error_mtx};
+            if (!b.error) { b.error = std::current_exception(); }
+            b.next.store(b.njobs); // No point doing the rest
+        }
+    }
+}
+
+void ParallelCompressor::run_batch(uint32_t njobs, std::function< void(CompressContext&, uint32_t) > fn) {
+    if (njobs == 0) { return; }
+
+    std::unique_lock serial_lg{m_serial_mtx};
+    batch b;
+    b.fn = std::move(fn);
+    b.njobs = njobs;
+    if ((njobs > 1) && !m_workers.empty()) {
+        {
+            std::unique_lock lg{m_mtx};
+            m_batch = &b;
+            ++m_batch_gen;
+        }
+        m_cv.notify_all();
+    }
+
+    // Calling thread takes its share of the jobs, after which the batch is unpublished and we only need to wait for
+    // the workers still running the last of the jobs
+    run_jobs(b, *m_contexts.back());
+    {
+        std::unique_lock lg{m_mtx};
+        m_batch = nullptr;
+        m_done_cv.wait(lg, [&b]() { return b.users == 0; });
+    }
+    if (b.error) { std::rethrow_exception(b.error); }
+}
+
+io_blob_safe ParallelCompressor::compress(const sg_list& src, buftag tag) {
+    const uint32_t nchunks{uint32_cast((src.size + m_chunk_size - 1) / m_chunk_size)};
+    const size_t index_size{sizeof(chunked_frame_header) + (nchunks + 1) * sizeof(uint64_t)};
+    const size_t max_frame{m_contexts.back()->max_frame_size(m_chunk_size)};
+    const size_t bound{index_size + nchunks * max_frame};
+    if (bound > std::numeric_limits< uint32_t >::max()) { throw compress_error("Input too large to compress"); }
+
+    // Carve the input into chunks upfront, so that the jobs need not walk the sg list
+    std::vector< sg_list > chunks;
+    chunks.reserve(nchunks);
+    if (nchunks > 0) {
+        sg_iterator it{src.iovs};
+        for (uint32_t i{0}; i < nchunks; ++i) {
+            const size_t sz{std::min(m_chunk_size, src.size - i * m_chunk_size)};
+            chunks.push_back(sg_list{sz, it.next_iovs(uint32_cast(sz))});
+        }
+    }
+
+    // Every chunk is compressed into its worst case slot and the frames are then packed behind the index
+    io_blob_safe out{uint32_cast(bound), 0, tag};
+    uint8_t* const slots{out.bytes() + index_size};
+    std::vector< size_t > frame_sizes(nchunks);
+    run_batch(nchunks, [&chunks, &frame_sizes, slots, max_frame](CompressContext& ctx, uint32_t i) {
+        frame_sizes[i] = ctx.compress(chunks[i], slots + i * max_frame, max_frame);
+    });
+
+    uint8_t* const index{out.bytes() + sizeof(chunked_frame_header)};
+    uint64_t off{index_size};
+    for (uint32_t i{0}; i < nchunks; ++i) {
+        std::memcpy(index + i * sizeof(uint64_t), &off, sizeof(uint64_t));
+        uint8_t* const slot{slots + i * max_frame};
+        if (out.bytes() + off != slot) { std::memmove(out.bytes() + off, slot, frame_sizes[i]); }
+        off += frame_sizes[i];
+    }
+    std::memcpy(index + nchunks * sizeof(uint64_t), &off, sizeof(uint64_t));
+
+    chunked_frame_header hdr;
+    hdr.chunk_size = uint32_cast(m_chunk_size);
+    hdr.nchunks = nchunks;
+    hdr.raw_size = src.size;
+    std::memcpy(out.bytes(), &hdr, sizeof(hdr));
+    out.buf_realloc(off, 0, tag);
+    return out;
+}
+
+io_blob_safe ParallelCompressor::compress(const blob& src, buftag tag) {
+    return compress(sg_list{src.size(), {iovec{const_cast< uint8_t* >(src.cbytes()), src.size()}}}, tag);
+}
+
+chunked_frame_header ParallelCompressor::read_header(const blob& container) {
+    chunked_frame_header hdr;
+    if (container.size() < sizeof(hdr)) { throw compress_error("Container is smaller than its header"); }
+    std::memcpy(&hdr, container.cbytes(), sizeof(hdr));
+    if (hdr.magic != chunked_frame_header::MAGIC) { throw compress_error("Not a chunked compressed container"); }
+    if (hdr.version > chunked_frame_header::VERSION) {
+        throw compress_error("Unsupported container version " + std::to_string(hdr.version));
+    }
+    if ((hdr.chunk_size == 0) || ((hdr.raw_size + hdr.chunk_size - 1) / hdr.chunk_size != hdr.nchunks) ||
+        (container.size() < sizeof(hdr) + (uint64_t{hdr.nchunks} + 1) * sizeof(uint64_t))) {
+        throw compress_error("Container header is corrupt");
+    }
+    return hdr;
+}
+
+blob ParallelCompressor::chunk_frame(const blob& container, uint32_t chunk) {
+    const auto hdr{read_header(container)};
+    if (chunk >= hdr.nchunks) { throw std::out_of_range("Chunk is not in range"); }
+
+    uint64_t offs[2];
+    std::memcpy(offs, container.cbytes() + sizeof(hdr) + chunk * sizeof(uint64_t), sizeof(offs));
+    if ((offs[0] > offs[1]) || (offs[1] > container.size())) { throw compress_error("Container index is corrupt"); }
+    return blob{container.cbytes() + offs[0], uint32_cast(offs[1] - offs[0])};
+}
+
+size_t ParallelCompressor::decompress_chunk(CompressContext& ctx, const blob& container, uint32_t chunk, uint8_t* dst,
+                                            size_t dst_capacity) {
+    return ctx.decompress(chunk_frame(container, chunk), dst, dst_capacity);
+}
+
+size_t ParallelCompressor::decompress(const blob& container, uint8_t* dst, size_t dst_capacity) {
+    const auto hdr{read_header(container)};
+    if (dst_capacity < hdr.raw_size) { throw compress_error("Output buffer too small"); }
+
+    run_batch(hdr.nchunks, [&container, &hdr, dst](CompressContext& ctx, uint32_t i) {
+        const size_t off{size_t{i} * hdr.chunk_size};
+        const size_t expected{std::min< size_t >(hdr.chunk_size, hdr.raw_size - off)};
+        if (decompress_chunk(ctx, container, i, dst + off, expected) != expected) {
+            throw compress_error("Chunk " + std::to_string(i) + " is not of the expected size");
+        }
+    });
+    return hdr.raw_size;
+}
+
+io_blob_safe ParallelCompressor::decompress(const blob& container, buftag tag) {
+    const auto hdr{read_header(container)};
+    if (hdr.raw_size > std::numeric_limits< uint32_t >::max()) { throw compress_error("Container too large"); }
+    io_blob_safe raw{uint32_cast(hdr.raw_size), 0, tag};
+    decompress(container, raw.bytes(), raw.size());
+    return raw;
+}
+
+} // namespace sisl
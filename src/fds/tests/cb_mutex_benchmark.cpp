@@ -0,0 +1,116 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#include <folly/SharedMutex.h>
+#pragma GCC diagnostic pop
+#include "sisl/logging/logging.h"
+#include "sisl/options/options.h"
+
+#include "callback_mutex.hpp"
+
+SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
+
+namespace {
+// The earlier wait queue: a vector of callbacks behind a reader writer lock, kept here as the baseline
+class locked_vector_cb_mutex {
+public:
+    bool try_lock(sisl::post_lock_cb_t&& cb) {
+        if (m_base_mutex.try_lock()) {
+            cb();
+            return true;
+        }
+        std::unique_lock< folly::SharedMutexWritePriority > holder{m_waitq_lock};
+        m_wait_q.emplace_back(std::move(cb));
+        return false;
+    }
+
+    void unlock() {
+        std::vector< sisl::post_lock_cb_t > wait_q;
+        {
+            std::unique_lock< folly::SharedMutexWritePriority > holder{m_waitq_lock};
+            std::swap(wait_q, m_wait_q);
+        }
+        for (const auto& cb : wait_q) {
+            cb();
+        }
+        m_base_mutex.unlock();
+    }
+
+private:
+    std::mutex m_base_mutex;
+    folly::SharedMutexWritePriority m_waitq_lock;
+    std::vector< sisl::post_lock_cb_t > m_wait_q;
+};
+
+uint64_t g_protected_val{0};
+std::mutex g_plain_mtx;
+locked_vector_cb_mutex g_locked_vector_mtx;
+sisl::CallbackMutex< std::mutex > g_cb_mtx;
+sisl::CallbackMutex< std::mutex > g_cb_batch_mtx{true /* batch_handoff */};
+
+// Tiny critical section, so that the cost of the lock and the wait queue dominates
+void critical_section() { benchmark::DoNotOptimize(++g_protected_val); }
+
+void test_plain_mutex(benchmark::State& state) {
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        std::lock_guard< std::mutex > lg{g_plain_mtx};
+        critical_section();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void test_locked_vector_cb_mutex(benchmark::State& state) {
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        if (g_locked_vector_mtx.try_lock(critical_section)) { g_locked_vector_mtx.unlock(); }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void test_cb_mutex(benchmark::State& state) {
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        sisl::CBUniqueLock< std::mutex > h{g_cb_mtx, critical_section};
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void test_cb_mutex_batch_handoff(benchmark::State& state) {
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        sisl::CBUniqueLock< std::mutex > h{g_cb_batch_mtx, critical_section};
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+} // namespace
+
+// Each thread is a waiter whenever some other thread holds the lock
+#define WAITER_ARGS ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->Threads(16)->UseRealTime()
+BENCHMARK(test_plain_mutex) WAITER_ARGS;
+BENCHMARK(test_locked_vector_cb_mutex) WAITER_ARGS;
+BENCHMARK(test_cb_mutex) WAITER_ARGS;
+BENCHMARK(test_cb_mutex_batch_handoff) WAITER_ARGS;
+
+SISL_OPTIONS_ENABLE(logging)
+int main(int argc, char** argv) {
+    SISL_OPTIONS_LOAD(argc, argv, logging)
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,99 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "sisl/logging/logging.h"
+#include "sisl/options/options.h"
+
+#include "sisl/fds/checksum.hpp"
+
+SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
+
+namespace {
+constexpr size_t MAX_SIZE{16 * 1024 * 1024};
+constexpr uint32_t PARALLEL_CHUNKS{4};
+
+std::vector< uint8_t > make_data() {
+    std::vector< uint8_t > data(MAX_SIZE);
+    uint32_t x{0x12345678};
+    for (auto& b : data) {
+        x = x * 1103515245 + 12345;
+        b = static_cast< uint8_t >(x >> 16);
+    }
+    return data;
+}
+const std::vector< uint8_t > s_data{make_data()};
+
+// Byte at a time table lookup, the way crc is usually hand rolled, as a baseline
+uint32_t crc32c_bytewise(const uint8_t* p, size_t len) {
+    static const auto table{[]() {
+        std::array< uint32_t, 256 > t{};
+        for (uint32_t i{0}; i < 256; ++i) {
+            uint32_t crc{i};
+            for (uint32_t b{0}; b < 8; ++b) {
+                crc = (crc & 1) ? ((crc >> 1) ^ 0x82f63b78) : (crc >> 1);
+            }
+            t[i] = crc;
+        }
+        return t;
+    }()};
+    uint32_t crc{~uint32_t{0}};
+    while (len--) {
+        crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+template < typename F >
+void run_checksum(benchmark::State& state, F&& f) {
+    const size_t size{static_cast< size_t >(state.range(0))};
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        benchmark::DoNotOptimize(f(s_data.data(), size));
+    }
+    state.SetBytesProcessed(static_cast< int64_t >(state.iterations() * size));
+}
+
+void test_crc32c_bytewise(benchmark::State& state) { run_checksum(state, crc32c_bytewise); }
+void test_crc32c_sw(benchmark::State& state) {
+    run_checksum(state, [](const uint8_t* p, size_t len) { return sisl::crc32c_sw(p, len); });
+}
+void test_crc32c(benchmark::State& state) {
+    run_checksum(state, [](const uint8_t* p, size_t len) { return sisl::crc32c(p, len); });
+}
+void test_crc32c_parallel(benchmark::State& state) {
+    run_checksum(state, [](const uint8_t* p, size_t len) { return sisl::crc32c_parallel(p, len, PARALLEL_CHUNKS); });
+}
+void test_xxh3_64(benchmark::State& state) {
+    run_checksum(state, [](const uint8_t* p, size_t len) { return sisl::xxh3_64(p, len); });
+}
+} // namespace
+
+BENCHMARK(test_crc32c_bytewise)->RangeMultiplier(16)->Range(4096, MAX_SIZE);
+BENCHMARK(test_crc32c_sw)->RangeMultiplier(16)->Range(4096, MAX_SIZE);
+BENCHMARK(test_crc32c)->RangeMultiplier(16)->Range(4096, MAX_SIZE);
+BENCHMARK(test_crc32c_parallel)->RangeMultiplier(16)->Range(1024 * 1024, MAX_SIZE)->UseRealTime();
+BENCHMARK(test_xxh3_64)->RangeMultiplier(16)->Range(4096, MAX_SIZE);
+
+SISL_OPTIONS_ENABLE(logging)
+int main(int argc, char** argv) {
+    SISL_OPTIONS_LOAD(argc, argv, logging)
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,97 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Yaming Kuang
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "sisl/logging/logging.h"
+#include "sisl/options/options.h"
+
+#include "sisl/fds/compress.hpp"
+
+SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
+
+namespace {
+constexpr size_t DATA_SIZE{64 * 1024 * 1024};
+
+// Semi compressible data, somewhat like a checkpoint of metadata records
+std::vector< uint8_t > make_data() {
+    std::vector< uint8_t > data;
+    data.reserve(DATA_SIZE);
+    uint32_t x{0x12345678};
+    for (uint64_t id{0}; data.size() < DATA_SIZE; ++id) {
+        x = x * 1103515245 + 12345;
+        const std::string rec{"{\"id\":" + std::to_string(id) + ",\"lsn\":" + std::to_string(x) +
+                              ",\"blkid\":" + std::to_string(x >> 7) + ",\"state\":\"committed\"}"};
+        data.insert(data.end(), rec.begin(), rec.end());
+    }
+    data.resize(DATA_SIZE);
+    return data;
+}
+const std::vector< uint8_t > s_data{make_data()};
+const sisl::blob s_blob{s_data.data(), uint32_cast(s_data.size())};
+
+void run_compress(benchmark::State& state, sisl::compress_codec codec) {
+    sisl::ParallelCompressor pc{codec, 0, uint32_cast(state.range(0))};
+    size_t compressed{0};
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        const auto container{pc.compress(s_blob)};
+        compressed = container.size();
+    }
+    state.SetBytesProcessed(static_cast< int64_t >(state.iterations() * DATA_SIZE));
+    state.counters["ratio"] = static_cast< double >(DATA_SIZE) / compressed;
+}
+
+void run_decompress(benchmark::State& state, sisl::compress_codec codec) {
+    sisl::ParallelCompressor pc{codec, 0, uint32_cast(state.range(0))};
+    const auto container{pc.compress(s_blob)};
+    std::vector< uint8_t > out(DATA_SIZE);
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        benchmark::DoNotOptimize(pc.decompress(container, out.data(), out.size()));
+    }
+    state.SetBytesProcessed(static_cast< int64_t >(state.iterations() * DATA_SIZE));
+}
+
+// Baseline of compressing the whole buffer as one frame on the calling thread
+void test_single_frame_lz4(benchmark::State& state) {
+    sisl::CompressContext ctx{sisl::compress_codec::lz4};
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        const auto frame{ctx.compress(s_blob)};
+        benchmark::DoNotOptimize(frame.cbytes());
+    }
+    state.SetBytesProcessed(static_cast< int64_t >(state.iterations() * DATA_SIZE));
+}
+
+void test_compress_lz4(benchmark::State& state) { run_compress(state, sisl::compress_codec::lz4); }
+void test_compress_zstd(benchmark::State& state) { run_compress(state, sisl::compress_codec::zstd); }
+void test_decompress_lz4(benchmark::State& state) { run_decompress(state, sisl::compress_codec::lz4); }
+void test_decompress_zstd(benchmark::State& state) { run_decompress(state, sisl::compress_codec::zstd); }
+} // namespace
+
+BENCHMARK(test_single_frame_lz4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(test_compress_lz4)->Arg(1)->Arg(4)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(test_compress_zstd)->Arg(1)->Arg(4)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(test_decompress_lz4)->Arg(1)->Arg(4)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(test_decompress_zstd)->Arg(1)->Arg(4)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+SISL_OPTIONS_ENABLE(logging)
+int main(int argc, char** argv) {
+    SISL_OPTIONS_LOAD(argc, argv, logging)
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -14,9 +14,12 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <vector>
 
 #include <benchmark/benchmark.h>
@@ -55,8 +58,91 @@ void test_concurrent_vector_insert(benchmark::State& state) {
     }
 }
 
+static constexpr uint64_t NUM_ITER_ENTRIES = 4 * 1024 * 1024;
+static constexpr uint32_t NUM_INSERT_THREADS = 4;
+
+// Fill a vector from a few threads, so that iteration has to go across thread buffers
+static std::unique_ptr< sisl::ConcurrentInsertVector< uint64_t > > filled_vector() {
+    auto cvec = std::make_unique< sisl::ConcurrentInsertVector< uint64_t > >();
+    std::vector< std::thread > threads;
+    for (uint32_t t{0}; t < NUM_INSERT_THREADS; ++t) {
+        threads.emplace_back([&cvec, t]() {
+            for (uint64_t i{t}; i < NUM_ITER_ENTRIES; i += NUM_INSERT_THREADS) {
+                cvec->push_back(i);
+            }
+        });
+    }
+    for (auto& thr : threads) {
+        thr.join();
+    }
+    return cvec;
+}
+
+void test_concurrent_vector_foreach(benchmark::State& state) {
+    auto cvec = filled_vector();
+    for (auto _ : state) { // Loops upto iteration count
+        uint64_t sum{0};
+        cvec->foreach_entry([&sum](uint64_t const& e) { sum += e; });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(static_cast< int64_t >(state.iterations() * NUM_ITER_ENTRIES));
+}
+
+void test_concurrent_vector_parallel_foreach(benchmark::State& state) {
+    auto cvec = filled_vector();
+    auto const ntasks = static_cast< uint32_t >(state.range(0));
+    for (auto _ : state) { // Loops upto iteration count
+        std::atomic< uint64_t > sum{0};
+        std::vector< std::thread > workers;
+        cvec->parallel_foreach([&workers](std::function< void() > task) { workers.emplace_back(std::move(task)); },
+                               [&sum](uint64_t const& e) {
+                                   if (e % 1024 == 0) { sum.fetch_add(e, std::memory_order_relaxed); }
+                               },
+                               ntasks);
+        for (auto& w : workers) {
+            w.join();
+        }
+        benchmark::DoNotOptimize(sum.load());
+    }
+    state.SetItemsProcessed(static_cast< int64_t >(state.iterations() * NUM_ITER_ENTRIES));
+}
+
+// Handing over all the entries to a consumer: copying them out vs draining the chunks
+void test_concurrent_vector_copy_out(benchmark::State& state) {
+    for (auto _ : state) { // Loops upto iteration count
+        state.PauseTiming();
+        auto cvec = filled_vector();
+        state.ResumeTiming();
+        std::vector< uint64_t > out;
+        cvec->foreach_entry([&out](uint64_t const& e) { out.push_back(e); });
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(static_cast< int64_t >(state.iterations() * NUM_ITER_ENTRIES));
+}
+
+void test_concurrent_vector_drain(benchmark::State& state) {
+    for (auto _ : state) { // Loops upto iteration count
+        state.PauseTiming();
+        auto cvec = filled_vector();
+        state.ResumeTiming();
+        auto chunks = cvec->drain();
+        benchmark::DoNotOptimize(chunks.data());
+    }
+    state.SetItemsProcessed(static_cast< int64_t >(state.iterations() * NUM_ITER_ENTRIES));
+}
+
 BENCHMARK(test_locked_vector_insert)->Threads(NUM_THREADS);
 BENCHMARK(test_concurrent_vector_insert)->Threads(NUM_THREADS);
+BENCHMARK(test_concurrent_vector_foreach)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(test_concurrent_vector_parallel_foreach)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(test_concurrent_vector_copy_out)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(test_concurrent_vector_drain)->Unit(benchmark::kMillisecond)->UseRealTime();
 
 int main(int argc, char** argv) {
     int parsed_argc{argc};
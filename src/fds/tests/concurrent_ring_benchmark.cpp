@@ -0,0 +1,152 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <boost/lockfree/queue.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include "sisl/logging/logging.h"
+#include "sisl/options/options.h"
+
+#include "sisl/fds/concurrent_ring.hpp"
+
+SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
+
+namespace {
+constexpr size_t RING_SIZE{4096};
+constexpr uint64_t ITERATIONS_PER_PRODUCER{200000};
+constexpr size_t BATCH_SIZE{16};
+
+// Adapters giving every queue the same single entry and batch interface
+template < typename RingT >
+struct ring_adapter {
+    RingT q{RING_SIZE};
+    bool push(uint64_t v) { return q.try_push(v); }
+    bool pop(uint64_t& v) { return q.try_pop(v); }
+    size_t push_n(uint64_t* vals, size_t n) { return q.push_n(vals, n); }
+    size_t pop_n(uint64_t* vals, size_t n) { return q.pop_n(vals, n); }
+};
+
+struct boost_mpmc_adapter {
+    boost::lockfree::queue< uint64_t, boost::lockfree::capacity< RING_SIZE - 1 > > q;
+    bool push(uint64_t v) { return q.bounded_push(v); }
+    bool pop(uint64_t& v) { return q.pop(v); }
+    size_t push_n(uint64_t* vals, size_t n) {
+        size_t i{0};
+        while ((i < n) && q.bounded_push(vals[i])) {
+            ++i;
+        }
+        return i;
+    }
+    size_t pop_n(uint64_t* vals, size_t n) {
+        size_t i{0};
+        while ((i < n) && q.pop(vals[i])) {
+            ++i;
+        }
+        return i;
+    }
+};
+
+struct boost_spsc_adapter {
+    boost::lockfree::spsc_queue< uint64_t, boost::lockfree::capacity< RING_SIZE > > q;
+    bool push(uint64_t v) { return q.push(v); }
+    bool pop(uint64_t& v) { return q.pop(v); }
+    size_t push_n(uint64_t* vals, size_t n) { return q.push(vals, n); }
+    size_t pop_n(uint64_t* vals, size_t n) { return q.pop(vals, n); }
+};
+
+/**
+ * range(0) producers each push ITERATIONS_PER_PRODUCER entries, while range(1) consumers pop them all. With batch
+ * set, both sides move BATCH_SIZE entries at a time.
+ */
+template < typename Adapter, bool Batch >
+void run_queue(benchmark::State& state) {
+    const auto nproducers{static_cast< uint32_t >(state.range(0))};
+    const auto nconsumers{static_cast< uint32_t >(state.range(1))};
+    const uint64_t total{nproducers * ITERATIONS_PER_PRODUCER};
+
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        auto adapter{std::make_unique< Adapter >()};
+        std::atomic< uint64_t > consumed{0};
+        std::vector< std::thread > threads;
+
+        for (uint32_t p{0}; p < nproducers; ++p) {
+            threads.emplace_back([&adapter]() {
+                uint64_t vals[BATCH_SIZE]{};
+                for (uint64_t i{0}; i < ITERATIONS_PER_PRODUCER;) {
+                    const size_t n{Batch ? adapter->push_n(&vals[0], std::min(BATCH_SIZE, ITERATIONS_PER_PRODUCER - i))
+                                         : (adapter->push(i) ? 1u : 0u)};
+                    if (n == 0) { std::this_thread::yield(); }
+                    i += n;
+                }
+            });
+        }
+        for (uint32_t c{0}; c < nconsumers; ++c) {
+            threads.emplace_back([&adapter, &consumed, total]() {
+                uint64_t vals[BATCH_SIZE];
+                while (consumed.load(std::memory_order_relaxed) < total) {
+                    const size_t n{Batch ? adapter->pop_n(&vals[0], BATCH_SIZE) : (adapter->pop(vals[0]) ? 1u : 0u)};
+                    if (n == 0) {
+                        std::this_thread::yield();
+                    } else {
+                        consumed.fetch_add(n, std::memory_order_relaxed);
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+    state.SetItemsProcessed(static_cast< int64_t >(state.iterations() * total));
+}
+
+void test_mpmc_ring(benchmark::State& state) { run_queue< ring_adapter< sisl::MPMCRing< uint64_t > >, false >(state); }
+void test_mpmc_ring_batch(benchmark::State& state) {
+    run_queue< ring_adapter< sisl::MPMCRing< uint64_t > >, true >(state);
+}
+void test_boost_queue(benchmark::State& state) { run_queue< boost_mpmc_adapter, false >(state); }
+void test_boost_queue_batch(benchmark::State& state) { run_queue< boost_mpmc_adapter, true >(state); }
+
+void test_spsc_ring(benchmark::State& state) { run_queue< ring_adapter< sisl::SPSCRing< uint64_t > >, false >(state); }
+void test_spsc_ring_batch(benchmark::State& state) {
+    run_queue< ring_adapter< sisl::SPSCRing< uint64_t > >, true >(state);
+}
+void test_boost_spsc_queue(benchmark::State& state) { run_queue< boost_spsc_adapter, false >(state); }
+void test_boost_spsc_queue_batch(benchmark::State& state) { run_queue< boost_spsc_adapter, true >(state); }
+} // namespace
+
+#define MPMC_ARGS ->Args({1, 1})->Args({2, 2})->Args({4, 4})->Args({4, 1})->Args({1, 4})->UseRealTime()
+BENCHMARK(test_mpmc_ring) MPMC_ARGS;
+BENCHMARK(test_mpmc_ring_batch) MPMC_ARGS;
+BENCHMARK(test_boost_queue) MPMC_ARGS;
+BENCHMARK(test_boost_queue_batch) MPMC_ARGS;
+
+BENCHMARK(test_spsc_ring)->Args({1, 1})->UseRealTime();
+BENCHMARK(test_spsc_ring_batch)->Args({1, 1})->UseRealTime();
+BENCHMARK(test_boost_spsc_queue)->Args({1, 1})->UseRealTime();
+BENCHMARK(test_boost_spsc_queue_batch)->Args({1, 1})->UseRealTime();
+
+SISL_OPTIONS_ENABLE(logging)
+int main(int argc, char** argv) {
+    SISL_OPTIONS_LOAD(argc, argv, logging)
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+}
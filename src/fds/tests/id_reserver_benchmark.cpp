@@ -0,0 +1,69 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "sisl/logging/logging.h"
+#include "sisl/options/options.h"
+
+#include "sisl/fds/id_reserver.hpp"
+
+SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
+
+namespace {
+constexpr uint32_t LIVE_IDS{1000000};
+constexpr size_t ITERATIONS{1000000};
+constexpr uint32_t THREAD_CACHE_IDS{64};
+
+std::unique_ptr< sisl::IDReserver > s_reserver;
+
+// Keep LIVE_IDS reserved throughout and measure a reserve + unreserve pair on top of it
+void run_reserve_unreserve(benchmark::State& state, uint32_t thread_cache_ids) {
+    if (state.thread_index() == 0) {
+        s_reserver = std::make_unique< sisl::IDReserver >(LIVE_IDS, thread_cache_ids);
+        std::vector< uint32_t > ids;
+        s_reserver->reserve_bulk(LIVE_IDS, ids);
+        // Free every 16th id so that searches have holes to find all over the id space
+        for (uint32_t i{0}; i < LIVE_IDS; i += 16) {
+            s_reserver->unreserve(ids[i]);
+        }
+    }
+
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        uint32_t id;
+        benchmark::DoNotOptimize(id = s_reserver->reserve());
+        s_reserver->unreserve(id);
+    }
+
+    if (state.thread_index() == 0) { s_reserver.reset(); }
+}
+
+void test_reserve(benchmark::State& state) { run_reserve_unreserve(state, 0); }
+void test_reserve_thread_cache(benchmark::State& state) { run_reserve_unreserve(state, THREAD_CACHE_IDS); }
+} // namespace
+
+BENCHMARK(test_reserve)->Iterations(ITERATIONS)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(test_reserve_thread_cache)->Iterations(ITERATIONS)->ThreadRange(1, 64)->UseRealTime();
+
+SISL_OPTIONS_ENABLE(logging)
+int main(int argc, char** argv) {
+    SISL_OPTIONS_LOAD(argc, argv, logging)
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+}
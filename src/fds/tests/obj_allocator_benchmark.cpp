@@ -14,12 +14,16 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <array>
 #include <cstdint>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <mutex>
 #include <random>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 #include "sisl/logging/logging.h"
@@ -35,6 +39,9 @@ namespace {
 std::mutex s_print_mutex;
 constexpr size_t ITERATIONS{10000000};
 constexpr size_t THREADS{8};
+constexpr size_t XFER_ITERATIONS{2000000};
+constexpr size_t XFER_BATCH{64};
+constexpr size_t XFER_MAX_QUEUED_BATCHES{64};
 
 struct my_request {
     int m_a;
@@ -85,10 +92,108 @@ void test_obj_alloc(benchmark::State& state) {
         std::cout << "Counter = " << counter << std::endl;
     }
 }
+
+void test_obj_alloc_slab(benchmark::State& state) {
+    typedef sisl::ObjectAllocator< my_request, sisl::FREELIST_CACHE_COUNT, sisl::FreeListSlabBacking<> > allocator_t;
+    uint64_t counter{0};
+    static thread_local std::random_device rd{};
+    static thread_local std::default_random_engine engine{rd()};
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        my_request* req;
+        benchmark::DoNotOptimize(req = allocator_t::make_object());
+        req->m_a = 10;
+        req->m_b[0] = 100;
+        std::uniform_int_distribution< uint64_t > dist{0, RAND_MAX};
+        req->m_d = req->m_a * dist(engine);
+        counter += req->m_d;
+        allocator_t::deallocate(req);
+    }
+
+    {
+        std::scoped_lock< std::mutex > lock{s_print_mutex};
+        std::cout << "Counter = " << counter << std::endl;
+    }
+}
+
+// Producer/consumer pattern: even threads only allocate and hand the objects in batches to their paired odd thread,
+// which only frees them. Without the depot, the freed objects pile up on the consumers and producers always miss.
+struct xfer_queue {
+    std::mutex mtx;
+    std::deque< std::vector< my_request* > > batches;
+};
+std::array< xfer_queue, THREADS / 2 > s_xfer_queues;
+
+template < typename AllocFn, typename FreeFn >
+void run_producer_consumer(benchmark::State& state, const AllocFn& alloc_fn, const FreeFn& free_fn) {
+    auto& q{s_xfer_queues[state.thread_index() / 2]};
+    const bool producer{(state.thread_index() % 2) == 0};
+    std::vector< my_request* > batch;
+    batch.reserve(XFER_BATCH);
+
+    for ([[maybe_unused]] auto si : state) { // Loops up to iteration count
+        if (producer) {
+            my_request* req;
+            benchmark::DoNotOptimize(req = alloc_fn());
+            req->m_a = 10;
+            batch.push_back(req);
+            if (batch.size() == XFER_BATCH) {
+                while (true) {
+                    {
+                        std::scoped_lock< std::mutex > lock{q.mtx};
+                        if (q.batches.size() < XFER_MAX_QUEUED_BATCHES) {
+                            q.batches.push_back(std::move(batch));
+                            break;
+                        }
+                    }
+                    std::this_thread::yield();
+                }
+                batch = std::vector< my_request* >{};
+                batch.reserve(XFER_BATCH);
+            }
+        } else {
+            while (batch.empty()) {
+                {
+                    std::scoped_lock< std::mutex > lock{q.mtx};
+                    if (!q.batches.empty()) {
+                        batch = std::move(q.batches.front());
+                        q.batches.pop_front();
+                        break;
+                    }
+                }
+                std::this_thread::yield();
+            }
+            free_fn(batch.back());
+            batch.pop_back();
+        }
+    }
+}
+
+void test_malloc_producer_consumer(benchmark::State& state) {
+    run_producer_consumer(
+        state, []() { return new my_request(); }, [](my_request* const req) { delete (req); });
+}
+
+void test_obj_alloc_producer_consumer(benchmark::State& state) {
+    run_producer_consumer(
+        state, []() { return sisl::ObjectAllocator< my_request >::make_object(); },
+        [](my_request* const req) { sisl::ObjectAllocator< my_request >::deallocate(req); });
+}
+
+void test_obj_alloc_slab_producer_consumer(benchmark::State& state) {
+    typedef sisl::ObjectAllocator< my_request, sisl::FREELIST_CACHE_COUNT, sisl::FreeListSlabBacking<> > allocator_t;
+    run_producer_consumer(
+        state, []() { return allocator_t::make_object(); },
+        [](my_request* const req) { allocator_t::deallocate(req); });
+}
 } // namespace
 
 BENCHMARK(test_malloc)->Iterations(ITERATIONS)->Threads(THREADS);
 BENCHMARK(test_obj_alloc)->Iterations(ITERATIONS)->Threads(THREADS);
+BENCHMARK(test_obj_alloc_slab)->Iterations(ITERATIONS)->Threads(THREADS);
+static_assert((XFER_ITERATIONS % XFER_BATCH) == 0, "Consumers need to get every batch the producers allocate");
+BENCHMARK(test_malloc_producer_consumer)->Iterations(XFER_ITERATIONS)->Threads(THREADS)->UseRealTime();
+BENCHMARK(test_obj_alloc_producer_consumer)->Iterations(XFER_ITERATIONS)->Threads(THREADS)->UseRealTime();
+BENCHMARK(test_obj_alloc_slab_producer_consumer)->Iterations(XFER_ITERATIONS)->Threads(THREADS)->UseRealTime();
 
 SISL_OPTIONS_ENABLE(logging)
 int main(int argc, char** argv) {
@@ -0,0 +1,228 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <sisl/logging/logging.h>
+#include <sisl/options/options.h>
+
+#include <gtest/gtest.h>
+
+#include "sisl/fds/aligned_pool_allocator.hpp"
+
+SISL_LOGGING_INIT(test_aligned_pool_allocator)
+SISL_OPTIONS_ENABLE(logging, test_aligned_pool_allocator)
+SISL_OPTION_GROUP(test_aligned_pool_allocator,
+                  (num_threads, "", "num_threads", "number of threads",
+                   ::cxxopts::value< uint32_t >()->default_value("8"), "number"))
+
+namespace {
+bool is_aligned(const uint8_t* const buf, const size_t align) {
+    return (reinterpret_cast< uintptr_t >(buf) % align) == 0;
+}
+} // namespace
+
+class AlignedPoolAllocatorTest : public testing::Test {
+protected:
+    std::unique_ptr< sisl::AlignedPoolAllocatorImpl > m_pool;
+
+    void SetUp() override { m_pool = std::make_unique< sisl::AlignedPoolAllocatorImpl >(); }
+    void TearDown() override { m_pool.reset(); }
+};
+
+TEST_F(AlignedPoolAllocatorTest, SizeClassesAndAlignment) {
+    const std::vector< std::pair< size_t, size_t > > reqs{{100, 512},    {512, 512},    {513, 512},
+                                                          {4096, 4096},  {5000, 4096},  {8192, 512},
+                                                          {65536, 4096}, {1024 * 1024, 4096}};
+    for (const auto& [sz, align] : reqs) {
+        uint8_t* const buf{m_pool->aligned_alloc(align, sz, sisl::buftag::common)};
+        ASSERT_NE(buf, nullptr);
+        ASSERT_TRUE(is_aligned(buf, align)) << "size=" << sz << " align=" << align;
+        const size_t bsize{m_pool->buf_size(buf)};
+        ASSERT_GE(bsize, sz);
+        ASSERT_EQ(bsize & (bsize - 1), 0) << "Pooled buffer size is not a power of 2";
+        ASSERT_TRUE(is_aligned(buf, bsize)) << "Pooled buffer is not aligned to its size class";
+        std::memset(buf, 0xab, sz);
+        m_pool->aligned_free(buf, sisl::buftag::common);
+    }
+}
+
+TEST_F(AlignedPoolAllocatorTest, ReuseFromThreadCache) {
+    uint8_t* const buf1{m_pool->aligned_alloc(4096, 4096, sisl::buftag::logread)};
+    m_pool->aligned_free(buf1, sisl::buftag::logread);
+    uint8_t* const buf2{m_pool->aligned_alloc(4096, 4096, sisl::buftag::logread)};
+    ASSERT_EQ(buf1, buf2) << "Freed buffer is expected to be reused by the next alloc of same class";
+
+    // Different tags are pooled separately
+    uint8_t* const buf3{m_pool->aligned_alloc(4096, 4096, sisl::buftag::logwrite)};
+    ASSERT_NE(buf2, buf3);
+    m_pool->aligned_free(buf2, sisl::buftag::logread);
+    m_pool->aligned_free(buf3, sisl::buftag::logwrite);
+}
+
+TEST_F(AlignedPoolAllocatorTest, CrossThreadFreeGoesThroughDepot) {
+    constexpr size_t count{1000};
+    std::vector< uint8_t* > bufs;
+    for (size_t i{0}; i < count; ++i) {
+        bufs.push_back(m_pool->aligned_alloc(4096, 8192, sisl::buftag::data_journal));
+    }
+    const std::set< uint8_t* > allocated{bufs.cbegin(), bufs.cend()};
+    ASSERT_EQ(allocated.size(), count);
+
+    // Free on another thread, which has to hand over the buffers to depot
+    std::thread t{[this, &bufs]() {
+        for (auto* const b : bufs) {
+            m_pool->aligned_free(b, sisl::buftag::data_journal);
+        }
+    }};
+    t.join();
+
+    // Allocating thread should now get back the same buffers instead of carving new ones
+    size_t reused{0};
+    std::vector< uint8_t* > again;
+    for (size_t i{0}; i < count; ++i) {
+        again.push_back(m_pool->aligned_alloc(4096, 8192, sisl::buftag::data_journal));
+        if (allocated.count(again.back())) { ++reused; }
+    }
+    ASSERT_EQ(reused, count);
+    for (auto* const b : again) {
+        m_pool->aligned_free(b, sisl::buftag::data_journal);
+    }
+}
+
+TEST_F(AlignedPoolAllocatorTest, TrimReleasesDepotPages) {
+    constexpr size_t count{100};
+    constexpr size_t sz{64 * 1024};
+    std::vector< uint8_t* > bufs;
+    for (size_t i{0}; i < count; ++i) {
+        bufs.push_back(m_pool->aligned_alloc(4096, sz, sisl::buftag::common));
+        std::memset(bufs.back(), 0xab, sz);
+    }
+
+    // Thread cache holds upto 2MB worth of 64K buffers, the rest overflow to the depot which trim releases
+    for (auto* const b : bufs) {
+        m_pool->aligned_free(b, sisl::buftag::common);
+    }
+    ASSERT_GE(m_pool->trim(), (count / 2) * sz);
+
+    // Already released buffers are not counted again
+    ASSERT_LT(m_pool->trim(), (count / 2) * sz);
+
+    // Trimmed buffers are still usable
+    for (auto*& b : bufs) {
+        b = m_pool->aligned_alloc(4096, sz, sisl::buftag::common);
+        ASSERT_NE(b, nullptr);
+        std::memset(b, 0xcd, sz);
+    }
+    for (auto* const b : bufs) {
+        m_pool->aligned_free(b, sisl::buftag::common);
+    }
+}
+
+TEST_F(AlignedPoolAllocatorTest, Realloc) {
+    // Pooled buffer grows within its class without moving
+    uint8_t* buf{m_pool->aligned_alloc(512, 3000, sisl::buftag::common)};
+    std::memset(buf, 0x11, 3000);
+    ASSERT_EQ(m_pool->aligned_realloc(buf, 512, 4096, 3000), buf);
+
+    // Moves to a larger class with contents intact
+    uint8_t* const moved{m_pool->aligned_realloc(buf, 512, 16384, 4096)};
+    ASSERT_NE(moved, nullptr);
+    for (size_t i{0}; i < 3000; ++i) {
+        ASSERT_EQ(moved[i], 0x11);
+    }
+
+    // Large buffers are remapped
+    buf = m_pool->aligned_realloc(moved, 4096, 2 * sisl::AlignedPoolAllocatorImpl::max_class_size, 16384);
+    ASSERT_NE(buf, nullptr);
+    ASSERT_TRUE(is_aligned(buf, 4096));
+    std::memset(buf, 0x22, 2 * sisl::AlignedPoolAllocatorImpl::max_class_size);
+    uint8_t* const grown{m_pool->aligned_realloc(buf, 4096, 8 * sisl::AlignedPoolAllocatorImpl::max_class_size)};
+    ASSERT_NE(grown, nullptr);
+    ASSERT_GE(m_pool->buf_size(grown), 8 * sisl::AlignedPoolAllocatorImpl::max_class_size);
+    for (size_t i{0}; i < 2 * sisl::AlignedPoolAllocatorImpl::max_class_size; i += 4096) {
+        ASSERT_EQ(grown[i], 0x22);
+    }
+    m_pool->aligned_free(grown, sisl::buftag::common);
+}
+
+TEST_F(AlignedPoolAllocatorTest, ForeignBufferFree) {
+    auto* const buf{static_cast< uint8_t* >(std::aligned_alloc(4096, 8192))};
+    m_pool->aligned_free(buf, sisl::buftag::common);
+}
+
+TEST_F(AlignedPoolAllocatorTest, MultiThreaded) {
+    const uint32_t nthreads{SISL_OPTIONS["num_threads"].as< uint32_t >()};
+    std::vector< std::thread > threads;
+    for (uint32_t t{0}; t < nthreads; ++t) {
+        threads.emplace_back([this, t]() {
+            std::default_random_engine engine{t};
+            std::uniform_int_distribution< size_t > size_dist{1, 256 * 1024};
+            std::vector< std::pair< uint8_t*, size_t > > live;
+            for (uint32_t i{0}; i < 20000; ++i) {
+                if (live.empty() || (engine() % 2)) {
+                    const size_t sz{size_dist(engine)};
+                    uint8_t* const buf{m_pool->aligned_alloc(512, sz, sisl::buftag::btree_node)};
+                    ASSERT_NE(buf, nullptr);
+                    std::memset(buf, static_cast< int >(t), sz);
+                    live.emplace_back(buf, sz);
+                } else {
+                    const auto [buf, sz]{live.back()};
+                    live.pop_back();
+                    ASSERT_EQ(buf[0], static_cast< uint8_t >(t));
+                    ASSERT_EQ(buf[sz - 1], static_cast< uint8_t >(t));
+                    m_pool->aligned_free(buf, sisl::buftag::btree_node);
+                }
+            }
+            for (const auto& [buf, sz] : live) {
+                m_pool->aligned_free(buf, sisl::buftag::btree_node);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+TEST(AlignedPoolAllocator, InstalledAsAllocator) {
+    sisl::AlignedAllocator::instance().set_allocator(new sisl::AlignedPoolAllocatorImpl());
+    {
+        sisl::io_blob blob{16384, 4096, sisl::buftag::metablk};
+        ASSERT_TRUE(is_aligned(blob.bytes(), 4096));
+        blob.buf_realloc(32768, 4096, sisl::buftag::metablk);
+        ASSERT_EQ(blob.size(), 32768u);
+        blob.buf_free(sisl::buftag::metablk);
+    }
+    sisl::AlignedAllocator::instance().set_allocator(new sisl::AlignedAllocatorImpl());
+}
+
+int main(int argc, char* argv[]) {
+    int parsed_argc{argc};
+    ::testing::InitGoogleTest(&parsed_argc, argv);
+    SISL_OPTIONS_LOAD(parsed_argc, argv, logging, test_aligned_pool_allocator);
+    sisl::logging::SetLogger("test_aligned_pool_allocator");
+    spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
+
+    const auto ret{RUN_ALL_TESTS()};
+    return ret;
+}
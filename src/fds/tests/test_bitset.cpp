@@ -14,6 +14,7 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <random>
@@ -329,6 +330,148 @@ TEST_F(BitsetTest, TestSetCount) {
     ASSERT_EQ(m_bset.get_set_count(), g_total_bits - 6 * word_size - word_size / 2);
 }
 
+TEST_F(BitsetTest, TestBitwiseOps) {
+    const auto word_size{m_bset.word_size()};
+    sisl::ThreadSafeBitset other{m_total_bits};
+    m_bset.set_bits(0, 4 * word_size);
+    other.set_bits(2 * word_size, 4 * word_size);
+
+    // counts do not modify
+    ASSERT_EQ(m_bset.get_and_count(other), static_cast< uint64_t >(2 * word_size));
+    ASSERT_EQ(m_bset.get_or_count(other), static_cast< uint64_t >(6 * word_size));
+    ASSERT_EQ(m_bset.get_xor_count(other), static_cast< uint64_t >(4 * word_size));
+    ASSERT_EQ(m_bset.get_andnot_count(other), static_cast< uint64_t >(2 * word_size));
+    ASSERT_EQ(m_bset.get_and_count(other, word_size / 2, 5 * word_size / 2 - 1),
+              static_cast< uint64_t >(word_size / 2));
+    ASSERT_EQ(m_bset.get_set_count(), static_cast< uint64_t >(4 * word_size));
+
+    // partial range or with unaligned boundaries
+    m_bset.or_with(other, 5 * word_size + 3, 6 * word_size - 4);
+    ASSERT_EQ(m_bset.get_set_count(), static_cast< uint64_t >(5 * word_size - 6));
+    ASSERT_TRUE(m_bset.is_bits_set(5 * word_size + 3, word_size - 6));
+    ASSERT_TRUE(m_bset.is_bits_reset(4 * word_size, word_size + 3));
+
+    m_bset.andnot_with(other);
+    ASSERT_EQ(m_bset.get_set_count(), static_cast< uint64_t >(2 * word_size));
+    ASSERT_TRUE(m_bset.is_bits_set(0, 2 * word_size));
+
+    // differing shrink offsets between the two bitsets
+    other.shrink_head(word_size + 5);
+    ShadowBitset shadow_other;
+    for (uint64_t bit{0}; bit < m_total_bits; ++bit) {
+        m_shadow_bm.set(m_bset.get_bitval(bit), bit);
+    }
+    for (uint64_t bit{0}; bit < other.size(); ++bit) {
+        shadow_other.set(other.get_bitval(bit), bit);
+    }
+    m_bset.xor_with(other);
+    for (uint64_t bit{0}; bit < other.size(); ++bit) {
+        ASSERT_EQ(m_bset.get_bitval(bit), m_shadow_bm.is_set(bit) != shadow_other.is_set(bit)) << "bit=" << bit;
+    }
+    for (uint64_t bit{other.size()}; bit < m_total_bits; ++bit) {
+        ASSERT_EQ(m_bset.get_bitval(bit), m_shadow_bm.is_set(bit)) << "bit=" << bit;
+    }
+
+    // self ops
+    m_bset.and_with(m_bset);
+    ASSERT_EQ(m_bset.get_xor_count(m_bset), static_cast< uint64_t >(0));
+    m_bset.xor_with(m_bset);
+    ASSERT_EQ(m_bset.get_set_count(), static_cast< uint64_t >(0));
+}
+
+TEST_F(BitsetTest, TestBitwiseOpsConcurrentSetBit) {
+    // or_with of even bits racing with set_bit of odd bits on the same words must not lose any of them
+    constexpr uint64_t nbits{256};
+    sisl::AtomicBitset even{nbits};
+    for (uint64_t bit{0}; bit < nbits; bit += 2) {
+        even.set_bit(bit);
+    }
+
+    for (uint32_t round{0}; round < 200; ++round) {
+        sisl::AtomicBitset abset{nbits};
+        std::atomic< bool > done{false};
+        std::thread setter{[&abset, &done]() {
+            for (uint64_t bit{1}; bit < nbits; bit += 2) {
+                abset.set_bit(bit);
+            }
+            done.store(true);
+        }};
+        while (!done.load()) {
+            abset.or_with(even);
+        }
+        setter.join();
+        abset.or_with(even);
+        ASSERT_EQ(abset.get_set_count(), nbits) << "round=" << round;
+    }
+}
+
+TEST_F(BitsetTest, TestRankSelect) {
+    fill_random(0, m_total_bits);
+    shrink_head(m_bset.word_size() + 3);
+
+    auto validate = [this]() {
+        uint64_t n{0};
+        for (uint64_t bit{0}; bit < m_total_bits; ++bit) {
+            ASSERT_EQ(m_bset.rank(bit), n) << "rank mismatch for bit=" << bit;
+            if (m_shadow_bm.is_set(bit)) {
+                ASSERT_EQ(m_bset.select(n), bit) << "select mismatch for n=" << n;
+                ++n;
+            }
+        }
+        ASSERT_EQ(m_bset.rank(m_total_bits), n);
+        ASSERT_EQ(m_bset.select(n), Bitset::npos);
+    };
+
+    validate();
+    reset(0, 2 * m_bset.word_size());
+    set(m_total_bits / 2, 10);
+    validate();
+
+    // a moved bitset rebuilds its own directory
+    ThreadSafeBitset moved{std::move(m_bset)};
+    ASSERT_EQ(moved.rank(m_total_bits), moved.get_set_count());
+}
+
+TEST_F(BitsetTest, TestRankSelectConcurrentReaders) {
+    fill_random(0, m_total_bits);
+    const uint64_t total{m_bset.get_set_count()};
+
+    std::vector< std::thread > readers;
+    for (uint32_t t{0}; t < 4; ++t) {
+        readers.emplace_back([this, total]() {
+            for (uint32_t i{0}; i < 100; ++i) {
+                ASSERT_EQ(m_bset.rank(m_total_bits), total);
+                if (total > 0) { ASSERT_EQ(m_bset.rank(m_bset.select(total - 1)), total - 1); }
+            }
+        });
+    }
+    for (auto& t : readers) {
+        t.join();
+    }
+}
+
+TEST_F(BitsetTest, TestRankSelectConcurrentWriter) {
+    // rank racing with set_bits must not keep a table built from the words before the write, once it returns
+    constexpr uint64_t nbits{64 * 1024 * 1024}; // Large enough for the reader to run amid set_bits
+    for (uint32_t round{0}; round < 10; ++round) {
+        sisl::AtomicBitset abset{nbits};
+        std::atomic< bool > reading{false};
+        std::atomic< bool > done{false};
+        std::thread reader{[&abset, &reading, &done]() {
+            while (!done.load()) {
+                [[maybe_unused]] const auto rank{abset.rank(nbits)};
+                reading.store(true);
+            }
+        }};
+        while (!reading.load()) {}
+        abset.set_bits(0, nbits / 2);
+        done.store(true);
+        reader.join();
+        ASSERT_EQ(abset.rank(nbits), nbits / 2) << "round=" << round;
+        ASSERT_EQ(abset.select(nbits / 2 - 1), nbits / 2 - 1) << "round=" << round;
+    }
+}
+
 TEST_F(BitsetTest, TestGetWordValue) {
     // use pointer constructor
     constexpr std::array< uint8_t, 16 > bits1{0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
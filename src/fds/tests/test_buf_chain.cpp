@@ -0,0 +1,173 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <sisl/logging/logging.h>
+#include <sisl/options/options.h>
+
+#include <gtest/gtest.h>
+
+#include "sisl/fds/buffer.hpp"
+
+SISL_LOGGING_INIT(test_buf_chain)
+SISL_OPTIONS_ENABLE(logging, test_buf_chain)
+
+namespace {
+sisl::byte_view make_view(const std::string& s) {
+    sisl::byte_view v{static_cast< uint32_t >(s.size())};
+    std::memcpy(const_cast< uint8_t* >(v.bytes()), s.data(), s.size());
+    return v;
+}
+
+std::string to_string(const sisl::buf_chain& chain) {
+    std::string ret;
+    for (const auto& seg : chain) {
+        ret += seg.get_string();
+    }
+    return ret;
+}
+} // namespace
+
+TEST(BufChain, AppendPrepend) {
+    sisl::buf_chain chain;
+    ASSERT_TRUE(chain.empty());
+    chain.append(make_view("world"));
+    chain.prepend(make_view("hello "));
+    chain.append(make_view("!"));
+    for (uint32_t i{0}; i < 10; ++i) {
+        chain.prepend(make_view(std::to_string(i)));
+    }
+    ASSERT_EQ(to_string(chain), "9876543210hello world!");
+    ASSERT_EQ(chain.size(), 22u);
+    ASSERT_EQ(chain.num_segments(), 13u);
+
+    sisl::buf_chain other{make_view(" and more")};
+    chain.append(std::move(other));
+    ASSERT_TRUE(other.empty());
+    ASSERT_EQ(to_string(chain), "9876543210hello world! and more");
+}
+
+TEST(BufChain, SplitAndTrimDoNotCopy) {
+    const auto v1{make_view("abcdef")};
+    const auto v2{make_view("ghijkl")};
+    sisl::buf_chain chain;
+    chain.append(v1);
+    chain.append(v2);
+
+    auto head{chain.split(8)};
+    ASSERT_EQ(to_string(head), "abcdefgh");
+    ASSERT_EQ(to_string(chain), "ijkl");
+    ASSERT_EQ(head.front().bytes(), v1.bytes());
+    ASSERT_EQ(head.back().bytes(), v2.bytes());
+    ASSERT_EQ(chain.front().bytes(), v2.bytes() + 2);
+
+    head.trim_front(3);
+    head.trim_back(2);
+    ASSERT_EQ(to_string(head), "def");
+    ASSERT_EQ(head.size(), 3u);
+    ASSERT_EQ(head.front().bytes(), v1.bytes() + 3);
+
+    head.trim_back(3);
+    ASSERT_TRUE(head.empty());
+    ASSERT_EQ(head.num_segments(), 0u);
+    chain.trim_front(4);
+    ASSERT_TRUE(chain.empty());
+}
+
+TEST(BufChain, TrimAfterSplitAndTrimBack) {
+    // Head of a split ends before its underlying array does
+    sisl::buf_chain chain{make_view("abcdef")};
+    auto head{chain.split(2)};
+    head.trim_front(1);
+    ASSERT_EQ(to_string(head), "b");
+    ASSERT_EQ(to_string(chain), "cdef");
+
+    // So does a segment shortened by trim_back
+    chain.trim_back(1);
+    chain.trim_front(1);
+    ASSERT_EQ(to_string(chain), "de");
+    auto rest{chain.split(1)};
+    ASSERT_EQ(to_string(rest), "d");
+    ASSERT_EQ(to_string(chain), "e");
+}
+
+TEST(BufChain, AppendAndTrimFrontAsQueue) {
+    sisl::buf_chain chain;
+    for (uint32_t i{0}; i < 10000; ++i) {
+        chain.append(make_view(std::to_string(i % 10)));
+        if (i >= 2) { chain.trim_front(1); }
+    }
+    ASSERT_EQ(to_string(chain), "89");
+    chain.clear();
+
+    for (uint32_t i{0}; i < 100; ++i) {
+        chain.append(make_view(std::to_string(i % 10)));
+        if (i % 2) { chain.trim_front(1); }
+    }
+    chain.prepend(make_view("p"));
+    ASSERT_EQ(chain.num_segments(), 51u);
+    ASSERT_EQ(to_string(chain).substr(0, 3), "p01");
+}
+
+TEST(BufChain, IovsAndSgIterator) {
+    sisl::buf_chain chain;
+    chain.append(make_view("0123"));
+    chain.append(make_view("45"));
+    chain.append(make_view("6789"));
+
+    const auto sgs{chain.to_sg_list()};
+    ASSERT_EQ(sgs.size, 10u);
+    ASSERT_EQ(sgs.iovs.size(), 3u);
+    ASSERT_EQ(sgs.iovs[1].iov_len, 2u);
+
+    sisl::sg_iterator it{chain};
+    const auto iovs{it.next_iovs(5)};
+    ASSERT_EQ(iovs.size(), 2u);
+    ASSERT_EQ(iovs[0].iov_len, 4u);
+    ASSERT_EQ(iovs[1].iov_len, 1u);
+    it.move_offset(3);
+    const auto rest{it.next_iovs(10)};
+    ASSERT_EQ(rest.size(), 1u);
+    ASSERT_EQ(std::string(static_cast< const char* >(rest[0].iov_base), rest[0].iov_len), "89");
+}
+
+TEST(BufChain, Coalesce) {
+    sisl::buf_chain chain{make_view("single")};
+    const auto* const orig{chain.front().bytes()};
+    ASSERT_EQ(chain.coalesce().bytes(), orig) << "Single segment chain should not be copied";
+
+    chain.append(make_view(" and"));
+    chain.prepend(make_view("not "));
+    const auto v{chain.coalesce(512)};
+    ASSERT_EQ(v.get_string(), "not single and");
+    ASSERT_EQ(reinterpret_cast< uintptr_t >(v.bytes()) % 512, 0u);
+    ASSERT_EQ(chain.num_segments(), 1u);
+    ASSERT_EQ(to_string(chain), "not single and");
+}
+
+int main(int argc, char* argv[]) {
+    int parsed_argc{argc};
+    ::testing::InitGoogleTest(&parsed_argc, argv);
+    SISL_OPTIONS_LOAD(parsed_argc, argv, logging);
+    sisl::logging::SetLogger("test_buf_chain");
+    spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
+
+    const auto ret{RUN_ALL_TESTS()};
+    return ret;
+}
@@ -14,7 +14,9 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <vector>
 #include <shared_mutex>
@@ -38,34 +40,30 @@ static uint64_t g_cur_val{1};
 template < typename MutexImpl >
 class CBMutexTest : public testing::Test {
 protected:
-    sisl::CallbackMutex< MutexImpl > m_cb_mtx;
+    std::unique_ptr< sisl::CallbackMutex< MutexImpl > > m_cb_mtx;
+    std::atomic< uint64_t > m_unique_cbs{0};
+    std::atomic< uint64_t > m_shared_cbs{0};
 
 protected:
     void thread_unique_fn(uint64_t count_per_thread) {
-        uint64_t count{0};
         for (uint64_t i{0}; i < count_per_thread; ++i) {
-            sisl::CBUniqueLock< MutexImpl > h(m_cb_mtx, [&count]() {
+            sisl::CBUniqueLock< MutexImpl > h(*m_cb_mtx, [this]() {
                 assert((g_prev_val + 1) == g_cur_val);
                 g_prev_val = g_cur_val++;
-                ++count;
+                m_unique_cbs.fetch_add(1, std::memory_order_relaxed);
             });
         }
-
-        LOGINFO("Thread attempted {} of exclusive callbacks", count);
     }
 
     template < typename I = MutexImpl >
     typename std::enable_if< sisl::CallbackMutex< I >::shared_mode_supported, void >::type
     thread_shared_fn(uint64_t count_per_thread) {
-        uint64_t count{0};
         for (uint64_t i{0}; i < count_per_thread; ++i) {
-            sisl::CBSharedLock< MutexImpl > h(m_cb_mtx, [&count]() {
+            sisl::CBSharedLock< MutexImpl > h(*m_cb_mtx, [this]() {
                 assert((g_prev_val + 1) == g_cur_val);
-                ++count;
+                m_shared_cbs.fetch_add(1, std::memory_order_relaxed);
             });
         }
-
-        LOGINFO("Thread attempted {} of shared callbacks", count);
     }
 
     template < typename I = MutexImpl >
@@ -73,10 +71,14 @@ protected:
         assert(0);
     }
 
-    void run_lock_unlock() {
+    void run_lock_unlock(bool batch_handoff) {
         auto num_threads = SISL_OPTIONS["num_threads"].as< uint32_t >();
         auto num_iters = sisl::round_up(SISL_OPTIONS["num_iters"].as< uint64_t >(), num_threads);
 
+        m_cb_mtx = std::make_unique< sisl::CallbackMutex< MutexImpl > >(batch_handoff);
+        m_unique_cbs.store(0);
+        m_shared_cbs.store(0);
+
         uint32_t unique_threads{num_threads};
         uint32_t shared_threads{0};
         if (sisl::CallbackMutex< MutexImpl >::shared_mode_supported) {
@@ -96,8 +98,12 @@ protected:
         }
         for (auto& t : threads) {
             t.join();
-            // delete (t);
         }
+
+        // Every callback, whether run right away or queued behind a lock holder, has to be run exactly once
+        LOGINFO("Ran {} exclusive and {} shared callbacks", m_unique_cbs.load(), m_shared_cbs.load());
+        ASSERT_EQ(m_unique_cbs.load(), unique_threads * (num_iters / num_threads));
+        ASSERT_EQ(m_shared_cbs.load(), shared_threads * (num_iters / num_threads));
     }
 };
 
@@ -107,7 +113,8 @@ typedef Types< std::mutex, std::shared_mutex, folly::SharedMutex > Implementatio
 // typedef Types< std::mutex, folly::SharedMutex > Implementations;
 TYPED_TEST_SUITE(CBMutexTest, Implementations);
 
-TYPED_TEST(CBMutexTest, LockUnlockTest) { this->run_lock_unlock(); }
+TYPED_TEST(CBMutexTest, LockUnlockTest) { this->run_lock_unlock(false); }
+TYPED_TEST(CBMutexTest, BatchHandoffTest) { this->run_lock_unlock(true); }
 
 SISL_OPTIONS_ENABLE(logging, test_cb_mutex)
 SISL_OPTION_GROUP(test_cb_mutex,
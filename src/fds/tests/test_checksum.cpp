@@ -0,0 +1,135 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sisl/logging/logging.h>
+#include <sisl/options/options.h>
+
+#include <gtest/gtest.h>
+
+#include "sisl/fds/checksum.hpp"
+
+SISL_LOGGING_INIT(test_checksum)
+SISL_OPTIONS_ENABLE(logging, test_checksum)
+
+namespace {
+std::vector< uint8_t > random_bytes(const size_t size, const uint32_t seed = 0) {
+    std::default_random_engine engine{seed};
+    std::uniform_int_distribution< uint32_t > dist{0, 255};
+    std::vector< uint8_t > ret(size);
+    for (auto& b : ret) {
+        b = static_cast< uint8_t >(dist(engine));
+    }
+    return ret;
+}
+
+sisl::sg_list make_sgl(const std::vector< uint8_t >& data, const std::vector< size_t >& piece_sizes) {
+    sisl::sg_list sgl{0, {}};
+    size_t off{0};
+    for (const auto sz : piece_sizes) {
+        sgl.iovs.push_back(iovec{const_cast< uint8_t* >(data.data() + off), sz});
+        sgl.size += sz;
+        off += sz;
+    }
+    return sgl;
+}
+} // namespace
+
+TEST(Checksum, KnownValues) {
+    const std::string check{"123456789"};
+    ASSERT_EQ(sisl::crc32c(check.data(), check.size()), 0xe3069283u);
+    ASSERT_EQ(sisl::crc32c_sw(check.data(), check.size()), 0xe3069283u);
+    ASSERT_EQ(sisl::crc32c(nullptr, 0), 0u);
+
+    // iSCSI (RFC 3720) test vector of 32 bytes of zeros
+    const std::vector< uint8_t > zeros(32, 0);
+    ASSERT_EQ(sisl::crc32c(zeros.data(), zeros.size()), 0x8a9136aau);
+
+    ASSERT_EQ(sisl::xxh3_64(nullptr, 0), 0x2d06800538d394c2ull);
+}
+
+TEST(Checksum, HardwareMatchesSoftware) {
+    const auto data{random_bytes(3 * 8192 * 3 + 1000)};
+    for (size_t off{0}; off < 16; ++off) {
+        for (const size_t len : {size_t{0}, size_t{1}, size_t{7}, size_t{63}, size_t{255}, size_t{768},
+                                 size_t{3 * 256 + 13}, size_t{3 * 8192}, size_t{3 * 8192 * 3 + 17}}) {
+            ASSERT_EQ(sisl::crc32c(data.data() + off, len), sisl::crc32c_sw(data.data() + off, len))
+                << "off=" << off << " len=" << len;
+            ASSERT_EQ(sisl::crc32c(data.data() + off, len, 0x12345678u),
+                      sisl::crc32c_sw(data.data() + off, len, 0x12345678u))
+                << "off=" << off << " len=" << len;
+        }
+    }
+}
+
+TEST(Checksum, ScatterGather) {
+    const auto data{random_bytes(100000, 1)};
+    const uint32_t crc{sisl::crc32c(data.data(), data.size())};
+    const uint64_t hash{sisl::xxh3_64(data.data(), data.size(), 42)};
+
+    const auto sgl{make_sgl(data, {1, 4095, 4096, 13, 50000, 41795})};
+    ASSERT_EQ(sisl::crc32c(sgl), crc);
+    ASSERT_EQ(sisl::xxh3_64(sgl, 42), hash);
+    ASSERT_EQ(sisl::xxh3_64(make_sgl(data, {data.size()}), 42), hash);
+
+    // Checksum the sg_list in pieces which do not line up with the iovs
+    sisl::sg_iterator it{sgl.iovs};
+    uint32_t crc_it{0};
+    sisl::xxh3_64_hasher hasher{42};
+    for (size_t off{0}; off < data.size(); off += 7777) {
+        const size_t sz{std::min< size_t >(7777, data.size() - off)};
+        sisl::sg_iterator hit{it};
+        crc_it = sisl::crc32c(it, sz, crc_it);
+        hasher.update(hit, sz);
+    }
+    ASSERT_EQ(crc_it, crc);
+    ASSERT_EQ(hasher.digest(), hash);
+
+    hasher.reset(42);
+    hasher.update(sisl::blob{data.data(), uint32_cast(data.size())});
+    ASSERT_EQ(hasher.digest(), hash);
+}
+
+TEST(Checksum, CombineAndParallel) {
+    const auto data{random_bytes(1024 * 1024 + 333, 2)};
+    const uint32_t crc{sisl::crc32c(data.data(), data.size())};
+    for (const size_t split : {size_t{0}, size_t{1}, size_t{3}, size_t{4096}, size_t{500001}, data.size()}) {
+        const uint32_t crc1{sisl::crc32c(data.data(), split)};
+        const uint32_t crc2{sisl::crc32c(data.data() + split, data.size() - split)};
+        ASSERT_EQ(sisl::crc32c_combine(crc1, crc2, data.size() - split), crc) << "split=" << split;
+    }
+
+    for (const uint32_t nchunks : {0u, 1u, 2u, 3u, 8u, 13u}) {
+        ASSERT_EQ(sisl::crc32c_parallel(data.data(), data.size(), nchunks), crc) << "nchunks=" << nchunks;
+    }
+    ASSERT_EQ(sisl::crc32c_parallel(data.data() + 100, data.size() - 100, 4, sisl::crc32c(data.data(), 100)), crc);
+}
+
+int main(int argc, char* argv[]) {
+    int parsed_argc{argc};
+    ::testing::InitGoogleTest(&parsed_argc, argv);
+    SISL_OPTIONS_LOAD(parsed_argc, argv, logging);
+    sisl::logging::SetLogger("test_checksum");
+    spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
+
+    const auto ret{RUN_ALL_TESTS()};
+    return ret;
+}
@@ -18,6 +18,7 @@
 #include <iostream>
 #include <boost/dynamic_bitset.hpp>
 #include <random>
+#include <vector>
 
 #include <sisl/logging/logging.h>
 #include <sisl/options/options.h>
@@ -142,6 +143,37 @@ TEST_F(CompactBitsetTest, RandomBitsWithReload) {
     validate();
 }
 
+TEST_F(CompactBitsetTest, RankSelect) {
+    auto const num_bits = m_bset->size();
+    std::random_device rd;
+    std::mt19937 re(rd());
+    std::uniform_int_distribution< CompactBitSet::bit_count_t > bit_gen(0, num_bits - 1);
+
+    std::vector< CompactBitSet::bit_count_t > set_bits;
+    auto validate = [this, &set_bits]() {
+        ASSERT_EQ(m_bset->rank(m_bset->size()), set_bits.size());
+        for (size_t n{0}; n < set_bits.size(); ++n) {
+            ASSERT_EQ(m_bset->select(s_cast< CompactBitSet::bit_count_t >(n)), set_bits[n]);
+            ASSERT_EQ(m_bset->rank(set_bits[n]), n);
+        }
+        ASSERT_EQ(m_bset->select(s_cast< CompactBitSet::bit_count_t >(set_bits.size())), CompactBitSet::inval_bit);
+    };
+
+    validate();
+    for (uint32_t i{0}; i < num_bits / 4; ++i) {
+        m_bset->set_bit(bit_gen(re));
+    }
+    for (CompactBitSet::bit_count_t b{0}; b < num_bits; ++b) {
+        if (m_bset->is_bit_set(b)) { set_bits.push_back(b); }
+    }
+    validate();
+
+    // Mutation should invalidate the directory built above
+    m_bset->reset_bit(set_bits.front());
+    set_bits.erase(set_bits.begin());
+    validate();
+}
+
 SISL_OPTION_GROUP(test_compact_bitset,
                   (buf_size, "", "buf_size", "buf_size that contains the bits",
                    ::cxxopts::value< uint32_t >()->default_value("1024"), "number"))
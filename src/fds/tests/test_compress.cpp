@@ -0,0 +1,233 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Yaming Kuang
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sisl/logging/logging.h>
+#include <sisl/options/options.h>
+
+#include <gtest/gtest.h>
+
+#include "sisl/fds/compress.hpp"
+
+SISL_LOGGING_INIT(test_compress)
+SISL_OPTIONS_ENABLE(logging, test_compress)
+
+namespace {
+// Repetitive text, which every codec should be able to compress
+std::string make_record(std::default_random_engine& engine, uint32_t id) {
+    std::uniform_int_distribution< uint32_t > dist{0, 1000};
+    return "{\"id\":" + std::to_string(id) + ",\"type\":\"btree_node\",\"level\":" + std::to_string(dist(engine) % 4) +
+        ",\"nentries\":" + std::to_string(dist(engine)) + ",\"checksum\":" + std::to_string(dist(engine)) +
+        ",\"owner\":\"index_table_" + std::to_string(dist(engine) % 8) + "\"}";
+}
+
+std::vector< uint8_t > make_data(size_t size) {
+    std::default_random_engine engine{0};
+    std::vector< uint8_t > data;
+    for (uint32_t id{0}; data.size() < size; ++id) {
+        const auto rec{make_record(engine, id)};
+        data.insert(data.end(), rec.begin(), rec.end());
+    }
+    data.resize(size);
+    return data;
+}
+
+sisl::sg_list make_sgl(std::vector< uint8_t >& data, size_t piece_size) {
+    sisl::sg_list sgl{0, {}};
+    for (size_t off{0}; off < data.size(); off += piece_size) {
+        const size_t sz{std::min(piece_size, data.size() - off)};
+        sgl.iovs.push_back(iovec{data.data() + off, sz});
+        sgl.size += sz;
+    }
+    return sgl;
+}
+
+bool equals(const sisl::blob& b, const std::vector< uint8_t >& data) {
+    return (b.size() == data.size()) && (data.empty() || (std::memcmp(b.cbytes(), data.data(), data.size()) == 0));
+}
+} // namespace
+
+TEST(Compress, RoundTrip) {
+    for (const auto codec : {sisl::compress_codec::none, sisl::compress_codec::snappy, sisl::compress_codec::lz4,
+                             sisl::compress_codec::zstd}) {
+        sisl::CompressContext ctx{codec};
+        for (const size_t size : {size_t{0}, size_t{1}, size_t{100}, size_t{4096}, size_t{1024 * 1024 + 3}}) {
+            auto data{make_data(size)};
+            const auto frame{ctx.compress(sisl::blob{data.data(), uint32_cast(data.size())})};
+            const auto hdr{sisl::CompressContext::read_header(frame)};
+            ASSERT_EQ(hdr.raw_size, size);
+            ASSERT_EQ(frame.size(), sizeof(sisl::compress_frame_header) + hdr.payload_size);
+            if ((size >= 4096) && (codec != sisl::compress_codec::none)) {
+                ASSERT_TRUE(hdr.codec == codec) << "codec=" << enum_name(codec);
+                ASSERT_LT(frame.size(), size) << "Repetitive data did not compress, codec=" << enum_name(codec);
+            }
+
+            // Scattered input should produce a frame which decompresses to the same data
+            const auto sg_frame{ctx.compress(make_sgl(data, 333))};
+            ASSERT_TRUE(equals(ctx.decompress(frame), data)) << "codec=" << enum_name(codec) << " size=" << size;
+            ASSERT_TRUE(equals(ctx.decompress(sg_frame), data)) << "codec=" << enum_name(codec) << " size=" << size;
+        }
+    }
+}
+
+TEST(Compress, AutoDetectCodec) {
+    auto data{make_data(64 * 1024)};
+    const auto sgl{make_sgl(data, 4096)};
+    sisl::CompressContext reader{sisl::compress_codec::none};
+    for (const auto codec : {sisl::compress_codec::snappy, sisl::compress_codec::lz4, sisl::compress_codec::zstd}) {
+        sisl::CompressContext writer{codec};
+        const auto frame{writer.compress(sgl)};
+        ASSERT_TRUE(sisl::CompressContext::read_header(frame).codec == codec);
+        ASSERT_TRUE(equals(reader.decompress(frame), data));
+    }
+
+    // Levels change the output but not the frame format
+    sisl::CompressContext fast{sisl::compress_codec::zstd, 1};
+    sisl::CompressContext best{sisl::compress_codec::zstd, 19};
+    const auto f1{fast.compress(sgl)};
+    const auto f2{best.compress(sgl)};
+    ASSERT_LE(f2.size(), f1.size());
+    ASSERT_TRUE(equals(reader.decompress(f1), data));
+    ASSERT_TRUE(equals(reader.decompress(f2), data));
+}
+
+TEST(Compress, IncompressibleIsStored) {
+    std::default_random_engine engine{1};
+    std::vector< uint8_t > data(8192);
+    for (auto& b : data) {
+        b = static_cast< uint8_t >(engine());
+    }
+    sisl::CompressContext ctx{sisl::compress_codec::lz4};
+    const auto frame{ctx.compress(sisl::blob{data.data(), uint32_cast(data.size())})};
+    ASSERT_TRUE(sisl::CompressContext::read_header(frame).codec == sisl::compress_codec::none);
+    ASSERT_EQ(frame.size(), sizeof(sisl::compress_frame_header) + data.size());
+    ASSERT_TRUE(equals(ctx.decompress(frame), data));
+}
+
+TEST(Compress, Dictionary) {
+    std::default_random_engine engine{2};
+    std::vector< std::string > records;
+    for (uint32_t id{0}; id < 2000; ++id) {
+        records.push_back(make_record(engine, id));
+    }
+    std::vector< sisl::blob > samples;
+    for (size_t i{0}; i < 1000; ++i) {
+        samples.emplace_back(r_cast< const uint8_t* >(records[i].data()), uint32_cast(records[i].size()));
+    }
+    const auto dict{sisl::compress_dictionary::train(samples, 16 * 1024)};
+    ASSERT_NE(dict->id(), 0u);
+
+    sisl::CompressContext plain{sisl::compress_codec::zstd};
+    sisl::CompressContext with_dict{sisl::compress_codec::zstd, 0, dict};
+    size_t plain_size{0};
+    size_t dict_size{0};
+    for (size_t i{1000}; i < records.size(); ++i) {
+        std::vector< uint8_t > rec{records[i].begin(), records[i].end()};
+        const sisl::blob b{rec.data(), uint32_cast(rec.size())};
+        const auto f1{plain.compress(b)};
+        const auto f2{with_dict.compress(b)};
+        plain_size += f1.size();
+        dict_size += f2.size();
+
+        const auto hdr{sisl::CompressContext::read_header(f2)};
+        ASSERT_TRUE(hdr.codec == sisl::compress_codec::zstd);
+        ASSERT_EQ(hdr.dict_id, dict->id());
+        ASSERT_TRUE(equals(with_dict.decompress(f2), rec));
+        ASSERT_THROW(plain.decompress(f2), sisl::compress_error) << "Frame needing dictionary was decompressed";
+    }
+    ASSERT_LT(dict_size * 2, plain_size) << "Dictionary did not help small records";
+}
+
+TEST(Compress, CorruptFrame) {
+    auto data{make_data(16 * 1024)};
+    sisl::CompressContext ctx{sisl::compress_codec::lz4};
+    auto frame{ctx.compress(sisl::blob{data.data(), uint32_cast(data.size())})};
+
+    ASSERT_THROW(ctx.decompress(sisl::blob{frame.cbytes(), 10}), sisl::compress_error);
+    ASSERT_THROW(ctx.decompress(sisl::blob{frame.cbytes(), frame.size() - 1}), sisl::compress_error);
+    frame.bytes()[0] ^= 0xff;
+    ASSERT_THROW(ctx.decompress(frame), sisl::compress_error);
+    frame.bytes()[0] ^= 0xff;
+    frame.bytes()[sizeof(sisl::compress_frame_header) + 1] ^= 0xff;
+    std::vector< uint8_t > out(data.size());
+    try {
+        ctx.decompress(frame, out.data(), out.size());
+        ASSERT_NE(out, data);
+    } catch (const sisl::compress_error&) {}
+}
+
+TEST(ParallelCompressor, RoundTrip) {
+    for (const uint32_t nthreads : {1u, 4u}) {
+        sisl::ParallelCompressor pc{sisl::compress_codec::lz4, 0, nthreads, 64 * 1024};
+        ASSERT_EQ(pc.nthreads(), nthreads);
+        for (const size_t size : {size_t{0}, size_t{1}, size_t{64 * 1024}, size_t{1024 * 1024 + 12345}}) {
+            auto data{make_data(size)};
+            const auto container{pc.compress(make_sgl(data, 10000))};
+            const auto hdr{sisl::ParallelCompressor::read_header(container)};
+            ASSERT_EQ(hdr.raw_size, size);
+            ASSERT_EQ(hdr.nchunks, (size + pc.chunk_size() - 1) / pc.chunk_size());
+            if (size >= pc.chunk_size()) { ASSERT_LT(container.size(), size); }
+            ASSERT_TRUE(equals(pc.decompress(container), data)) << "nthreads=" << nthreads << " size=" << size;
+        }
+    }
+}
+
+TEST(ParallelCompressor, RandomAccessChunk) {
+    constexpr size_t chunk_size{32 * 1024};
+    auto data{make_data(10 * chunk_size + 100)};
+    sisl::ParallelCompressor pc{sisl::compress_codec::zstd, 0, 4, chunk_size};
+    const auto container{pc.compress(sisl::blob{data.data(), uint32_cast(data.size())})};
+
+    sisl::CompressContext ctx{sisl::compress_codec::none};
+    std::vector< uint8_t > out(chunk_size);
+    for (const uint32_t chunk : {7u, 0u, 10u, 3u}) {
+        const size_t sz{sisl::ParallelCompressor::decompress_chunk(ctx, container, chunk, out.data(), out.size())};
+        ASSERT_EQ(sz, std::min(chunk_size, data.size() - chunk * chunk_size));
+        ASSERT_EQ(std::memcmp(out.data(), data.data() + chunk * chunk_size, sz), 0) << "chunk=" << chunk;
+    }
+    ASSERT_THROW(sisl::ParallelCompressor::chunk_frame(container, 11), std::out_of_range);
+}
+
+TEST(ParallelCompressor, CorruptChunkFails) {
+    auto data{make_data(1024 * 1024)};
+    sisl::ParallelCompressor pc{sisl::compress_codec::lz4, 0, 4, 64 * 1024};
+    auto container{pc.compress(sisl::blob{data.data(), uint32_cast(data.size())})};
+
+    // Wreck the magic of one chunk frame, which should fail the whole decompression
+    const auto frame{sisl::ParallelCompressor::chunk_frame(container, 5)};
+    container.bytes()[frame.cbytes() - container.cbytes()] ^= 0xff;
+    ASSERT_THROW(pc.decompress(container), sisl::compress_error);
+
+    // Compressor is still usable after a failed batch
+    container.bytes()[frame.cbytes() - container.cbytes()] ^= 0xff;
+    ASSERT_TRUE(equals(pc.decompress(container), data));
+}
+
+int main(int argc, char* argv[]) {
+    int parsed_argc{argc};
+    ::testing::InitGoogleTest(&parsed_argc, argv);
+    SISL_OPTIONS_LOAD(parsed_argc, argv, logging);
+    sisl::logging::SetLogger("test_compress");
+    spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
+
+    const auto ret{RUN_ALL_TESTS()};
+    return ret;
+}
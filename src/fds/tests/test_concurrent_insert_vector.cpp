@@ -14,10 +14,17 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <iostream>
 #include <boost/dynamic_bitset.hpp>
+#include <mutex>
 #include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 #include <sisl/logging/logging.h>
 #include <sisl/options/options.h>
@@ -70,6 +77,25 @@ protected:
         ASSERT_EQ(m_cvec.size(), bset.get_set_count(0)) << "Size doesn't match with number of entries";
     }
 
+    void validate_all_parallel(uint32_t ntasks) {
+        sisl::Bitset bset{SISL_OPTIONS["num_entries"].as< uint32_t >()};
+        std::mutex mtx;
+        std::vector< std::thread > workers;
+        m_cvec.parallel_foreach(
+            [&workers](std::function< void() > task) { workers.emplace_back(std::move(task)); },
+            [&bset, &mtx](uint32_t const& e) {
+                std::unique_lock lg{mtx};
+                bset.set_bit(e);
+            },
+            ntasks);
+        for (auto& w : workers) {
+            w.join();
+        }
+        ASSERT_LE(workers.size(), ntasks);
+        ASSERT_EQ(bset.get_next_reset_bit(0), sisl::Bitset::npos) << "Access didn't receive all entries";
+        ASSERT_EQ(m_cvec.size(), bset.get_set_count(0)) << "Size doesn't match with number of entries";
+    }
+
     void validate_all_by_iteration() {
         sisl::Bitset bset{SISL_OPTIONS["num_entries"].as< uint32_t >()};
         for (const auto& e : m_cvec) {
@@ -98,6 +124,62 @@ TEST_F(ConcurrentInsertVectorTest, concurrent_insertion) {
     validate_all_by_iteration();
 }
 
+TEST_F(ConcurrentInsertVectorTest, parallel_foreach_and_drain) {
+    LOGINFO("Step1: Inserting {} entries in parallel in {} threads and wait",
+            SISL_OPTIONS["num_entries"].as< uint32_t >(), SISL_OPTIONS["num_threads"].as< uint32_t >());
+    insert_and_wait();
+
+    LOGINFO("Step2: Validating all entries by parallel iteration, with a task per thread and inline on caller");
+    validate_all_parallel(4);
+    validate_all_parallel(1);
+
+    LOGINFO("Step3: Validating that an exception in callback is passed on to the caller");
+    ASSERT_THROW(m_cvec.parallel_foreach([](std::function< void() > task) { task(); },
+                                         [](uint32_t const&) { throw std::runtime_error("stop"); }),
+                 std::runtime_error);
+
+    LOGINFO("Step3a: Validating that a failing executor waits for the tasks it already submitted");
+    std::atomic< bool > submitted_started{false};
+    std::vector< std::thread > workers;
+    ASSERT_THROW(m_cvec.parallel_foreach(
+                     [&workers, &submitted_started](std::function< void() > task) {
+                         if (!workers.empty()) { throw std::runtime_error("no more workers"); }
+                         workers.emplace_back([task = std::move(task), &submitted_started]() {
+                             std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                             submitted_started.store(true);
+                             task();
+                         });
+                     },
+                     [](uint32_t const&) {}, 2),
+                 std::runtime_error);
+    ASSERT_TRUE(submitted_started.load());
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    LOGINFO("Step4: Draining all the chunks and validating entries in them");
+    auto const* first_entry = &(*m_cvec.begin());
+    auto chunks = m_cvec.drain();
+    ASSERT_EQ(m_cvec.size(), 0u);
+    ASSERT_EQ(m_cvec.begin(), m_cvec.end());
+
+    sisl::Bitset bset{SISL_OPTIONS["num_entries"].as< uint32_t >()};
+    bool found_first{false};
+    for (auto const& chunk : chunks) {
+        if (chunk.data() == first_entry) { found_first = true; } // Chunks are moved out, not copied
+        for (auto const e : chunk) {
+            bset.set_bit(e);
+        }
+    }
+    ASSERT_TRUE(found_first);
+    ASSERT_EQ(bset.get_next_reset_bit(0), sisl::Bitset::npos) << "Drain didn't return all entries";
+
+    LOGINFO("Step5: Inserting again after drain");
+    m_cvec.push_back(10u);
+    ASSERT_EQ(m_cvec.size(), 1u);
+    ASSERT_EQ(*m_cvec.begin(), 10u);
+}
+
 SISL_OPTION_GROUP(test_concurrent_insert_vector,
                   (num_entries, "", "num_entries", "num_entries",
                    ::cxxopts::value< uint32_t >()->default_value("10000"), "number"),
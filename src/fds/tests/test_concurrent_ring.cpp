@@ -0,0 +1,267 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <sisl/logging/logging.h>
+#include <sisl/options/options.h>
+
+#include <gtest/gtest.h>
+
+#include "sisl/fds/concurrent_ring.hpp"
+
+SISL_LOGGING_INIT(test_concurrent_ring)
+SISL_OPTIONS_ENABLE(logging, test_concurrent_ring)
+SISL_OPTION_GROUP(test_concurrent_ring,
+                  (num_threads, "", "num_threads", "number of producer and consumer threads",
+                   ::cxxopts::value< uint32_t >()->default_value("4"), "number"))
+
+namespace {
+constexpr uint64_t entries_per_producer{100000};
+
+template < typename RingT >
+void single_thread_fifo() {
+    RingT ring{5};
+    ASSERT_EQ(ring.capacity(), 8u);
+    ASSERT_TRUE(ring.empty());
+
+    uint64_t v;
+    ASSERT_FALSE(ring.try_pop(v));
+    for (uint64_t i{0}; i < 8; ++i) {
+        ASSERT_TRUE(ring.try_push(i));
+    }
+    ASSERT_FALSE(ring.try_push(100ul));
+    ASSERT_EQ(ring.size(), 8u);
+
+    // Keep going around the ring a few laps, so that positions wrap the slots
+    for (uint64_t i{8}; i < 100; ++i) {
+        ASSERT_TRUE(ring.try_pop(v));
+        ASSERT_EQ(v, i - 8);
+        ASSERT_TRUE(ring.try_push(i));
+    }
+    for (uint64_t i{92}; i < 100; ++i) {
+        ASSERT_TRUE(ring.try_pop(v));
+        ASSERT_EQ(v, i);
+    }
+    ASSERT_TRUE(ring.empty());
+}
+
+template < typename RingT >
+void batch_ops() {
+    RingT ring{16};
+    std::vector< uint64_t > in(24);
+    std::vector< uint64_t > out(24);
+    uint64_t next_in{0};
+    uint64_t next_out{0};
+
+    for (uint32_t round{0}; round < 50; ++round) {
+        for (auto& v : in) {
+            v = next_in++;
+        }
+        const size_t pushed{ring.push_n(in.begin(), in.size())};
+        ASSERT_LE(pushed, 16u);
+        next_in -= (in.size() - pushed);
+
+        const size_t popped{ring.pop_n(out.begin(), 11)};
+        ASSERT_EQ(popped, std::min< size_t >(11, ring.size() + popped));
+        for (size_t i{0}; i < popped; ++i) {
+            ASSERT_EQ(out[i], next_out++);
+        }
+    }
+    const size_t popped{ring.pop_n(out.begin(), out.size())};
+    for (size_t i{0}; i < popped; ++i) {
+        ASSERT_EQ(out[i], next_out++);
+    }
+    ASSERT_EQ(next_out, next_in);
+    ASSERT_EQ(ring.pop_n(out.begin(), out.size()), 0u);
+}
+
+template < typename RingT >
+void destroys_remaining() {
+    auto counted{std::make_shared< int >(0)};
+    {
+        RingT ring{8};
+        for (int i{0}; i < 6; ++i) {
+            ASSERT_TRUE(ring.try_push(counted));
+        }
+        std::shared_ptr< int > p;
+        ASSERT_TRUE(ring.try_pop(p));
+        ASSERT_EQ(counted.use_count(), 7);
+    }
+    ASSERT_EQ(counted.use_count(), 1);
+}
+} // namespace
+
+TEST(MPMCRing, SingleThreadFifo) { single_thread_fifo< sisl::MPMCRing< uint64_t > >(); }
+TEST(SPSCRing, SingleThreadFifo) { single_thread_fifo< sisl::SPSCRing< uint64_t > >(); }
+TEST(MPMCRing, BatchOps) { batch_ops< sisl::MPMCRing< uint64_t > >(); }
+TEST(SPSCRing, BatchOps) { batch_ops< sisl::SPSCRing< uint64_t > >(); }
+TEST(MPMCRing, DestroysRemaining) { destroys_remaining< sisl::MPMCRing< std::shared_ptr< int > > >(); }
+TEST(SPSCRing, DestroysRemaining) { destroys_remaining< sisl::SPSCRing< std::shared_ptr< int > > >(); }
+
+TEST(MPMCRing, MultiProducerConsumer) {
+    const uint32_t nthreads{SISL_OPTIONS["num_threads"].as< uint32_t >()};
+    sisl::MPMCRing< uint64_t > ring{64, "test_mpmc_ring"};
+    std::atomic< uint64_t > consumed{0};
+    std::atomic< uint64_t > sum{0};
+    const uint64_t total{nthreads * entries_per_producer};
+
+    std::vector< std::thread > threads;
+    for (uint32_t t{0}; t < nthreads; ++t) {
+        // Half the producers and consumers use the batch apis
+        threads.emplace_back([&ring, t]() {
+            std::vector< uint64_t > batch;
+            for (uint64_t i{0}; i < entries_per_producer;) {
+                const uint64_t v{t * entries_per_producer + i + 1};
+                if (t % 2 == 0) {
+                    if (ring.try_push(v)) {
+                        ++i;
+                        continue;
+                    }
+                } else {
+                    batch.clear();
+                    for (uint64_t j{0}; (j < 8) && (i + j < entries_per_producer); ++j) {
+                        batch.push_back(v + j);
+                    }
+                    const size_t n{ring.push_n(batch.begin(), batch.size())};
+                    i += n;
+                    if (n != 0) { continue; }
+                }
+                std::this_thread::yield();
+            }
+        });
+        threads.emplace_back([&ring, &consumed, &sum, total, t]() {
+            uint64_t out[8];
+            while (consumed.load() < total) {
+                const size_t n{(t % 2 == 0) ? (ring.try_pop(out[0]) ? 1u : 0u) : ring.pop_n(&out[0], 8)};
+                if (n == 0) { std::this_thread::yield(); }
+                for (size_t i{0}; i < n; ++i) {
+                    sum.fetch_add(out[i]);
+                }
+                consumed.fetch_add(n);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_EQ(consumed.load(), total);
+    ASSERT_EQ(sum.load(), total * (total + 1) / 2); // Every value popped exactly once
+    ASSERT_TRUE(ring.empty());
+}
+
+TEST(SPSCRing, ProducerConsumerOrder) {
+    sisl::SPSCRing< uint64_t > ring{128, "test_spsc_ring"};
+    constexpr uint64_t total{10 * entries_per_producer};
+
+    std::thread producer{[&ring]() {
+        uint64_t batch[16];
+        for (uint64_t i{0}; i < total;) {
+            if (i % 3 == 0) {
+                if (ring.try_push(i)) {
+                    ++i;
+                    continue;
+                }
+            } else {
+                const uint64_t n{std::min< uint64_t >(16, total - i)};
+                for (uint64_t j{0}; j < n; ++j) {
+                    batch[j] = i + j;
+                }
+                const size_t pushed{ring.push_n(&batch[0], n)};
+                i += pushed;
+                if (pushed != 0) { continue; }
+            }
+            std::this_thread::yield();
+        }
+    }};
+
+    uint64_t expected{0};
+    uint64_t out[16];
+    while (expected < total) {
+        const size_t n{ring.pop_n(&out[0], 16)};
+        if (n == 0) { std::this_thread::yield(); }
+        for (size_t i{0}; i < n; ++i) {
+            ASSERT_EQ(out[i], expected++);
+        }
+    }
+    producer.join();
+    ASSERT_TRUE(ring.empty());
+}
+
+TEST(MPMCRing, BlockingPushPop) {
+    sisl::MPMCRing< uint64_t, true > ring{4};
+    constexpr uint64_t total{entries_per_producer};
+
+    // Tiny ring, so that both sides keep blocking on each other
+    std::thread producer{[&ring]() {
+        for (uint64_t i{1}; i <= total; ++i) {
+            ring.push(i);
+        }
+    }};
+    uint64_t sum{0};
+    for (uint64_t i{0}; i < total; ++i) {
+        sum += ring.pop();
+    }
+    producer.join();
+    ASSERT_EQ(sum, total * (total + 1) / 2);
+}
+
+TEST(SPSCRing, BlockingPushPop) {
+    sisl::SPSCRing< uint64_t, true > ring{4};
+    constexpr uint64_t total{entries_per_producer};
+
+    std::thread producer{[&ring]() {
+        for (uint64_t i{0}; i < total; ++i) {
+            ring.push(i);
+        }
+    }};
+    for (uint64_t i{0}; i < total; ++i) {
+        ASSERT_EQ(ring.pop(), i);
+    }
+    producer.join();
+}
+
+TEST(MPMCRing, TimedPop) {
+    sisl::MPMCRing< uint64_t, true > ring{4};
+    uint64_t v;
+    const auto start{std::chrono::steady_clock::now()};
+    ASSERT_FALSE(ring.try_pop_for(v, std::chrono::milliseconds{20}));
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds{20});
+
+    std::thread producer{[&ring]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        ring.push(42ul);
+    }};
+    ASSERT_TRUE(ring.try_pop_for(v, std::chrono::seconds{10}));
+    ASSERT_EQ(v, 42u);
+    producer.join();
+}
+
+int main(int argc, char* argv[]) {
+    int parsed_argc{argc};
+    ::testing::InitGoogleTest(&parsed_argc, argv);
+    SISL_OPTIONS_LOAD(parsed_argc, argv, logging, test_concurrent_ring);
+    sisl::logging::SetLogger("test_concurrent_ring");
+    spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
+
+    const auto ret{RUN_ALL_TESTS()};
+    return ret;
+}
@@ -14,7 +14,13 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <thread>
 #include <vector>
 
@@ -27,68 +33,202 @@
 
 using namespace sisl;
 
-SISL_LOGGING_INIT(test_bitset);
-
-SISL_OPTIONS_ENABLE(logging, test_id_reserver)
-
-SISL_OPTION_GROUP(test_id_reserver,
-                 (num_threads, "", "num_threads", "number of threads",
-                  ::cxxopts::value< uint32_t >()->default_value("8"), "number"),
-                 (max_ids, "", "max_ids", "maximum number of ids",
-                  ::cxxopts::value< uint32_t >()->default_value("1000"), "number"),
+SISL_LOGGING_INIT(test_id_reserver)
 
 namespace {
-    uint32_t g_max_ids;
-    uint32_t g_num_threads;
+uint32_t g_max_ids;
+uint32_t g_num_threads;
 
-    void run_parallel(uint32_t nthreads, const std::function< void(uint32_t) >& thr_fn) {
-        std::vector< std::thread > threads;
-        auto n_per_thread = std::ceil((double)g_max_ids / nthreads);
-        int32_t remain_ids = (int32_t)g_max_ids;
+void run_parallel(uint32_t nthreads, const std::function< void(uint32_t) >& thr_fn) {
+    std::vector< std::thread > threads;
+    for (uint32_t t{0}; t < nthreads; ++t) {
+        threads.emplace_back(thr_fn, t);
+    }
+    for (auto& t : threads) {
+        if (t.joinable()) t.join();
+    }
+}
 
-        while (remain_ids > 0) {
-            threads.emplace_back(thr_fn, std::min(remain_ids, (int32_t)n_per_thread));
-            remain_ids -= n_per_thread;
-        }
-        for (auto t : threads) {
-            if (t.joinable()) t.join();
+std::vector< uint32_t > reserved_ids(IDReserver& reserver) {
+    std::vector< uint32_t > ids;
+    uint32_t id;
+    if (!reserver.first_reserved_id(id)) { return ids; }
+    do {
+        ids.push_back(id);
+    } while (reserver.next_reserved_id(id));
+    return ids;
+}
+
+// Runs reserve/unreserve of ids from all the threads and checks that no id is handed out twice and that the
+// reserver reports exactly the ids that are held at the end
+void verify_parallel_reserve(IDReserver& reserver, bool bulk) {
+    std::mutex mtx;
+    std::vector< uint32_t > all_held;
+    run_parallel(g_num_threads, [&](uint32_t t) {
+        std::mt19937 re{t};
+        std::vector< uint32_t > held;
+        const uint32_t per_thread{g_max_ids / g_num_threads};
+        while (held.size() < per_thread) {
+            std::vector< uint32_t > ids;
+            const uint32_t count{std::uniform_int_distribution< uint32_t >{1, 16}(re)};
+            if (bulk) {
+                reserver.reserve_bulk(count, ids);
+            } else {
+                for (uint32_t i{0}; i < count; ++i) {
+                    ids.push_back(reserver.reserve());
+                }
+            }
+
+            // Keep every other id and give the rest back
+            std::vector< uint32_t > unreserve_ids;
+            for (size_t i{0}; i < ids.size(); ++i) {
+                ((i % 2 == 0) ? held : unreserve_ids).push_back(ids[i]);
+            }
+            if (bulk) {
+                reserver.unreserve_bulk(unreserve_ids);
+            } else {
+                for (const auto id : unreserve_ids) {
+                    reserver.unreserve(id);
+                }
+            }
         }
+        std::unique_lock lg(mtx);
+        all_held.insert(all_held.end(), held.cbegin(), held.cend());
+    });
+
+    std::sort(all_held.begin(), all_held.end());
+    ASSERT_EQ(std::adjacent_find(all_held.cbegin(), all_held.cend()), all_held.cend()) << "An id is reserved twice";
+    ASSERT_EQ(reserved_ids(reserver), all_held);
+}
+
+struct IDReserverTest : public testing::Test {
+public:
+    IDReserverTest() = default;
+    IDReserverTest(const IDReserverTest&) = delete;
+    IDReserverTest(IDReserverTest&&) noexcept = delete;
+    IDReserverTest& operator=(const IDReserverTest&) = delete;
+    IDReserverTest& operator=(IDReserverTest&&) noexcept = delete;
+    virtual ~IDReserverTest() override = default;
+
+protected:
+    IDReserver m_reserver{4};
+
+    void SetUp() override {}
+    void TearDown() override {}
+};
+} // namespace
+
+TEST_F(IDReserverTest, ReserveLowestUsingHint) {
+    for (uint32_t i{0}; i < 10; ++i) {
+        ASSERT_EQ(m_reserver.reserve(), i); // Grows past the estimated ids
     }
 
-    struct IDReserverTest : public testing::Test {
-    public:
-        IDReserverTest(const IDReserverTest&) = delete;
-        IDReserverTest(IDReserverTest&&) noexcept = delete;
-        IDReserverTest& operator=(const IDReserverTest&) = delete;
-        IDReserverTest& operator=(IDReserverTest&&) noexcept = delete;
-        virtual ~IDReserverTest() override = default;
+    // Unreserve moves the hint back, so the freed ids are handed out lowest first before the next new one
+    m_reserver.unreserve(7);
+    m_reserver.unreserve(3);
+    ASSERT_FALSE(m_reserver.is_reserved(3));
+    ASSERT_EQ(m_reserver.reserve(), 3u);
+    ASSERT_EQ(m_reserver.reserve(), 7u);
+    ASSERT_EQ(m_reserver.reserve(), 10u);
+
+    // An explicitly reserved id above the hint is skipped
+    m_reserver.reserve(12);
+    ASSERT_TRUE(m_reserver.is_reserved(12));
+    ASSERT_EQ(m_reserver.reserve(), 11u);
+    ASSERT_EQ(m_reserver.reserve(), 13u);
+}
 
-    protected:
-        IDReserver m_reserver;
+TEST_F(IDReserverTest, BulkRoundTrip) {
+    std::vector< uint32_t > ids;
+    m_reserver.reserve_bulk(100, ids);
+    ASSERT_EQ(ids.size(), 100u);
+    for (uint32_t i{0}; i < 100; ++i) {
+        ASSERT_EQ(ids[i], i);
+    }
 
-        void SetUp() override {}
-        void TearDown() override {}
-    };
+    std::vector< uint32_t > odd_ids;
+    for (uint32_t i{1}; i < 100; i += 2) {
+        odd_ids.push_back(i);
+    }
+    m_reserver.unreserve_bulk(odd_ids);
+    for (uint32_t i{0}; i < 100; ++i) {
+        ASSERT_EQ(m_reserver.is_reserved(i), (i % 2 == 0)) << "id=" << i;
+    }
+
+    std::vector< uint32_t > again;
+    m_reserver.reserve_bulk(50, again);
+    ASSERT_EQ(again, odd_ids);
+    ASSERT_EQ(m_reserver.reserve(), 100u);
+}
+
+TEST_F(IDReserverTest, ParallelBulkNoDuplicates) { verify_parallel_reserve(m_reserver, true /* bulk */); }
+
+TEST_F(IDReserverTest, ParallelThreadCacheNoDuplicates) {
+    IDReserver reserver{1024, 16};
+    verify_parallel_reserve(reserver, false /* bulk */);
+}
+
+TEST_F(IDReserverTest, ThreadCacheReturnedOnThreadExit) {
+    IDReserver reserver{1024, 16};
+    uint32_t id;
+    std::thread{[&reserver, &id]() { id = reserver.reserve(); }}.join();
+
+    // The rest of the batch the thread had cached are free again, so they are the lowest ids to hand out
+    ASSERT_EQ(reserved_ids(reserver), std::vector< uint32_t >{id});
+    std::vector< uint32_t > ids;
+    reserver.reserve_bulk(15, ids);
+    for (const auto i : ids) {
+        ASSERT_LT(i, 16u);
+        ASSERT_NE(i, id);
+    }
 }
 
-TEST_F(IDReserverTest, RandomIDSet) {
-    run_parallel(g_num_threads, [&](int32_t n_ids_this_thread) {
-        LOGINFO("INFO: Setting alternate bits (set even and reset odd) in range[{} - {}]", start, start + count - 1);
-        for (auto i = 0; i < n_ids_this_thread; ++i) {
-            if (i % 2 == 0) { reserve(); }
+TEST_F(IDReserverTest, ThreadCacheReturnedOnReserverDestroy) {
+    auto reserver{std::make_unique< IDReserver >(1024, 16)};
+    std::atomic< bool > reserved{false};
+    std::atomic< bool > destroyed{false};
+    std::thread t{[&reserver, &reserved, &destroyed]() {
+        reserver->reserve();
+        reserver->unreserve(reserver->reserve());
+        reserved.store(true);
+        while (!destroyed.load()) {
+            std::this_thread::yield();
         }
-    });
+        // Thread exits after the reserver is gone, its cache must not be returned again
+    }};
+    while (!reserved.load()) {
+        std::this_thread::yield();
+    }
+
+    // Cached ids are reported as unreserved, including in the serialized state
+    ASSERT_EQ(reserved_ids(*reserver).size(), 1u);
+    IDReserver restored{reserver->serialize()};
+    ASSERT_EQ(reserved_ids(restored), reserved_ids(*reserver));
+
+    // Destroying the reserver returns the cache of the still running thread
+    reserver.reset();
+    destroyed.store(true);
+    t.join();
 }
 
+SISL_OPTIONS_ENABLE(logging, test_id_reserver)
+
+SISL_OPTION_GROUP(test_id_reserver,
+                  (num_threads, "", "num_threads", "number of threads",
+                   ::cxxopts::value< uint32_t >()->default_value("8"), "number"),
+                  (max_ids, "", "max_ids", "maximum number of ids",
+                   ::cxxopts::value< uint32_t >()->default_value("10000"), "number"))
+
 int main(int argc, char* argv[]) {
-    SISL_OPTIONS_LOAD(argc, argv, logging, test_id_reserver);
-    ::testing::InitGoogleTest(&argc, argv);
+    int parsed_argc{argc};
+    ::testing::InitGoogleTest(&parsed_argc, argv);
+    SISL_OPTIONS_LOAD(parsed_argc, argv, logging, test_id_reserver);
     sisl::logging::SetLogger("test_id_reserver");
     spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
 
     g_max_ids = SISL_OPTIONS["max_ids"].as< uint32_t >();
     g_num_threads = SISL_OPTIONS["num_threads"].as< uint32_t >();
 
-    auto ret = RUN_ALL_TESTS();
+    const auto ret{RUN_ALL_TESTS()};
     return ret;
 }
@@ -14,8 +14,10 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <vector>
 
 #include "sisl/logging/logging.h"
 #include "sisl/options/options.h"
@@ -40,10 +42,56 @@ public:
 private:
     T m_id;
 };
+
+struct SlabObj {
+    uint64_t m_id;
+    uint64_t m_data[3];
+};
+
+// Objects allocated back to back from a slab backed allocator should share the same slab
+bool test_slab_backing() {
+    typedef sisl::ObjectAllocator< SlabObj, FREELIST_CACHE_COUNT, sisl::FreeListSlabBacking<> > slab_obj_allocator;
+    sisl::FreeListSlabBacking<>::set_idle_release_period< sizeof(SlabObj) >(std::chrono::milliseconds{0});
+
+    constexpr uint64_t count{1000};
+    std::vector< SlabObj* > objs;
+    for (uint64_t i{0}; i < count; ++i) {
+        objs.push_back(slab_obj_allocator::make_object(SlabObj{i, {i, i, i}}));
+    }
+
+    bool success{true};
+    const auto slab_of{[](const SlabObj* const o) { return reinterpret_cast< uintptr_t >(o) / sisl::SLAB_SIZE; }};
+    for (uint64_t i{0}; i < count; ++i) {
+        if ((objs[i]->m_id != i) || (slab_of(objs[i]) != slab_of(objs[0]))) {
+            std::cout << "Slab backed object " << i << " at " << static_cast< const void* >(objs[i])
+                      << " is corrupted or not in the same slab as the first object\n";
+            success = false;
+        }
+    }
+
+    for (auto* const o : objs) {
+        slab_obj_allocator::deallocate(o);
+    }
+
+    // Freed objects are still cached by this thread, trim hands them back so that their slab gets unmapped
+    auto& pool{sisl::SlabPool< sizeof(SlabObj), false >::instance()};
+    if (pool.num_slabs() == 0) {
+        std::cout << "No slab is mapped while objects are cached\n";
+        success = false;
+    }
+    slab_obj_allocator::trim();
+    if (pool.num_slabs() != 0) {
+        std::cout << pool.num_slabs() << " slabs are still mapped after trim\n";
+        success = false;
+    }
+    return success;
+}
 } // namespace
 
 int main() {
     Node< uint64_t >* const ptr1{sisl::ObjectAllocator< Node< uint64_t > >::make_object(~static_cast< uint64_t >(0))};
     std::cout << "ptr1 = " << static_cast< const void* >(ptr1) << " Id = " << ptr1->get_id() << std::endl;
     sisl::ObjectAllocator< Node< uint64_t > >::deallocate(ptr1);
+
+    return test_slab_backing() ? 0 : 1;
 }
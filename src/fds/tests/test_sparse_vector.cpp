@@ -0,0 +1,183 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sisl/logging/logging.h>
+#include <sisl/options/options.h>
+
+#include <gtest/gtest.h>
+
+#include "sisl/fds/sparse_vector.hpp"
+
+SISL_LOGGING_INIT(test_sparse_vector)
+SISL_OPTIONS_ENABLE(logging)
+
+TEST(SparseVector, FillsVoid) {
+    sisl::sparse_vector< std::string > v;
+    v[5] = "five";
+    ASSERT_EQ(v.size(), 6u);
+    ASSERT_TRUE(v.index_exists(3));
+    ASSERT_TRUE(v[3].empty());
+    ASSERT_EQ(v.at(5), "five");
+}
+
+TEST(PagedSparseVector, FarIndexAllocatesOnePage) {
+    sisl::paged_sparse_vector< std::string > v;
+    v[10'000'000] = "far";
+    ASSERT_EQ(v.size(), 1u);
+    ASSERT_EQ(v.page_count(), 1u);
+    ASSERT_FALSE(v.index_exists(0));
+    ASSERT_FALSE(v.index_exists(10'000'001));
+    ASSERT_EQ(v.find(9'999'999), nullptr);
+    ASSERT_EQ(v.at(10'000'000), "far");
+    ASSERT_THROW(v.at(1), std::out_of_range);
+
+    // A neighbour on the same page does not allocate another one
+    v.emplace(10'000'001, 3, 'x');
+    ASSERT_EQ(v.at(10'000'001), "xxx");
+    ASSERT_EQ(v.page_count(), 1u);
+    ASSERT_EQ(v.size(), 2u);
+
+    // Replacing an entry does not change the count
+    v.emplace(10'000'001, "y");
+    ASSERT_EQ(v.at(10'000'001), "y");
+    ASSERT_EQ(v.size(), 2u);
+}
+
+TEST(PagedSparseVector, IterateInOrder) {
+    sisl::paged_sparse_vector< uint64_t, 6 > v;
+    std::map< size_t, uint64_t > expected;
+    std::default_random_engine engine{1234};
+    std::uniform_int_distribution< size_t > dist{0, 1'000'000};
+    for (auto i{0}; i < 5000; ++i) {
+        const size_t idx{dist(engine)};
+        v[idx] = idx * 3;
+        expected[idx] = idx * 3;
+    }
+    ASSERT_EQ(v.size(), expected.size());
+
+    auto it{expected.begin()};
+    v.foreach_entry([&it, &expected](size_t idx, uint64_t& val) {
+        EXPECT_NE(it, expected.end());
+        EXPECT_EQ(idx, it->first);
+        EXPECT_EQ(val, it->second);
+        ++it;
+        return true;
+    });
+    ASSERT_EQ(it, expected.end());
+
+    size_t count{0};
+    v.foreach_entry([&count](size_t, uint64_t&) { return (++count < 10); });
+    ASSERT_EQ(count, 10u);
+}
+
+TEST(PagedSparseVector, ReleaseEmptyPages) {
+    auto counted{std::make_shared< int >(0)};
+    {
+        sisl::paged_sparse_vector< std::shared_ptr< int >, 4 > v{true /* release_empty_pages */};
+        for (size_t i{0}; i < 64; ++i) {
+            v[i * 3] = counted;
+        }
+        ASSERT_EQ(counted.use_count(), 65);
+        const size_t pages{v.page_count()};
+        ASSERT_EQ(pages, 12u);
+
+        // Emptying the first page releases it, leaving the rest alone
+        for (size_t i{0}; i < 16; i += 3) {
+            ASSERT_TRUE(v.erase(i));
+        }
+        ASSERT_FALSE(v.erase(0));
+        ASSERT_EQ(v.page_count(), pages - 1);
+        ASSERT_EQ(v.size(), 58u);
+        ASSERT_EQ(counted.use_count(), 59);
+    }
+    ASSERT_EQ(counted.use_count(), 1);
+
+    sisl::paged_sparse_vector< int > kept;
+    kept[7] = 1;
+    kept.erase(7);
+    ASSERT_EQ(kept.page_count(), 1u);
+    ASSERT_TRUE(kept.empty());
+}
+
+TEST(PagedSparseVector, FarApartIndexes) {
+    sisl::paged_sparse_vector< uint64_t > v{true /* release_empty_pages */};
+    // Index 2^40 needed 2^30 directory slots before any page, when the directory was flat
+    const std::vector< size_t > indexes{3, size_t{1} << 30, (size_t{1} << 40) + 5,
+                                        (size_t{1} << 40) + (size_t{1} << 20)};
+    for (const auto idx : indexes) {
+        v[idx] = idx;
+    }
+    ASSERT_EQ(v.page_count(), indexes.size());
+    ASSERT_EQ(v.at(size_t{1} << 30), size_t{1} << 30);
+    ASSERT_FALSE(v.index_exists(size_t{1} << 41));
+
+    std::vector< size_t > visited;
+    v.foreach_entry([&visited](size_t idx, uint64_t& val) {
+        EXPECT_EQ(idx, val);
+        visited.push_back(idx);
+        return true;
+    });
+    ASSERT_EQ(visited, indexes);
+
+    // Pages, and the directory nodes above them, come back after being released
+    ASSERT_TRUE(v.erase((size_t{1} << 40) + 5));
+    ASSERT_TRUE(v.erase((size_t{1} << 40) + (size_t{1} << 20)));
+    ASSERT_EQ(v.page_count(), 2u);
+    v.emplace((size_t{1} << 40) + 5, 7);
+    ASSERT_EQ(v.at((size_t{1} << 40) + 5), 7u);
+    ASSERT_EQ(v.page_count(), 3u);
+    ASSERT_EQ(v.size(), 3u);
+}
+
+TEST(PagedSparseVector, ThrowingConstructor) {
+    struct entry {
+        explicit entry(const bool fail) {
+            if (fail) { throw std::runtime_error("construct failed"); }
+        }
+    };
+    sisl::paged_sparse_vector< entry > v;
+
+    // A failed replace leaves the entry unpopulated and does not leak the page it emptied
+    v.emplace(5, false);
+    ASSERT_THROW(v.emplace(5, true), std::runtime_error);
+    ASSERT_FALSE(v.index_exists(5));
+    ASSERT_TRUE(v.empty());
+    ASSERT_EQ(v.page_count(), 0u);
+
+    v.emplace(6, false);
+    ASSERT_THROW(v.emplace(10'000, true), std::runtime_error);
+    ASSERT_EQ(v.size(), 1u);
+    ASSERT_EQ(v.page_count(), 1u);
+}
+
+int main(int argc, char* argv[]) {
+    int parsed_argc{argc};
+    ::testing::InitGoogleTest(&parsed_argc, argv);
+    SISL_OPTIONS_LOAD(parsed_argc, argv, logging);
+    sisl::logging::SetLogger("test_sparse_vector");
+    spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
+
+    const auto ret{RUN_ALL_TESTS()};
+    return ret;
+}
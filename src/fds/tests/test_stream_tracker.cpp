@@ -14,9 +14,12 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <random>
 #include <thread>
+#include <vector>
 
 #include <nlohmann/json.hpp>
 #include <gtest/gtest.h>
@@ -166,6 +169,175 @@ TEST_F(StreamTrackerTest, Rollback) {
     EXPECT_EQ(exception_hit, true);
 }
 
+TEST_F(StreamTrackerTest, SegmentGrowthKeepsSlots) {
+    constexpr auto seg_size{int64_cast(StreamTracker< TestData >::alloc_blk_size)};
+    for (int64_t i = 0; i < 10; ++i) {
+        m_tracker.create(i, int_cast(i));
+    }
+    const TestData* slot_addr = &m_tracker.at(5);
+
+    // Growing over several segments should not move the existing slots
+    for (int64_t i = 10; i < 3 * seg_size + 10; ++i) {
+        m_tracker.create(i, int_cast(i));
+    }
+    EXPECT_EQ(&m_tracker.at(5), slot_addr);
+    EXPECT_EQ(m_tracker.active_upto(), 3 * seg_size + 9);
+    EXPECT_EQ(m_tracker.completed_upto(), -1);
+
+    // Completion across segment boundaries
+    m_tracker.complete(0, 2 * seg_size + 3);
+    EXPECT_EQ(m_tracker.completed_upto(), 2 * seg_size + 3);
+    EXPECT_TRUE(m_tracker.status(2 * seg_size + 3).is_completed);
+    EXPECT_TRUE(m_tracker.status(2 * seg_size + 4).is_active);
+    EXPECT_TRUE(m_tracker.status(10 * seg_size).is_hole);
+
+    int64_t count{0};
+    m_tracker.foreach_all_completed(seg_size - 2, [&count](int64_t idx, TestData& d) {
+        EXPECT_EQ(d.m_value, idx);
+        ++count;
+        return true;
+    });
+    EXPECT_EQ(count, seg_size + 6);
+}
+
+TEST_F(StreamTrackerTest, TruncateRecyclesSegments) {
+    constexpr auto seg_size{int64_cast(StreamTracker< TestData >::alloc_blk_size)};
+    int64_t idx{0};
+    size_t max_mem_size{0};
+
+    // Keep about 2 segments worth of entries in flight, truncated segments should be reused
+    for (auto round = 0; round < 20; ++round) {
+        for (auto i = 0; i < seg_size; ++i, ++idx) {
+            m_tracker.create_and_complete(idx, int_cast(idx));
+        }
+        if (round > 0) { m_tracker.truncate(idx - seg_size - 1); }
+        max_mem_size = std::max(max_mem_size, get_mem_size());
+    }
+    EXPECT_LE(max_mem_size, 4 * seg_size * sizeof(TestData));
+    EXPECT_EQ(m_tracker.completed_upto(), idx - 1);
+    EXPECT_TRUE(m_tracker.status(idx - seg_size - 1).is_out_of_range);
+    EXPECT_EQ(m_tracker.at(idx - seg_size), TestData{int_cast(idx - seg_size)});
+}
+
+TEST_F(StreamTrackerTest, ConcurrentUpdateAndTruncate) {
+    constexpr int64_t nthreads{4};
+    constexpr int64_t per_thread{50000};
+    std::atomic< bool > done{false};
+
+    // Writers interleave their indexes, while another thread keeps truncating what is completed
+    std::vector< std::thread > threads;
+    for (int64_t t = 0; t < nthreads; ++t) {
+        threads.emplace_back([this, t]() {
+            for (int64_t i = 0; i < per_thread; ++i) {
+                const int64_t idx{i * nthreads + t};
+                m_tracker.create(idx, int_cast(idx));
+                m_tracker.update(
+                    idx, [idx](TestData& d) { return (d.m_value == idx); }, int_cast(idx));
+            }
+        });
+    }
+    std::thread truncator{[this, &done]() {
+        while (!done.load()) {
+            m_tracker.truncate();
+            std::this_thread::yield();
+        }
+    }};
+    for (auto& t : threads) {
+        t.join();
+    }
+    done.store(true);
+    truncator.join();
+
+    EXPECT_EQ(m_tracker.completed_upto(), nthreads * per_thread - 1);
+    m_tracker.truncate();
+    EXPECT_TRUE(m_tracker.status(nthreads * per_thread - 1).is_out_of_range);
+}
+
+TEST_F(StreamTrackerTest, RollbackWithConcurrentScans) {
+    constexpr int64_t end_idx{int64_cast(16 * StreamTracker< TestData >::alloc_blk_size) - 1};
+    std::atomic< uint64_t > nscans{0};
+    std::atomic< bool > done{false};
+
+    // A scan racing with the rollback must not leave behind a watermark beyond the rolled back end
+    std::thread scanner{[this, &nscans, &done]() {
+        while (!done.load()) {
+            [[maybe_unused]] const auto upto{m_tracker.completed_upto()};
+            nscans.fetch_add(1);
+        }
+    }};
+    std::default_random_engine re{0};
+    for (int64_t round{0}; round < 200; ++round) {
+        m_tracker.complete_range(0, end_idx);
+        const int64_t new_end{std::uniform_int_distribution< int64_t >{0, end_idx / 2}(re)};
+        m_tracker.rollback(new_end);
+
+        // Let the scan which was in progress during the rollback finish
+        const auto scans{nscans.load()};
+        while (nscans.load() < scans + 2) {
+            std::this_thread::yield();
+        }
+        ASSERT_EQ(m_tracker.completed_upto(), new_end) << "round=" << round;
+    }
+    done.store(true);
+    scanner.join();
+}
+
+TEST_F(StreamTrackerTest, RangeUpdates) {
+    constexpr auto seg_size{int64_cast(StreamTracker< TestData >::alloc_blk_size)};
+    const int64_t end_idx{seg_size + 100};
+
+    // Create the whole range in one call, spanning 2 segments, completing none
+    m_tracker.update_range(0, end_idx, [](TestData&) { return false; }, 7);
+    EXPECT_EQ(m_tracker.active_upto(), end_idx);
+    EXPECT_EQ(m_tracker.completed_upto(), -1);
+    EXPECT_EQ(m_tracker.at(end_idx), TestData{7});
+
+    // Update the existing slots in place and complete them all
+    m_tracker.update_range(0, end_idx, [](TestData& d) {
+        d.m_value += 1;
+        return true;
+    });
+    EXPECT_EQ(m_tracker.at(10), TestData{8});
+    EXPECT_EQ(m_tracker.completed_upto(), end_idx);
+
+    m_tracker.rollback(seg_size - 10);
+    EXPECT_EQ(m_tracker.completed_upto(), seg_size - 10);
+    EXPECT_TRUE(m_tracker.status(seg_size).is_hole);
+
+    // Complete a range beyond what is allocated, with a hole before it
+    m_tracker.complete_range(seg_size, 3 * seg_size);
+    EXPECT_EQ(m_tracker.completed_upto(), seg_size - 10);
+    EXPECT_TRUE(m_tracker.status(3 * seg_size).is_completed);
+    m_tracker.complete_range(seg_size - 9, seg_size - 1);
+    EXPECT_EQ(m_tracker.completed_upto(), 3 * seg_size);
+
+    // Search hint beyond the cached watermark should not disturb it
+    m_tracker.rollback(3 * seg_size);
+    m_tracker.complete_range(3 * seg_size + 10, 3 * seg_size + 20);
+    EXPECT_EQ(m_tracker.completed_upto(3 * seg_size + 10), 3 * seg_size + 20);
+    EXPECT_EQ(m_tracker.completed_upto(), 3 * seg_size);
+
+    EXPECT_EQ(m_tracker.truncate(), 3 * seg_size);
+    EXPECT_EQ(m_tracker.completed_upto(), 3 * seg_size);
+    EXPECT_EQ(m_tracker.complete_range(0, 10), 3 * seg_size);
+}
+
+TEST(StreamTrackerAutoTruncate, CompleteRange) {
+    StreamTracker< TestData, true /* AutoTruncate */ > tracker{"StreamTrackerAuto"};
+
+    // Truncation kicks in once more than the truncate frequency of entries are completed
+    EXPECT_EQ(tracker.complete_range(0, 499), -1);
+    EXPECT_EQ(tracker.complete_range(500, 999), -1);
+    EXPECT_EQ(tracker.complete_range(1000, 1099), 1099);
+    EXPECT_TRUE(tracker.status(1099).is_out_of_range);
+
+    // Completing already completed entries is not counted again
+    tracker.update_range(1100, 1999, [](TestData&) { return false; }, 1);
+    EXPECT_EQ(tracker.complete_range(1100, 1500), 1099);
+    EXPECT_EQ(tracker.complete_range(1100, 1500), 1099);
+    EXPECT_EQ(tracker.completed_upto(), 1500);
+}
+
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
     auto ret = RUN_ALL_TESTS();
@@ -0,0 +1,524 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <exception>
+#include <iterator>
+#include <string_view>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <zlib.h>
+
+#include <sisl/logging/logging.h>
+#include <sisl/sobject/sobject.hpp>
+#include <sisl/utility/thread_factory.hpp>
+
+#include "sisl/metrics/http_exporter.hpp"
+#include "sisl/metrics/metrics.hpp"
+
+namespace sisl {
+static constexpr size_t max_request_header_size{16 * 1024};
+static constexpr size_t max_pending_output_size{1024 * 1024}; // Requests are not read beyond this unsent output
+static constexpr size_t max_events{64};
+
+static bool gzip_compress(const std::string& in, std::string& out) {
+    z_stream zs{};
+    // windowBits of 15 + 16 writes gzip header and trailer instead of zlib ones
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) { return false; }
+
+    out.resize(deflateBound(&zs, in.size()));
+    zs.next_in = reinterpret_cast< Bytef* >(const_cast< char* >(in.data()));
+    zs.avail_in = in.size();
+    zs.next_out = reinterpret_cast< Bytef* >(out.data());
+    zs.avail_out = out.size();
+    const auto ret{deflate(&zs, Z_FINISH)};
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return (ret == Z_STREAM_END);
+}
+
+static std::string_view trim(std::string_view str) {
+    while (!str.empty() && std::isspace(static_cast< unsigned char >(str.front()))) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && std::isspace(static_cast< unsigned char >(str.back()))) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+static bool iequals(std::string_view a, std::string_view b) {
+    return std::equal(a.cbegin(), a.cend(), b.cbegin(), b.cend(), [](const char x, const char y) {
+        return std::tolower(static_cast< unsigned char >(x)) == std::tolower(static_cast< unsigned char >(y));
+    });
+}
+
+// Is the token present in the comma separated header value, like "gzip" in "Accept-Encoding: deflate, gzip"
+static bool has_token(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        const auto comma{value.find(',')};
+        auto item{value.substr(0, comma)};
+        item = trim(item.substr(0, item.find(';')));
+        if (iequals(item, token)) { return true; }
+        if (comma == std::string_view::npos) { break; }
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+static std::string url_decode(std::string_view str) {
+    std::string decoded;
+    decoded.reserve(str.size());
+    for (size_t i{0}; i < str.size(); ++i) {
+        if ((str[i] == '%') && (i + 2 < str.size()) && std::isxdigit(static_cast< unsigned char >(str[i + 1])) &&
+            std::isxdigit(static_cast< unsigned char >(str[i + 2]))) {
+            decoded.push_back(static_cast< char >(std::stoi(std::string{str.substr(i + 1, 2)}, nullptr, 16)));
+            i += 2;
+        } else if (str[i] == '+') {
+            decoded.push_back(' ');
+        } else {
+            decoded.push_back(str[i]);
+        }
+    }
+    return decoded;
+}
+
+static const char* status_text(const int status) {
+    switch (status) {
+    case 200:
+        return "OK";
+    case 400:
+        return "Bad Request";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 431:
+        return "Request Header Fields Too Large";
+    case 500:
+        return "Internal Server Error";
+    default:
+        return "Internal Server Error";
+    }
+}
+
+MetricsHttpExporter::MetricsHttpExporter(const http_exporter_options& options) : m_options{options} {}
+
+MetricsHttpExporter::~MetricsHttpExporter() { stop(); }
+
+bool MetricsHttpExporter::start() {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_options.port);
+    if (::inet_pton(AF_INET, m_options.address.c_str(), &addr.sin_addr) != 1) {
+        LOGERROR("Invalid metrics http exporter address: {}", m_options.address);
+        return false;
+    }
+
+    m_listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listen_fd < 0) {
+        LOGERROR("metrics http exporter socket creation failed, errno: {}", errno);
+        return false;
+    }
+
+    const int reuse{1};
+    ::setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    socklen_t addr_len{sizeof(addr)};
+    if ((::bind(m_listen_fd, reinterpret_cast< sockaddr* >(&addr), sizeof(addr)) < 0) ||
+        (::listen(m_listen_fd, SOMAXCONN) < 0) ||
+        (::getsockname(m_listen_fd, reinterpret_cast< sockaddr* >(&addr), &addr_len) < 0)) {
+        LOGERROR("metrics http exporter could not listen on {}:{}, errno: {}", m_options.address, m_options.port,
+                 errno);
+        stop();
+        return false;
+    }
+    m_port = ntohs(addr.sin_port);
+
+    m_epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    m_event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((m_epoll_fd < 0) || (m_event_fd < 0)) {
+        LOGERROR("metrics http exporter epoll/eventfd creation failed, errno: {}", errno);
+        stop();
+        return false;
+    }
+
+    for (const auto fd : {m_listen_fd, m_event_fd}) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (::epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            LOGERROR("metrics http exporter epoll_ctl failed, errno: {}", errno);
+            stop();
+            return false;
+        }
+    }
+
+    m_thread = sisl::make_unique_thread("metrics_http", &MetricsHttpExporter::run, this);
+    LOGINFO("metrics http exporter listening on {}:{}", m_options.address, m_port);
+    return true;
+}
+
+bool MetricsHttpExporter::stop() {
+    bool ret{true};
+    if (m_thread) {
+        const uint64_t val{1};
+        if (::write(m_event_fd, &val, sizeof(val)) != sizeof(val)) {
+            LOGERROR("metrics http exporter stop notification failed, errno: {}", errno);
+            ret = false;
+        }
+        m_thread->join();
+        m_thread.reset();
+    }
+
+    for (auto& [fd, conn] : m_conns) {
+        ::close(fd);
+    }
+    m_conns.clear();
+    for (auto* fd : {&m_listen_fd, &m_epoll_fd, &m_event_fd}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+    return ret;
+}
+
+void MetricsHttpExporter::run() {
+    std::array< epoll_event, max_events > events;
+    while (true) {
+        const auto nevents{::epoll_wait(m_epoll_fd, events.data(), events.size(), -1)};
+        if (nevents < 0) {
+            if (errno == EINTR) { continue; }
+            LOGERROR("metrics http exporter epoll_wait failed, errno: {}", errno);
+            break;
+        }
+
+        for (int i{0}; i < nevents; ++i) {
+            const auto fd{events[i].data.fd};
+            if (fd == m_event_fd) {
+                LOGDEBUG("metrics http exporter shutdown signalled");
+                return;
+            }
+            if (fd == m_listen_fd) {
+                accept_connections();
+                continue;
+            }
+
+            const auto it{m_conns.find(fd)};
+            if (it == m_conns.end()) { continue; }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                close_connection(fd);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+                on_readable(fd, it->second); // Could close the connection
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) { on_writable(fd, it->second); }
+        }
+    }
+}
+
+void MetricsHttpExporter::accept_connections() {
+    while (true) {
+        const auto fd{::accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)};
+        if (fd < 0) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+                LOGWARN("metrics http exporter accept failed, errno: {}", errno);
+            }
+            if (errno == EINTR) { continue; }
+            return;
+        }
+
+        if (m_conns.size() >= m_options.max_connections) {
+            LOGWARN("metrics http exporter has reached max connections {}, rejecting", m_options.max_connections);
+            ::close(fd);
+            continue;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (::epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            LOGWARN("metrics http exporter epoll_ctl for connection failed, errno: {}", errno);
+            ::close(fd);
+            continue;
+        }
+        m_conns.try_emplace(fd);
+    }
+}
+
+void MetricsHttpExporter::close_connection(const int fd) {
+    ::epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    m_conns.erase(fd);
+}
+
+void MetricsHttpExporter::on_readable(const int fd, connection_t& conn) {
+    std::array< char, 4096 > buf;
+    bool peer_closed{false};
+    // Reading is paused beyond a request header worth of input, until the requests already read are served
+    while (conn.in.size() <= max_request_header_size) {
+        const auto n{::recv(fd, buf.data(), buf.size(), 0)};
+        if (n > 0) {
+            conn.in.append(buf.data(), n);
+        } else if (n == 0) {
+            peer_closed = true;
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            close_connection(fd);
+            return;
+        }
+    }
+
+    serve_requests(conn);
+    if (peer_closed && conn.out.empty()) {
+        close_connection(fd);
+        return;
+    }
+    if (peer_closed) { conn.close_after_write = true; }
+    on_writable(fd, conn);
+}
+
+void MetricsHttpExporter::on_writable(const int fd, connection_t& conn) {
+    bool was_waiting{false};
+    while (true) {
+        while (conn.out_offset < conn.out.size()) {
+            const auto n{
+                ::send(fd, conn.out.data() + conn.out_offset, conn.out.size() - conn.out_offset, MSG_NOSIGNAL)};
+            if (n >= 0) {
+                conn.out_offset += static_cast< size_t >(n);
+            } else if (errno == EINTR) {
+                continue;
+            } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                // Wait for the socket to drain, before writing rest of the response. Nothing more is read from a
+                // connection which is going to be closed, or which has too much output pending already.
+                epoll_event ev{};
+                ev.events = (conn.close_after_write || (conn.out.size() - conn.out_offset > max_pending_output_size))
+                    ? EPOLLOUT
+                    : (EPOLLIN | EPOLLOUT | EPOLLRDHUP);
+                ev.data.fd = fd;
+                ::epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+                return;
+            } else {
+                close_connection(fd);
+                return;
+            }
+        }
+
+        was_waiting = was_waiting || !conn.out.empty();
+        conn.out.clear();
+        conn.out_offset = 0;
+        if (conn.close_after_write) {
+            close_connection(fd);
+            return;
+        }
+
+        // Requests left unserved for the pending output, which the socket will not notify about again
+        serve_requests(conn);
+        if (conn.out.empty()) { break; }
+    }
+
+    if (was_waiting) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        ::epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    }
+}
+
+void MetricsHttpExporter::serve_requests(connection_t& conn) {
+    // Serve the complete (possibly pipelined) requests in the order received, until the output is too large
+    while (!conn.close_after_write && (conn.out.size() - conn.out_offset <= max_pending_output_size)) {
+        const auto end{conn.in.find("\r\n\r\n")};
+        if (end == std::string::npos) {
+            if (conn.in.size() > max_request_header_size) {
+                respond(conn, 431, "text/plain", "Request header too large\n", false, false, false /* keep_alive */);
+            }
+            break;
+        }
+        const auto header{conn.in.substr(0, end)};
+        conn.in.erase(0, end + 4);
+        if (!handle_request(header, conn)) { conn.close_after_write = true; }
+    }
+}
+
+bool MetricsHttpExporter::handle_request(const std::string& header, connection_t& conn) {
+    std::string_view lines{header};
+    const auto line_end{lines.find("\r\n")};
+    const auto request_line{lines.substr(0, line_end)};
+    lines.remove_prefix((line_end == std::string_view::npos) ? lines.size() : line_end + 2);
+
+    const auto sp1{request_line.find(' ')};
+    const auto sp2{(sp1 == std::string_view::npos) ? sp1 : request_line.find(' ', sp1 + 1)};
+    if (sp2 == std::string_view::npos) {
+        respond(conn, 400, "text/plain", "Malformed request line\n", false, false, false /* keep_alive */);
+        return false;
+    }
+    const auto method{request_line.substr(0, sp1)};
+    const auto target{request_line.substr(sp1 + 1, sp2 - sp1 - 1)};
+    const auto version{request_line.substr(sp2 + 1)};
+
+    bool keep_alive{version == "HTTP/1.1"};
+    bool accept_gzip{false};
+    bool has_body{false};
+    while (!lines.empty()) {
+        const auto end{lines.find("\r\n")};
+        const auto line{lines.substr(0, end)};
+        lines.remove_prefix((end == std::string_view::npos) ? lines.size() : end + 2);
+
+        const auto colon{line.find(':')};
+        if (colon == std::string_view::npos) { continue; }
+        const auto name{trim(line.substr(0, colon))};
+        const auto value{trim(line.substr(colon + 1))};
+        if (iequals(name, "Connection")) {
+            if (has_token(value, "close")) { keep_alive = false; }
+            if (has_token(value, "keep-alive")) { keep_alive = true; }
+        } else if (iequals(name, "Accept-Encoding")) {
+            accept_gzip = has_token(value, "gzip");
+        } else if (iequals(name, "Content-Length")) {
+            has_body = (value != "0");
+        } else if (iequals(name, "Transfer-Encoding")) {
+            has_body = true;
+        }
+    }
+
+    // Only the scrapes are served, a request with body is not expected, hence not parsed either
+    const bool head_only{method == "HEAD"};
+    if ((method != "GET") && !head_only) {
+        respond(conn, 405, "text/plain", "Only GET and HEAD are supported\n", false, false, false /* keep_alive */);
+        return false;
+    }
+    if (has_body) {
+        respond(conn, 400, "text/plain", "Request body is not supported\n", false, head_only, false /* keep_alive */);
+        return false;
+    }
+
+    const auto qmark{target.find('?')};
+    const auto path{target.substr(0, qmark)};
+    // Gather and status callbacks are user code, a failing one fails only the request
+    try {
+        if (path == "/metrics") {
+            bool gzipped{accept_gzip};
+            const auto& body{cached_body(m_text_cache, gzipped, false /* is_json */)};
+            respond(conn, 200, "text/plain; version=0.0.4; charset=utf-8", body, gzipped, head_only, keep_alive);
+        } else if (path == "/metrics.json") {
+            bool gzipped{accept_gzip};
+            const auto& body{cached_body(m_json_cache, gzipped, true /* is_json */)};
+            respond(conn, 200, "application/json", body, gzipped, head_only, keep_alive);
+        } else if ((path == "/status") && (m_options.sobject_mgr != nullptr)) {
+            auto body{status_body((qmark == std::string_view::npos) ? "" : std::string{target.substr(qmark + 1)})};
+            std::string gzip_body;
+            const bool gzipped{accept_gzip && gzip_compress(body, gzip_body)};
+            respond(conn, 200, "application/json", gzipped ? gzip_body : body, gzipped, head_only, keep_alive);
+        } else {
+            respond(conn, 404, "text/plain", "Not found\n", false, head_only, keep_alive);
+        }
+    } catch (const std::exception& e) {
+        LOGERROR("metrics http exporter failed to serve {}: {}", path, e.what());
+        respond(conn, 500, "text/plain", "Internal server error\n", false, head_only, keep_alive);
+    } catch (...) {
+        LOGERROR("metrics http exporter failed to serve {} with unknown exception", path);
+        respond(conn, 500, "text/plain", "Internal server error\n", false, head_only, keep_alive);
+    }
+    return keep_alive;
+}
+
+void MetricsHttpExporter::respond(connection_t& conn, const int status, const char* content_type,
+                                  const std::string& body, const bool gzipped, const bool head_only,
+                                  const bool keep_alive) {
+    fmt::format_to(std::back_inserter(conn.out),
+                   "HTTP/1.1 {} {}\r\nContent-Type: {}\r\nContent-Length: {}\r\n{}Connection: {}\r\n\r\n", status,
+                   status_text(status), content_type, body.size(), gzipped ? "Content-Encoding: gzip\r\n" : "",
+                   keep_alive ? "keep-alive" : "close");
+    if (!head_only) { conn.out.append(body); }
+    if (!keep_alive) { conn.close_after_write = true; }
+}
+
+const std::string& MetricsHttpExporter::cached_body(cached_body_t& cache, bool& gzip, const bool is_json) {
+    const auto now{std::chrono::steady_clock::now()};
+    if (!cache.valid || (now - cache.at >= std::chrono::milliseconds{m_options.cache_ms})) {
+        if (is_json) {
+            cache.body = MetricsFarm::getInstance().get_result_in_json_string();
+        } else {
+            MetricsFarm::getInstance().report(m_text_writer);
+            cache.body = m_text_writer.text();
+        }
+        cache.gzip_body.clear();
+        cache.at = now;
+        cache.valid = true;
+    }
+
+    if (!gzip) { return cache.body; }
+    if (cache.gzip_body.empty() && !gzip_compress(cache.body, cache.gzip_body)) {
+        LOGWARN("metrics http exporter gzip compression failed, serving uncompressed");
+        cache.gzip_body.clear();
+        gzip = false;
+        return cache.body;
+    }
+    return cache.gzip_body;
+}
+
+std::string MetricsHttpExporter::status_body(const std::string& query) {
+    status_request request;
+    std::string_view params{query};
+    while (!params.empty()) {
+        const auto amp{params.find('&')};
+        const auto param{params.substr(0, amp)};
+        params.remove_prefix((amp == std::string_view::npos) ? params.size() : amp + 1);
+
+        const auto eq{param.find('=')};
+        const auto key{url_decode(param.substr(0, eq))};
+        const auto value{(eq == std::string_view::npos) ? std::string{} : url_decode(param.substr(eq + 1))};
+        if (key == "type") {
+            request.obj_type = value;
+        } else if (key == "name") {
+            request.obj_name = value;
+        } else if (key == "path") {
+            std::string_view path{value};
+            while (!path.empty()) {
+                const auto slash{path.find('/')};
+                if (slash != 0) { request.obj_path.emplace_back(path.substr(0, slash)); }
+                path.remove_prefix((slash == std::string_view::npos) ? path.size() : slash + 1);
+            }
+        } else if (key == "recurse") {
+            request.do_recurse = (value.empty() || (value == "true") || (value == "1"));
+        } else if (key == "verbose") {
+            request.verbose_level = std::atoi(value.c_str());
+        } else if (key == "batch_size") {
+            request.batch_size = std::atoi(value.c_str());
+        } else if (key == "cursor") {
+            request.next_cursor = value;
+        }
+    }
+    return m_options.sobject_mgr->get_status(request).json.dump();
+}
+} // namespace sisl
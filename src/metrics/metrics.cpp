@@ -14,6 +14,10 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 #include <sisl/logging/logging.h>
 
 #include "sisl/metrics/metrics.hpp"
@@ -28,6 +32,7 @@ static std::atomic< bool > metrics_farm_initialized{false};
 
 /**************************** MetricsFarm ***********************************/
 Reporter& MetricsFarm::get_reporter() { return *getInstance().m_reporter; }
+GaugeCallbackRunner& MetricsFarm::get_gauge_cb_runner() { return getInstance().m_gauge_cb_runner; }
 
 MetricsFarm::MetricsFarm() {
     metrics_farm_initialized = true;
@@ -58,37 +63,126 @@ void MetricsFarm::deregister_metrics_group(MetricsGroupImplPtr mgrp_impl) {
 }
 
 nlohmann::json MetricsFarm::get_result_in_json(bool need_latest) {
+    std::lock_guard scrape_locked{m_scrape_lock};
+    const auto groups{snapshot_groups()};
+    const auto updated{test_and_clear_updated(groups, scrape_type::json)};
+    std::vector< nlohmann::json > results(groups.size());
+    foreach_group(groups, [this, need_latest, &updated, &results](const MetricsGroupImplPtr& mgroup, size_t idx) {
+        results[idx] = m_gather_opts.skip_unchanged ? mgroup->get_result_in_json_if_updated(need_latest, updated[idx])
+                                                    : mgroup->get_result_in_json(need_latest);
+    });
+
     nlohmann::json json;
-    auto locked{lock()};
-    for (auto& mgroup : m_mgroups) {
-        json[mgroup->get_group_name()][mgroup->get_instance_name()] = mgroup->get_result_in_json(need_latest);
+    for (size_t idx{0}; idx < groups.size(); ++idx) {
+        json[groups[idx]->get_group_name()][groups[idx]->get_instance_name()] = std::move(results[idx]);
     }
-
     return json;
 }
 
 std::string MetricsFarm::get_result_in_json_string(bool need_latest) { return get_result_in_json(need_latest).dump(); }
 
 std::string MetricsFarm::report(ReportFormat format) {
-    auto locked{lock()};
-    for (auto& mgroup : m_mgroups) {
-        mgroup->publish_result();
-    }
+    std::lock_guard scrape_locked{m_scrape_lock};
+    const auto groups{snapshot_groups()};
+    const auto updated{test_and_clear_updated(groups, scrape_type::report)};
+    foreach_group(groups, [&updated](const MetricsGroupImplPtr& mgroup, size_t idx) {
+        if (updated[idx]) { mgroup->publish_result(); }
+    });
 
     // Now everything is published to reporter, serialize them
     return m_reporter->serialize(format);
 }
 
+bool MetricsFarm::report(PrometheusTextWriter& writer) {
+    std::lock_guard scrape_locked{m_scrape_lock};
+    const auto groups{snapshot_groups()};
+    if (std::any_of(groups.cbegin(), groups.cend(), [](const MetricsGroupImplPtr& mgroup) {
+            return (mgroup->impl_type() == group_impl_type_t::thread_buf_signal);
+        })) {
+        ThreadBufferMetricsGroup::flush_core_cache();
+    }
+
+    // Samples of a family come from many groups, hence the writer is filled serially
+    writer.begin();
+    for (const auto& mgroup : groups) {
+        mgroup->write_prometheus_text(writer);
+    }
+    return writer.finish();
+}
+
 void MetricsFarm::gather() {
-    nlohmann::json json;
+    std::lock_guard scrape_locked{m_scrape_lock};
+    const auto groups{snapshot_groups()};
+    const auto updated{test_and_clear_updated(groups, scrape_type::gather)};
+    if (!m_gather_opts.skip_unchanged &&
+        std::any_of(groups.cbegin(), groups.cend(), [](const MetricsGroupImplPtr& mgroup) {
+            return (mgroup->impl_type() == group_impl_type_t::thread_buf_signal);
+        })) {
+        ThreadBufferMetricsGroup::flush_core_cache(); // Already done while clearing the updated groups otherwise
+    }
+
+    foreach_group(groups, [&updated](const MetricsGroupImplPtr& mgroup, size_t idx) {
+        if (updated[idx]) { mgroup->gather(); }
+    });
+}
+
+std::vector< bool > MetricsFarm::test_and_clear_updated(const std::vector< MetricsGroupImplPtr >& groups,
+                                                        const scrape_type type) {
+    std::vector< bool > updated(groups.size(), true);
+    if (!m_gather_opts.skip_unchanged) { return updated; }
+
+    for (size_t idx{0}; idx < groups.size(); ++idx) {
+        updated[idx] = groups[idx]->test_and_clear_updated(type);
+    }
+
+    // Pairs with mark_updated(): an update the cleared bits missed is visible to the reads of the values from here on
+    ThreadBufferMetricsGroup::flush_core_cache();
+    return updated;
+}
+
+void MetricsFarm::set_gather_options(const gather_options& opts) {
+    std::lock_guard scrape_locked{m_scrape_lock};
+    if (opts.skip_unchanged) {
+        MetricsGroupImpl::enable_update_tracking(!ThreadBufferMetricsGroup::flush_core_cache_covers_all_threads());
+    }
+    m_gather_opts = opts;
+}
+
+std::vector< MetricsGroupImplPtr > MetricsFarm::snapshot_groups() const {
     auto locked{lock()};
-    bool flushed{false};
-    for (auto& mgroup : m_mgroups) {
-        if (!flushed && (mgroup->impl_type() == group_impl_type_t::thread_buf_signal)) {
-            ThreadBufferMetricsGroup::flush_core_cache();
+    return std::vector< MetricsGroupImplPtr >(m_mgroups.cbegin(), m_mgroups.cend());
+}
+
+void MetricsFarm::foreach_group(const std::vector< MetricsGroupImplPtr >& groups,
+                                const std::function< void(const MetricsGroupImplPtr&, size_t) >& cb) const {
+    static constexpr size_t groups_per_batch{16};
+    const size_t nthreads{std::min< size_t >(std::max< uint32_t >(m_gather_opts.nthreads, 1),
+                                             (groups.size() + groups_per_batch - 1) / groups_per_batch)};
+    if (nthreads <= 1) {
+        for (size_t idx{0}; idx < groups.size(); ++idx) {
+            cb(groups[idx], idx);
         }
-        flushed = true;
-        mgroup->gather();
+        return;
+    }
+
+    // Threads pick the next batch of groups till all are done, the caller being one of them
+    std::atomic< size_t > next{0};
+    const auto worker{[&groups, &cb, &next]() {
+        for (size_t start{next.fetch_add(groups_per_batch)}; start < groups.size();
+             start = next.fetch_add(groups_per_batch)) {
+            for (size_t idx{start}; idx < std::min(start + groups_per_batch, groups.size()); ++idx) {
+                cb(groups[idx], idx);
+            }
+        }
+    }};
+
+    std::vector< std::thread > threads;
+    for (size_t t{1}; t < nthreads; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
     }
 }
 
@@ -15,6 +15,11 @@
  *
  *********************************************************************************/
 #include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <limits>
+#include <numeric>
+#include <thread>
 
 #if defined __clang__ or defined __GNUC__
 #pragma GCC diagnostic push
@@ -27,10 +32,12 @@
 
 #include <fmt/format.h>
 #include <sisl/logging/logging.h>
+#include <sisl/utility/thread_factory.hpp>
 
 #include "sisl/metrics/metrics_group_impl.hpp"
 #include "sisl/metrics/metrics.hpp"
 #include "sisl/metrics/metrics_tlocal.hpp"
+#include "sisl/metrics/prometheus_text_writer.hpp"
 
 namespace sisl {
 
@@ -47,6 +54,9 @@ MetricsGroupImplPtr MetricsGroup::make_group(const std::string& grp_name, const
     } else if (type == group_impl_type_t::atomic) {
         return std::dynamic_pointer_cast< MetricsGroupImpl >(
             std::make_shared< AtomicMetricsGroup >(grp_name, inst_name));
+    } else if (type == group_impl_type_t::per_cpu) {
+        return std::dynamic_pointer_cast< MetricsGroupImpl >(
+            std::make_shared< PerCpuMetricsGroup >(grp_name, inst_name));
     } else {
         return nullptr;
     }
@@ -113,6 +123,13 @@ uint64_t MetricsGroupStaticInfo::register_histogram(const std::string& name, con
     return m_histograms.size() - 1;
 }
 
+uint64_t MetricsGroupStaticInfo::register_summary(const std::string& name, const std::string& desc,
+                                                  const std::string& report_name, const metric_label& label_pair,
+                                                  const summary_quantiles_t& quantiles) {
+    m_summaries.emplace_back(name, desc, report_name, label_pair, quantiles);
+    return m_summaries.size() - 1;
+}
+
 std::shared_ptr< MetricsGroupStaticInfo > MetricsGroupStaticInfo::create_or_get_info(const std::string& grp_name) {
     static folly::Synchronized< std::unordered_map< std::string, std::shared_ptr< MetricsGroupStaticInfo > > > _grp_map;
 
@@ -134,6 +151,8 @@ MetricsGroupImpl::MetricsGroupImpl(const std::string& grp_name, const std::strin
 }
 
 MetricsGroupImpl::~MetricsGroupImpl() {
+    m_gauge_cbs.clear(); // Waits for the callbacks still running, before anything they could use is torn down
+
     for (size_t idx{0}; idx < m_counters_dinfo.size(); ++idx) {
         m_counters_dinfo[idx].unregister(m_static_info->m_counters[idx]);
     }
@@ -145,6 +164,10 @@ MetricsGroupImpl::~MetricsGroupImpl() {
     for (size_t idx{0}; idx < m_histograms_dinfo.size(); ++idx) {
         m_histograms_dinfo[idx].unregister(m_static_info->m_histograms[idx]);
     }
+
+    for (size_t idx{0}; idx < m_summaries_dinfo.size(); ++idx) {
+        m_summaries_dinfo[idx].unregister(m_static_info->m_summaries[idx]);
+    }
 }
 
 void MetricsGroupImpl::registration_completed() {
@@ -190,6 +213,32 @@ uint64_t MetricsGroupImpl::register_gauge(const std::string& name, const std::st
     return register_gauge(name, desc, "", label_pair);
 }
 
+uint64_t MetricsGroupImpl::register_gauge_cb(const std::string& name, const std::string& desc,
+                                             const gauge_value_cb_t& cb, const std::string& report_name,
+                                             const metric_label& label_pair, const std::chrono::milliseconds timeout) {
+    const auto idx = register_gauge(name, desc, report_name, label_pair);
+    m_gauge_cbs.emplace_back(idx, GaugeCallback{cb, timeout});
+    return idx;
+}
+
+uint64_t MetricsGroupImpl::register_gauge_cb(const std::string& name, const std::string& desc,
+                                             const gauge_value_cb_t& cb, const metric_label& label_pair,
+                                             const std::chrono::milliseconds timeout) {
+    return register_gauge_cb(name, desc, cb, "", label_pair, timeout);
+}
+
+uint64_t MetricsGroupImpl::register_gauge_cb(const std::string& name, const std::string& desc,
+                                             const gauge_value_cb_t& cb, const std::chrono::milliseconds timeout) {
+    return register_gauge_cb(name, desc, cb, "", {"", ""}, timeout);
+}
+
+LabeledCounterFamily& MetricsGroupImpl::register_labeled_counter(const std::string& name, const std::string& desc,
+                                                                const uint32_t max_label_sets) {
+    auto locked = lock();
+    m_labeled_counters.push_back(std::make_unique< LabeledCounterFamily >(name, desc, m_inst_name, max_label_sets));
+    return *m_labeled_counters.back();
+}
+
 uint64_t MetricsGroupImpl::register_histogram(const std::string& name, const std::string& desc,
                                               const std::string& report_name, const metric_label& label_pair,
                                               const hist_bucket_boundaries_t& bkt_boundaries, _publish_as ptype) {
@@ -218,14 +267,49 @@ uint64_t MetricsGroupImpl::register_histogram(const std::string& name, const std
     return register_histogram(name, desc, "", {"", ""}, HistogramBucketsType(DefaultBuckets), ptype);
 }
 
-void MetricsGroupImpl::gauge_update(uint64_t index, int64_t val) { m_gauge_values[index].update(val); }
+uint64_t MetricsGroupImpl::register_summary(const std::string& name, const std::string& desc,
+                                            const std::string& report_name, const metric_label& label_pair,
+                                            const summary_quantiles_t& quantiles) {
+    const auto idx = m_summaries_dinfo.size();
+    if (m_static_info->m_reg_pending) {
+        [[maybe_unused]] auto s_idx = m_static_info->register_summary(name, desc, report_name, label_pair, quantiles);
+        assert(idx == s_idx);
+    }
+    m_summaries_dinfo.emplace_back(m_static_info->m_summaries[idx], m_inst_name);
+    return idx;
+}
+
+uint64_t MetricsGroupImpl::register_summary(const std::string& name, const std::string& desc,
+                                            const metric_label& label_pair, const summary_quantiles_t& quantiles) {
+    return register_summary(name, desc, "", label_pair, quantiles);
+}
+
+uint64_t MetricsGroupImpl::register_summary(const std::string& name, const std::string& desc,
+                                            const summary_quantiles_t& quantiles) {
+    return register_summary(name, desc, "", {"", ""}, quantiles);
+}
+
+void MetricsGroupImpl::update_callback_gauges() {
+    std::lock_guard lg{m_gauge_cbs_mutex};
+    for (auto& [idx, gauge_cb] : m_gauge_cbs) {
+        const auto value{gauge_cb.evaluate(gauge_static_info(idx).name())};
+        if (value) { m_gauge_values[idx].update(*value); }
+    }
+}
+
+void MetricsGroupImpl::gauge_update(uint64_t index, int64_t val) {
+    m_gauge_values[index].update(val);
+    mark_updated();
+}
 
 nlohmann::json MetricsGroupImpl::get_result_in_json(bool need_latest) {
+    update_callback_gauges();
     auto locked = lock();
     nlohmann::json json;
     nlohmann::json counter_entries;
     nlohmann::json gauge_entries;
     nlohmann::json hist_entries;
+    nlohmann::json summary_entries;
 
     if (m_on_gather_cb) { m_on_gather_cb(); }
     gather_result(
@@ -247,11 +331,30 @@ nlohmann::json MetricsGroupImpl::get_result_in_json(bool need_latest) {
             } else {
                 hist_entries[hist_static_info(idx).desc()] = std::to_string(h.average(result));
             }
+        },
+        [&summary_entries, this](uint64_t idx, const SummaryValue& result) {
+            const auto& s = summary_static_info(idx);
+            nlohmann::json entry;
+            entry["count"] = result.count();
+            entry["avg"] = result.average();
+            for (const auto q : s.get_quantiles()) {
+                entry[fmt::format("p{:g}", q * 100)] = result.quantile(q);
+            }
+            summary_entries[s.desc()] = entry;
         });
 
     json["Counters"] = counter_entries;
     json["Gauges"] = gauge_entries;
     json["Histograms percentiles (usecs) avg/50/95/99"] = hist_entries;
+    if (num_summaries() != 0) { json["Summaries quantiles"] = summary_entries; }
+    if (!m_labeled_counters.empty()) {
+        nlohmann::json labeled_entries;
+        for (auto& family : m_labeled_counters) {
+            family->gather();
+            labeled_entries[family->desc()] = family->get_result_in_json();
+        }
+        json["Labeled counters"] = labeled_entries;
+    }
 
     for (auto& cg : m_child_groups) {
         json[cg->m_inst_name] = cg->get_result_in_json(need_latest);
@@ -260,13 +363,22 @@ nlohmann::json MetricsGroupImpl::get_result_in_json(bool need_latest) {
 }
 
 void MetricsGroupImpl::publish_result() {
+    update_callback_gauges();
     auto locked = lock();
     if (m_on_gather_cb) { m_on_gather_cb(); }
     gather_result(
         true, /* need_latest */
         [this](uint64_t idx, const CounterValue& result) { counter_dynamic_info(idx).publish(result); }, // Counter
         [this](uint64_t idx, const GaugeValue& result) { gauge_dynamic_info(idx).publish(result); },     // Gauge
-        [this](uint64_t idx, const HistogramValue& result) { hist_dynamic_info(idx).publish(result); }); // Histogram
+        [this](uint64_t idx, const HistogramValue& result) { hist_dynamic_info(idx).publish(result); }, // Histogram
+        [this](uint64_t idx, const SummaryValue& result) {
+            summary_dynamic_info(idx).publish(result, summary_static_info(idx));
+        }); // Summary
+
+    for (auto& family : m_labeled_counters) {
+        family->gather();
+        family->publish();
+    }
 
     // Call child group publish result
     for (auto& cg : m_child_groups) {
@@ -275,19 +387,78 @@ void MetricsGroupImpl::publish_result() {
 }
 
 void MetricsGroupImpl::gather() {
+    update_callback_gauges();
     auto locked = lock();
     if (m_on_gather_cb) { m_on_gather_cb(); }
     gather_result(
         true, /* need_latest */
         []([[maybe_unused]] uint64_t idx, [[maybe_unused]] const CounterValue& result) {},
         []([[maybe_unused]] uint64_t idx, [[maybe_unused]] const GaugeValue& result) {},
-        []([[maybe_unused]] uint64_t idx, [[maybe_unused]] const HistogramValue& result) {});
+        []([[maybe_unused]] uint64_t idx, [[maybe_unused]] const HistogramValue& result) {},
+        []([[maybe_unused]] uint64_t idx, [[maybe_unused]] const SummaryValue& result) {});
+    for (auto& family : m_labeled_counters) {
+        family->gather();
+    }
 
     for (auto& cg : m_child_groups) {
         cg->gather();
     }
 }
 
+void MetricsGroupImpl::write_prometheus_text(PrometheusTextWriter& writer) {
+    update_callback_gauges();
+    auto locked = lock();
+    if (m_on_gather_cb) { m_on_gather_cb(); }
+    gather_result(
+        true, /* need_latest */
+        [this, &writer](uint64_t idx, const CounterValue& result) {
+            counter_dynamic_info(idx).write_text(writer, counter_static_info(idx), result);
+        },
+        [this, &writer](uint64_t idx, const GaugeValue& result) {
+            gauge_dynamic_info(idx).write_text(writer, gauge_static_info(idx), result);
+        },
+        [this, &writer](uint64_t idx, const HistogramValue& result) {
+            hist_dynamic_info(idx).write_text(writer, hist_static_info(idx), result);
+        },
+        [this, &writer](uint64_t idx, const SummaryValue& result) {
+            summary_dynamic_info(idx).write_text(writer, summary_static_info(idx), result);
+        });
+    for (auto& family : m_labeled_counters) {
+        family->gather();
+        family->write_text(writer);
+    }
+
+    for (auto& cg : m_child_groups) {
+        cg->write_prometheus_text(writer);
+    }
+}
+
+bool MetricsGroupImpl::test_and_clear_updated(const scrape_type type) {
+    const auto bit{static_cast< uint8_t >(type)};
+    bool updated{(m_updated.fetch_and(~bit, std::memory_order_seq_cst) & bit) != 0};
+
+    auto locked = lock();
+    // Labeled counters do not mark the group updated, to keep their increments to a single thread local store
+    if (m_on_gather_cb || !m_gauge_cbs.empty() || !m_labeled_counters.empty()) { updated = true; }
+    for (auto& cg : m_child_groups) {
+        // Every child has to be cleared, hence no short circuit
+        if (cg->test_and_clear_updated(type)) { updated = true; }
+    }
+    return updated;
+}
+
+nlohmann::json MetricsGroupImpl::get_result_in_json_if_updated(const bool need_latest, const bool updated) {
+    if (updated || m_last_json.is_null()) {
+        auto json = get_result_in_json(need_latest);
+        auto locked = lock();
+        m_last_json = json;
+        return json;
+    }
+
+    auto locked = lock();
+    return m_last_json;
+}
+
 const std::string& MetricsGroupImpl::get_group_name() const { return m_static_info->m_grp_name; }
 const std::string& MetricsGroupImpl::get_instance_name() const { return m_inst_name; }
 
@@ -299,7 +470,8 @@ CounterStaticInfo::CounterStaticInfo(const std::string& name, const std::string&
 }
 
 CounterDynamicInfo::CounterDynamicInfo(const CounterStaticInfo& static_info, const std::string& instance_name,
-                                       _publish_as ptype) {
+                                       _publish_as ptype) :
+        m_text_labels{PrometheusTextWriter::make_labels(instance_name, static_info.m_label_pair)} {
     if (ptype == _publish_as::publish_as_counter) {
         m_report_counter_gauge = MetricsFarm::get_reporter().add_counter(static_info.m_name, static_info.m_desc,
                                                                          instance_name, static_info.m_label_pair);
@@ -317,6 +489,12 @@ void CounterDynamicInfo::publish(const CounterValue& value) {
     }
 }
 
+void CounterDynamicInfo::write_text(PrometheusTextWriter& writer, const CounterStaticInfo& static_info,
+                                    const CounterValue& value) const {
+    auto& samples{writer.family(static_info.m_name, static_info.m_desc, is_counter_reporter() ? "counter" : "gauge")};
+    PrometheusTextWriter::append_sample(samples, static_info.m_name, "", m_text_labels, "", value.get());
+}
+
 void CounterDynamicInfo::unregister(const CounterStaticInfo& static_info) {
     if (is_counter_reporter()) {
         MetricsFarm::get_reporter().remove_counter(static_info.m_name, as_counter());
@@ -332,27 +510,198 @@ GaugeStaticInfo::GaugeStaticInfo(const std::string& name, const std::string& des
     if (!label_pair.first.empty() && !label_pair.second.empty()) { m_label_pair = label_pair; }
 }
 
-GaugeDynamicInfo::GaugeDynamicInfo(const GaugeStaticInfo& static_info, const std::string& instance_name) {
+GaugeDynamicInfo::GaugeDynamicInfo(const GaugeStaticInfo& static_info, const std::string& instance_name) :
+        m_text_labels{PrometheusTextWriter::make_labels(instance_name, static_info.m_label_pair)} {
     m_report_gauge = MetricsFarm::get_reporter().add_gauge(static_info.m_name, static_info.m_desc, instance_name,
                                                            static_info.m_label_pair);
 }
 
 void GaugeDynamicInfo::publish(const GaugeValue& value) { m_report_gauge->set_value((double)value.get()); }
 
+void GaugeDynamicInfo::write_text(PrometheusTextWriter& writer, const GaugeStaticInfo& static_info,
+                                  const GaugeValue& value) const {
+    auto& samples{writer.family(static_info.m_name, static_info.m_desc, "gauge")};
+    PrometheusTextWriter::append_sample(samples, static_info.m_name, "", m_text_labels, "", value.get());
+}
+
 void GaugeDynamicInfo::unregister(const GaugeStaticInfo& static_info) {
     MetricsFarm::get_reporter().remove_gauge(static_info.m_name, m_report_gauge);
 }
 
+/***************************** GaugeCallback **************************/
+static std::optional< int64_t > call_gauge_cb(const gauge_value_cb_t& cb, const std::string& name) {
+    try {
+        return cb();
+    } catch (const std::exception& e) {
+        LOGWARN("Callback of gauge {} failed: {}", name, e.what());
+    } catch (...) { LOGWARN("Callback of gauge {} failed with unknown exception", name); }
+    return std::nullopt;
+}
+
+struct GaugeCallbackRunner::job_t {
+    enum class state_t : uint8_t { queued, running, done };
+
+    job_t(const std::shared_ptr< const gauge_value_cb_t >& c, const std::string& n) : cb{c}, name{n} {}
+
+    void run() {
+        {
+            std::lock_guard lg{mtx};
+            if (state != state_t::queued) { return; } // Cancelled
+            state = state_t::running;
+            cv.notify_all();
+        }
+        auto v{call_gauge_cb(*cb, name)};
+        std::lock_guard lg{mtx};
+        value = v;
+        state = state_t::done;
+        cv.notify_all();
+    }
+
+    // Makes sure the callback is not running, nor is going to run, after this returns
+    void cancel() {
+        std::unique_lock lk{mtx};
+        if (state == state_t::queued) {
+            state = state_t::done;
+            cv.notify_all();
+        }
+        cv.wait(lk, [this]() { return state == state_t::done; });
+    }
+
+    std::shared_ptr< const gauge_value_cb_t > cb;
+    std::string name;
+    std::mutex mtx;
+    std::condition_variable cv;
+    state_t state{state_t::queued};
+    std::optional< int64_t > value;
+    worker_t* worker{nullptr}; // Worker running it, protected by the runner mutex
+};
+
+GaugeCallbackRunner::~GaugeCallbackRunner() {
+    {
+        std::lock_guard lg{m_mutex};
+        m_stopped = true;
+    }
+    m_cv.notify_all();
+
+    // No worker is added or removed once stopped
+    for (auto& worker : m_workers) {
+        worker.thread->join();
+    }
+
+    // Nothing is going to run the jobs left in the queue, release whoever is waiting for them
+    for (auto& job : m_jobs) {
+        job->cancel();
+    }
+}
+
+bool GaugeCallbackRunner::submit(const std::shared_ptr< job_t >& job) {
+    std::lock_guard lg{m_mutex};
+    if (m_stopped) { return false; }
+    if (m_workers.empty()) {
+        for (size_t i{0}; i < num_workers; ++i) {
+            start_worker();
+        }
+    }
+    m_jobs.push_back(job);
+    m_cv.notify_one();
+    return true;
+}
+
+void GaugeCallbackRunner::overrun(const std::shared_ptr< job_t >& job) {
+    std::lock_guard lg{m_mutex};
+    if (m_stopped || (job->worker == nullptr) || job->worker->retired) { return; }
+    job->worker->retired = true;
+    reap_workers();
+    start_worker();
+}
+
+void GaugeCallbackRunner::start_worker() {
+    auto& worker{m_workers.emplace_back()};
+    worker.thread = sisl::make_unique_thread("gauge_cb_runner", &GaugeCallbackRunner::run, this, &worker);
+}
+
+void GaugeCallbackRunner::reap_workers() {
+    for (auto it{m_workers.begin()}; it != m_workers.end();) {
+        if (it->exited) {
+            it->thread->join(); // It has released the mutex as its last step
+            it = m_workers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void GaugeCallbackRunner::run(worker_t* const worker) {
+    std::unique_lock lk{m_mutex};
+    while (true) {
+        m_cv.wait(lk, [this]() { return m_stopped || !m_jobs.empty(); });
+        if (m_stopped) { break; }
+        auto job{std::move(m_jobs.front())};
+        m_jobs.pop_front();
+        job->worker = worker;
+
+        lk.unlock();
+        job->run();
+        lk.lock();
+
+        job->worker = nullptr;
+        if (worker->retired) { break; } // Replaced by another worker while the job was running
+    }
+    worker->exited = true;
+}
+
+GaugeCallback::GaugeCallback(const gauge_value_cb_t& cb, const std::chrono::milliseconds timeout) :
+        m_cb{std::make_shared< const gauge_value_cb_t >(cb)}, m_timeout{timeout} {}
+
+GaugeCallback::~GaugeCallback() {
+    if (m_pending) { m_pending->cancel(); }
+}
+
+std::optional< int64_t > GaugeCallback::evaluate(const std::string& name) {
+    using state_t = GaugeCallbackRunner::job_t::state_t;
+    if (m_timeout == std::chrono::milliseconds::zero()) { return call_gauge_cb(*m_cb, name); }
+
+    if (m_pending) {
+        std::lock_guard lg{m_pending->mtx};
+        if (m_pending->state != state_t::done) { return std::nullopt; } // Previous call is still stuck, don't pile up
+    }
+    m_pending.reset();
+
+    auto& runner{MetricsFarm::get_gauge_cb_runner()};
+    auto job{std::make_shared< GaugeCallbackRunner::job_t >(m_cb, name)};
+    if (!runner.submit(job)) { return std::nullopt; }
+
+    // Timeout is from when a worker picks the job, which is prompt since the stuck workers are replaced
+    std::unique_lock lk{job->mtx};
+    job->cv.wait(lk, [&job]() { return job->state != state_t::queued; });
+    if (job->cv.wait_for(lk, m_timeout, [&job]() { return job->state == state_t::done; })) { return job->value; }
+    LOGWARN("Callback of gauge {} did not complete in {} ms, retaining its previous value", name, m_timeout.count());
+    lk.unlock();
+    runner.overrun(job);
+    m_pending = std::move(job);
+    return std::nullopt;
+}
+
 /***************************** HistogramStaticInfo **************************/
 HistogramStaticInfo::HistogramStaticInfo(const std::string& name, const std::string& desc,
                                          const std::string& report_name, const metric_label& label_pair,
                                          const hist_bucket_boundaries_t& bkt_boundaries) :
-        m_name(report_name.empty() ? name : report_name), m_desc(desc), m_bkt_boundaries(bkt_boundaries) {
+        m_name(report_name.empty() ? name : report_name),
+        m_desc(desc),
+        m_bkt_boundaries(bkt_boundaries),
+        m_log_linear(HistogramBuckets::getInstance().is_log_linear(bkt_boundaries)) {
     if (!label_pair.first.empty() && !label_pair.second.empty()) { m_label_pair = label_pair; }
+
+    m_le_labels.reserve(m_bkt_boundaries.size() + 1);
+    for (const auto b : m_bkt_boundaries) {
+        m_le_labels.push_back(PrometheusTextWriter::make_extra_label("le", b));
+    }
+    m_le_labels.push_back(PrometheusTextWriter::make_extra_label("le", std::numeric_limits< double >::infinity()));
 }
 
 HistogramDynamicInfo::HistogramDynamicInfo(const HistogramStaticInfo& static_info, const std::string& instance_name,
-                                           _publish_as ptype) {
+                                           _publish_as ptype) :
+        m_text_labels{PrometheusTextWriter::make_labels(instance_name, static_info.m_label_pair)} {
     if (ptype == _publish_as::publish_as_histogram) {
         m_report_histogram_gauge =
             MetricsFarm::get_reporter().add_histogram(static_info.m_name, static_info.m_desc, instance_name,
@@ -373,6 +722,27 @@ void HistogramDynamicInfo::publish(const HistogramValue& hvalue) {
     }
 }
 
+void HistogramDynamicInfo::write_text(PrometheusTextWriter& writer, const HistogramStaticInfo& static_info,
+                                      const HistogramValue& hvalue) const {
+    const auto& name{static_info.m_name};
+    if (!is_histogram_reporter()) {
+        auto& samples{writer.family(name, static_info.m_desc, "gauge")};
+        PrometheusTextWriter::append_sample(samples, name, "", m_text_labels, "", average(hvalue));
+        return;
+    }
+
+    auto& samples{writer.family(name, static_info.m_desc, "histogram")};
+    const auto& freqs{hvalue.get_freqs()};
+    const auto& le_labels{static_info.le_labels()};
+    int64_t cum_freq{0};
+    for (size_t i{0}; i < le_labels.size(); ++i) {
+        cum_freq += freqs[i];
+        PrometheusTextWriter::append_sample(samples, name, "_bucket", m_text_labels, le_labels[i], cum_freq);
+    }
+    PrometheusTextWriter::append_sample(samples, name, "_sum", m_text_labels, "", hvalue.get_sum());
+    PrometheusTextWriter::append_sample(samples, name, "_count", m_text_labels, "", cum_freq);
+}
+
 double HistogramDynamicInfo::percentile(const HistogramValue& hvalue, const hist_bucket_boundaries_t& bkt_boundaries,
                                         const float pcntl) const {
     assert((pcntl > 0.0f) && (pcntl <= 100.0f));
@@ -419,4 +789,79 @@ void HistogramDynamicInfo::unregister(const HistogramStaticInfo& static_info) {
         MetricsFarm::get_reporter().remove_gauge(static_info.m_name, as_gauge());
     }
 }
+
+/***************************** SummaryValue **************************/
+uint64_t SummaryValue::count() const {
+    return std::accumulate(std::cbegin(m_counts), std::cend(m_counts), static_cast< uint64_t >(0));
+}
+
+double SummaryValue::average() const {
+    const auto cnt = count();
+    return (cnt ? static_cast< double >(m_sum) / static_cast< double >(cnt) : 0.0);
+}
+
+double SummaryValue::quantile(const double q) const {
+    assert((q > 0.0) && (q <= 1.0));
+    const auto total{count()};
+    if (total == 0) { return 0.0; }
+
+    const auto rank{std::clamp(static_cast< uint64_t >(std::ceil(q * static_cast< double >(total))),
+                               static_cast< uint64_t >(1), total)};
+    uint64_t cum_count{0};
+    size_t idx{0};
+    for (; idx < m_counts.size(); ++idx) {
+        cum_count += m_counts[idx];
+        if (cum_count >= rank) { break; }
+    }
+
+    // Buckets in the first two ranges hold exactly one value each, beyond that take the midpoint of the bucket
+    if (idx < 2 * SummaryBuckets_t::sub_buckets) { return static_cast< double >(idx); }
+    const auto lower{static_cast< double >(SummaryBuckets_t::bucket_lower_bound(idx))};
+    if (idx >= SummaryBuckets_t::num_buckets) { return lower; }
+    return lower + (static_cast< double >(SummaryBuckets_t::bucket_upper_bound(idx)) - lower) / 2;
+}
+
+/***************************** SummaryStaticInfo **************************/
+SummaryStaticInfo::SummaryStaticInfo(const std::string& name, const std::string& desc, const std::string& report_name,
+                                     const metric_label& label_pair, const summary_quantiles_t& quantiles) :
+        m_name(report_name.empty() ? name : report_name), m_desc(desc), m_quantiles(quantiles) {
+    if (!label_pair.first.empty() && !label_pair.second.empty()) { m_label_pair = label_pair; }
+
+    m_quantile_labels.reserve(m_quantiles.size());
+    for (const auto q : m_quantiles) {
+        m_quantile_labels.push_back(PrometheusTextWriter::make_extra_label("quantile", q));
+    }
+}
+
+SummaryDynamicInfo::SummaryDynamicInfo(const SummaryStaticInfo& static_info, const std::string& instance_name) :
+        m_text_labels{PrometheusTextWriter::make_labels(instance_name, static_info.m_label_pair)} {
+    m_report_summary = MetricsFarm::get_reporter().add_summary(static_info.m_name, static_info.m_desc, instance_name,
+                                                               static_info.m_quantiles, static_info.m_label_pair);
+}
+
+void SummaryDynamicInfo::publish(const SummaryValue& svalue, const SummaryStaticInfo& static_info) {
+    std::vector< double > values;
+    values.reserve(static_info.m_quantiles.size());
+    for (const auto q : static_info.m_quantiles) {
+        values.push_back(svalue.quantile(q));
+    }
+    m_report_summary->set_value(values, svalue.count(), static_cast< double >(svalue.get_sum()));
+}
+
+void SummaryDynamicInfo::write_text(PrometheusTextWriter& writer, const SummaryStaticInfo& static_info,
+                                    const SummaryValue& svalue) const {
+    const auto& name{static_info.m_name};
+    auto& samples{writer.family(name, static_info.m_desc, "summary")};
+    for (size_t i{0}; i < static_info.m_quantiles.size(); ++i) {
+        PrometheusTextWriter::append_sample(samples, name, "", m_text_labels, static_info.m_quantile_labels[i],
+                                            svalue.quantile(static_info.m_quantiles[i]));
+    }
+    PrometheusTextWriter::append_sample(samples, name, "_sum", m_text_labels, "", svalue.get_sum());
+    PrometheusTextWriter::append_sample(samples, name, "_count", m_text_labels, "",
+                                        static_cast< int64_t >(svalue.count()));
+}
+
+void SummaryDynamicInfo::unregister(const SummaryStaticInfo& static_info) {
+    MetricsFarm::get_reporter().remove_summary(static_info.m_name, m_report_summary);
+}
 } // namespace sisl
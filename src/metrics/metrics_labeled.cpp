@@ -0,0 +1,198 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <mutex>
+
+#include "sisl/metrics/metrics.hpp"
+#include "sisl/metrics/metrics_labeled.hpp"
+#include "sisl/metrics/prometheus_text_writer.hpp"
+
+namespace sisl {
+static constexpr const char* overflow_label_value{"__overflow__"};
+static constexpr const char* instance_label_name{"entity"}; // Label every metric gets for its instance name
+static constexpr const char* renamed_instance_label_name{"exported_entity"};
+
+static std::string label_set_key(const metric_labels_t& labels) {
+    std::string key;
+    for (const auto& [name, value] : labels) {
+        // Separators are control characters which are not expected in label names or values
+        key.append(name).push_back('\x1f');
+        key.append(value).push_back('\x1e');
+    }
+    return key;
+}
+
+/////////////////////////////// LabeledValues ///////////////////////////////
+LabeledValues::LabeledValues(const uint32_t num_values) : m_chunks((num_values + chunk_size - 1) / chunk_size) {}
+
+LabeledValues::~LabeledValues() {
+    for (auto& chunk : m_chunks) {
+        delete chunk.load(std::memory_order_relaxed);
+    }
+}
+
+LabeledValues::chunk_t* LabeledValues::new_chunk(const uint32_t chunk_num) {
+    auto* chunk{new chunk_t{}};
+    m_chunks[chunk_num].store(chunk, std::memory_order_release);
+    return chunk;
+}
+
+void LabeledValues::merge_into(std::vector< int64_t >& values) const {
+    for (size_t c{0}; c < m_chunks.size(); ++c) {
+        const auto* chunk{m_chunks[c].load(std::memory_order_acquire)};
+        if (chunk == nullptr) { continue; }
+        const auto base{c * chunk_size};
+        for (size_t i{0}; (i < chunk_size) && (base + i < values.size()); ++i) {
+            values[base + i] += (*chunk)[i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/////////////////////////////// LabeledCounterFamily ///////////////////////////////
+LabeledCounterFamily::LabeledCounterFamily(const std::string& name, const std::string& desc,
+                                           const std::string& instance_name, const uint32_t max_label_sets) :
+        m_name{name},
+        m_desc{desc},
+        m_instance_name{instance_name},
+        m_max_label_sets{max_label_sets},
+        m_values{max_label_sets + 1}, // Last one is the overflow set
+        m_exited_values(max_label_sets + 1, 0),
+        m_gathered(max_label_sets + 1, 0) {}
+
+LabeledCounterFamily::~LabeledCounterFamily() {
+    auto& reporter{MetricsFarm::get_reporter()};
+    for (auto& set : m_label_sets) {
+        if (set.report_counter) { reporter.remove_counter(m_name, set.report_counter); }
+    }
+    if (m_overflow_set && m_overflow_set->report_counter) {
+        reporter.remove_counter(m_name, m_overflow_set->report_counter);
+    }
+}
+
+LabeledCounter LabeledCounterFamily::with_label_set(const metric_labels_t& labels) {
+    auto key{label_set_key(labels)};
+    auto& cache{m_values->m_index_cache};
+    if (const auto it{cache.find(key)}; it != cache.end()) { return LabeledCounter{this, it->second}; }
+
+    const auto idx{resolve(key, labels)};
+    // Overflowed label sets are not cached, otherwise an unbounded cardinality grows every thread's cache instead
+    if (idx != overflow_index()) { cache.emplace(std::move(key), idx); }
+    return LabeledCounter{this, idx};
+}
+
+uint32_t LabeledCounterFamily::resolve(const std::string& key, const metric_labels_t& labels) {
+    {
+        std::shared_lock lk{m_mutex};
+        if (const auto it{m_index.find(key)}; it != m_index.end()) { return it->second; }
+        if (m_overflow_set) { return overflow_index(); }
+    }
+
+    std::unique_lock lk{m_mutex};
+    if (const auto it{m_index.find(key)}; it != m_index.end()) { return it->second; }
+    if (m_label_sets.size() < m_max_label_sets) {
+        const auto idx{static_cast< uint32_t >(m_label_sets.size())};
+        m_label_sets.push_back(make_label_set(labels));
+        m_index.emplace(key, idx);
+        return idx;
+    }
+
+    if (!m_overflow_set) {
+        auto overflow_labels{labels};
+        for (auto& label : overflow_labels) {
+            label.second = overflow_label_value;
+        }
+        m_overflow_set = std::make_unique< label_set_t >(make_label_set(overflow_labels));
+    }
+    return overflow_index();
+}
+
+LabeledCounterFamily::label_set_t LabeledCounterFamily::make_label_set(const metric_labels_t& labels) const {
+    // A user label clashing with the instance label is renamed, the way prometheus renames clashing target labels
+    auto set_labels{labels};
+    for (auto& label : set_labels) {
+        if (label.first == instance_label_name) { label.first = renamed_instance_label_name; }
+    }
+    auto text_labels{PrometheusTextWriter::make_labels(m_instance_name, set_labels)};
+    return label_set_t{std::move(set_labels), std::move(text_labels), nullptr};
+}
+
+void LabeledCounterFamily::gather() {
+    m_gathered = m_exited_values;
+    m_values.access_all_threads([this](LabeledValues* values, const bool is_running,
+                                       [[maybe_unused]] const bool is_last_thread) {
+        if (is_running) {
+            values->merge_into(m_gathered);
+            return false;
+        }
+
+        // Fold the values of an exited thread once, so its buffer can be freed
+        if (!values->m_folded) {
+            values->merge_into(m_exited_values);
+            values->merge_into(m_gathered);
+            values->m_folded = true;
+        }
+        return true;
+    });
+}
+
+template < typename CB >
+void LabeledCounterFamily::foreach_label_set(const CB& cb) const {
+    for (size_t i{0}; i < m_label_sets.size(); ++i) {
+        cb(m_label_sets[i], m_gathered[i]);
+    }
+    if (m_overflow_set) { cb(*m_overflow_set, m_gathered[overflow_index()]); }
+}
+
+nlohmann::json LabeledCounterFamily::get_result_in_json() const {
+    nlohmann::json json = nlohmann::json::object();
+    std::shared_lock lk{m_mutex};
+    foreach_label_set([&json](const label_set_t& set, const int64_t value) {
+        std::string key;
+        for (const auto& [name, label_value] : set.labels) {
+            if (!key.empty()) { key.push_back(','); }
+            key.append(name).append("=").append(label_value);
+        }
+        json[key] = value;
+    });
+    return json;
+}
+
+void LabeledCounterFamily::publish() {
+    // Report counters are created lazily, as the label sets show up between the scrapes
+    std::unique_lock lk{m_mutex};
+    auto publish_set = [this](label_set_t& set, const int64_t value) {
+        if (!set.report_counter) {
+            set.report_counter =
+                MetricsFarm::get_reporter().add_labeled_counter(m_name, m_desc, m_instance_name, set.labels);
+        }
+        set.report_counter->set_value(static_cast< double >(value));
+    };
+    for (size_t i{0}; i < m_label_sets.size(); ++i) {
+        publish_set(m_label_sets[i], m_gathered[i]);
+    }
+    if (m_overflow_set) { publish_set(*m_overflow_set, m_gathered[overflow_index()]); }
+}
+
+void LabeledCounterFamily::write_text(PrometheusTextWriter& writer) const {
+    std::shared_lock lk{m_mutex};
+    if (m_label_sets.empty()) { return; }
+
+    auto& samples{writer.family(m_name, m_desc, "counter")};
+    foreach_label_set([&samples, this](const label_set_t& set, const int64_t value) {
+        PrometheusTextWriter::append_sample(samples, m_name, "", set.text_labels, "", value);
+    });
+}
+} // namespace sisl
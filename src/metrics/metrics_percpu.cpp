@@ -0,0 +1,241 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+#include "sisl/metrics/metrics_percpu.hpp"
+
+// asm goto with output operands, which the rseq add needs, is supported from gcc 11 and clang 11
+#if defined(__clang__)
+#define SISL_METRICS_ASM_GOTO_OUTPUT (__clang_major__ >= 11)
+#elif defined(__GNUC__)
+#define SISL_METRICS_ASM_GOTO_OUTPUT (__GNUC__ >= 11)
+#else
+#define SISL_METRICS_ASM_GOTO_OUTPUT 0
+#endif
+
+#if defined(__linux__) && defined(__x86_64__) && defined(__NR_rseq) && SISL_METRICS_ASM_GOTO_OUTPUT
+#define SISL_METRICS_RSEQ
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h> // glibc 2.35 onwards registers rseq for every thread, see __rseq_size
+#define SISL_METRICS_GLIBC_RSEQ
+#else
+#include <linux/rseq.h>
+#endif
+#endif
+
+namespace sisl {
+#ifdef SISL_METRICS_RSEQ
+// Signature the kernel expects right before the abort handler, same as what glibc registers with on x86_64
+static constexpr uint32_t rseq_signature{0x53053053};
+static constexpr uint32_t rseq_abi_size{32}; // Size of the original struct rseq, accepted by every kernel with rseq
+
+struct rseq_thread_state {
+    bool checked;
+    bool enabled;
+    ptrdiff_t offset; // Offset of the struct rseq of this thread from the thread pointer
+};
+static thread_local rseq_thread_state t_rseq{false, false, 0};
+static thread_local struct rseq t_rseq_area; // Used only when glibc has not registered one for us
+
+static bool register_rseq() {
+#ifdef SISL_METRICS_GLIBC_RSEQ
+    if (__rseq_size > 0) {
+        t_rseq.offset = __rseq_offset;
+        return true;
+    }
+#endif
+    if (::syscall(__NR_rseq, &t_rseq_area, rseq_abi_size, 0, rseq_signature) != 0) { return false; }
+    t_rseq.offset = reinterpret_cast< char* >(&t_rseq_area) - static_cast< char* >(__builtin_thread_pointer());
+    return true;
+}
+
+static inline bool rseq_enabled() {
+    if (!t_rseq.checked) {
+        t_rseq.enabled = register_rseq();
+        t_rseq.checked = true;
+    }
+    return t_rseq.enabled;
+}
+
+// cpu_id field of the struct rseq, which is above any valid cpu number if the registration has failed
+static inline uint32_t rseq_cpu_id() {
+    const auto* area{reinterpret_cast< const volatile struct rseq* >(static_cast< char* >(__builtin_thread_pointer()) +
+                                                                     t_rseq.offset)};
+    return area->cpu_id;
+}
+
+/* Adds count to *v, provided the thread is still running on the given cpu when the add is done. Kernel restarts the
+ * sequence from the abort handler if the thread is preempted, migrated or signalled in between, in which case this
+ * returns false. The add being the last instruction of the sequence, it is either done once on the given cpu or not
+ * done at all. */
+static inline bool rseq_add(int64_t* const v, const int64_t count, const uint32_t cpu) {
+    __asm__ __volatile__ goto(
+        // Critical section descriptor: version, flags, start_ip, post_commit_offset, abort_ip
+        ".pushsection __rseq_cs, \"aw\"\n\t"
+        ".balign 32\n\t"
+        "3:\n\t"
+        ".long 0x0, 0x0\n\t"
+        ".quad 1f, (2f - 1f), 4f\n\t"
+        ".popsection\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, %%fs:8(%[rseq_offset])\n\t" // struct rseq::rseq_cs
+        "1:\n\t"
+        "cmpl %[cpu], %%fs:4(%[rseq_offset])\n\t" // struct rseq::cpu_id
+        "jnz 4f\n\t"
+        "addq %[count], %[v]\n\t"
+        "2:\n\t"
+        ".pushsection __rseq_failure, \"ax\"\n\t"
+        ".byte 0x0f, 0xb9, 0x3d\n\t" // ud1 with the signature as displacement, never executed
+        ".long 0x53053053\n\t"
+        "4:\n\t"
+        "jmp %l[abort]\n\t"
+        ".popsection\n\t"
+        : [v] "+m"(*v)
+        : [cpu] "r"(cpu), [rseq_offset] "r"(t_rseq.offset), [count] "er"(count)
+        : "memory", "cc", "rax"
+        : abort);
+    return true;
+abort:
+    return false;
+}
+#endif
+
+bool PerCpuMetricsGroup::is_rseq_enabled() {
+#ifdef SISL_METRICS_RSEQ
+    return rseq_enabled() && (rseq_cpu_id() < static_cast< uint32_t >(get_nprocs_conf()));
+#else
+    return false;
+#endif
+}
+
+void PerCpuMetricsGroup::on_register() {
+    m_ncpus = static_cast< uint32_t >(std::max(get_nprocs_conf(), 1));
+    m_hist_offset = num_counters();
+    m_summary_offset = m_hist_offset + (num_histograms() * hist_slab_values);
+
+    const auto values_per_line{std::tuple_size_v< decltype(cache_line_t::values) >};
+    const auto lines{(m_summary_offset + (num_summaries() * summary_slab_values) + values_per_line - 1) /
+                     values_per_line};
+    m_slab_size = std::max< uint64_t >(lines, 1) * values_per_line;
+
+    // std::make_unique<[]> will allocate and value initialize
+    m_slabs = std::make_unique< cache_line_t[] >(2 * m_ncpus * m_slab_size / values_per_line);
+}
+
+void PerCpuMetricsGroup::add(const uint64_t offset, const int64_t val) {
+#ifdef SISL_METRICS_RSEQ
+    if (rseq_enabled()) {
+        uint32_t cpu;
+        while ((cpu = rseq_cpu_id()) < m_ncpus) {
+            if (rseq_add(slab(cpu) + offset, val, cpu)) { return; }
+        }
+    }
+#endif
+    // Fallback slabs are kept apart, as the cpu given by sched_getcpu() could be stale by the time of the add
+    const auto cpu{::sched_getcpu()};
+    const auto slab_num{m_ncpus + ((cpu < 0) ? 0 : (static_cast< uint32_t >(cpu) % m_ncpus))};
+    std::atomic_ref< int64_t >{slab(slab_num)[offset]}.fetch_add(val, std::memory_order_relaxed);
+}
+
+int64_t PerCpuMetricsGroup::sum_all_cpus(const uint64_t offset) const {
+    int64_t sum{0};
+    for (uint32_t s{0}; s < 2 * m_ncpus; ++s) {
+        sum += std::atomic_ref< int64_t >{slab(s)[offset]}.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void PerCpuMetricsGroup::gather_result([[maybe_unused]] bool need_latest, const counter_gather_cb_t& counter_cb,
+                                       const gauge_gather_cb_t& gauge_cb, const histogram_gather_cb_t& histogram_cb,
+                                       const summary_gather_cb_t& summary_cb) {
+    for (size_t i{0}; i < num_counters(); ++i) {
+        CounterValue c{};
+        c.m_value = sum_all_cpus(i);
+        counter_cb(i, c);
+    }
+
+    for (size_t i{0}; i < num_gauges(); ++i) {
+        gauge_cb(i, m_gauge_values[i]);
+    }
+
+    for (size_t i{0}; i < num_histograms(); ++i) {
+        const auto base{m_hist_offset + (i * hist_slab_values)};
+        HistogramValue h{};
+        for (size_t b{0}; b < h.m_freqs.size(); ++b) {
+            h.m_freqs[b] = sum_all_cpus(base + b);
+        }
+        h.m_sum = sum_all_cpus(base + h.m_freqs.size());
+        histogram_cb(i, h);
+    }
+
+    for (size_t i{0}; i < num_summaries(); ++i) {
+        const auto base{m_summary_offset + (i * summary_slab_values)};
+        SummaryValue s{};
+        for (size_t b{0}; b < s.m_counts.size(); ++b) {
+            s.m_counts[b] = static_cast< uint64_t >(sum_all_cpus(base + b));
+        }
+        s.m_sum = sum_all_cpus(base + s.m_counts.size());
+        summary_cb(i, s);
+    }
+}
+
+void PerCpuMetricsGroup::counter_increment(uint64_t index, int64_t val) {
+    add(index, val);
+    mark_updated();
+}
+
+void PerCpuMetricsGroup::counter_decrement(uint64_t index, int64_t val) {
+    add(index, -val);
+    mark_updated();
+}
+
+// Bucket and sum are two separate adds, a gather in between could see one without the other, same as atomic groups
+void PerCpuMetricsGroup::histogram_observe(uint64_t index, int64_t val) {
+    const auto base{m_hist_offset + (index * hist_slab_values)};
+    add(base + hist_static_info(index).bucket_index(val), 1);
+    add(base + HistogramBuckets::max_hist_bkts, val);
+    mark_updated();
+}
+
+void PerCpuMetricsGroup::histogram_observe(uint64_t index, int64_t val, uint64_t count) {
+    const auto base{m_hist_offset + (index * hist_slab_values)};
+    add(base + hist_static_info(index).bucket_index(val), static_cast< int64_t >(count));
+    add(base + HistogramBuckets::max_hist_bkts, val * static_cast< int64_t >(count));
+    mark_updated();
+}
+
+void PerCpuMetricsGroup::summary_observe(uint64_t index, int64_t val) {
+    const auto base{m_summary_offset + (index * summary_slab_values)};
+    add(base + SummaryBuckets_t::bucket_index(val), 1);
+    add(base + SummaryBuckets_t::num_buckets + 1, val);
+    mark_updated();
+}
+
+void PerCpuMetricsGroup::summary_observe(uint64_t index, int64_t val, uint64_t count) {
+    const auto base{m_summary_offset + (index * summary_slab_values)};
+    add(base + SummaryBuckets_t::bucket_index(val), static_cast< int64_t >(count));
+    add(base + SummaryBuckets_t::num_buckets + 1, val * static_cast< int64_t >(count));
+    mark_updated();
+}
+} // namespace sisl
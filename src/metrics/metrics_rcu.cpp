@@ -20,17 +20,20 @@
 namespace sisl {
 
 void WisrBufferMetricsGroup::on_register() {
-    m_metrics = std::make_unique< WisrBufferMetrics >(m_static_info->m_histograms, num_counters(), num_histograms());
+    m_metrics = std::make_unique< WisrBufferMetrics >(m_static_info->m_histograms, num_counters(), num_histograms(),
+                                                      num_summaries());
 }
 
 void WisrBufferMetricsGroup::counter_increment(uint64_t index, int64_t val) {
     auto m{m_metrics->insert_access()};
     m->get_counter(index).increment(val);
+    mark_updated();
 }
 
 void WisrBufferMetricsGroup::counter_decrement(uint64_t index, int64_t val) {
     auto m{m_metrics->insert_access()};
     m->get_counter(index).decrement(val);
+    mark_updated();
 }
 
 // If we were to call the method with count parameter and compiler inlines them, binaries linked with libsisl gets
@@ -39,17 +42,32 @@ void WisrBufferMetricsGroup::counter_decrement(uint64_t index, int64_t val) {
 // one with count and one without count. In any case this is a single line method.
 void WisrBufferMetricsGroup::histogram_observe(uint64_t index, int64_t val) {
     auto m{m_metrics->insert_access()};
-    m->get_histogram(index).observe(val, hist_static_info(index).get_boundaries(), 1);
+    m->get_histogram(index).observe(val, hist_static_info(index).bucket_index(val), 1);
+    mark_updated();
 }
 
 void WisrBufferMetricsGroup::histogram_observe(uint64_t index, int64_t val, uint64_t count) {
     auto m{m_metrics->insert_access()};
-    m->get_histogram(index).observe(val, hist_static_info(index).get_boundaries(), count);
+    m->get_histogram(index).observe(val, hist_static_info(index).bucket_index(val), count);
+    mark_updated();
+}
+
+void WisrBufferMetricsGroup::summary_observe(uint64_t index, int64_t val) {
+    auto m{m_metrics->insert_access()};
+    m->get_summary(index).observe(val, 1);
+    mark_updated();
+}
+
+void WisrBufferMetricsGroup::summary_observe(uint64_t index, int64_t val, uint64_t count) {
+    auto m{m_metrics->insert_access()};
+    m->get_summary(index).observe(val, count);
+    mark_updated();
 }
 
 void WisrBufferMetricsGroup::gather_result(bool need_latest, const counter_gather_cb_t& counter_cb,
                                            const gauge_gather_cb_t& gauge_cb,
-                                           const histogram_gather_cb_t& histogram_cb) {
+                                           const histogram_gather_cb_t& histogram_cb,
+                                           const summary_gather_cb_t& summary_cb) {
     PerThreadMetrics* tmetrics;
     if (need_latest) {
         tmetrics = m_metrics->now();
@@ -68,5 +86,9 @@ void WisrBufferMetricsGroup::gather_result(bool need_latest, const counter_gathe
     for (size_t i{0}; i < num_histograms(); ++i) {
         histogram_cb(i, tmetrics->get_histogram(i));
     }
+
+    for (size_t i{0}; i < num_summaries(); ++i) {
+        summary_cb(i, tmetrics->get_summary(i));
+    }
 }
 } // namespace sisl
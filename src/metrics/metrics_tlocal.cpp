@@ -18,6 +18,12 @@
 #include <iostream>
 #include <mutex>
 
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include <sisl/logging/logging.h>
 
 #include "sisl/metrics/metrics_tlocal.hpp"
@@ -25,12 +31,14 @@
 namespace sisl {
 
 PerThreadMetrics::PerThreadMetrics(const std::vector< HistogramStaticInfo >& hinfo, const uint32_t ncntrs,
-                                   const uint32_t nhists) :
-        m_histogram_info{hinfo}, m_ncntrs{ncntrs}, m_nhists{nhists} {
+                                   const uint32_t nhists, const uint32_t nsummaries) :
+        m_histogram_info{hinfo}, m_ncntrs{ncntrs}, m_nhists{nhists}, m_nsummaries{nsummaries} {
     m_counters = std::make_unique< CounterValue[] >(ncntrs);
     m_histograms = std::make_unique< HistogramValue[] >(nhists);
+    m_summaries = std::make_unique< SummaryValue[] >(nsummaries);
     std::uninitialized_default_construct(m_counters.get(), m_counters.get() + ncntrs);
     std::uninitialized_default_construct(m_histograms.get(), m_histograms.get() + nhists);
+    std::uninitialized_default_construct(m_summaries.get(), m_summaries.get() + nsummaries);
 
 #if 0
         LOG("ThreadId=%08lux: SafeMetrics=%p constructor, m_counters=%p, m_histograms=%p\n",
@@ -54,6 +62,10 @@ void PerThreadMetrics::merge(PerThreadMetrics* const a, PerThreadMetrics* const
     for (decltype(m_nhists) i{0}; i < a->m_nhists; ++i) {
         a->m_histograms[i].merge(b->m_histograms[i], a->m_histogram_info[i].get_boundaries());
     }
+
+    for (decltype(m_nsummaries) i{0}; i < a->m_nsummaries; ++i) {
+        a->m_summaries[i].merge(b->m_summaries[i]);
+    }
 }
 
 CounterValue& PerThreadMetrics::get_counter(const uint64_t index) {
@@ -66,6 +78,11 @@ HistogramValue& PerThreadMetrics::get_histogram(const uint64_t index) {
     return m_histograms[index];
 }
 
+SummaryValue& PerThreadMetrics::get_summary(const uint64_t index) {
+    assert(index < m_nsummaries);
+    return m_summaries[index];
+}
+
 /******* Thread Local Safe Metrics **********/
 static int outstanding_flush{0};
 static std::mutex flush_cv_mtx;
@@ -82,12 +99,52 @@ static void flush_cache_handler([[maybe_unused]] sisl::logging::SignalType signa
     // std::cout << "Flushing, now outstanding flushes " << outstanding_flush << "\n";
 }
 
+static void install_flush_signal_handler() {
+    static std::once_flag flag;
+    std::call_once(flag, []() { sisl::logging::add_signal_handler(SIGUSR4, "SIGUSR4", &flush_cache_handler); });
+}
+
+/* Private expedited membarrier runs a full memory barrier on every core currently running a thread of this process,
+ * which is the same ordering the signal handler's fence provides, but with one syscall and without interrupting the
+ * threads. It needs the process to register for it once, which is done on first use.
+ */
+static bool membarrier_supported() {
+#if defined(__linux__) && defined(__NR_membarrier)
+    static const bool supported{[]() {
+        const auto cmds{::syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0, 0)};
+        if ((cmds < 0) || !(cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) { return false; }
+        return (::syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0);
+    }()};
+    return supported;
+#else
+    return false;
+#endif
+}
+
+static bool membarrier_flush() {
+#if defined(__linux__) && defined(__NR_membarrier)
+    if (membarrier_supported() && (::syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0) == 0)) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+#endif
+    return false;
+}
+
 ThreadBufferMetricsGroup::~ThreadBufferMetricsGroup() {}
 
+void ThreadBufferMetricsGroup::flush_core_cache() {
+    if (!membarrier_flush()) { flush_core_cache_by_signal(); }
+}
+
+bool ThreadBufferMetricsGroup::flush_core_cache_covers_all_threads() { return membarrier_supported(); }
+
 /* We flush the cache in each thread by sending them a signal and then forcing them to do atomic barrier. Once
  * all threads run atomic barrier, notify the caller and the caller waits on a CV
  */
-void ThreadBufferMetricsGroup::flush_core_cache() {
+void ThreadBufferMetricsGroup::flush_core_cache_by_signal() {
+    install_flush_signal_handler();
+
     outstanding_flush = 0;
     ThreadRegistry::instance()->foreach_running([&]([[maybe_unused]] const uint32_t thread_num, const pthread_t pt) {
         {
@@ -106,21 +163,22 @@ void ThreadBufferMetricsGroup::flush_core_cache() {
 }
 
 void ThreadBufferMetricsGroup::on_register() {
-    static std::once_flag flag1;
-    std::call_once(flag1, [&]() { sisl::logging::add_signal_handler(SIGUSR4, "SIGUSR4", &flush_cache_handler); });
+    // Register for membarrier upfront, so that the first scrape doesn't pay for it
+    if (!membarrier_supported()) { install_flush_signal_handler(); }
 
-    m_metrics_buf =
-        std::make_unique< PerThreadMetricsBuffer >(m_static_info->m_histograms, num_counters(), num_histograms());
-    m_gather_metrics =
-        std::make_unique< PerThreadMetrics >(m_static_info->m_histograms, num_counters(), num_histograms());
+    m_metrics_buf = std::make_unique< PerThreadMetricsBuffer >(m_static_info->m_histograms, num_counters(),
+                                                               num_histograms(), num_summaries());
+    m_gather_metrics = std::make_unique< PerThreadMetrics >(m_static_info->m_histograms, num_counters(),
+                                                            num_histograms(), num_summaries());
 }
 
 void ThreadBufferMetricsGroup::gather_result(const bool need_latest, const counter_gather_cb_t& counter_cb,
                                              const gauge_gather_cb_t& gauge_cb,
-                                             const histogram_gather_cb_t& histogram_cb) {
+                                             const histogram_gather_cb_t& histogram_cb,
+                                             const summary_gather_cb_t& summary_cb) {
     if (need_latest) {
-        m_gather_metrics =
-            std::make_unique< PerThreadMetrics >(m_static_info->m_histograms, num_counters(), num_histograms());
+        m_gather_metrics = std::make_unique< PerThreadMetrics >(m_static_info->m_histograms, num_counters(),
+                                                                num_histograms(), num_summaries());
 
         m_metrics_buf->access_all_threads([&](PerThreadMetrics* tmetrics, [[maybe_unused]] bool is_thread_running,
                                               [[maybe_unused]] bool is_last_thread) {
@@ -140,14 +198,20 @@ void ThreadBufferMetricsGroup::gather_result(const bool need_latest, const count
     for (size_t i{0}; i < num_histograms(); ++i) {
         histogram_cb(i, m_gather_metrics->get_histogram(i));
     }
+
+    for (size_t i{0}; i < num_summaries(); ++i) {
+        summary_cb(i, m_gather_metrics->get_summary(i));
+    }
 }
 
 void ThreadBufferMetricsGroup::counter_increment(const uint64_t index, const int64_t val) {
     m_metrics_buf->get()->get_counter(index).increment(val);
+    mark_updated();
 }
 
 void ThreadBufferMetricsGroup::counter_decrement(const uint64_t index, const int64_t val) {
     m_metrics_buf->get()->get_counter(index).decrement(val);
+    mark_updated();
 }
 
 // If we were to call the method with count parameter and compiler inlines them, binaries linked with libsisl gets
@@ -155,10 +219,23 @@ void ThreadBufferMetricsGroup::counter_decrement(const uint64_t index, const int
 // everyone makes and wanted to avoid additional function call in the stack. Hence we are duplicating the function
 // one with count and one without count. In any case this is a single line method.
 void ThreadBufferMetricsGroup::histogram_observe(const uint64_t index, const int64_t val) {
-    m_metrics_buf->get()->get_histogram(index).observe(val, m_static_info->m_histograms[index].get_boundaries(), 1);
+    m_metrics_buf->get()->get_histogram(index).observe(val, m_static_info->m_histograms[index].bucket_index(val), 1);
+    mark_updated();
 }
 
 void ThreadBufferMetricsGroup::histogram_observe(const uint64_t index, const int64_t val, const uint64_t count) {
-    m_metrics_buf->get()->get_histogram(index).observe(val, m_static_info->m_histograms[index].get_boundaries(), count);
+    m_metrics_buf->get()->get_histogram(index).observe(val, m_static_info->m_histograms[index].bucket_index(val),
+                                                       count);
+    mark_updated();
+}
+
+void ThreadBufferMetricsGroup::summary_observe(const uint64_t index, const int64_t val) {
+    m_metrics_buf->get()->get_summary(index).observe(val, 1);
+    mark_updated();
+}
+
+void ThreadBufferMetricsGroup::summary_observe(const uint64_t index, const int64_t val, const uint64_t count) {
+    m_metrics_buf->get()->get_summary(index).observe(val, count);
+    mark_updated();
 }
 } // namespace sisl
@@ -0,0 +1,160 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cerrno>
+#include <cmath>
+#include <iterator>
+
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include "sisl/metrics/prometheus_text_writer.hpp"
+
+namespace sisl {
+static void append_escaped(std::string& buf, const std::string& str, const bool is_label_value) {
+    for (const auto c : str) {
+        switch (c) {
+        case '\\':
+            buf.append("\\\\");
+            break;
+        case '\n':
+            buf.append("\\n");
+            break;
+        case '"':
+            if (is_label_value) {
+                buf.append("\\\"");
+            } else {
+                buf.push_back(c);
+            }
+            break;
+        default:
+            buf.push_back(c);
+        }
+    }
+}
+
+static void append_value(std::string& buf, const double value) {
+    if (std::isnan(value)) {
+        buf.append("NaN");
+    } else if (std::isinf(value)) {
+        buf.append((value > 0) ? "+Inf" : "-Inf");
+    } else {
+        fmt::format_to(std::back_inserter(buf), "{}", value);
+    }
+}
+
+PrometheusTextWriter::PrometheusTextWriter(const int fd, const size_t flush_size) :
+        m_fd{fd}, m_flush_size{flush_size} {}
+
+void PrometheusTextWriter::begin() {
+    for (auto& f : m_families) {
+        f.samples.clear();
+    }
+    m_out.clear();
+    m_write_failed = false;
+}
+
+std::string& PrometheusTextWriter::family(const std::string& name, const std::string& help, const char* type) {
+    const auto [it, inserted] = m_family_index.try_emplace(name, m_families.size());
+    if (inserted) {
+        m_families.emplace_back();
+        m_families.back().name = name;
+    }
+
+    auto& f = m_families[it->second];
+    if (f.samples.empty()) {
+        f.help = help;
+        f.type = type;
+    }
+    return f.samples;
+}
+
+bool PrometheusTextWriter::finish() {
+    for (const auto& f : m_families) {
+        if (f.samples.empty()) { continue; } // No instances of this metric in this scrape
+        m_out.append("# HELP ").append(f.name).append(" ");
+        append_escaped(m_out, f.help, false /* is_label_value */);
+        m_out.append("\n# TYPE ").append(f.name).append(" ").append(f.type).append("\n");
+        m_out.append(f.samples);
+        write_out(false /* force */);
+    }
+    return write_out(true /* force */);
+}
+
+bool PrometheusTextWriter::write_out(const bool force) {
+    if ((m_fd < 0) || (!force && (m_out.size() < m_flush_size))) { return !m_write_failed; }
+
+    size_t written{0};
+    while (!m_write_failed && (written < m_out.size())) {
+        const auto ret{::write(m_fd, m_out.data() + written, m_out.size() - written)};
+        if (ret >= 0) {
+            written += static_cast< size_t >(ret);
+        } else if (errno != EINTR) {
+            m_write_failed = true;
+        }
+    }
+    m_out.clear();
+    return !m_write_failed;
+}
+
+void PrometheusTextWriter::append_sample(std::string& buf, const std::string& name, const char* suffix,
+                                         const std::string& labels, const std::string& extra_label,
+                                         const double value) {
+    buf.append(name).append(suffix).append("{").append(labels).append(extra_label).append("} ");
+    append_value(buf, value);
+    buf.push_back('\n');
+}
+
+void PrometheusTextWriter::append_sample(std::string& buf, const std::string& name, const char* suffix,
+                                         const std::string& labels, const std::string& extra_label,
+                                         const int64_t value) {
+    buf.append(name).append(suffix).append("{").append(labels).append(extra_label).append("} ");
+    fmt::format_to(std::back_inserter(buf), "{}", value);
+    buf.push_back('\n');
+}
+
+std::string PrometheusTextWriter::make_labels(const std::string& instance_name, const metric_label& label_pair) {
+    std::string labels{"entity=\""};
+    append_escaped(labels, instance_name, true /* is_label_value */);
+    labels.push_back('"');
+    if (!label_pair.first.empty() && !label_pair.second.empty()) {
+        labels.append(",").append(label_pair.first).append("=\"");
+        append_escaped(labels, label_pair.second, true /* is_label_value */);
+        labels.push_back('"');
+    }
+    return labels;
+}
+
+std::string PrometheusTextWriter::make_labels(const std::string& instance_name,
+                                              const std::vector< metric_label >& labels) {
+    std::string text{make_labels(instance_name, metric_label{"", ""})};
+    for (const auto& label : labels) {
+        text.append(",").append(label.first).append("=\"");
+        append_escaped(text, label.second, true /* is_label_value */);
+        text.push_back('"');
+    }
+    return text;
+}
+
+std::string PrometheusTextWriter::make_extra_label(const char* name, const double value) {
+    std::string label{","};
+    label.append(name).append("=\"");
+    append_value(label, value);
+    label.push_back('"');
+    return label;
+}
+} // namespace sisl
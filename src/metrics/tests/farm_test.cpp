@@ -15,12 +15,17 @@
  *
  *********************************************************************************/
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <string>
 #include <thread>
+#include <vector>
+
+#include <unistd.h>
 
 #include <gtest/gtest.h>
 #include <sisl/logging/logging.h>
@@ -144,6 +149,228 @@ TEST(farmTest, gather) {
     th3.join();
 }
 
+TEST(farmTest, parallelGatherSkipsUnchanged) {
+    constexpr size_t ngroups{100};
+    std::vector< MetricsGroupImplPtr > mgroups;
+    for (size_t i{0}; i < ngroups; ++i) {
+        auto mgroup =
+            MetricsGroup::make_group("ParallelGroup", "Instance" + std::to_string(i), group_impl_type_t::atomic);
+        mgroup->register_counter("counter1", "Counter1");
+        MetricsFarm::getInstance().register_metrics_group(mgroup);
+        mgroup->counter_increment(0, i);
+        mgroups.push_back(mgroup);
+    }
+    MetricsFarm::getInstance().set_gather_options(gather_options{4 /* nthreads */, true /* skip_unchanged */});
+
+    auto output = MetricsFarm::getInstance().get_result_in_json();
+    for (size_t i{0}; i < ngroups; ++i) {
+        EXPECT_EQ(output["ParallelGroup"]["Instance" + std::to_string(i)]["Counters"]["Counter1"], i);
+    }
+    MetricsFarm::getInstance().gather();
+    EXPECT_FALSE(mgroups[1]->test_and_clear_updated(scrape_type::json));
+
+    // Only the updated group is scraped again, rest of them are reported from their previous scrape
+    mgroups[1]->counter_increment(0, 10);
+    EXPECT_TRUE(mgroups[1]->test_and_clear_updated(scrape_type::gather));
+    output = MetricsFarm::getInstance().get_result_in_json();
+    EXPECT_EQ(output["ParallelGroup"]["Instance1"]["Counters"]["Counter1"], 11);
+    EXPECT_EQ(output["ParallelGroup"]["Instance2"]["Counters"]["Counter1"], 2);
+
+    const auto prometheus_bytes = MetricsFarm::getInstance().report(ReportFormat::kTextFormat);
+    EXPECT_NE(prometheus_bytes.find("entity=\"Instance99\""), std::string::npos);
+
+    for (auto& mgroup : mgroups) {
+        MetricsFarm::getInstance().deregister_metrics_group(mgroup);
+    }
+    MetricsFarm::getInstance().set_gather_options(gather_options{});
+}
+
+TEST(farmTest, skipUnchangedRacingUpdates) {
+    std::vector< MetricsGroupImplPtr > mgroups;
+    for (const auto type : {group_impl_type_t::atomic, group_impl_type_t::thread_buf_signal}) {
+        auto mgroup = MetricsGroup::make_group("RacingGroup", "Instance" + std::to_string(mgroups.size()), type);
+        mgroup->register_counter("counter1", "Counter1");
+        MetricsFarm::getInstance().register_metrics_group(mgroup);
+        mgroups.push_back(mgroup);
+    }
+    MetricsFarm::getInstance().set_gather_options(gather_options{2 /* nthreads */, true /* skip_unchanged */});
+
+    // An update racing with a scrape which skips unchanged groups is never lost for the scrapes after it
+    constexpr uint64_t nupdates{200000};
+    std::atomic< bool > done{false};
+    std::thread scraper{[&done]() {
+        while (!done.load()) {
+            MetricsFarm::getInstance().get_result_in_json(true /* need_latest */);
+        }
+    }};
+    std::thread updater{[&mgroups]() {
+        for (uint64_t i{0}; i < nupdates; ++i) {
+            for (auto& mgroup : mgroups) {
+                mgroup->counter_increment(0);
+            }
+        }
+    }};
+    updater.join();
+    done.store(true);
+    scraper.join();
+
+    const auto output = MetricsFarm::getInstance().get_result_in_json(true /* need_latest */);
+    for (size_t i{0}; i < mgroups.size(); ++i) {
+        EXPECT_EQ(output["RacingGroup"]["Instance" + std::to_string(i)]["Counters"]["Counter1"], nupdates);
+    }
+
+    for (auto& mgroup : mgroups) {
+        MetricsFarm::getInstance().deregister_metrics_group(mgroup);
+    }
+    MetricsFarm::getInstance().set_gather_options(gather_options{});
+}
+
+TEST(farmTest, prometheusTextWriter) {
+    std::vector< MetricsGroupImplPtr > mgroups;
+    for (const auto& inst : {"Instance1", "Instance2"}) {
+        auto mgroup = MetricsGroup::make_group("TextWriterGroup", inst, group_impl_type_t::atomic);
+        mgroup->register_counter("writer_counter", "Writer counter");
+        mgroup->register_gauge("writer_gauge", "Writer gauge");
+        mgroup->register_histogram("writer_latency", "Writer latency");
+        mgroup->register_summary("writer_size", "Writer size", summary_quantiles_t{0.5});
+        MetricsFarm::getInstance().register_metrics_group(mgroup);
+        mgroup->counter_increment(0, 3);
+        mgroup->gauge_update(0, 7);
+        mgroup->histogram_observe(0, 5);
+        mgroup->histogram_observe(0, 15);
+        mgroup->summary_observe(0, 100);
+        mgroups.push_back(mgroup);
+    }
+
+    PrometheusTextWriter writer;
+    ASSERT_TRUE(MetricsFarm::getInstance().report(writer));
+    const auto text{writer.text()};
+
+    // Both instances are under a single family
+    const auto type_pos{text.find("# TYPE writer_counter counter\n")};
+    ASSERT_NE(type_pos, std::string::npos);
+    EXPECT_EQ(text.find("# TYPE writer_counter counter", type_pos + 1), std::string::npos);
+    EXPECT_NE(text.find("writer_counter{entity=\"Instance1\"} 3\n"), std::string::npos);
+    EXPECT_NE(text.find("writer_counter{entity=\"Instance2\"} 3\n"), std::string::npos);
+    EXPECT_NE(text.find("writer_gauge{entity=\"Instance1\"} 7\n"), std::string::npos);
+    EXPECT_NE(text.find("# TYPE writer_latency histogram\n"), std::string::npos);
+    EXPECT_NE(text.find("writer_latency_bucket{entity=\"Instance1\",le=\"10\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("writer_latency_bucket{entity=\"Instance1\",le=\"+Inf\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("writer_latency_sum{entity=\"Instance1\"} 20\n"), std::string::npos);
+    EXPECT_NE(text.find("writer_latency_count{entity=\"Instance1\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("writer_size{entity=\"Instance2\",quantile=\"0.5\"}"), std::string::npos);
+    EXPECT_NE(text.find("writer_size_count{entity=\"Instance2\"} 1\n"), std::string::npos);
+
+    // Streaming to a file descriptor in small chunks gives the same output
+    std::array< int, 2 > fds;
+    ASSERT_EQ(::pipe(fds.data()), 0);
+    PrometheusTextWriter fd_writer{fds[1], 256 /* flush_size */};
+    ASSERT_TRUE(MetricsFarm::getInstance().report(fd_writer));
+    ::close(fds[1]);
+    EXPECT_TRUE(fd_writer.text().empty());
+
+    std::string streamed;
+    std::array< char, 4096 > buf;
+    ssize_t n;
+    while ((n = ::read(fds[0], buf.data(), buf.size())) > 0) {
+        streamed.append(buf.data(), n);
+    }
+    ::close(fds[0]);
+    EXPECT_EQ(streamed, text);
+
+    for (auto& mgroup : mgroups) {
+        MetricsFarm::getInstance().deregister_metrics_group(mgroup);
+    }
+}
+
+TEST(farmTest, labeledCounter) {
+    auto mgroup = MetricsGroup::make_group("LabeledGroup", "Instance1", group_impl_type_t::atomic);
+    MetricsFarm::getInstance().register_metrics_group(mgroup);
+    auto& family{mgroup->register_labeled_counter("tenant_ops", "Ops per tenant", 2 /* max_label_sets */)};
+
+    // Threads exit before the scrape, so their values are kept after their buffers are freed
+    std::vector< std::thread > threads;
+    for (size_t t{0}; t < 4; ++t) {
+        threads.emplace_back([&family]() {
+            auto tenant1{family.with_labels({"tenant", "t1"})};
+            for (size_t i{0}; i < 1000; ++i) {
+                tenant1.increment();
+                family.with_labels({"tenant", "t2"}).increment(2);
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    // Beyond the cap, all new label sets share the overflow set
+    EXPECT_EQ(family.with_labels({"tenant", "t3"}).index(), family.overflow_index());
+    family.with_labels({"tenant", "t3"}).increment();
+    family.with_labels({"tenant", "t4"}).increment();
+    family.with_labels({"tenant", "t1"}).decrement(1000);
+
+    for (size_t scrape{0}; scrape < 2; ++scrape) {
+        const auto output = MetricsFarm::getInstance().get_result_in_json();
+        const auto& labeled = output["LabeledGroup"][mgroup->instance_name()]["Labeled counters"]["Ops per tenant"];
+        EXPECT_EQ(labeled["tenant=t1"], 3000);
+        EXPECT_EQ(labeled["tenant=t2"], 8000);
+        EXPECT_EQ(labeled["tenant=__overflow__"], 2);
+    }
+
+    PrometheusTextWriter writer;
+    ASSERT_TRUE(MetricsFarm::getInstance().report(writer));
+    const auto text{writer.text()};
+    const auto entity{"entity=\"" + mgroup->instance_name() + "\""};
+    EXPECT_NE(text.find("# TYPE tenant_ops counter\n"), std::string::npos);
+    EXPECT_NE(text.find("tenant_ops{" + entity + ",tenant=\"t2\"} 8000\n"), std::string::npos);
+    EXPECT_NE(text.find("tenant_ops{" + entity + ",tenant=\"__overflow__\"} 2\n"), std::string::npos);
+
+    const auto prometheus_bytes = MetricsFarm::getInstance().report(ReportFormat::kTextFormat);
+    EXPECT_NE(prometheus_bytes.find("tenant=\"t2\""), std::string::npos);
+
+    // User label clashing with the instance label is renamed, in both the reporter and the text writer
+    auto& entity_family{mgroup->register_labeled_counter("entity_ops", "Ops per entity")};
+    entity_family.with_labels({"entity", "e1"}).increment(5);
+    writer.begin();
+    ASSERT_TRUE(MetricsFarm::getInstance().report(writer));
+    EXPECT_NE(writer.text().find("entity_ops{" + entity + ",exported_entity=\"e1\"} 5\n"), std::string::npos);
+    EXPECT_NE(MetricsFarm::getInstance().report(ReportFormat::kTextFormat).find("exported_entity=\"e1\""),
+              std::string::npos);
+
+    MetricsFarm::getInstance().deregister_metrics_group(mgroup);
+}
+
+TEST(farmTest, perCpuGroup) {
+    auto mgroup = MetricsGroup::make_group("PerCpuGroup", "Instance1", group_impl_type_t::per_cpu);
+    mgroup->register_counter("percpu_counter", "PerCpu counter");
+    mgroup->register_histogram("percpu_latency", "PerCpu latency");
+    MetricsFarm::getInstance().register_metrics_group(mgroup);
+    RecordProperty("rseq_enabled", PerCpuMetricsGroup::is_rseq_enabled() ? "true" : "false");
+
+    // Many short lived threads, values stay in the cpu slabs after the threads exit
+    for (size_t round{0}; round < 10; ++round) {
+        std::vector< std::thread > threads;
+        for (size_t t{0}; t < 8; ++t) {
+            threads.emplace_back([&mgroup]() {
+                for (size_t i{0}; i < 10000; ++i) {
+                    mgroup->counter_increment(0);
+                    mgroup->histogram_observe(0, 10);
+                }
+                mgroup->counter_decrement(0, 100);
+            });
+        }
+        for (auto& th : threads) {
+            th.join();
+        }
+    }
+
+    const auto output = mgroup->get_result_in_json(true /* need_latest */);
+    EXPECT_EQ(output["Counters"]["PerCpu counter"], 80 * (10000 - 100));
+    const std::string hist{output["Histograms percentiles (usecs) avg/50/95/99"]["PerCpu latency"]};
+    EXPECT_EQ(hist.substr(0, hist.find(' ')), "10.0");
+    MetricsFarm::getInstance().deregister_metrics_group(mgroup);
+}
+
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,180 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <sisl/logging/logging.h>
+
+#include "sisl/metrics/metrics.hpp"
+
+RCU_REGISTER_INIT
+SISL_LOGGING_INIT(vmod_metrics_framework)
+
+using namespace sisl;
+
+namespace {
+std::vector< int64_t > sample_values() {
+    std::vector< int64_t > values{-5, 0, 1, 7, 8, 9, 10, 1023, 1024, 1025, 4000000, 1ll << 31, (1ll << 32) - 1,
+                                  1ll << 32, std::numeric_limits< int64_t >::max()};
+    std::mt19937_64 re{42};
+    for (uint32_t shift{0}; shift < 40; ++shift) {
+        for (uint32_t i{0}; i < 100; ++i) {
+            values.push_back(static_cast< int64_t >(re() >> (24 + shift)));
+        }
+    }
+    return values;
+}
+} // namespace
+
+TEST(LogLinearBuckets, BoundariesAreIncreasing) {
+    const auto& b{HistogramBucketsType(LogLinearBuckets)};
+    ASSERT_EQ(b.size(), LogLinearBuckets_t::num_buckets);
+    ASSERT_LT(b.size(), HistogramBuckets::max_hist_bkts);
+    for (size_t i{1}; i < b.size(); ++i) {
+        ASSERT_LT(b[i - 1], b[i]);
+    }
+
+    // Every bucket upto the last one has to be reachable
+    for (size_t i{0}; i < b.size(); ++i) {
+        ASSERT_EQ(LogLinearBuckets_t::bucket_index(LogLinearBuckets_t::bucket_upper_bound(i)), i);
+    }
+}
+
+TEST(LogLinearBuckets, IndexMatchesBoundarySearch) {
+    const HistogramStaticInfo info{"loglinear_hist", "Log linear histogram", "", {"", ""},
+                                   HistogramBucketsType(LogLinearBuckets)};
+    ASSERT_TRUE(info.is_log_linear());
+
+    HistogramValue computed;
+    HistogramValue searched;
+    for (const auto v : sample_values()) {
+        const auto idx{info.bucket_index(v)};
+        if (v > 0) {
+            // Bucket has to be the one whose 'le' is the first boundary not below the value
+            if (idx < info.get_boundaries().size()) { ASSERT_LE(v, info.get_boundaries()[idx]); }
+            if (idx > 0) { ASSERT_GT(v, info.get_boundaries()[idx - 1]); }
+        } else {
+            ASSERT_EQ(idx, 0u);
+        }
+        computed.observe(v, idx);
+        searched.observe(v, info.get_boundaries());
+    }
+    ASSERT_EQ(computed.get_freqs(), searched.get_freqs());
+    ASSERT_EQ(computed.get_sum(), searched.get_sum());
+}
+
+TEST(LogLinearBuckets, OtherBucketsUseSearch) {
+    const HistogramStaticInfo info{"default_hist", "Default histogram"};
+    ASSERT_FALSE(info.is_log_linear());
+    ASSERT_EQ(info.bucket_index(0), 0u);
+    ASSERT_EQ(info.bucket_index(10), 0u);
+    ASSERT_EQ(info.bucket_index(11), 1u);
+    ASSERT_EQ(info.bucket_index(std::numeric_limits< int64_t >::max()), info.get_boundaries().size());
+}
+
+TEST(LogLinearBuckets, ObserveAllGroupTypes) {
+    for (const auto type : {group_impl_type_t::rcu, group_impl_type_t::thread_buf_signal, group_impl_type_t::atomic,
+                            group_impl_type_t::per_cpu}) {
+        auto mgroup{MetricsGroup::make_group("LogLinearGroup", "Instance1", type)};
+        mgroup->register_histogram("loglinear_latency", "Log linear latency", HistogramBucketsType(LogLinearBuckets));
+        MetricsFarm::getInstance().register_metrics_group(mgroup);
+
+        for (uint32_t i{0}; i < 100; ++i) {
+            mgroup->histogram_observe(0, 1000);
+        }
+        mgroup->histogram_observe(0, 3000, 100);
+
+        const auto result = mgroup->get_result_in_json(true /* need_latest */);
+        const std::string hist{result["Histograms percentiles (usecs) avg/50/95/99"]["Log linear latency"]};
+        ASSERT_EQ(hist.substr(0, hist.find(' ')), "2000.0");
+        MetricsFarm::getInstance().deregister_metrics_group(mgroup);
+    }
+}
+
+TEST(SummaryValue, QuantileWithinRelativeError) {
+    std::mt19937_64 re{7};
+    std::lognormal_distribution< double > dist{8.0, 2.0};
+    std::vector< int64_t > values;
+    SummaryValue sval;
+    for (uint32_t i{0}; i < 100000; ++i) {
+        const auto v{static_cast< int64_t >(dist(re))};
+        values.push_back(v);
+        sval.observe(v);
+    }
+    std::sort(values.begin(), values.end());
+    ASSERT_EQ(sval.count(), values.size());
+
+    for (const auto q : {0.01, 0.25, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+        const auto rank{static_cast< size_t >(std::ceil(q * static_cast< double >(values.size())))};
+        const auto exact{static_cast< double >(values[rank - 1])};
+        const auto estimate{sval.quantile(q)};
+        ASSERT_LE(std::abs(estimate - exact), exact * 0.016 + 0.5) << "quantile " << q;
+    }
+}
+
+TEST(SummaryValue, MergeIsSameAsObserveAll) {
+    SummaryValue all;
+    SummaryValue a;
+    SummaryValue b;
+    const auto values{sample_values()};
+    for (size_t i{0}; i < values.size(); ++i) {
+        all.observe(values[i]);
+        ((i % 3) ? a : b).observe(values[i]);
+    }
+    a.merge(b);
+    ASSERT_EQ(a.get_counts(), all.get_counts());
+    ASSERT_EQ(a.get_sum(), all.get_sum());
+    for (const auto q : {0.5, 0.99, 0.999}) {
+        ASSERT_EQ(a.quantile(q), all.quantile(q));
+    }
+}
+
+TEST(SummaryValue, ObserveAllGroupTypes) {
+    for (const auto type : {group_impl_type_t::rcu, group_impl_type_t::thread_buf_signal, group_impl_type_t::atomic,
+                            group_impl_type_t::per_cpu}) {
+        auto mgroup{MetricsGroup::make_group("SummaryGroup", "Instance1", type)};
+        mgroup->register_summary("summary_latency", "Summary latency", summary_quantiles_t{0.5, 0.9});
+        MetricsFarm::getInstance().register_metrics_group(mgroup);
+
+        for (int64_t i{1}; i <= 100; ++i) {
+            mgroup->summary_observe(0, i);
+        }
+        mgroup->summary_observe(0, 100, 10);
+
+        const auto result = mgroup->get_result_in_json(true /* need_latest */);
+        const auto& summary = result["Summaries quantiles"]["Summary latency"];
+        ASSERT_EQ(summary["count"].get< uint64_t >(), 110u);
+        ASSERT_NEAR(summary["p50"].get< double >(), 55.0, 1.0);
+        ASSERT_NEAR(summary["p90"].get< double >(), 99.0, 2.0);
+
+        const auto prometheus_bytes = MetricsFarm::getInstance().report(ReportFormat::kTextFormat);
+        ASSERT_NE(prometheus_bytes.find("summary_latency_count"), std::string::npos);
+        ASSERT_NE(prometheus_bytes.find("quantile=\"0.9\""), std::string::npos);
+        MetricsFarm::getInstance().deregister_metrics_group(mgroup);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
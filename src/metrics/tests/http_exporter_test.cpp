@@ -0,0 +1,292 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Author/Developer(s): Harihara Kadayam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+#include <sisl/logging/logging.h>
+#include <sisl/sobject/sobject.hpp>
+
+#include "sisl/metrics/http_exporter.hpp"
+#include "sisl/metrics/metrics.hpp"
+
+RCU_REGISTER_INIT
+SISL_LOGGING_INIT(vmod_metrics_framework)
+
+using namespace sisl;
+
+namespace {
+struct http_response {
+    std::string header;
+    std::string body;
+};
+
+class HttpClient {
+public:
+    explicit HttpClient(const uint16_t port, const int recv_buf_size = 0) {
+        m_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (recv_buf_size > 0) { ::setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &recv_buf_size, sizeof(recv_buf_size)); }
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        m_connected = (::connect(m_fd, reinterpret_cast< sockaddr* >(&addr), sizeof(addr)) == 0);
+    }
+    ~HttpClient() { ::close(m_fd); }
+
+    [[nodiscard]] bool connected() const { return m_connected; }
+
+    bool send(const std::string& request) {
+        return ::send(m_fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast< ssize_t >(request.size());
+    }
+
+    // Reads one response, returns empty header if connection is closed before that
+    http_response receive(const bool head_only = false) {
+        http_response resp;
+        size_t hdr_end;
+        while ((hdr_end = m_buf.find("\r\n\r\n")) == std::string::npos) {
+            if (!read_more()) { return resp; }
+        }
+        resp.header = m_buf.substr(0, hdr_end + 2);
+        m_buf.erase(0, hdr_end + 4);
+
+        const auto cl_pos{resp.header.find("Content-Length: ")};
+        const size_t len{head_only ? 0 : std::strtoul(resp.header.c_str() + cl_pos + 16, nullptr, 10)};
+        while (m_buf.size() < len) {
+            if (!read_more()) { return http_response{}; }
+        }
+        resp.body = m_buf.substr(0, len);
+        m_buf.erase(0, len);
+        return resp;
+    }
+
+    http_response get(const std::string& path, const std::string& extra_headers = "") {
+        send("GET " + path + " HTTP/1.1\r\nHost: localhost\r\n" + extra_headers + "\r\n");
+        return receive();
+    }
+
+    // Returns true if the server closed the connection
+    bool is_closed() { return m_buf.empty() && !read_more(); }
+
+private:
+    bool read_more() {
+        std::array< char, 4096 > buf;
+        const auto n{::recv(m_fd, buf.data(), buf.size(), 0)};
+        if (n <= 0) { return false; }
+        m_buf.append(buf.data(), n);
+        return true;
+    }
+
+private:
+    int m_fd;
+    bool m_connected{false};
+    std::string m_buf;
+};
+
+std::string gunzip(const std::string& in) {
+    z_stream zs{};
+    inflateInit2(&zs, 15 + 16);
+    std::string out(in.size() * 20 + 1024, '\0');
+    zs.next_in = reinterpret_cast< Bytef* >(const_cast< char* >(in.data()));
+    zs.avail_in = in.size();
+    zs.next_out = reinterpret_cast< Bytef* >(out.data());
+    zs.avail_out = out.size();
+    const auto ret{inflate(&zs, Z_FINISH)};
+    out.resize((ret == Z_STREAM_END) ? zs.total_out : 0);
+    inflateEnd(&zs);
+    return out;
+}
+
+class HttpExporterTest : public testing::Test {
+protected:
+    void SetUp() override {
+        m_group = MetricsGroup::make_group("HttpExporterGroup", "Instance1", group_impl_type_t::atomic);
+        m_group->register_counter("http_counter", "Http counter");
+        MetricsFarm::getInstance().register_metrics_group(m_group);
+        m_group->counter_increment(0, 5);
+    }
+
+    void TearDown() override { MetricsFarm::getInstance().deregister_metrics_group(m_group); }
+
+    // Instance name is made unique by the farm, as every test registers the group again
+    std::string counter_sample(const int64_t value) const {
+        return "http_counter{entity=\"" + m_group->instance_name() + "\"} " + std::to_string(value) + "\n";
+    }
+
+    MetricsGroupImplPtr m_group;
+};
+} // namespace
+
+TEST_F(HttpExporterTest, KeepAliveServesAllEndpoints) {
+    MetricsHttpExporter exporter;
+    ASSERT_TRUE(exporter.start());
+    ASSERT_NE(exporter.port(), 0);
+
+    HttpClient client{exporter.port()};
+    ASSERT_TRUE(client.connected());
+
+    auto resp{client.get("/metrics")};
+    ASSERT_EQ(resp.header.rfind("HTTP/1.1 200 OK\r\n", 0), 0u) << resp.header;
+    EXPECT_NE(resp.header.find("Connection: keep-alive"), std::string::npos);
+    EXPECT_NE(resp.body.find(counter_sample(5)), std::string::npos);
+
+    // Same connection is reused for the further requests
+    resp = client.get("/metrics.json");
+    ASSERT_EQ(resp.header.rfind("HTTP/1.1 200 OK\r\n", 0), 0u) << resp.header;
+    const auto json = nlohmann::json::parse(resp.body);
+    EXPECT_EQ(json["HttpExporterGroup"][m_group->instance_name()]["Counters"]["Http counter"], 5);
+
+    resp = client.get("/unknown");
+    EXPECT_EQ(resp.header.rfind("HTTP/1.1 404 Not Found\r\n", 0), 0u) << resp.header;
+    resp = client.get("/status");
+    EXPECT_EQ(resp.header.rfind("HTTP/1.1 404 Not Found\r\n", 0), 0u) << resp.header;
+
+    // Pipelined requests are answered in order
+    ASSERT_TRUE(client.send("HEAD /metrics HTTP/1.1\r\n\r\nGET /metrics HTTP/1.1\r\nConnection: close\r\n\r\n"));
+    resp = client.receive(true /* head_only */);
+    EXPECT_EQ(resp.header.rfind("HTTP/1.1 200 OK\r\n", 0), 0u) << resp.header;
+    resp = client.receive();
+    EXPECT_NE(resp.header.find("Connection: close"), std::string::npos);
+    EXPECT_FALSE(resp.body.empty());
+    EXPECT_TRUE(client.is_closed());
+
+    ASSERT_TRUE(exporter.stop());
+}
+
+TEST_F(HttpExporterTest, SnapshotIsReusedWithinCacheTime) {
+    MetricsHttpExporter cached_exporter{http_exporter_options{"127.0.0.1", 0, 60 * 1000 /* cache_ms */}};
+    MetricsHttpExporter uncached_exporter{http_exporter_options{"127.0.0.1", 0, 0 /* cache_ms */}};
+    ASSERT_TRUE(cached_exporter.start());
+    ASSERT_TRUE(uncached_exporter.start());
+
+    HttpClient cached_client{cached_exporter.port()};
+    HttpClient uncached_client{uncached_exporter.port()};
+    EXPECT_NE(cached_client.get("/metrics").body.find(counter_sample(5)), std::string::npos);
+    EXPECT_NE(uncached_client.get("/metrics").body.find(counter_sample(5)), std::string::npos);
+
+    m_group->counter_increment(0, 2);
+    EXPECT_NE(cached_client.get("/metrics").body.find(counter_sample(5)), std::string::npos);
+    EXPECT_NE(uncached_client.get("/metrics").body.find(counter_sample(7)), std::string::npos);
+
+    // Another scraper on a new connection gets the same snapshot
+    HttpClient another_client{cached_exporter.port()};
+    EXPECT_NE(another_client.get("/metrics").body.find(counter_sample(5)), std::string::npos);
+}
+
+TEST_F(HttpExporterTest, GzipWhenAccepted) {
+    MetricsHttpExporter exporter;
+    ASSERT_TRUE(exporter.start());
+    HttpClient client{exporter.port()};
+
+    const auto plain{client.get("/metrics")};
+    const auto gzipped{client.get("/metrics", "Accept-Encoding: deflate, gzip;q=1.0\r\n")};
+    EXPECT_EQ(plain.header.find("Content-Encoding"), std::string::npos);
+    EXPECT_NE(gzipped.header.find("Content-Encoding: gzip\r\n"), std::string::npos);
+    EXPECT_EQ(gunzip(gzipped.body), plain.body);
+}
+
+TEST_F(HttpExporterTest, StatusTree) {
+    sobject_manager mgr;
+    auto obj{mgr.create_object("module", "http_module", [](const status_request& request) {
+        status_response resp;
+        resp.json["verbose"] = request.verbose_level;
+        return resp;
+    })};
+
+    http_exporter_options options;
+    options.sobject_mgr = &mgr;
+    MetricsHttpExporter exporter{options};
+    ASSERT_TRUE(exporter.start());
+    HttpClient client{exporter.port()};
+
+    const auto resp{client.get("/status?name=http%5Fmodule&verbose=3")};
+    ASSERT_EQ(resp.header.rfind("HTTP/1.1 200 OK\r\n", 0), 0u) << resp.header;
+    EXPECT_EQ(nlohmann::json::parse(resp.body)["verbose"], 3);
+}
+
+TEST_F(HttpExporterTest, FailingCallbackGets500) {
+    sobject_manager mgr;
+    auto obj{mgr.create_object("module", "failing_module", [](const status_request&) -> status_response {
+        throw std::runtime_error("status failed");
+    })};
+
+    http_exporter_options options;
+    options.sobject_mgr = &mgr;
+    MetricsHttpExporter exporter{options};
+    ASSERT_TRUE(exporter.start());
+    HttpClient client{exporter.port()};
+
+    EXPECT_EQ(client.get("/status?name=failing_module").header.rfind("HTTP/1.1 500 ", 0), 0u);
+    EXPECT_EQ(client.get("/metrics").header.rfind("HTTP/1.1 200 OK\r\n", 0), 0u);
+}
+
+TEST_F(HttpExporterTest, PipelinedRequestsBeyondPendingOutput) {
+    MetricsHttpExporter exporter{http_exporter_options{"127.0.0.1", 0, 60 * 1000 /* cache_ms */}};
+    ASSERT_TRUE(exporter.start());
+    HttpClient client{exporter.port(), 4096 /* recv_buf_size */};
+
+    // Responses add up to more than the socket buffers hold, hence while the client is not reading, the exporter
+    // has to stop reading the requests once its pending output is full
+    static constexpr size_t num_requests{50000};
+    std::string requests;
+    for (size_t i{0}; i < num_requests; ++i) {
+        requests.append("GET /metrics HTTP/1.1\r\n\r\n");
+    }
+    std::thread sender{[&client, &requests]() { EXPECT_TRUE(client.send(requests)); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds{1000});
+    size_t num_responses{0};
+    while ((num_responses < num_requests) && (client.receive().body.find(counter_sample(5)) != std::string::npos)) {
+        ++num_responses;
+    }
+    sender.join();
+    EXPECT_EQ(num_responses, num_requests);
+}
+
+TEST_F(HttpExporterTest, BadRequests) {
+    MetricsHttpExporter exporter;
+    ASSERT_TRUE(exporter.start());
+
+    HttpClient post_client{exporter.port()};
+    ASSERT_TRUE(post_client.send("POST /metrics HTTP/1.1\r\nContent-Length: 0\r\n\r\n"));
+    EXPECT_EQ(post_client.receive().header.rfind("HTTP/1.1 405 ", 0), 0u);
+    EXPECT_TRUE(post_client.is_closed());
+
+    HttpClient large_client{exporter.port()};
+    ASSERT_TRUE(large_client.send("GET /metrics HTTP/1.1\r\nX-Filler: " + std::string(32 * 1024, 'x')));
+    EXPECT_EQ(large_client.receive().header.rfind("HTTP/1.1 431 ", 0), 0u);
+    EXPECT_TRUE(large_client.is_closed());
+
+    // Exporter is still serving
+    HttpClient client{exporter.port()};
+    EXPECT_EQ(client.get("/metrics").header.rfind("HTTP/1.1 200 OK\r\n", 0), 0u);
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
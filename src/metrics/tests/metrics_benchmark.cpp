@@ -14,8 +14,11 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <chrono>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include <benchmark/benchmark.h>
 #include <boost/preprocessor/repetition/repeat.hpp>
 
@@ -93,12 +96,14 @@ atomic_counter_groups glob_matomic_grp;
 MetricsGroupImplPtr glob_tbuffer_mgroup;
 MetricsGroupImplPtr glob_rcu_mgroup;
 MetricsGroupImplPtr glob_atomic_mgroup;
+MetricsGroupImplPtr glob_percpu_mgroup;
 
 void setup() {
     // Initialize rcu based metric group
     glob_tbuffer_mgroup = MetricsGroup::make_group("Group1", "Instance1", group_impl_type_t::thread_buf_signal);
     glob_rcu_mgroup = MetricsGroup::make_group("Group2", "Instance1", group_impl_type_t::rcu);
     glob_atomic_mgroup = MetricsGroup::make_group("Group3", "Instance1", group_impl_type_t::atomic);
+    glob_percpu_mgroup = MetricsGroup::make_group("Group4", "Instance1", group_impl_type_t::per_cpu);
 
     for (auto i = 0; i < NCOUNTERS; i++) {
         std::stringstream ss;
@@ -106,6 +111,7 @@ void setup() {
         glob_tbuffer_mgroup->register_counter(ss.str(), " for test", "");
         glob_rcu_mgroup->register_counter(ss.str(), " for test", "");
         glob_atomic_mgroup->register_counter(ss.str(), " for test", "");
+        glob_percpu_mgroup->register_counter(ss.str(), " for test", "");
     }
 
     for (auto i = 0; i < NGAUGES; i++) {
@@ -114,6 +120,7 @@ void setup() {
         glob_tbuffer_mgroup->register_gauge(ss.str(), " for test", "");
         glob_rcu_mgroup->register_gauge(ss.str(), " for test", "");
         glob_atomic_mgroup->register_gauge(ss.str(), " for test", "");
+        glob_percpu_mgroup->register_gauge(ss.str(), " for test", "");
     }
 
     for (auto i = 0; i < NHISTOGRAMS; i++) {
@@ -122,20 +129,24 @@ void setup() {
         glob_tbuffer_mgroup->register_histogram(ss.str(), " for test", "");
         glob_rcu_mgroup->register_histogram(ss.str(), " for test", "");
         glob_atomic_mgroup->register_histogram(ss.str(), " for test", "");
+        glob_percpu_mgroup->register_histogram(ss.str(), " for test", "");
     }
 
     MetricsFarm::getInstance().register_metrics_group(glob_tbuffer_mgroup);
     MetricsFarm::getInstance().register_metrics_group(glob_rcu_mgroup);
     MetricsFarm::getInstance().register_metrics_group(glob_atomic_mgroup);
+    MetricsFarm::getInstance().register_metrics_group(glob_percpu_mgroup);
 }
 
 void teardown() {
     MetricsFarm::getInstance().deregister_metrics_group(glob_tbuffer_mgroup);
     MetricsFarm::getInstance().deregister_metrics_group(glob_rcu_mgroup);
     MetricsFarm::getInstance().deregister_metrics_group(glob_atomic_mgroup);
+    MetricsFarm::getInstance().deregister_metrics_group(glob_percpu_mgroup);
     glob_tbuffer_mgroup.reset();
     glob_rcu_mgroup.reset();
     glob_atomic_mgroup.reset();
+    glob_percpu_mgroup.reset();
 }
 
 void test_counters_write_tbuffer(benchmark::State& state) {
@@ -176,6 +187,45 @@ void test_counters_write_atomic(benchmark::State& state) {
     }
 }
 
+void test_counters_write_percpu(benchmark::State& state) {
+    // Actual test
+    for (auto _ : state) { // Loops upto iteration count
+        for (auto i = 0; i < NCOUNTERS; i++) {
+            glob_percpu_mgroup->counter_increment(i);
+        }
+    }
+}
+
+// Every iteration is a new thread, which per thread buffers pay for with a new buffer and per cpu slabs do not
+template < typename Fn >
+static void run_short_lived_threads(benchmark::State& state, const Fn& update) {
+    for (auto _ : state) { // Loops upto iteration count
+        std::vector< std::thread > threads;
+        for (auto t = 0; t < THREADS; t++) {
+            threads.emplace_back([&update]() {
+                for (auto i = 0; i < NCOUNTERS; i++) {
+                    update(i);
+                }
+            });
+        }
+        for (auto& th : threads) {
+            th.join();
+        }
+    }
+}
+
+void test_counters_short_lived_threads_tbuffer(benchmark::State& state) {
+    run_short_lived_threads(state, [](int i) { glob_tbuffer_mgroup->counter_increment(i); });
+}
+
+void test_counters_short_lived_threads_atomic(benchmark::State& state) {
+    run_short_lived_threads(state, [](int i) { glob_atomic_mgroup->counter_increment(i); });
+}
+
+void test_counters_short_lived_threads_percpu(benchmark::State& state) {
+    run_short_lived_threads(state, [](int i) { glob_percpu_mgroup->counter_increment(i); });
+}
+
 void test_histogram_write_tbuffer(benchmark::State& state) {
     auto v = 1U;
 
@@ -211,6 +261,18 @@ void test_histogram_write_atomic(benchmark::State& state) {
         ++v;
     }
 }
+
+void test_histogram_write_percpu(benchmark::State& state) {
+    auto v = 1U;
+
+    // Actual test
+    for (auto _ : state) { // Loops upto iteration count
+        for (auto i = 0; i < NHISTOGRAMS; i++) {
+            glob_percpu_mgroup->histogram_observe(i, v * (i + 1));
+        }
+        ++v;
+    }
+}
 #else
 
 using namespace metrics;
@@ -290,6 +352,13 @@ void test_metrics_read_tbuffer(benchmark::State& state) {
     // std::cout << "str = " << str << "\n";
 }
 
+void test_metrics_read_percpu(benchmark::State& state) {
+    // Actual test
+    for (auto _ : state) { // Loops upto iteration count
+        glob_percpu_mgroup->gather();
+    }
+}
+
 void test_metrics_read_rcu(benchmark::State& state) {
     std::string str;
     // Actual test
@@ -367,9 +436,108 @@ void test_histogram_read_locked(benchmark::State& state) {
     }
 }
 
+// Latency like values spread over several orders of magnitude, to compare the cost of finding the bucket alone
+static std::vector< int64_t > bucket_test_values() {
+    std::vector< int64_t > values(4096);
+    uint64_t x{88172645463325252ull};
+    for (auto& v : values) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        v = static_cast< int64_t >(x >> (40 + (x % 20)));
+    }
+    return values;
+}
+
+static void observe_values(benchmark::State& state, const HistogramStaticInfo& info) {
+    const auto values{bucket_test_values()};
+    HistogramValue hvalue;
+    for (auto _ : state) { // Loops upto iteration count
+        for (const auto v : values) {
+            hvalue.observe(v, info.bucket_index(v));
+        }
+    }
+    benchmark::DoNotOptimize(hvalue.get_sum());
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+
+void test_histogram_bucket_search(benchmark::State& state) {
+    const HistogramStaticInfo info{"hist", "Sample histogram"};
+    observe_values(state, info);
+}
+
+void test_histogram_bucket_log_linear(benchmark::State& state) {
+    const HistogramStaticInfo info{"hist", "Sample histogram", "", {"", ""}, HistogramBucketsType(LogLinearBuckets)};
+    observe_values(state, info);
+}
+
+/*
+ * Scrape side cost of flushing the per thread caches while range(0) workers keep observing into the thread buffer
+ * group. Workers time every round of observes, so worker_p99_ns shows how much the flush disturbs them.
+ */
+static void flush_with_workers(benchmark::State& state, const bool by_signal) {
+    const auto nworkers{static_cast< size_t >(state.range(0))};
+    std::atomic< bool > stop{false};
+    std::vector< SummaryValue > latencies(nworkers);
+    std::vector< std::thread > workers;
+    for (size_t w{0}; w < nworkers; ++w) {
+        workers.emplace_back([&stop, &latencies, w]() {
+            while (!stop.load(std::memory_order_relaxed)) {
+                const auto start{std::chrono::steady_clock::now()};
+                for (auto i = 0; i < NHISTOGRAMS; i++) {
+                    glob_tbuffer_mgroup->histogram_observe(i, i + 1);
+                }
+                latencies[w].observe(std::chrono::duration_cast< std::chrono::nanoseconds >(
+                                         std::chrono::steady_clock::now() - start)
+                                         .count());
+            }
+        });
+    }
+
+    for (auto _ : state) { // Loops upto iteration count
+        if (by_signal) {
+            ThreadBufferMetricsGroup::flush_core_cache_by_signal();
+        } else {
+            ThreadBufferMetricsGroup::flush_core_cache();
+        }
+    }
+
+    stop.store(true, std::memory_order_relaxed);
+    SummaryValue merged;
+    for (size_t w{0}; w < nworkers; ++w) {
+        workers[w].join();
+        merged.merge(latencies[w]);
+    }
+    state.counters["worker_p99_ns"] = merged.quantile(0.99);
+}
+
+void test_flush_core_cache(benchmark::State& state) { flush_with_workers(state, false /* by_signal */); }
+void test_flush_core_cache_by_signal(benchmark::State& state) { flush_with_workers(state, true /* by_signal */); }
+
+// Full prometheus text scrape through the reporter vs directly from the gathered values
+void test_report_text_format(benchmark::State& state) {
+    for (auto _ : state) { // Loops upto iteration count
+        benchmark::DoNotOptimize(MetricsFarm::getInstance().report(ReportFormat::kTextFormat));
+    }
+}
+
+void test_report_text_writer(benchmark::State& state) {
+    PrometheusTextWriter writer;
+    for (auto _ : state) { // Loops upto iteration count
+        benchmark::DoNotOptimize(MetricsFarm::getInstance().report(writer));
+    }
+}
+
+BENCHMARK(test_histogram_bucket_search);
+BENCHMARK(test_histogram_bucket_log_linear);
+
 BENCHMARK(test_counters_write_atomic)->Iterations(ITERATIONS)->Threads(THREADS);
 BENCHMARK(test_counters_write_rcu)->Iterations(ITERATIONS)->Threads(THREADS);
 BENCHMARK(test_counters_write_tbuffer)->Iterations(ITERATIONS)->Threads(THREADS);
+BENCHMARK(test_counters_write_percpu)->Iterations(ITERATIONS)->Threads(THREADS);
+BENCHMARK(test_counters_short_lived_threads_atomic)->Iterations(ITERATIONS)->UseRealTime();
+BENCHMARK(test_counters_short_lived_threads_tbuffer)->Iterations(ITERATIONS)->UseRealTime();
+BENCHMARK(test_counters_short_lived_threads_percpu)->Iterations(ITERATIONS)->UseRealTime();
 
 // BENCHMARK(test_gauge_write_atomic)->Iterations(ITERATIONS)->Threads(THREADS);
 BENCHMARK(test_gauge_write_tbuffer)->Iterations(ITERATIONS)->Threads(THREADS);
@@ -378,12 +546,20 @@ BENCHMARK(test_gauge_write_tbuffer)->Iterations(ITERATIONS)->Threads(THREADS);
 BENCHMARK(test_histogram_write_atomic)->Iterations(ITERATIONS)->Threads(THREADS);
 BENCHMARK(test_histogram_write_rcu)->Iterations(ITERATIONS)->Threads(THREADS);
 BENCHMARK(test_histogram_write_tbuffer)->Iterations(ITERATIONS)->Threads(THREADS);
+BENCHMARK(test_histogram_write_percpu)->Iterations(ITERATIONS)->Threads(THREADS);
 
 // BENCHMARK(test_gauge_read_atomic)->Iterations(ITERATIONS)->Threads(1);
 // BENCHMARK(test_histogram_read_locked)->Iterations(ITERATIONS)->Threads(1);
 BENCHMARK(test_metrics_read_atomic)->Iterations(ITERATIONS)->Threads(1);
 BENCHMARK(test_metrics_read_tbuffer)->Iterations(ITERATIONS)->Threads(1);
 BENCHMARK(test_metrics_read_rcu)->Iterations(ITERATIONS)->Threads(1);
+BENCHMARK(test_metrics_read_percpu)->Iterations(ITERATIONS)->Threads(1);
+
+BENCHMARK(test_flush_core_cache)->Arg(1)->Arg(4)->Arg(8)->UseRealTime();
+BENCHMARK(test_flush_core_cache_by_signal)->Arg(1)->Arg(4)->Arg(8)->UseRealTime();
+
+BENCHMARK(test_report_text_format);
+BENCHMARK(test_report_text_writer);
 
 int main(int argc, char** argv) {
     setup();
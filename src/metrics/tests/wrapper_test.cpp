@@ -14,7 +14,9 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <atomic>
 #include <iostream>
+#include <stdexcept>
 #include <thread>
 #include <chrono>
 #include <fstream>
@@ -250,6 +252,130 @@ TEST(counterTest, wrapperTest) {
     // std::cout << "Prometheus serialized format: " << prometheus_bytes << "\n";
 }
 
+class QueueMetrics : public MetricsGroupWrapper {
+public:
+    QueueMetrics(const char* inst_name, const std::atomic< int64_t >& depth) :
+            MetricsGroupWrapper("Queue", inst_name), m_depth{depth} {
+        REGISTER_GAUGE_CB(queue_depth, "Queue depth", [this] { return m_depth.load(); });
+        REGISTER_GAUGE_CB(queue_broken, "Queue broken", []() -> int64_t { throw std::runtime_error("broken"); });
+        REGISTER_GAUGE_CB(
+            queue_slow, "Queue slow",
+            [] {
+                std::this_thread::sleep_for(std::chrono::seconds{2});
+                return int64_t{1};
+            },
+            std::chrono::milliseconds{20});
+        register_me_to_farm();
+    }
+
+private:
+    const std::atomic< int64_t >& m_depth;
+};
+
+TEST(gaugeTest, callbackGauge) {
+    std::atomic< int64_t > depth{3};
+    QueueMetrics queue{"queue1", depth};
+    const auto gauges = [&queue]() {
+        return MetricsFarm::getInstance().get_result_in_json()["Queue"][queue.instance_name()]["Gauges"];
+    };
+
+    auto result = gauges();
+    EXPECT_EQ(result["Queue depth"], 3);
+    EXPECT_EQ(result["Queue broken"], 0);
+    EXPECT_EQ(result["Queue slow"], 0);
+
+    // Stuck callback is not waited upon again, failing ones don't affect the rest
+    depth = 8;
+    const auto start{std::chrono::steady_clock::now()};
+    result = gauges();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds{1});
+    EXPECT_EQ(result["Queue depth"], 8);
+    EXPECT_EQ(result["Queue broken"], 0);
+    EXPECT_EQ(result["Queue slow"], 0);
+
+    depth = 5;
+    EXPECT_NE(MetricsFarm::getInstance().report(ReportFormat::kTextFormat).find("queue_depth"), std::string::npos);
+}
+
+TEST(gaugeTest, groupOutlivesRunningCallback) {
+    std::atomic< bool > returned{false};
+    auto group{MetricsGroup::make_group("SlowGauge", "slow1", group_impl_type_t::atomic)};
+    group->register_gauge_cb(
+        "slow_gauge", "Slow gauge",
+        [&returned]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds{500});
+            returned = true;
+            return int64_t{1};
+        },
+        std::chrono::milliseconds{20});
+    MetricsFarm::getInstance().register_metrics_group(group);
+
+    MetricsFarm::getInstance().gather();
+    EXPECT_FALSE(returned);
+
+    // Destroying the group waits for the callback which is still running
+    MetricsFarm::getInstance().deregister_metrics_group(group);
+    group.reset();
+    EXPECT_TRUE(returned);
+}
+
+TEST(gaugeTest, callbackRunsWithoutGroupLock) {
+    std::atomic< bool > returned{false};
+    auto group{MetricsGroup::make_group("LockedGauge", "locked1", group_impl_type_t::atomic)};
+    group->register_gauge_cb(
+        "locked_gauge", "Locked gauge",
+        [&returned]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds{500});
+            returned = true;
+            return int64_t{1};
+        },
+        std::chrono::seconds{5});
+    MetricsFarm::getInstance().register_metrics_group(group);
+
+    std::thread scraper{[]() { MetricsFarm::getInstance().gather(); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    group->attach_gather_cb([]() {}); // Takes the group lock
+    EXPECT_FALSE(returned);
+    scraper.join();
+    EXPECT_TRUE(returned);
+    MetricsFarm::getInstance().deregister_metrics_group(group);
+}
+
+TEST(gaugeTest, stuckCallbackHoldsOnlyItsGauge) {
+    std::atomic< bool > release{false};
+    std::atomic< int64_t > nfast{0};
+    auto group{MetricsGroup::make_group("StuckGauge", "stuck1", group_impl_type_t::atomic)};
+
+    // More stuck callbacks than the runner has workers
+    constexpr size_t nstuck{GaugeCallbackRunner::num_workers + 1};
+    for (size_t i{0}; i < nstuck; ++i) {
+        group->register_gauge_cb(
+            "stuck_gauge" + std::to_string(i), "Stuck gauge " + std::to_string(i),
+            [&release]() {
+                while (!release) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+                }
+                return int64_t{1};
+            },
+            std::chrono::milliseconds{20});
+    }
+    group->register_gauge_cb(
+        "fast_gauge", "Fast gauge", [&nfast]() { return ++nfast; }, std::chrono::milliseconds{200});
+    MetricsFarm::getInstance().register_metrics_group(group);
+
+    // Workers stuck past the timeout are replaced, so the fast callback still gets to run
+    for (int64_t i{1}; i <= 3; ++i) {
+        const auto gauges = group->get_result_in_json(true /* need_latest */)["Gauges"];
+        EXPECT_EQ(gauges["Fast gauge"], i);
+        for (size_t s{0}; s < nstuck; ++s) {
+            EXPECT_EQ(gauges["Stuck gauge " + std::to_string(s)], 0);
+        }
+    }
+
+    release = true;
+    MetricsFarm::getInstance().deregister_metrics_group(group);
+}
+
 // SISL_OPTIONS_ENABLE(logging)
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);